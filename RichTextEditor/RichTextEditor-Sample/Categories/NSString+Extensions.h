@@ -12,6 +12,7 @@ NS_ASSUME_NONNULL_BEGIN
 
 @interface NSString (Extensions)
 
+/// Valid if the link answers a HEAD request with any 2xx status, see RTELinkValidator. complete is called on the main queue.
 - (void)validateURL:(void (^)(bool isValid))complete;
 
 @end
@@ -8,36 +8,22 @@
 
 #import "NSString+Extensions.h"
 
+#import <RichTextEditor/RichTextEditor.h>
+
 @implementation NSString (Extensions)
 
 - (void)validateURL:(void (^)(bool isValid))complete {
-    NSString *urlString = self;
-    NSError *error;
-    NSDataDetector *detector = [NSDataDetector dataDetectorWithTypes:NSTextCheckingTypeLink error:&error];
+    NSURL *url = [NSURL URLWithString:self];
     
-    if (!error && detector) {
-        NSURL *url = [NSURL URLWithString:urlString];
-        NSRange match = [detector rangeOfFirstMatchInString:urlString options:kNilOptions range:NSMakeRange(0, urlString.length)];
-        
-        if ((match.length == urlString.length) && (url.host.length > 0)) {
-            NSMutableURLRequest *request = [NSMutableURLRequest requestWithURL:url];
-            [request setHTTPMethod:@"HEAD"];
-            
-            NSURLSessionDataTask *task = [[NSURLSession sharedSession] dataTaskWithRequest:request completionHandler:^(NSData * _Nullable data, NSURLResponse * _Nullable response, NSError * _Nullable error) {
-                if (!error && [response isKindOfClass:[NSHTTPURLResponse class]] && (((NSHTTPURLResponse *)response).statusCode == 200)) {
-                    complete(YES);
-                } else {
-                    complete(NO);
-                }
-            }];
-            
-            [task resume];
-        } else {
-            complete(NO);
-        }
-    } else {
+    if ((url == nil) || ![RTELinkValidator isWellFormedURLString:self]) {
         complete(NO);
+        return;
     }
+    
+    /// The shared validator caches the result, checking the same link again while typing costs no request.
+    [[RTELinkValidator sharedValidator] validateURL:url completion:^(BOOL isValid) {
+        complete(isValid);
+    }];
 }
 
 @end
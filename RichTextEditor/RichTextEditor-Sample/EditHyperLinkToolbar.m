@@ -46,11 +46,7 @@
     NSString *urlString = [[self.textField stringValue] stringByReplacingOccurrencesOfString:@" " withString:@""];
     
     [urlString validateURL:^(bool isValid) {
-        BOOL isEnabled = isValid || (urlString.length == 0);
-        
-        dispatch_async(dispatch_get_main_queue(), ^{
-            [self.applyButton setEnabled:isEnabled];
-        });
+        [self.applyButton setEnabled:(isValid || (urlString.length == 0))];
     }];
 }
 
@@ -59,13 +55,7 @@
     NSURL *url = [NSURL URLWithString:urlString];
     
     [urlString validateURL:^(bool isValid) {
-        if (isValid && (url != nil)) {
-            dispatch_async(dispatch_get_main_queue(), ^{
-                [self.delegate toolbarDidChangeFormatLink:url];
-            });
-        } else {
-            [self.delegate toolbarDidChangeFormatLink:nil];
-        }
+        [self.delegate toolbarDidChangeFormatLink:((isValid && (url != nil)) ? url : nil)];
     }];
 }
 
@@ -19,5 +19,25 @@ FOUNDATION_EXPORT const unsigned char RichTextEditorVersionString[];
 #include <RichTextEditor/RTERichTextEditor.h>
 #include <RichTextEditor/RTETextFormat.h>
 #include <RichTextEditor/RTEFontManager.h>
+#include <RichTextEditor/RTEFontCache.h>
+#include <RichTextEditor/RTEStyleTable.h>
+#include <RichTextEditor/RTEBinaryDocument.h>
+#include <RichTextEditor/RTEUndoJournal.h>
+#include <RichTextEditor/RTEEditPlan.h>
+#include <RichTextEditor/RTEPasteNormalizer.h>
+#include <RichTextEditor/RTESearchIndex.h>
+#include <RichTextEditor/RTEFormatIndex.h>
+#include <RichTextEditor/RTEDocumentSnapshot.h>
+#include <RichTextEditor/RTEIncrementalHTMLExporter.h>
+#include <RichTextEditor/RTEProgressiveHTMLLoader.h>
+#include <RichTextEditor/RTELinkValidator.h>
+#include <RichTextEditor/RTEEventBus.h>
+#include <RichTextEditor/RTETrace.h>
+#include <RichTextEditor/RTEParagraphIndex.h>
+#include <RichTextEditor/RTEFormatListCache.h>
+#include <RichTextEditor/RTEHTMLSerializer.h>
+#include <RichTextEditor/RTEHTMLSniffer.h>
+#include <RichTextEditor/RTEHTMLParser.h>
+#include <RichTextEditor/RTEBatchConverter.h>
 #include <RichTextEditor/NSFont+RichTextEditor.h>
 #include <RichTextEditor/NSAttributedString+RichTextEditor.h>
@@ -33,6 +33,8 @@
 
 #import "NSFont+RichTextEditor.h"
 #import "RTEFontManager.h"
+#import "RTEParagraphIndex.h"
+#import "RTEHTMLSerializer.h"
 
 @implementation NSAttributedString (RichTextEditor)
 
@@ -104,6 +106,12 @@
         return NSMakeRange(0, 0);
     }
     
+    RTEParagraphIndex *paragraphIndex = [self attachedParagraphIndex];
+    
+    if (paragraphIndex != nil) {
+        return [paragraphIndex paragraphRangeAtLocation:range.location];
+    }
+    
     NSInteger start = -1;
     NSInteger end = -1;
     NSInteger length = 0;
@@ -149,17 +157,34 @@
 
 - (NSArray *)rangeOfParagraphsFromTextRange:(NSRange)textRange {
     NSMutableArray *paragraphRanges = [NSMutableArray array];
-    NSInteger rangeStartIndex = textRange.location;
+    RTEParagraphIndex *paragraphIndex = [self attachedParagraphIndex];
     
-    while (true) {
-        NSRange range = [self firstParagraphRangeFromTextRange:NSMakeRange(rangeStartIndex, 0)];
-        rangeStartIndex = range.location + range.length + 1;
+    if (paragraphIndex != nil) {
+        [paragraphIndex enumerateParagraphsInRange:textRange usingBlock:^(NSRange paragraphRange, BOOL *stop) {
+            [paragraphRanges addObject:[NSValue valueWithRange:paragraphRange]];
+        }];
         
+        return paragraphRanges;
+    }
+    
+    /// Without an index, only the first paragraph is looked up, the following ones are found
+    /// by searching forward for the next newline, so each character is visited once.
+    NSString *string = self.string;
+    NSUInteger length = string.length;
+    NSRange range = [self firstParagraphRangeFromTextRange:NSMakeRange(textRange.location, 0)];
+    
+    while (true) {
         [paragraphRanges addObject:[NSValue valueWithRange:range]];
         
-        if (range.location + range.length >= textRange.location + textRange.length) {
+        if ((NSMaxRange(range) >= NSMaxRange(textRange)) || (NSMaxRange(range) >= length)) {
             break;
         }
+        
+        NSUInteger start = NSMaxRange(range) + 1;
+        NSRange newlineRange = [string rangeOfString:@"\n" options:NSLiteralSearch range:NSMakeRange(start, length - start)];
+        NSUInteger end = (newlineRange.location == NSNotFound) ? length : newlineRange.location;
+        
+        range = NSMakeRange(start, end - start);
     }
     
     return paragraphRanges;
@@ -176,96 +201,7 @@
 }
 
 - (NSString *)htmlString {
-    NSMutableString *htmlString = [NSMutableString string];
-    NSArray *paragraphRanges = [self rangeOfParagraphsFromTextRange:NSMakeRange(0, self.string.length - 1)];
-    
-    for (int i = 0; i < paragraphRanges.count; i++) {
-        NSValue *value = paragraphRanges[i];
-        NSRange range = [value rangeValue];
-        NSDictionary *paragraphDictionary = [self attributesAtIndex:range.location effectiveRange:nil];
-        NSParagraphStyle *paragraphStyle = [paragraphDictionary objectForKey:NSParagraphStyleAttributeName];
-        NSString *textAlignmentString = [self htmlTextAlignmentString:paragraphStyle.alignment];
-        
-        [htmlString appendString:@"<p "];
-        
-        if (textAlignmentString) {
-            [htmlString appendFormat:@"align=\"%@\" ", textAlignmentString];
-        }
-        
-        [htmlString appendFormat:@"style=\""];
-        
-        if (paragraphStyle.firstLineHeadIndent > 0) {
-            [htmlString appendFormat:@"text-indent:%.0fpx; ", paragraphStyle.firstLineHeadIndent - paragraphStyle.headIndent];
-        }
-        
-        if (paragraphStyle.headIndent > 0) {
-            [htmlString appendFormat:@"margin-left:%.0fpx; ", paragraphStyle.headIndent];
-        }
-        
-        
-        [htmlString appendString:@" \">"];
-        
-        [self enumerateAttributesInRange:range
-                                 options:NSAttributedStringEnumerationLongestEffectiveRangeNotRequired
-                              usingBlock:^(NSDictionary *dictionary, NSRange range, BOOL *stop){
-            
-            NSMutableString *fontString = [NSMutableString string];
-            NSFont *font = [dictionary objectForKey:NSFontAttributeName];
-            NSColor *foregroundColor = [dictionary objectForKey:NSForegroundColorAttributeName];
-            NSColor *backGroundColor = [dictionary objectForKey:NSBackgroundColorAttributeName];
-            NSNumber *underline = [dictionary objectForKey:NSUnderlineStyleAttributeName];
-            BOOL hasUnderline = (!underline || underline.intValue == NSUnderlineStyleNone) ? NO : YES;
-            NSNumber *strikeThrough = [dictionary objectForKey:NSStrikethroughStyleAttributeName];
-            BOOL hasStrikeThrough = (!strikeThrough || strikeThrough.intValue == NSUnderlineStyleNone) ? NO : YES;
-            
-            [fontString appendFormat:@"<font "];
-            [fontString appendFormat:@"face=\"%@\" ", font.familyName];
-            
-            // Begin style
-            [fontString appendString:@" style=\" "];
-            
-            [fontString appendFormat:@"font-size:%.0fpx; ", font.pointSize];
-            
-            if (foregroundColor && [foregroundColor isKindOfClass:[NSColor class]]) {
-                [fontString appendFormat:@"color:%@; ", [self htmlRgbColor:foregroundColor]];
-            }
-            
-            if (backGroundColor && [backGroundColor isKindOfClass:[NSColor class]]) {
-                [fontString appendFormat:@"background-color:%@; ", [self htmlRgbColor:backGroundColor]];
-            }
-            
-            [fontString appendString:@"\" "];
-            // End Style
-            
-            [fontString appendString:@">"];
-            [fontString appendString:[[self.string substringFromIndex:range.location] substringToIndex:range.length]];
-            [fontString appendString:@"</font>"];
-            if ([font isBold]) {
-                [fontString insertString:@"<b>" atIndex:0];
-                [fontString insertString:@"</b>" atIndex:fontString.length];
-            }
-            
-            if ([font isItalic]) {
-                [fontString insertString:@"<i>" atIndex:0];
-                [fontString insertString:@"</i>" atIndex:fontString.length];
-            }
-            
-            if (hasUnderline) {
-                [fontString insertString:@"<u>" atIndex:0];
-                [fontString insertString:@"</u>" atIndex:fontString.length];
-            }
-            
-            if (hasStrikeThrough) {
-                [fontString insertString:@"<strike>" atIndex:0];
-                [fontString insertString:@"</strike>" atIndex:fontString.length];
-            }
-            
-            [htmlString appendString:fontString];
-        }];
-        [htmlString appendString:@"</p>"];
-    }
-    
-    return htmlString;
+    return [[RTEHTMLSerializer threadSerializer] HTMLStringFromAttributedString:self];
 }
 
 - (NSURL *)hyperlinkFromTextRange:(NSRange)textRange {
@@ -287,25 +223,12 @@
 
 #pragma mark - Helper Methods -
 
-- (NSString *)htmlTextAlignmentString:(NSTextAlignment)textAlignment {
-    switch (textAlignment) {
-        case NSTextAlignmentLeft:
-            return @"left";
-        case NSTextAlignmentCenter:
-            return @"center";
-        case NSTextAlignmentRight:
-            return @"right";
-        case NSTextAlignmentJustified:
-            return @"justify";
-        default:
-            return nil;
+- (RTEParagraphIndex *)attachedParagraphIndex {
+    if ([self isKindOfClass:[NSTextStorage class]]) {
+        return [(NSTextStorage *)self RTEParagraphIndex];
     }
-}
-
-- (NSString *)htmlRgbColor:(NSColor *)color {
-    CGFloat red = 0.0, green = 0.0, blue = 0.0, alpha = 0.0;
-    [color getRed:&red green:&green blue:&blue alpha:&alpha];
-    return [NSString stringWithFormat:@"rgb(%d,%d,%d)",(int)(red * 255.0), (int)(green * 255.0), (int)(blue * 255.0)];
+    
+    return nil;
 }
 
 @end
@@ -0,0 +1,53 @@
+//
+//  RTEBatchConverter.h
+//  RichTextEditor
+//
+//  Created by lam1611 on 10/18/26.
+//
+
+#import <Cocoa/Cocoa.h>
+
+extern NSErrorDomain const _Nonnull RTEBatchConverterErrorDomain;
+
+typedef NS_ENUM(NSInteger, RTEBatchConverterError) {
+    /// The item is not of the expected class.
+    RTEBatchConverterErrorInvalidItem           = 1,
+    /// The conversion produced no result or raised an exception.
+    RTEBatchConverterErrorConversionFailed      = 2,
+    /// The HTML wasn't exported by this editor and only the AppKit importer, which runs on the main thread, can read it.
+    RTEBatchConverterErrorRequiresMainThread    = 3
+};
+
+/// Called once per item, in no particular order, on the serial delivery queue of the converter.
+/// Exactly one of result and error is non-nil.
+typedef void (^RTEBatchConverterResultHandler)(NSUInteger index, id _Nullable result, NSError *_Nullable error);
+
+/// Converts many documents between HTML and NSAttributedString off the main thread.
+/// Workers take the next unconverted item from a shared cursor, so a worker that finishes a short document
+/// picks up more work instead of waiting on the others.
+/// Results are handed to the result handler as soon as they're ready, and workers stop converting while
+/// maximumPendingResults results are still waiting for the handler, so memory stays bounded on large batches.
+/// @note HTML that wasn't exported by this editor can only be read by the AppKit importer, which has to run on the main thread.
+/// Workers never wait for the main thread, such items fail with RTEBatchConverterErrorRequiresMainThread
+/// and can be converted on the main thread with +[RichTextEditor attributedStringFromHTMLString:defaultAttributes:].
+@interface RTEBatchConverter : NSObject
+
+/// Number of worker threads. Defaults to the number of active processors.
+@property (nonatomic, assign) NSUInteger maximumConcurrentConversions;
+
+/// Number of converted results allowed to wait for the result handler. Defaults to twice the number of workers.
+@property (nonatomic, assign) NSUInteger maximumPendingResults;
+
+/// Converts every HTML string to an NSAttributedString, the same as +[RichTextEditor attributedStringFromHTMLString:defaultAttributes:].
+- (void)convertHTMLStrings:(NSArray<NSString *> *_Nonnull)htmlStrings defaultAttributes:(NSDictionary<NSAttributedStringKey, id> *_Nonnull)defaultAttributes resultHandler:(RTEBatchConverterResultHandler _Nonnull)resultHandler completion:(void (^_Nullable)(void))completion;
+
+/// Converts every NSAttributedString to HTML, the same as +[RichTextEditor htmlStringFromAttributedText:].
+/// The attributed strings must not be mutated until the completion is called.
+- (void)convertAttributedStrings:(NSArray<NSAttributedString *> *_Nonnull)attributedStrings resultHandler:(RTEBatchConverterResultHandler _Nonnull)resultHandler completion:(void (^_Nullable)(void))completion;
+
+/// Collecting variants for batches small enough to keep in memory.
+/// Failed items are NSNull in results, their errors are keyed by index in errors.
+- (void)convertHTMLStrings:(NSArray<NSString *> *_Nonnull)htmlStrings defaultAttributes:(NSDictionary<NSAttributedStringKey, id> *_Nonnull)defaultAttributes completion:(void (^_Nonnull)(NSArray<id> *_Nonnull results, NSDictionary<NSNumber *, NSError *> *_Nonnull errors))completion;
+- (void)convertAttributedStrings:(NSArray<NSAttributedString *> *_Nonnull)attributedStrings completion:(void (^_Nonnull)(NSArray<id> *_Nonnull results, NSDictionary<NSNumber *, NSError *> *_Nonnull errors))completion;
+
+@end
@@ -0,0 +1,199 @@
+//
+//  RTEBatchConverter.m
+//  RichTextEditor
+//
+//  Created by lam1611 on 10/18/26.
+//
+
+#import "RTEBatchConverter.h"
+
+#import <stdatomic.h>
+
+#import "RTERichTextEditor.h"
+#import "RTEHTMLParser.h"
+#import "RTEHTMLSerializer.h"
+
+NSErrorDomain const RTEBatchConverterErrorDomain = @"RTEBatchConverterErrorDomain";
+
+/// Converts one item, owned by a single worker.
+typedef id (^RTEBatchConversion)(id item, NSError **error);
+
+@interface RTEBatchConverter ()
+
+@property (nonatomic, strong) dispatch_queue_t workQueue;
+@property (nonatomic, strong) dispatch_queue_t deliveryQueue;
+
+@end
+
+@implementation RTEBatchConverter
+
+#pragma mark - Initialization -
+
+- (instancetype)init {
+    if (self = [super init]) {
+        _maximumConcurrentConversions = MAX([[NSProcessInfo processInfo] activeProcessorCount], 1);
+        _maximumPendingResults = _maximumConcurrentConversions * 2;
+        _workQueue = dispatch_queue_create("RTEBatchConverter.work", dispatch_queue_attr_make_with_qos_class(DISPATCH_QUEUE_CONCURRENT, QOS_CLASS_UTILITY, 0));
+        _deliveryQueue = dispatch_queue_create("RTEBatchConverter.delivery", DISPATCH_QUEUE_SERIAL);
+    }
+    
+    return self;
+}
+
+#pragma mark - Public Methods -
+
+- (void)convertHTMLStrings:(NSArray<NSString *> *)htmlStrings defaultAttributes:(NSDictionary<NSAttributedStringKey, id> *)defaultAttributes resultHandler:(RTEBatchConverterResultHandler)resultHandler completion:(void (^)(void))completion {
+    NSDictionary *attributes = [defaultAttributes copy];
+    
+    [self convertItems:[htmlStrings copy] expectedClass:[NSString class] conversionFactory:^RTEBatchConversion{
+        /// One parser per worker, its buffers are reused by every document the worker converts.
+        RTEHTMLParser *parser = [[RTEHTMLParser alloc] initWithDefaultAttributes:attributes];
+        
+        return ^id(NSString *htmlString, NSError **error) {
+            if ([RTEHTMLParser isExportedHTML:htmlString]) {
+                NSAttributedString *attributedString = [parser attributedStringFromHTMLString:htmlString];
+                
+                if (attributedString.length > 0) {
+                    return attributedString;
+                }
+            }
+            
+            if (![RichTextEditor isHTML:htmlString]) {
+                return [[NSAttributedString alloc] initWithString:htmlString];
+            }
+            
+            /// Waiting for the main thread here would serialize the batch on it, and deadlock while it's blocked.
+            if (error != NULL) {
+                *error = [NSError errorWithDomain:RTEBatchConverterErrorDomain code:RTEBatchConverterErrorRequiresMainThread userInfo:@{NSLocalizedDescriptionKey: @"HTML not exported by the editor has to be converted on the main thread"}];
+            }
+            
+            return nil;
+        };
+    } resultHandler:resultHandler completion:completion];
+}
+
+- (void)convertAttributedStrings:(NSArray<NSAttributedString *> *)attributedStrings resultHandler:(RTEBatchConverterResultHandler)resultHandler completion:(void (^)(void))completion {
+    [self convertItems:[attributedStrings copy] expectedClass:[NSAttributedString class] conversionFactory:^RTEBatchConversion{
+        /// One serializer per worker rather than the one of the pool thread, its buffer is reused by every document
+        /// the worker converts and released with the batch.
+        RTEHTMLSerializer *serializer = [[RTEHTMLSerializer alloc] init];
+        
+        return ^id(NSAttributedString *attributedString, NSError **error) {
+            /// Blank text exports as itself, the same as +[RichTextEditor htmlStringFromAttributedText:].
+            NSString *string = [attributedString.string stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceAndNewlineCharacterSet]];
+            
+            return (string.length > 0) ? [serializer HTMLStringFromAttributedString:attributedString] : string;
+        };
+    } resultHandler:resultHandler completion:completion];
+}
+
+- (void)convertHTMLStrings:(NSArray<NSString *> *)htmlStrings defaultAttributes:(NSDictionary<NSAttributedStringKey, id> *)defaultAttributes completion:(void (^)(NSArray<id> *, NSDictionary<NSNumber *, NSError *> *))completion {
+    NSMutableArray *results = [self placeholderResultsWithCount:htmlStrings.count];
+    NSMutableDictionary *errors = [[NSMutableDictionary alloc] init];
+    
+    [self convertHTMLStrings:htmlStrings defaultAttributes:defaultAttributes resultHandler:^(NSUInteger index, id result, NSError *error) {
+        [self storeResult:result error:error atIndex:index inResults:results errors:errors];
+    } completion:^{
+        completion(results, errors);
+    }];
+}
+
+- (void)convertAttributedStrings:(NSArray<NSAttributedString *> *)attributedStrings completion:(void (^)(NSArray<id> *, NSDictionary<NSNumber *, NSError *> *))completion {
+    NSMutableArray *results = [self placeholderResultsWithCount:attributedStrings.count];
+    NSMutableDictionary *errors = [[NSMutableDictionary alloc] init];
+    
+    [self convertAttributedStrings:attributedStrings resultHandler:^(NSUInteger index, id result, NSError *error) {
+        [self storeResult:result error:error atIndex:index inResults:results errors:errors];
+    } completion:^{
+        completion(results, errors);
+    }];
+}
+
+#pragma mark - Helper Methods -
+
+- (void)convertItems:(NSArray *)items expectedClass:(Class)expectedClass conversionFactory:(RTEBatchConversion (^)(void))conversionFactory resultHandler:(RTEBatchConverterResultHandler)resultHandler completion:(void (^)(void))completion {
+    NSUInteger count = items.count;
+    NSUInteger numberOfWorkers = MIN(MAX(self.maximumConcurrentConversions, 1), MAX(count, 1));
+    dispatch_queue_t deliveryQueue = self.deliveryQueue;
+    dispatch_semaphore_t pendingResults = dispatch_semaphore_create(MAX(self.maximumPendingResults, 1));
+    dispatch_group_t group = dispatch_group_create();
+    _Atomic(NSUInteger) *nextIndex = malloc(sizeof(_Atomic(NSUInteger)));
+    
+    atomic_init(nextIndex, 0);
+    
+    for (NSUInteger worker = 0; worker < numberOfWorkers; worker++) {
+        dispatch_group_async(group, self.workQueue, ^{
+            RTEBatchConversion conversion = conversionFactory();
+            
+            while (YES) {
+                NSUInteger index = atomic_fetch_add(nextIndex, 1);
+                
+                if (index >= count) {
+                    break;
+                }
+                
+                /// Wait for the handler to catch up before producing another result.
+                dispatch_semaphore_wait(pendingResults, DISPATCH_TIME_FOREVER);
+                
+                @autoreleasepool {
+                    id item = [items objectAtIndex:index];
+                    id result = nil;
+                    NSError *error = nil;
+                    
+                    if (![item isKindOfClass:expectedClass]) {
+                        error = [NSError errorWithDomain:RTEBatchConverterErrorDomain code:RTEBatchConverterErrorInvalidItem userInfo:@{NSLocalizedDescriptionKey: [NSString stringWithFormat:@"Item %lu is a %@, expected %@", (unsigned long)index, [item class], expectedClass]}];
+                    } else {
+                        @try {
+                            result = conversion(item, &error);
+                        } @catch (NSException *e) {
+                            NSLog(@"%s [Line %d] failed with exception: %@", __PRETTY_FUNCTION__, __LINE__, e);
+                            result = nil;
+                        }
+                        
+                        if ((result == nil) && (error == nil)) {
+                            error = [NSError errorWithDomain:RTEBatchConverterErrorDomain code:RTEBatchConverterErrorConversionFailed userInfo:@{NSLocalizedDescriptionKey: [NSString stringWithFormat:@"Item %lu could not be converted", (unsigned long)index]}];
+                        }
+                    }
+                    
+                    if (error != nil) {
+                        result = nil;
+                    }
+                    
+                    dispatch_async(deliveryQueue, ^{
+                        resultHandler(index, result, error);
+                        dispatch_semaphore_signal(pendingResults);
+                    });
+                }
+            }
+        });
+    }
+    
+    /// Every result was queued on the delivery queue before the group finished, the completion runs after them.
+    dispatch_group_notify(group, deliveryQueue, ^{
+        free(nextIndex);
+        
+        if (completion != nil) {
+            completion();
+        }
+    });
+}
+
+- (NSMutableArray *)placeholderResultsWithCount:(NSUInteger)count {
+    NSMutableArray *results = [[NSMutableArray alloc] initWithCapacity:count];
+    
+    for (NSUInteger i = 0; i < count; i++) {
+        [results addObject:[NSNull null]];
+    }
+    
+    return results;
+}
+
+- (void)storeResult:(id)result error:(NSError *)error atIndex:(NSUInteger)index inResults:(NSMutableArray *)results errors:(NSMutableDictionary *)errors {
+    if (result != nil) {
+        [results replaceObjectAtIndex:index withObject:result];
+    } else if (error != nil) {
+        [errors setObject:error forKey:[NSNumber numberWithUnsignedInteger:index]];
+    }
+}
+
+@end
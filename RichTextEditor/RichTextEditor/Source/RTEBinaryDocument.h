@@ -0,0 +1,60 @@
+//
+//  RTEBinaryDocument.h
+//  RichTextEditor
+//
+//  Created by lam1611 on 10/18/26.
+//
+
+#import <Cocoa/Cocoa.h>
+
+#import "RTEStyleTable.h"
+
+extern NSErrorDomain const _Nonnull RTEBinaryDocumentErrorDomain;
+
+typedef NS_ENUM(NSInteger, RTEBinaryDocumentError) {
+    RTEBinaryDocumentErrorInvalidData = 1,
+    RTEBinaryDocumentErrorUnsupportedVersion = 2,
+};
+
+typedef NS_ENUM(uint16_t, RTEBinaryDocumentListType) {
+    RTEBinaryDocumentListTypeBullet = 1,
+    RTEBinaryDocumentListTypeNumbering = 2,
+};
+
+typedef struct {
+    /// The location of the marker, the start of its paragraph.
+    NSUInteger location;
+    RTEBinaryDocumentListType type;
+    /// Nesting level, 0 for the outermost list.
+    uint16_t level;
+} RTEBinaryDocumentListMarker;
+
+/// A versioned binary encoding of an attributed string, used for the editor's pasteboard type.
+///
+/// Layout, all integers little-endian, offsets from the start of the data:
+///   header:  64 bytes, magic "RTEDOC01", uint32 version, then the length or count and the offset of every block
+///   text:    the UTF-16LE code units, at an even offset
+///   runs:    uint32 length, character style ID, paragraph style ID per run
+///   markers: uint32 location, uint16 type, uint16 level per list paragraph
+///   styles:  the character and paragraph styles of the runs, as a secure keyed archive
+/// Every offset, count and ID is validated before use. The text is used in place, without copying, so a
+/// document mapped from a file costs no more than its style table until its attributed string is built.
+@interface RTEBinaryDocument : NSObject
+
+/// The text, backed by the data of the document.
+@property (nonatomic, strong, readonly, nonnull) NSString *string;
+@property (nonatomic, strong, readonly, nonnull) RTEStyleRuns *runs;
+@property (nonatomic, assign, readonly) NSUInteger numberOfListMarkers;
+
+/// The list marker paragraphs are found from the marker characters, their level from the head indent.
++ (NSData *_Nonnull)dataWithAttributedString:(NSAttributedString *_Nonnull)attributedString;
+
+/// Returns nil and sets error if data is not a valid document. data is kept, not copied.
+- (instancetype _Nullable)initWithData:(NSData *_Nonnull)data error:(NSError *_Nullable *_Nullable)error;
+/// Maps the file at url.
+- (instancetype _Nullable)initWithContentsOfURL:(NSURL *_Nonnull)url error:(NSError *_Nullable *_Nullable)error;
+
+- (RTEBinaryDocumentListMarker)listMarkerAtIndex:(NSUInteger)index;
+- (NSAttributedString *_Nonnull)attributedString;
+
+@end
@@ -0,0 +1,417 @@
+//
+//  RTEBinaryDocument.m
+//  RichTextEditor
+//
+//  Created by lam1611 on 10/18/26.
+//
+
+#import "RTEBinaryDocument.h"
+
+#import "RTEDefiniens.h"
+#import "RTELayoutManager.h"
+
+NSErrorDomain const RTEBinaryDocumentErrorDomain = @"RTEBinaryDocumentErrorDomain";
+
+static const char kDocumentMagic[8] = {'R', 'T', 'E', 'D', 'O', 'C', '0', '1'};
+static const uint32_t kDocumentVersion = 1;
+static const NSUInteger kDocumentHeaderLength = 64;
+static const NSUInteger kRunLength = 12;
+static const NSUInteger kListMarkerLength = 8;
+
+/// Header field offsets.
+enum {
+    kHeaderVersion = 8,
+    kHeaderTextLength = 12,
+    kHeaderTextOffset = 16,
+    kHeaderRunCount = 20,
+    kHeaderRunOffset = 24,
+    kHeaderMarkerCount = 28,
+    kHeaderMarkerOffset = 32,
+    kHeaderStyleLength = 36,
+    kHeaderStyleOffset = 40,
+    kHeaderCharacterStyleCount = 44,
+    kHeaderParagraphStyleCount = 48,
+};
+
+static uint32_t RTEReadUInt32(const uint8_t *bytes) {
+    return (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) | ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+}
+
+static uint16_t RTEReadUInt16(const uint8_t *bytes) {
+    return (uint16_t)(bytes[0] | (bytes[1] << 8));
+}
+
+static void RTEWriteUInt32(uint8_t *bytes, uint32_t value) {
+    bytes[0] = (uint8_t)value;
+    bytes[1] = (uint8_t)(value >> 8);
+    bytes[2] = (uint8_t)(value >> 16);
+    bytes[3] = (uint8_t)(value >> 24);
+}
+
+static void RTEAppendUInt32(NSMutableData *data, uint32_t value) {
+    uint8_t bytes[4];
+    RTEWriteUInt32(bytes, value);
+    [data appendBytes:bytes length:4];
+}
+
+static void RTEAppendUInt16(NSMutableData *data, uint16_t value) {
+    uint8_t bytes[2] = {(uint8_t)value, (uint8_t)(value >> 8)};
+    [data appendBytes:bytes length:2];
+}
+
+static void RTEAppendPadding(NSMutableData *data, NSUInteger alignment) {
+    static const uint8_t zeros[8] = {0};
+    NSUInteger remainder = data.length % alignment;
+    
+    if (remainder != 0) {
+        [data appendBytes:zeros length:alignment - remainder];
+    }
+}
+
+/// Releases the document data once the string that uses its text is deallocated.
+static void RTEDataDeallocate(void *pointer, void *info) {
+    CFRelease(info);
+}
+
+@interface RTEBinaryDocument ()
+
+@property (nonatomic, strong) NSData *data;
+@property (nonatomic, assign) NSUInteger markerOffset;
+
+@end
+
+@implementation RTEBinaryDocument
+
+#pragma mark - Initialization -
+
+- (instancetype)initWithContentsOfURL:(NSURL *)url error:(NSError **)error {
+    NSData *data = [NSData dataWithContentsOfURL:url options:NSDataReadingMappedIfSafe error:error];
+    
+    if (data == nil) {
+        return nil;
+    }
+    
+    return [self initWithData:data error:error];
+}
+
+- (instancetype)initWithData:(NSData *)data error:(NSError **)error {
+    if (self = [super init]) {
+        const uint8_t *bytes = data.bytes;
+        NSUInteger length = data.length;
+        
+        if ((length < kDocumentHeaderLength) || (memcmp(bytes, kDocumentMagic, sizeof(kDocumentMagic)) != 0)) {
+            return [self failWithCode:RTEBinaryDocumentErrorInvalidData reason:@"Not a document" error:error];
+        }
+        
+        if (RTEReadUInt32(bytes + kHeaderVersion) != kDocumentVersion) {
+            return [self failWithCode:RTEBinaryDocumentErrorUnsupportedVersion reason:[NSString stringWithFormat:@"Unsupported version %u", RTEReadUInt32(bytes + kHeaderVersion)] error:error];
+        }
+        
+        uint32_t textLength = RTEReadUInt32(bytes + kHeaderTextLength);
+        uint32_t textOffset = RTEReadUInt32(bytes + kHeaderTextOffset);
+        uint32_t runCount = RTEReadUInt32(bytes + kHeaderRunCount);
+        uint32_t runOffset = RTEReadUInt32(bytes + kHeaderRunOffset);
+        uint32_t markerCount = RTEReadUInt32(bytes + kHeaderMarkerCount);
+        uint32_t markerOffset = RTEReadUInt32(bytes + kHeaderMarkerOffset);
+        uint32_t styleLength = RTEReadUInt32(bytes + kHeaderStyleLength);
+        uint32_t styleOffset = RTEReadUInt32(bytes + kHeaderStyleOffset);
+        uint32_t characterStyleCount = RTEReadUInt32(bytes + kHeaderCharacterStyleCount);
+        uint32_t paragraphStyleCount = RTEReadUInt32(bytes + kHeaderParagraphStyleCount);
+        
+        /// The blocks must follow each other in order, inside the data. 64-bit sums can't overflow from 32-bit fields.
+        uint64_t textEnd = (uint64_t)textOffset + (uint64_t)textLength * 2;
+        uint64_t runEnd = (uint64_t)runOffset + (uint64_t)runCount * kRunLength;
+        uint64_t markerEnd = (uint64_t)markerOffset + (uint64_t)markerCount * kListMarkerLength;
+        uint64_t styleEnd = (uint64_t)styleOffset + styleLength;
+        
+        if ((textOffset < kDocumentHeaderLength) || ((textOffset % 2) != 0) || (runOffset < textEnd) || (markerOffset < runEnd) || (styleOffset < markerEnd) || (styleEnd > length)) {
+            return [self failWithCode:RTEBinaryDocumentErrorInvalidData reason:@"Blocks out of bounds" error:error];
+        }
+        
+        NSArray *styles = [RTEBinaryDocument unarchiveStylesFromData:[data subdataWithRange:NSMakeRange(styleOffset, styleLength)]];
+        NSArray<NSDictionary *> *characterStyles = (styles.count == 2) ? styles[0] : nil;
+        NSArray *paragraphStyles = (styles.count == 2) ? styles[1] : nil;
+        
+        if (![characterStyles isKindOfClass:[NSArray class]] || ![paragraphStyles isKindOfClass:[NSArray class]] || (characterStyles.count != characterStyleCount) || (paragraphStyles.count != paragraphStyleCount)) {
+            return [self failWithCode:RTEBinaryDocumentErrorInvalidData reason:@"Invalid style table" error:error];
+        }
+        
+        /// Map the stored IDs to the IDs of a fresh table, the stored paragraph IDs start at 1 like RTEStyleTable's.
+        RTEStyleTable *styleTable = [[RTEStyleTable alloc] init];
+        RTEStyleID *characterStyleIDs = calloc(MAX(characterStyleCount, 1), sizeof(RTEStyleID));
+        RTEStyleID *paragraphStyleIDs = calloc((NSUInteger)paragraphStyleCount + 1, sizeof(RTEStyleID));
+        BOOL isValid = YES;
+        
+        for (uint32_t i = 0; (i < characterStyleCount) && isValid; i++) {
+            isValid = [characterStyles[i] isKindOfClass:[NSDictionary class]];
+            characterStyleIDs[i] = isValid ? [styleTable characterStyleIDForAttributes:characterStyles[i]] : RTEStyleIDNone;
+        }
+        
+        for (uint32_t i = 0; (i < paragraphStyleCount) && isValid; i++) {
+            isValid = [paragraphStyles[i] isKindOfClass:[NSParagraphStyle class]];
+            paragraphStyleIDs[i + 1] = isValid ? [styleTable paragraphStyleIDForParagraphStyle:paragraphStyles[i]] : RTEStyleIDNone;
+        }
+        
+        RTEStyleRuns *runs = [[RTEStyleRuns alloc] initWithStyleTable:styleTable];
+        
+        for (uint32_t i = 0; (i < runCount) && isValid; i++) {
+            const uint8_t *runBytes = bytes + runOffset + (NSUInteger)i * kRunLength;
+            uint32_t characterStyleID = RTEReadUInt32(runBytes + 4);
+            uint32_t paragraphStyleID = RTEReadUInt32(runBytes + 8);
+            
+            isValid = (characterStyleID < characterStyleCount) && (paragraphStyleID <= paragraphStyleCount) && (runs.length + RTEReadUInt32(runBytes) <= textLength);
+            
+            if (isValid) {
+                RTEStyleRun run = {RTEReadUInt32(runBytes), characterStyleIDs[characterStyleID], paragraphStyleIDs[paragraphStyleID]};
+                [runs appendRun:run];
+            }
+        }
+        
+        free(characterStyleIDs);
+        free(paragraphStyleIDs);
+        
+        if (!isValid || (runs.length != textLength)) {
+            return [self failWithCode:RTEBinaryDocumentErrorInvalidData reason:@"Invalid runs" error:error];
+        }
+        
+        const uint8_t *textBytes = bytes + textOffset;
+        unichar bulletCharacter = [[RTELayoutManager kBulletString] characterAtIndex:0];
+        unichar numberingCharacter = [[RTELayoutManager kNumberingString] characterAtIndex:0];
+        
+        for (uint32_t i = 0; i < markerCount; i++) {
+            const uint8_t *markerBytes = bytes + markerOffset + (NSUInteger)i * kListMarkerLength;
+            uint32_t location = RTEReadUInt32(markerBytes);
+            uint16_t type = RTEReadUInt16(markerBytes + 4);
+            unichar expectedCharacter = (type == RTEBinaryDocumentListTypeBullet) ? bulletCharacter : numberingCharacter;
+            
+            if ((location >= textLength) || ((type != RTEBinaryDocumentListTypeBullet) && (type != RTEBinaryDocumentListTypeNumbering)) || (RTEReadUInt16(textBytes + (NSUInteger)location * 2) != expectedCharacter)) {
+                return [self failWithCode:RTEBinaryDocumentErrorInvalidData reason:@"Invalid list marker" error:error];
+            }
+        }
+        
+        _data = data;
+        _runs = runs;
+        _markerOffset = markerOffset;
+        _numberOfListMarkers = markerCount;
+        _string = [RTEBinaryDocument stringWithUTF16LEBytes:textBytes length:textLength ofData:data];
+    }
+    
+    return self;
+}
+
+#pragma mark - Public Methods -
+
++ (NSData *)dataWithAttributedString:(NSAttributedString *)attributedString {
+    NSString *string = attributedString.string;
+    NSUInteger textLength = string.length;
+    RTEStyleTable *styleTable = [[RTEStyleTable alloc] init];
+    RTEStyleRuns *runs = [[RTEStyleRuns alloc] initWithAttributedString:attributedString styleTable:styleTable];
+    NSMutableData *data = [[NSMutableData alloc] initWithLength:kDocumentHeaderLength];
+    
+    /// Text
+    NSUInteger textOffset = data.length;
+    
+    [data increaseLengthBy:textLength * sizeof(unichar)];
+    unichar *characters = (unichar *)((uint8_t *)data.mutableBytes + textOffset);
+    [string getCharacters:characters range:NSMakeRange(0, textLength)];
+    
+    if (NSHostByteOrder() != NS_LittleEndian) {
+        for (NSUInteger i = 0; i < textLength; i++) {
+            characters[i] = NSSwapHostShortToLittle(characters[i]);
+        }
+    }
+    
+    RTEAppendPadding(data, 4);
+    
+    /// Runs
+    NSUInteger runOffset = data.length;
+    
+    for (NSUInteger i = 0; i < runs.count; i++) {
+        RTEStyleRun run = [runs runAtIndex:i];
+        RTEAppendUInt32(data, (uint32_t)run.length);
+        RTEAppendUInt32(data, run.characterStyleID);
+        RTEAppendUInt32(data, run.paragraphStyleID);
+    }
+    
+    /// List markers
+    NSUInteger markerOffset = data.length;
+    uint32_t markerCount = 0;
+    unichar bulletCharacter = [[RTELayoutManager kBulletString] characterAtIndex:0];
+    unichar numberingCharacter = [[RTELayoutManager kNumberingString] characterAtIndex:0];
+    NSUInteger formatListLength = [RTELayoutManager kBulletString].length;
+    NSMutableDictionary<NSString *, NSNumber *> *formatListWidths = [[NSMutableDictionary alloc] init];
+    NSUInteger paragraphStart = 0;
+    
+    while (paragraphStart < textLength) {
+        unichar character = [string characterAtIndex:paragraphStart];
+        
+        if ((character == bulletCharacter) || (character == numberingCharacter)) {
+            NSDictionary *dictionary = [attributedString attributesAtIndex:paragraphStart effectiveRange:NULL];
+            NSParagraphStyle *paragraphStyle = [dictionary objectForKey:NSParagraphStyleAttributeName];
+            NSFont *font = [dictionary objectForKey:NSFontAttributeName];
+            NSString *formatListString = [string substringWithRange:NSMakeRange(paragraphStart, MIN(formatListLength, textLength - paragraphStart))];
+            NSString *key = [NSString stringWithFormat:@"%@\n%@\n%g", formatListString, font.fontName, font.pointSize];
+            NSNumber *formatListWidth = [formatListWidths objectForKey:key];
+            
+            if (formatListWidth == nil) {
+                formatListWidth = @([formatListString sizeWithAttributes:((font != nil) ? @{NSFontAttributeName: font} : @{})].width);
+                [formatListWidths setObject:formatListWidth forKey:key];
+            }
+            
+            /// The same level as -[RTELayoutManager formatListLevelOfParagraphWithRange:], drawing widens the firstLineHeadIndent.
+            NSInteger level = lround((paragraphStyle.headIndent - formatListWidth.doubleValue) / kFirstLineHeadIndent) - 1;
+            
+            RTEAppendUInt32(data, (uint32_t)paragraphStart);
+            RTEAppendUInt16(data, (character == bulletCharacter) ? RTEBinaryDocumentListTypeBullet : RTEBinaryDocumentListTypeNumbering);
+            RTEAppendUInt16(data, (uint16_t)MAX(level, 0));
+            markerCount += 1;
+        }
+        
+        NSRange newlineRange = [string rangeOfString:@"\n" options:NSLiteralSearch range:NSMakeRange(paragraphStart, textLength - paragraphStart)];
+        
+        if (newlineRange.location == NSNotFound) {
+            break;
+        }
+        
+        paragraphStart = NSMaxRange(newlineRange);
+    }
+    
+    /// Styles, the paragraph styles are stored without RTEStyleIDNone.
+    NSMutableArray<NSDictionary *> *characterStyles = [[NSMutableArray alloc] initWithCapacity:styleTable.numberOfCharacterStyles];
+    NSMutableArray<NSParagraphStyle *> *paragraphStyles = [[NSMutableArray alloc] initWithCapacity:styleTable.numberOfParagraphStyles];
+    
+    for (RTEStyleID styleID = 0; styleID < styleTable.numberOfCharacterStyles; styleID++) {
+        [characterStyles addObject:[RTEBinaryDocument secureCodingAttributes:[styleTable characterAttributesForStyleID:styleID]]];
+    }
+    
+    for (RTEStyleID styleID = 1; styleID <= styleTable.numberOfParagraphStyles; styleID++) {
+        [paragraphStyles addObject:[styleTable paragraphStyleForStyleID:styleID]];
+    }
+    
+    NSData *styleData = [RTEBinaryDocument archiveStyles:@[characterStyles, paragraphStyles]];
+    NSUInteger styleOffset = data.length;
+    [data appendData:styleData];
+    
+    uint8_t *header = data.mutableBytes;
+    memcpy(header, kDocumentMagic, sizeof(kDocumentMagic));
+    RTEWriteUInt32(header + kHeaderVersion, kDocumentVersion);
+    RTEWriteUInt32(header + kHeaderTextLength, (uint32_t)textLength);
+    RTEWriteUInt32(header + kHeaderTextOffset, (uint32_t)textOffset);
+    RTEWriteUInt32(header + kHeaderRunCount, (uint32_t)runs.count);
+    RTEWriteUInt32(header + kHeaderRunOffset, (uint32_t)runOffset);
+    RTEWriteUInt32(header + kHeaderMarkerCount, markerCount);
+    RTEWriteUInt32(header + kHeaderMarkerOffset, (uint32_t)markerOffset);
+    RTEWriteUInt32(header + kHeaderStyleLength, (uint32_t)styleData.length);
+    RTEWriteUInt32(header + kHeaderStyleOffset, (uint32_t)styleOffset);
+    RTEWriteUInt32(header + kHeaderCharacterStyleCount, (uint32_t)characterStyles.count);
+    RTEWriteUInt32(header + kHeaderParagraphStyleCount, (uint32_t)paragraphStyles.count);
+    
+    return data;
+}
+
+- (RTEBinaryDocumentListMarker)listMarkerAtIndex:(NSUInteger)index {
+    RTEBinaryDocumentListMarker marker = {NSNotFound, 0, 0};
+    
+    if (index < self.numberOfListMarkers) {
+        const uint8_t *markerBytes = (const uint8_t *)self.data.bytes + self.markerOffset + index * kListMarkerLength;
+        marker.location = RTEReadUInt32(markerBytes);
+        marker.type = RTEReadUInt16(markerBytes + 4);
+        marker.level = RTEReadUInt16(markerBytes + 6);
+    }
+    
+    return marker;
+}
+
+- (NSAttributedString *)attributedString {
+    return [self.runs attributedStringWithString:self.string];
+}
+
+#pragma mark - Helper Methods -
+
+- (id)failWithCode:(RTEBinaryDocumentError)code reason:(NSString *)reason error:(NSError **)error {
+    if (error != NULL) {
+        *error = [NSError errorWithDomain:RTEBinaryDocumentErrorDomain code:code userInfo:@{NSLocalizedDescriptionKey: reason}];
+    }
+    
+    return nil;
+}
+
++ (NSString *)stringWithUTF16LEBytes:(const uint8_t *)bytes length:(NSUInteger)length ofData:(NSData *)data {
+    if (length == 0) {
+        return @"";
+    }
+    
+    if (NSHostByteOrder() != NS_LittleEndian) {
+        return [[NSString alloc] initWithBytes:bytes length:length * 2 encoding:NSUTF16LittleEndianStringEncoding] ?: @"";
+    }
+    
+    /// The allocator keeps data alive for as long as the string uses its bytes.
+    CFAllocatorContext context = {0};
+    context.info = (void *)CFBridgingRetain(data);
+    context.deallocate = RTEDataDeallocate;
+    CFAllocatorRef allocator = CFAllocatorCreate(kCFAllocatorDefault, &context);
+    CFStringRef string = CFStringCreateWithCharactersNoCopy(kCFAllocatorDefault, (const UniChar *)bytes, length, allocator);
+    CFRelease(allocator);
+    
+    return (NSString *)CFBridgingRelease(string);
+}
+
+/// Drops the attribute values that can't be decoded from a secure archive.
++ (NSDictionary *)secureCodingAttributes:(NSDictionary *)attributes {
+    NSMutableDictionary *secureAttributes = [[NSMutableDictionary alloc] initWithCapacity:attributes.count];
+    
+    [attributes enumerateKeysAndObjectsUsingBlock:^(NSAttributedStringKey key, id value, BOOL *stop) {
+        for (Class styleClass in [RTEBinaryDocument styleClasses]) {
+            if ([value isKindOfClass:styleClass]) {
+                [secureAttributes setObject:value forKey:key];
+                break;
+            }
+        }
+    }];
+    
+    return secureAttributes;
+}
+
++ (NSSet<Class> *)styleClasses {
+    static NSSet<Class> *styleClasses = nil;
+    static dispatch_once_t onceToken;
+    
+    dispatch_once(&onceToken, ^{
+        styleClasses = [NSSet setWithObjects:[NSArray class], [NSDictionary class], [NSString class], [NSNumber class], [NSURL class], [NSFont class], [NSColor class], [NSParagraphStyle class], [NSMutableParagraphStyle class], [NSTextTab class], [NSShadow class], nil];
+    });
+    
+    return styleClasses;
+}
+
++ (NSData *)archiveStyles:(NSArray *)styles {
+    @try {
+        NSMutableData *data = [[NSMutableData alloc] init];
+        NSKeyedArchiver *archiver = [[NSKeyedArchiver alloc] initForWritingWithMutableData:data];
+        archiver.requiresSecureCoding = YES;
+        [archiver encodeObject:styles forKey:NSKeyedArchiveRootObjectKey];
+        [archiver finishEncoding];
+        
+        return data;
+    } @catch (NSException *e) {
+        NSLog(@"%s [Line %d] failed with exception: %@", __PRETTY_FUNCTION__, __LINE__, e);
+    }
+    
+    return [NSData data];
+}
+
++ (NSArray *)unarchiveStylesFromData:(NSData *)data {
+    @try {
+        NSKeyedUnarchiver *unarchiver = [[NSKeyedUnarchiver alloc] initForReadingWithData:data];
+        unarchiver.requiresSecureCoding = YES;
+        id styles = [unarchiver decodeObjectOfClasses:[RTEBinaryDocument styleClasses] forKey:NSKeyedArchiveRootObjectKey];
+        [unarchiver finishDecoding];
+        
+        return [styles isKindOfClass:[NSArray class]] ? styles : nil;
+    } @catch (NSException *e) {
+        NSLog(@"%s [Line %d] failed with exception: %@", __PRETTY_FUNCTION__, __LINE__, e);
+    }
+    
+    return nil;
+}
+
+@end
@@ -17,7 +17,17 @@ typedef NS_ENUM(NSInteger, ParagraphIndentation) {
 /// \u00A0: Non-breaking space.
 static const NSString *kNonBreakingSpace = @"\u00A0";
 
+/// Written to the generator meta tag of the exported HTML, identifies documents exported by this editor.
+static const NSString *kHTMLGenerator = @"RichTextEditor";
+
 static const CGFloat kBulletNumberingIndent = 15;
 static const CGFloat kFirstLineHeadIndent = 52;
 
+/// Pastes into single line editors longer than this are inserted this many characters per run loop turn.
+static const NSUInteger kPasteChunkLength = 64 * 1024;
+
+/// HTML characters parsed before a document loaded in chunks is first shown, and per chunk after that.
+static const NSUInteger kHTMLLoadFirstChunkLength = 16 * 1024;
+static const NSUInteger kHTMLLoadChunkLength = 256 * 1024;
+
 #endif /* RTEDefiniens_h */
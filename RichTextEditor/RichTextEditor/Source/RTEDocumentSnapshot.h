@@ -0,0 +1,40 @@
+//
+//  RTEDocumentSnapshot.h
+//  RichTextEditor
+//
+//  Created by lam1611 on 10/18/26.
+//
+
+#import <Cocoa/Cocoa.h>
+
+/// An immutable copy of a document, safe to read from any thread.
+///
+/// The text is kept in a balanced rope of attributed chunks of up to a few thousand characters whose nodes are never changed
+/// once built. An edit builds new nodes along the path to the edit only and shares the rest, so taking a snapshot of a
+/// tracked text storage costs O(1) and later edits cost O(log n) plus the edited text. A snapshot keeps the nodes it
+/// sees alive and frees them when it is released.
+@interface RTEDocumentSnapshot : NSObject <NSCopying>
+
+@property (nonatomic, readonly) NSUInteger length;
+
+/// Builds a snapshot by copying attributedString, O(n).
+- (instancetype _Nonnull)initWithAttributedString:(NSAttributedString *_Nonnull)attributedString;
+
+/// The whole document, put together from the chunks on every call.
+- (NSString *_Nonnull)string;
+- (NSAttributedString *_Nonnull)attributedString;
+- (NSAttributedString *_Nonnull)attributedSubstringFromRange:(NSRange)range;
+
+/// Enumerates the chunks of range in order without copying them as a whole, chunkRange is the range of chunk in the document.
+- (void)enumerateChunksInRange:(NSRange)range usingBlock:(void (^_Nonnull)(NSAttributedString *_Nonnull chunk, NSRange chunkRange, BOOL *_Nonnull stop))block;
+
+@end
+
+@interface NSTextStorage (RTEDocumentSnapshot)
+
+/// Starts keeping a rope of the receiver in sync with every character and attribute edit.
+- (void)attachDocumentSnapshots;
+/// A snapshot of the receiver in O(1), nil if snapshots are not attached or while the receiver is being edited.
+- (RTEDocumentSnapshot *_Nullable)RTEDocumentSnapshot;
+
+@end
@@ -0,0 +1,329 @@
+//
+//  RTEDocumentSnapshot.m
+//  RichTextEditor
+//
+//  Created by lam1611 on 10/18/26.
+//
+
+#import "RTEDocumentSnapshot.h"
+
+#import <objc/runtime.h>
+
+#import "RTETrace.h"
+
+static const NSUInteger kLeafLength = 2048;
+static const void *kDocumentRopeKey = &kDocumentRopeKey;
+
+/// A node of the rope, either a leaf holding a chunk or a branch with both children.
+/// All instance variables are set in the initializer and never written again, which is what makes sharing nodes
+/// between threads safe.
+@interface RTERopeNode : NSObject {
+    @public
+    RTERopeNode *_left;
+    RTERopeNode *_right;
+    NSAttributedString *_chunk;
+    NSUInteger _length;
+    NSUInteger _height;
+}
+
+@end
+
+@implementation RTERopeNode
+
+- (instancetype)initWithChunk:(NSAttributedString *)chunk {
+    if (self = [super init]) {
+        _chunk = [chunk copy];
+        _length = chunk.length;
+        _height = 1;
+    }
+    
+    return self;
+}
+
+- (instancetype)initWithLeft:(RTERopeNode *)left right:(RTERopeNode *)right {
+    if (self = [super init]) {
+        _left = left;
+        _right = right;
+        _length = left->_length + right->_length;
+        _height = MAX(left->_height, right->_height) + 1;
+    }
+    
+    return self;
+}
+
+@end
+
+static inline NSUInteger RTERopeHeight(RTERopeNode *node) {
+    return (node != nil) ? node->_height : 0;
+}
+
+/// A branch of left and right, rotated once if their heights differ by two.
+static RTERopeNode *RTERopeBalance(RTERopeNode *left, RTERopeNode *right) {
+    if (RTERopeHeight(left) > RTERopeHeight(right) + 1) {
+        if (RTERopeHeight(left->_left) >= RTERopeHeight(left->_right)) {
+            return [[RTERopeNode alloc] initWithLeft:left->_left right:[[RTERopeNode alloc] initWithLeft:left->_right right:right]];
+        }
+        
+        RTERopeNode *middle = left->_right;
+        
+        return [[RTERopeNode alloc] initWithLeft:[[RTERopeNode alloc] initWithLeft:left->_left right:middle->_left] right:[[RTERopeNode alloc] initWithLeft:middle->_right right:right]];
+    }
+    
+    if (RTERopeHeight(right) > RTERopeHeight(left) + 1) {
+        if (RTERopeHeight(right->_right) >= RTERopeHeight(right->_left)) {
+            return [[RTERopeNode alloc] initWithLeft:[[RTERopeNode alloc] initWithLeft:left right:right->_left] right:right->_right];
+        }
+        
+        RTERopeNode *middle = right->_left;
+        
+        return [[RTERopeNode alloc] initWithLeft:[[RTERopeNode alloc] initWithLeft:left right:middle->_left] right:[[RTERopeNode alloc] initWithLeft:middle->_right right:right->_right]];
+    }
+    
+    return [[RTERopeNode alloc] initWithLeft:left right:right];
+}
+
+/// Joins two ropes, going down the spine of the taller one until the heights meet, O(difference in height).
+/// Two short leaves become one, so typing does not leave a trail of one character leaves.
+static RTERopeNode *RTERopeConcat(RTERopeNode *left, RTERopeNode *right) {
+    if ((left == nil) || (left->_length == 0)) {
+        return right;
+    }
+    
+    if ((right == nil) || (right->_length == 0)) {
+        return left;
+    }
+    
+    if ((left->_chunk != nil) && (right->_chunk != nil) && (left->_length + right->_length <= kLeafLength)) {
+        NSMutableAttributedString *chunk = [left->_chunk mutableCopy];
+        [chunk appendAttributedString:right->_chunk];
+        
+        return [[RTERopeNode alloc] initWithChunk:chunk];
+    }
+    
+    if (left->_height > right->_height + 1) {
+        return RTERopeBalance(left->_left, RTERopeConcat(left->_right, right));
+    }
+    
+    if (right->_height > left->_height + 1) {
+        return RTERopeBalance(RTERopeConcat(left, right->_left), right->_right);
+    }
+    
+    return [[RTERopeNode alloc] initWithLeft:left right:right];
+}
+
+/// The ropes of the characters before location and from location on, sharing every node not on the path to location.
+static void RTERopeSplit(RTERopeNode *node, NSUInteger location, RTERopeNode *__strong *left, RTERopeNode *__strong *right) {
+    if ((node == nil) || (location == 0)) {
+        *left = nil;
+        *right = node;
+    } else if (location >= node->_length) {
+        *left = node;
+        *right = nil;
+    } else if (node->_chunk != nil) {
+        *left = [[RTERopeNode alloc] initWithChunk:[node->_chunk attributedSubstringFromRange:NSMakeRange(0, location)]];
+        *right = [[RTERopeNode alloc] initWithChunk:[node->_chunk attributedSubstringFromRange:NSMakeRange(location, node->_length - location)]];
+    } else if (location <= node->_left->_length) {
+        RTERopeNode *lower = nil;
+        RTERopeNode *upper = nil;
+        
+        RTERopeSplit(node->_left, location, &lower, &upper);
+        *left = lower;
+        *right = RTERopeConcat(upper, node->_right);
+    } else {
+        RTERopeNode *lower = nil;
+        RTERopeNode *upper = nil;
+        
+        RTERopeSplit(node->_right, location - node->_left->_length, &lower, &upper);
+        *left = RTERopeConcat(node->_left, lower);
+        *right = upper;
+    }
+}
+
+/// A balanced rope of range of attributedString, cut into count leaves of about equal length.
+static RTERopeNode *RTERopeBuild(NSAttributedString *attributedString, NSRange range, NSUInteger count) {
+    if (range.length == 0) {
+        return nil;
+    }
+    
+    if (count <= 1) {
+        return [[RTERopeNode alloc] initWithChunk:[attributedString attributedSubstringFromRange:range]];
+    }
+    
+    NSUInteger leftCount = count / 2;
+    NSUInteger leftLength = (NSUInteger)(range.length * ((double)leftCount / count));
+    
+    return [[RTERopeNode alloc] initWithLeft:RTERopeBuild(attributedString, NSMakeRange(range.location, leftLength), leftCount) right:RTERopeBuild(attributedString, NSMakeRange(range.location + leftLength, range.length - leftLength), count - leftCount)];
+}
+
+static RTERopeNode *RTERopeWithAttributedString(NSAttributedString *attributedString, NSRange range) {
+    return RTERopeBuild(attributedString, range, (range.length + kLeafLength - 1) / kLeafLength);
+}
+
+/// Calls block with the part of each leaf of node inside range, offset being the location of node in the document.
+static BOOL RTERopeEnumerate(RTERopeNode *node, NSUInteger offset, NSRange range, void (^block)(NSAttributedString *chunk, NSRange chunkRange, BOOL *stop)) {
+    if ((node == nil) || (offset >= NSMaxRange(range)) || (offset + node->_length <= range.location)) {
+        return NO;
+    }
+    
+    if (node->_chunk != nil) {
+        NSRange chunkRange = NSIntersectionRange(range, NSMakeRange(offset, node->_length));
+        NSAttributedString *chunk = node->_chunk;
+        BOOL stop = NO;
+        
+        if (chunkRange.length < node->_length) {
+            chunk = [chunk attributedSubstringFromRange:NSMakeRange(chunkRange.location - offset, chunkRange.length)];
+        }
+        
+        block(chunk, chunkRange, &stop);
+        
+        return stop;
+    }
+    
+    return RTERopeEnumerate(node->_left, offset, range, block) || RTERopeEnumerate(node->_right, offset + node->_left->_length, range, block);
+}
+
+@interface RTEDocumentSnapshot () {
+    RTERopeNode *_root;
+}
+
+- (instancetype)initWithRoot:(RTERopeNode *)root;
+
+@end
+
+/// Keeps the rope of a text storage up to date, each snapshot shares the root current when it was taken.
+@interface RTEDocumentRope : NSObject
+
+@property (nonatomic, strong) RTERopeNode *root;
+@property (nonatomic, unsafe_unretained) NSTextStorage *textStorage;
+
+@end
+
+@implementation RTEDocumentSnapshot
+
+#pragma mark - Initialization -
+
+- (instancetype)initWithAttributedString:(NSAttributedString *)attributedString {
+    RTE_TRACE_SCOPE_WITH_ARGUMENT("build document rope", attributedString.length);
+    
+    return [self initWithRoot:RTERopeWithAttributedString(attributedString, NSMakeRange(0, attributedString.length))];
+}
+
+- (instancetype)initWithRoot:(RTERopeNode *)root {
+    if (self = [super init]) {
+        _root = root;
+    }
+    
+    return self;
+}
+
+- (id)copyWithZone:(NSZone *)zone {
+    return self;
+}
+
+#pragma mark - Public Methods -
+
+- (NSUInteger)length {
+    return (_root != nil) ? _root->_length : 0;
+}
+
+- (NSString *)string {
+    NSMutableString *string = [[NSMutableString alloc] initWithCapacity:self.length];
+    
+    [self enumerateChunksInRange:NSMakeRange(0, self.length) usingBlock:^(NSAttributedString *chunk, NSRange chunkRange, BOOL *stop) {
+        [string appendString:chunk.string];
+    }];
+    
+    return string;
+}
+
+- (NSAttributedString *)attributedString {
+    return [self attributedSubstringFromRange:NSMakeRange(0, self.length)];
+}
+
+- (NSAttributedString *)attributedSubstringFromRange:(NSRange)range {
+    NSMutableAttributedString *attributedString = [[NSMutableAttributedString alloc] init];
+    
+    [attributedString beginEditing];
+    [self enumerateChunksInRange:range usingBlock:^(NSAttributedString *chunk, NSRange chunkRange, BOOL *stop) {
+        [attributedString appendAttributedString:chunk];
+    }];
+    [attributedString endEditing];
+    
+    return attributedString;
+}
+
+- (void)enumerateChunksInRange:(NSRange)range usingBlock:(void (^)(NSAttributedString *chunk, NSRange chunkRange, BOOL *stop))block {
+    RTERopeEnumerate(_root, 0, range, block);
+}
+
+@end
+
+@implementation RTEDocumentRope
+
+#pragma mark - Initialization -
+
+- (void)dealloc {
+    if (self.textStorage != nil) {
+        [[NSNotificationCenter defaultCenter] removeObserver:self name:NSTextStorageDidProcessEditingNotification object:self.textStorage];
+    }
+}
+
+#pragma mark - Helper Methods -
+
+- (void)textStorageDidProcessEditing:(NSNotification *)notification {
+    NSTextStorage *textStorage = notification.object;
+    
+    if ([textStorage editedMask] == 0) {
+        return;
+    }
+    
+    /// The edited range covers the new characters, the replaced ones were changeInLength shorter or longer.
+    NSRange editedRange = [textStorage editedRange];
+    NSRange replacedRange = NSMakeRange(editedRange.location, editedRange.length - [textStorage changeInLength]);
+    RTE_TRACE_SCOPE_WITH_ARGUMENT("update document rope", editedRange.length);
+    RTERopeNode *before = nil;
+    RTERopeNode *rest = nil;
+    RTERopeNode *replaced = nil;
+    RTERopeNode *after = nil;
+    
+    RTERopeSplit(self.root, replacedRange.location, &before, &rest);
+    RTERopeSplit(rest, replacedRange.length, &replaced, &after);
+    self.root = RTERopeConcat(RTERopeConcat(before, RTERopeWithAttributedString(textStorage, editedRange)), after);
+    
+    if (((self.root != nil) ? self.root->_length : 0) != textStorage.length) {
+        /// Should never happen, but rebuilding is cheaper than handing out a wrong document.
+        self.root = RTERopeWithAttributedString(textStorage, NSMakeRange(0, textStorage.length));
+    }
+}
+
+@end
+
+@implementation NSTextStorage (RTEDocumentSnapshot)
+
+- (void)attachDocumentSnapshots {
+    if (objc_getAssociatedObject(self, kDocumentRopeKey) != nil) {
+        return;
+    }
+    
+    RTE_TRACE_SCOPE_WITH_ARGUMENT("build document rope", self.length);
+    RTEDocumentRope *documentRope = [[RTEDocumentRope alloc] init];
+    documentRope.root = RTERopeWithAttributedString(self, NSMakeRange(0, self.length));
+    documentRope.textStorage = self;
+    
+    [[NSNotificationCenter defaultCenter] addObserver:documentRope selector:@selector(textStorageDidProcessEditing:) name:NSTextStorageDidProcessEditingNotification object:self];
+    objc_setAssociatedObject(self, kDocumentRopeKey, documentRope, OBJC_ASSOCIATION_RETAIN_NONATOMIC);
+}
+
+- (RTEDocumentSnapshot *)RTEDocumentSnapshot {
+    RTEDocumentRope *documentRope = objc_getAssociatedObject(self, kDocumentRopeKey);
+    NSUInteger length = ((documentRope != nil) && (documentRope.root != nil)) ? documentRope.root->_length : 0;
+    
+    /// While the receiver is being edited, the rope still holds it as it was before the edit.
+    if ((documentRope == nil) || ([self editedMask] != 0) || (length != self.length)) {
+        return nil;
+    }
+    
+    return [[RTEDocumentSnapshot alloc] initWithRoot:documentRope.root];
+}
+
+@end
@@ -0,0 +1,39 @@
+//
+//  RTEEditPlan.h
+//  RichTextEditor
+//
+//  Created by lam1611 on 10/18/26.
+//
+
+#import <Foundation/Foundation.h>
+
+/// A list of replacements and attribute changes, all given in the coordinates of the text the plan was created for,
+/// applied to that text in a single beginEditing/endEditing.
+///
+/// Commands read the unchanged text while they build the plan, so they never have to track how earlier changes
+/// shifted later ranges, and the text storage processes, invalidates and notifies once for the whole command.
+/// Replacements must not overlap. An attribute range is mapped through the replacements: it includes text inserted
+/// at its start but not text inserted at its end.
+@interface RTEEditPlan : NSObject
+
+/// Length of the text the plan was created for.
+@property (nonatomic, assign, readonly) NSUInteger baseLength;
+@property (nonatomic, assign, readonly) NSUInteger numberOfReplacements;
+@property (nonatomic, assign, readonly) NSUInteger numberOfAttributeChanges;
+/// The length change once the plan is committed.
+@property (nonatomic, assign, readonly) NSInteger changeInLength;
+
+- (instancetype _Nonnull)initWithBaseLength:(NSUInteger)baseLength;
+
+- (void)replaceCharactersInRange:(NSRange)range withAttributedString:(NSAttributedString *_Nonnull)attributedString;
+- (void)addAttribute:(NSAttributedStringKey _Nonnull)name value:(id _Nonnull)value range:(NSRange)range;
+- (void)removeAttribute:(NSAttributedStringKey _Nonnull)name range:(NSRange)range;
+
+/// location in the text once the plan is committed.
+- (NSUInteger)mappedLocation:(NSUInteger)location;
+
+/// Applies the plan and returns the range it changed in the resulting text, {NSNotFound, 0} if it changed nothing.
+/// Applies nothing and returns {NSNotFound, 0} if attributedString doesn't have the base length or replacements overlap.
+- (NSRange)commitToAttributedString:(NSMutableAttributedString *_Nonnull)attributedString;
+
+@end
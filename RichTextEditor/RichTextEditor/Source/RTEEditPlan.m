@@ -0,0 +1,254 @@
+//
+//  RTEEditPlan.m
+//  RichTextEditor
+//
+//  Created by lam1611 on 10/18/26.
+//
+
+#import "RTEEditPlan.h"
+
+@interface RTEEditPlanReplacement : NSObject
+
+@property (nonatomic, assign) NSRange range;
+@property (nonatomic, strong) NSAttributedString *attributedString;
+
+@end
+
+@implementation RTEEditPlanReplacement
+
+@end
+
+@interface RTEEditPlanAttributeChange : NSObject
+
+@property (nonatomic, assign) NSRange range;
+@property (nonatomic, copy) NSAttributedStringKey name;
+/// nil to remove the attribute.
+@property (nonatomic, strong) id value;
+
+@end
+
+@implementation RTEEditPlanAttributeChange
+
+@end
+
+@interface RTEEditPlan () {
+    /// Sum of the length changes of the replacements before each sorted replacement.
+    NSInteger *_deltasBefore;
+}
+
+@property (nonatomic, strong) NSMutableArray<RTEEditPlanReplacement *> *replacements;
+@property (nonatomic, strong) NSMutableArray<RTEEditPlanAttributeChange *> *attributeChanges;
+@property (nonatomic, assign) BOOL isSorted;
+
+@end
+
+@implementation RTEEditPlan
+
+#pragma mark - Initialization -
+
+- (instancetype)initWithBaseLength:(NSUInteger)baseLength {
+    if (self = [super init]) {
+        _baseLength = baseLength;
+        _changeInLength = 0;
+        _replacements = [[NSMutableArray alloc] init];
+        _attributeChanges = [[NSMutableArray alloc] init];
+        _isSorted = YES;
+        _deltasBefore = NULL;
+    }
+    
+    return self;
+}
+
+- (void)dealloc {
+    free(_deltasBefore);
+}
+
+#pragma mark - Public Methods -
+
+- (NSUInteger)numberOfReplacements {
+    return self.replacements.count;
+}
+
+- (NSUInteger)numberOfAttributeChanges {
+    return self.attributeChanges.count;
+}
+
+- (void)replaceCharactersInRange:(NSRange)range withAttributedString:(NSAttributedString *)attributedString {
+    if ((range.length == 0) && (attributedString.length == 0)) {
+        return;
+    }
+    
+    RTEEditPlanReplacement *replacement = [[RTEEditPlanReplacement alloc] init];
+    replacement.range = range;
+    replacement.attributedString = [attributedString copy];
+    
+    RTEEditPlanReplacement *lastReplacement = self.replacements.lastObject;
+    
+    if ((lastReplacement != nil) && (lastReplacement.range.location >= range.location)) {
+        self.isSorted = NO;
+    }
+    
+    [self.replacements addObject:replacement];
+    _changeInLength += (NSInteger)attributedString.length - (NSInteger)range.length;
+    
+    free(_deltasBefore);
+    _deltasBefore = NULL;
+}
+
+- (void)addAttribute:(NSAttributedStringKey)name value:(id)value range:(NSRange)range {
+    RTEEditPlanAttributeChange *attributeChange = [[RTEEditPlanAttributeChange alloc] init];
+    attributeChange.range = range;
+    attributeChange.name = name;
+    attributeChange.value = value;
+    
+    [self.attributeChanges addObject:attributeChange];
+}
+
+- (void)removeAttribute:(NSAttributedStringKey)name range:(NSRange)range {
+    RTEEditPlanAttributeChange *attributeChange = [[RTEEditPlanAttributeChange alloc] init];
+    attributeChange.range = range;
+    attributeChange.name = name;
+    
+    [self.attributeChanges addObject:attributeChange];
+}
+
+- (NSUInteger)mappedLocation:(NSUInteger)location {
+    if (![self prepareReplacements]) {
+        return location;
+    }
+    
+    return [self mappedLocation:location isEnd:NO];
+}
+
+- (NSRange)commitToAttributedString:(NSMutableAttributedString *)attributedString {
+    if ((attributedString.length != self.baseLength) || ![self prepareReplacements]) {
+        NSLog(@"%s [Line %d] edit plan doesn't apply to the text, discarding it", __PRETTY_FUNCTION__, __LINE__);
+        return NSMakeRange(NSNotFound, 0);
+    }
+    
+    NSUInteger changedStart = NSUIntegerMax;
+    NSUInteger changedEnd = 0;
+    
+    for (RTEEditPlanReplacement *replacement in self.replacements) {
+        NSUInteger start = [self mappedLocation:replacement.range.location isEnd:NO];
+        changedStart = MIN(changedStart, start);
+        changedEnd = MAX(changedEnd, start + replacement.attributedString.length);
+    }
+    
+    NSMutableArray<NSValue *> *attributeRanges = [[NSMutableArray alloc] initWithCapacity:self.attributeChanges.count];
+    
+    for (RTEEditPlanAttributeChange *attributeChange in self.attributeChanges) {
+        NSUInteger start = [self mappedLocation:attributeChange.range.location isEnd:NO];
+        NSUInteger end = MAX([self mappedLocation:NSMaxRange(attributeChange.range) isEnd:YES], start);
+        
+        [attributeRanges addObject:[NSValue valueWithRange:NSMakeRange(start, end - start)]];
+        
+        if (end > start) {
+            changedStart = MIN(changedStart, start);
+            changedEnd = MAX(changedEnd, end);
+        }
+    }
+    
+    if (changedStart == NSUIntegerMax) {
+        return NSMakeRange(NSNotFound, 0);
+    }
+    
+    [attributedString beginEditing];
+    
+    /// Back to front, so the base ranges of the replacements not applied yet stay valid.
+    for (RTEEditPlanReplacement *replacement in [self.replacements reverseObjectEnumerator]) {
+        [attributedString replaceCharactersInRange:replacement.range withAttributedString:replacement.attributedString];
+    }
+    
+    [self.attributeChanges enumerateObjectsUsingBlock:^(RTEEditPlanAttributeChange *attributeChange, NSUInteger index, BOOL *stop) {
+        NSRange range = [attributeRanges[index] rangeValue];
+        
+        if (range.length == 0) {
+            return;
+        }
+        
+        if (attributeChange.value != nil) {
+            [attributedString addAttribute:attributeChange.name value:attributeChange.value range:range];
+        } else {
+            [attributedString removeAttribute:attributeChange.name range:range];
+        }
+    }];
+    
+    [attributedString endEditing];
+    
+    return NSMakeRange(changedStart, changedEnd - changedStart);
+}
+
+#pragma mark - Helper Methods -
+
+/// Sorts the replacements, checks they don't overlap and fit the base text, and sums up their length changes.
+- (BOOL)prepareReplacements {
+    if (_deltasBefore != NULL) {
+        return YES;
+    }
+    
+    if (!self.isSorted) {
+        [self.replacements sortWithOptions:NSSortStable usingComparator:^NSComparisonResult(RTEEditPlanReplacement *replacement1, RTEEditPlanReplacement *replacement2) {
+            if (replacement1.range.location == replacement2.range.location) {
+                return NSOrderedSame;
+            }
+            
+            return (replacement1.range.location < replacement2.range.location) ? NSOrderedAscending : NSOrderedDescending;
+        }];
+        self.isSorted = YES;
+    }
+    
+    NSUInteger count = self.replacements.count;
+    NSInteger *deltasBefore = malloc((count + 1) * sizeof(NSInteger));
+    NSUInteger previousEnd = 0;
+    
+    deltasBefore[0] = 0;
+    
+    for (NSUInteger i = 0; i < count; i++) {
+        NSRange range = self.replacements[i].range;
+        
+        /// Two replacements at one location would make the order of their texts ambiguous.
+        if ((NSMaxRange(range) > self.baseLength) || ((i > 0) && ((range.location < previousEnd) || (range.location == self.replacements[i - 1].range.location)))) {
+            free(deltasBefore);
+            return NO;
+        }
+        
+        previousEnd = NSMaxRange(range);
+        deltasBefore[i + 1] = deltasBefore[i] + (NSInteger)self.replacements[i].attributedString.length - (NSInteger)range.length;
+    }
+    
+    _deltasBefore = deltasBefore;
+    
+    return YES;
+}
+
+- (NSUInteger)mappedLocation:(NSUInteger)location isEnd:(BOOL)isEnd {
+    /// The number of replacements starting before location.
+    NSUInteger low = 0;
+    NSUInteger high = self.replacements.count;
+    
+    while (low < high) {
+        NSUInteger middle = (low + high) / 2;
+        
+        if (self.replacements[middle].range.location < location) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    
+    if (low > 0) {
+        RTEEditPlanReplacement *replacement = self.replacements[low - 1];
+        
+        if (location < NSMaxRange(replacement.range)) {
+            /// Inside a replaced range: starts snap to the start of the new text, ends to its end.
+            NSUInteger start = (NSUInteger)((NSInteger)replacement.range.location + _deltasBefore[low - 1]);
+            
+            return isEnd ? start + replacement.attributedString.length : start;
+        }
+    }
+    
+    return (NSUInteger)((NSInteger)location + _deltasBefore[low]);
+}
+
+@end
@@ -0,0 +1,71 @@
+//
+//  RTEEventBus.h
+//  RichTextEditor
+//
+//  Created by lam1611 on 10/18/26.
+//
+
+#import <Foundation/Foundation.h>
+
+typedef NS_OPTIONS(NSUInteger, RTEEditorEventType) {
+    RTEEditorEventTypeTextChange                = 1 << 0,
+    RTEEditorEventTypeSelectionChange           = 1 << 1,
+    RTEEditorEventTypeTypingAttributesChange    = 1 << 2,
+    /// A user action about to change the editor, the detail of the event is its RichTextEditorPreviewChange.
+    RTEEditorEventTypePreviewChange             = 1 << 3,
+    RTEEditorEventTypeAll                       = (1 << 4) - 1
+};
+
+typedef NS_ENUM(NSInteger, RTEEventDelivery) {
+    /// The handler is called by the post, with a record of that event alone.
+    RTEEventDeliverySynchronous,
+    /// The events of a frame are merged into one record per type and detail and handed over together at the next frame boundary.
+    RTEEventDeliveryCoalesced
+};
+
+/// A change record: one event, or all the events of a type and detail posted during a frame.
+@interface RTEEditorEvent : NSObject
+
+@property (nonatomic, readonly) RTEEditorEventType type;
+@property (nonatomic, readonly) NSInteger detail;
+/// Text changes: the characters changed, in the text after the last merged change.
+/// Other events: the range of the last merged event, e.g. the selection.
+@property (nonatomic, readonly) NSRange range;
+/// Text changes: the change of the text length, summed over the merged changes.
+@property (nonatomic, readonly) NSInteger changeInLength;
+@property (nonatomic, readonly) NSUInteger numberOfEvents;
+/// System uptime in seconds when the first merged event was posted.
+@property (nonatomic, readonly) NSTimeInterval timestamp;
+
+@end
+
+typedef void (^RTEEventBusHandler)(NSArray<RTEEditorEvent *> *_Nonnull events);
+
+/// Hands editor events to subscribers, either as they are posted or coalesced per frame.
+///
+/// A drag-select or key repeat posts many events of the same type between two frames. Subscribers that only redraw,
+/// like a toolbar, subscribe for coalesced delivery and get one record per type with the merged ranges once per frame.
+/// The bus is confined to its queue: post, subscribe and flush there.
+@interface RTEEventBus : NSObject
+
+/// Seconds between two frame boundaries, coalesced records are delivered at the first one after they are posted.
+/// Defaults to 1/60.
+@property (nonatomic, assign) NSTimeInterval frameInterval;
+/// Number of records waiting for the next frame boundary.
+@property (nonatomic, readonly) NSUInteger numberOfPendingRecords;
+
+/// Bus on the main queue.
+- (instancetype _Nonnull)init;
+- (instancetype _Nonnull)initWithQueue:(dispatch_queue_t _Nonnull)queue;
+
+/// Returns the subscription to pass to removeSubscriber:. handler is called with the records of the types asked for only.
+- (id _Nonnull)addSubscriberForEventTypes:(RTEEditorEventType)types delivery:(RTEEventDelivery)delivery handler:(RTEEventBusHandler _Nonnull)handler;
+- (void)removeSubscriber:(id _Nonnull)subscriber;
+
+/// Does nothing if no subscriber asked for type.
+- (void)postEventOfType:(RTEEditorEventType)type detail:(NSInteger)detail range:(NSRange)range changeInLength:(NSInteger)changeInLength;
+
+/// Delivers the pending records now instead of at the next frame boundary.
+- (void)flush;
+
+@end
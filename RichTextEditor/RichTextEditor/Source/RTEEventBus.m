@@ -0,0 +1,245 @@
+//
+//  RTEEventBus.m
+//  RichTextEditor
+//
+//  Created by lam1611 on 10/18/26.
+//
+
+#import "RTEEventBus.h"
+
+#import "RTETrace.h"
+
+@interface RTEEditorEvent ()
+
+@property (nonatomic, readwrite) RTEEditorEventType type;
+@property (nonatomic, readwrite) NSInteger detail;
+@property (nonatomic, readwrite) NSRange range;
+@property (nonatomic, readwrite) NSInteger changeInLength;
+@property (nonatomic, readwrite) NSUInteger numberOfEvents;
+@property (nonatomic, readwrite) NSTimeInterval timestamp;
+
+@end
+
+@implementation RTEEditorEvent
+
+/// Takes the next event of the same type and detail into the record.
+- (void)mergeRange:(NSRange)range changeInLength:(NSInteger)changeInLength {
+    self.numberOfEvents++;
+    
+    if (self.type != RTEEditorEventTypeTextChange) {
+        self.range = range;
+        return;
+    }
+    
+    /// Moves the changed range of the record into the text after this change, which replaced the
+    /// characters from range.location to oldEnd, then adds the characters of this change.
+    NSInteger location = (NSInteger)range.location;
+    NSInteger end = (NSInteger)NSMaxRange(range);
+    NSInteger oldEnd = end - changeInLength;
+    NSInteger recordStart = (NSInteger)self.range.location;
+    NSInteger recordEnd = (NSInteger)NSMaxRange(self.range);
+    
+    if (recordStart > location) {
+        recordStart = (recordStart >= oldEnd) ? recordStart + changeInLength : location;
+    }
+    
+    if (recordEnd > location) {
+        recordEnd = (recordEnd >= oldEnd) ? recordEnd + changeInLength : end;
+    }
+    
+    recordStart = MIN(recordStart, location);
+    recordEnd = MAX(recordEnd, end);
+    
+    self.range = NSMakeRange((NSUInteger)recordStart, (NSUInteger)(recordEnd - recordStart));
+    self.changeInLength += changeInLength;
+}
+
+@end
+
+@interface RTEEventSubscriber : NSObject
+
+@property (nonatomic, assign) RTEEditorEventType types;
+@property (nonatomic, assign) RTEEventDelivery delivery;
+@property (nonatomic, copy) RTEEventBusHandler handler;
+
+@end
+
+@implementation RTEEventSubscriber
+
+@end
+
+@interface RTEEventBus ()
+
+@property (nonatomic, strong) dispatch_queue_t queue;
+@property (nonatomic, strong) NSMutableArray<RTEEventSubscriber *> *subscribers;
+/// Types some subscriber asked for, by delivery.
+@property (nonatomic, assign) RTEEditorEventType synchronousTypes;
+@property (nonatomic, assign) RTEEditorEventType coalescedTypes;
+/// In the order their first event was posted. A frame has a handful at most, they are looked up linearly.
+@property (nonatomic, strong) NSMutableArray<RTEEditorEvent *> *pendingRecords;
+/// Bumped by every flush, a scheduled flush of an older generation has nothing left to do.
+@property (nonatomic, assign) NSUInteger flushGeneration;
+@property (nonatomic, assign) BOOL isFlushScheduled;
+
+@end
+
+@implementation RTEEventBus
+
+#pragma mark - Initialization -
+
+- (instancetype)init {
+    return [self initWithQueue:dispatch_get_main_queue()];
+}
+
+- (instancetype)initWithQueue:(dispatch_queue_t)queue {
+    if (self = [super init]) {
+        _queue = queue;
+        _frameInterval = 1.0 / 60.0;
+        _subscribers = [[NSMutableArray alloc] init];
+        _pendingRecords = [[NSMutableArray alloc] init];
+    }
+    
+    return self;
+}
+
+#pragma mark - Public Methods -
+
+- (id)addSubscriberForEventTypes:(RTEEditorEventType)types delivery:(RTEEventDelivery)delivery handler:(RTEEventBusHandler)handler {
+    RTEEventSubscriber *subscriber = [[RTEEventSubscriber alloc] init];
+    subscriber.types = types;
+    subscriber.delivery = delivery;
+    subscriber.handler = handler;
+    
+    [self.subscribers addObject:subscriber];
+    [self updateSubscribedTypes];
+    
+    return subscriber;
+}
+
+- (void)removeSubscriber:(id)subscriber {
+    [self.subscribers removeObjectIdenticalTo:subscriber];
+    [self updateSubscribedTypes];
+}
+
+- (NSUInteger)numberOfPendingRecords {
+    return self.pendingRecords.count;
+}
+
+- (void)postEventOfType:(RTEEditorEventType)type detail:(NSInteger)detail range:(NSRange)range changeInLength:(NSInteger)changeInLength {
+    if (((self.synchronousTypes | self.coalescedTypes) & type) == 0) {
+        return;
+    }
+    
+    NSTimeInterval timestamp = [[NSProcessInfo processInfo] systemUptime];
+    
+    if (self.synchronousTypes & type) {
+        RTEEditorEvent *event = [self recordOfType:type detail:detail range:range changeInLength:changeInLength timestamp:timestamp];
+        NSArray<RTEEditorEvent *> *events = @[event];
+        
+        for (RTEEventSubscriber *subscriber in [self.subscribers copy]) {
+            if ((subscriber.delivery == RTEEventDeliverySynchronous) && (subscriber.types & type)) {
+                subscriber.handler(events);
+            }
+        }
+    }
+    
+    if ((self.coalescedTypes & type) == 0) {
+        return;
+    }
+    
+    for (RTEEditorEvent *record in self.pendingRecords) {
+        if ((record.type == type) && (record.detail == detail)) {
+            [record mergeRange:range changeInLength:changeInLength];
+            return;
+        }
+    }
+    
+    [self.pendingRecords addObject:[self recordOfType:type detail:detail range:range changeInLength:changeInLength timestamp:timestamp]];
+    [self scheduleFlushAtNextFrame:timestamp];
+}
+
+- (void)flush {
+    self.flushGeneration++;
+    self.isFlushScheduled = NO;
+    
+    if (self.pendingRecords.count == 0) {
+        return;
+    }
+    
+    RTE_TRACE_SCOPE_WITH_ARGUMENT("event bus flush", self.pendingRecords.count);
+    NSArray<RTEEditorEvent *> *records = [self.pendingRecords copy];
+    [self.pendingRecords removeAllObjects];
+    
+    for (RTEEventSubscriber *subscriber in [self.subscribers copy]) {
+        if (subscriber.delivery != RTEEventDeliveryCoalesced) {
+            continue;
+        }
+        
+        NSMutableArray<RTEEditorEvent *> *events = [[NSMutableArray alloc] initWithCapacity:records.count];
+        
+        for (RTEEditorEvent *record in records) {
+            if (subscriber.types & record.type) {
+                [events addObject:record];
+            }
+        }
+        
+        if (events.count > 0) {
+            subscriber.handler(events);
+        }
+    }
+}
+
+#pragma mark - Helper Methods -
+
+- (RTEEditorEvent *)recordOfType:(RTEEditorEventType)type detail:(NSInteger)detail range:(NSRange)range changeInLength:(NSInteger)changeInLength timestamp:(NSTimeInterval)timestamp {
+    RTEEditorEvent *record = [[RTEEditorEvent alloc] init];
+    record.type = type;
+    record.detail = detail;
+    record.range = range;
+    record.changeInLength = changeInLength;
+    record.numberOfEvents = 1;
+    record.timestamp = timestamp;
+    
+    return record;
+}
+
+- (void)updateSubscribedTypes {
+    RTEEditorEventType synchronousTypes = 0;
+    RTEEditorEventType coalescedTypes = 0;
+    
+    for (RTEEventSubscriber *subscriber in self.subscribers) {
+        if (subscriber.delivery == RTEEventDeliveryCoalesced) {
+            coalescedTypes |= subscriber.types;
+        } else {
+            synchronousTypes |= subscriber.types;
+        }
+    }
+    
+    self.synchronousTypes = synchronousTypes;
+    self.coalescedTypes = coalescedTypes;
+}
+
+/// Frame boundaries are multiples of frameInterval in system uptime,
+/// so records posted anywhere in a frame are delivered together.
+- (void)scheduleFlushAtNextFrame:(NSTimeInterval)now {
+    if (self.isFlushScheduled) {
+        return;
+    }
+    
+    NSTimeInterval frameInterval = (self.frameInterval > 0) ? self.frameInterval : 1.0 / 60.0;
+    NSTimeInterval delay = (floor(now / frameInterval) + 1) * frameInterval - now;
+    NSUInteger generation = self.flushGeneration;
+    __weak typeof(self) weakSelf = self;
+    
+    self.isFlushScheduled = YES;
+    
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delay * NSEC_PER_SEC)), self.queue, ^{
+        RTEEventBus *strongSelf = weakSelf;
+        
+        if ((strongSelf != nil) && (strongSelf.flushGeneration == generation)) {
+            [strongSelf flush];
+        }
+    });
+}
+
+@end
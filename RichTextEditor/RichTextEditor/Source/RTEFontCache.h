@@ -0,0 +1,46 @@
+//
+//  RTEFontCache.h
+//  RichTextEditor
+//
+//  Created by lam1611 on 10/18/26.
+//
+
+#import <Cocoa/Cocoa.h>
+
+/// Resolves a font from a family or font name, a size and the bold and italic traits.
+@protocol RTEFontProvider <NSObject>
+
+- (NSFont *_Nullable)fontWithName:(NSString *_Nonnull)name size:(CGFloat)size boldTrait:(BOOL)isBold italicTrait:(BOOL)isItalic;
+
+@end
+
+/// Resolves fonts with CoreText, the way +[NSFont fontWithName:size:boldTrait:italicTrait:] always did.
+@interface RTECoreTextFontProvider : NSObject <RTEFontProvider>
+
+@end
+
+/// Interns the fonts returned by a provider, keyed by name, size, bold and italic.
+/// Lookups take a shared lock, so any number of threads can read at the same time, the provider is asked on misses only.
+/// Names the provider can't resolve are cached as well, until the available fonts change and the cache is emptied.
+/// When full, the cache evicts with the clock algorithm: fonts used since the hand last passed them get a second chance.
+@interface RTEFontCache : NSObject
+
+/// The cache behind +[NSFont fontWithName:size:boldTrait:italicTrait:], resolving with RTECoreTextFontProvider.
++ (RTEFontCache *_Nonnull)sharedCache;
+
+@property (nonatomic, strong, readonly, nonnull) id<RTEFontProvider> provider;
+/// Maximum number of cached fonts.
+@property (nonatomic, assign, readonly) NSUInteger capacity;
+
+@property (nonatomic, assign, readonly) NSUInteger hitCount;
+@property (nonatomic, assign, readonly) NSUInteger missCount;
+@property (nonatomic, assign, readonly) NSUInteger evictionCount;
+
+- (instancetype _Nonnull)initWithProvider:(id<RTEFontProvider> _Nonnull)provider capacity:(NSUInteger)capacity;
+
+- (NSFont *_Nullable)fontWithName:(NSString *_Nonnull)name size:(CGFloat)size boldTrait:(BOOL)isBold italicTrait:(BOOL)isItalic;
+
+- (void)removeAllFonts;
+- (void)resetStatistics;
+
+@end
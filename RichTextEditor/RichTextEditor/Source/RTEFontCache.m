@@ -0,0 +1,297 @@
+//
+//  RTEFontCache.m
+//  RichTextEditor
+//
+//  Created by lam1611 on 10/18/26.
+//
+
+#import "RTEFontCache.h"
+
+#import <pthread.h>
+#import <stdatomic.h>
+
+#import "NSFont+RichTextEditor.h"
+#import "RTEFontManager.h"
+#import "RTETrace.h"
+
+static const NSUInteger kDefaultFontCacheCapacity = 512;
+
+@implementation RTECoreTextFontProvider
+
+- (NSFont *)fontWithName:(NSString *)name size:(CGFloat)size boldTrait:(BOOL)isBold italicTrait:(BOOL)isItalic {
+    // avoid error with "All system UI font access should be through proper APIs..."
+    // by bailing early if the user gets here with a system font
+    /// The cache is used off the main thread, so the traits go through the font descriptor rather than NSFontManager.
+    if ([name containsString:@"SFNS"]) {
+        NSFont *sysFont = [NSFont systemFontOfSize:size];
+        NSFontDescriptorSymbolicTraits traits = sysFont.fontDescriptor.symbolicTraits;
+        if (isItalic) {
+            traits |= NSFontDescriptorTraitItalic;
+        }
+        if (isBold) {
+            traits |= NSFontDescriptorTraitBold;
+        }
+        if (traits != sysFont.fontDescriptor.symbolicTraits) {
+            return [NSFont fontWithDescriptor:[sysFont.fontDescriptor fontDescriptorWithSymbolicTraits:traits] size:size] ?: sysFont;
+        }
+        return sysFont;
+    }
+    
+    NSString *postScriptName = [NSFont postscriptNameFromFullName:name];
+    CTFontRef fontWithoutTrait = CTFontCreateWithName((__bridge CFStringRef)(postScriptName), size, NULL);
+    CTFontSymbolicTraits traits = 0;
+    CTFontRef newFontRef;
+    
+    if (isItalic) {
+        traits |= kCTFontItalicTrait;
+    }
+    
+    if (isBold) {
+        traits |= kCTFontBoldTrait;
+    }
+    
+    if (traits == 0) {
+        newFontRef = CTFontCreateCopyWithAttributes(fontWithoutTrait, 0.0, NULL, NULL);
+    } else {
+        newFontRef = CTFontCreateCopyWithSymbolicTraits(fontWithoutTrait, 0.0, NULL, traits, traits);
+        
+        if (newFontRef == NULL) {
+            newFontRef = CTFontCreateCopyWithAttributes(fontWithoutTrait, 0.0, NULL, NULL);
+        }
+    }
+    
+    if (fontWithoutTrait) {
+        CFRelease(fontWithoutTrait);
+    }
+    
+    if (newFontRef) {
+        NSString *fontNameKey = (NSString *)CFBridgingRelease(CTFontCopyName(newFontRef, kCTFontPostScriptNameKey));
+        CGFloat size = CTFontGetSize(newFontRef);
+        CFRelease(newFontRef);
+        return [NSFont fontWithName:fontNameKey size:size];
+    }
+    
+    return nil;
+}
+
+@end
+
+@interface RTEFontCacheKey : NSObject <NSCopying>
+
+@property (nonatomic, copy) NSString *name;
+@property (nonatomic, assign) CGFloat size;
+@property (nonatomic, assign) BOOL isBold;
+@property (nonatomic, assign) BOOL isItalic;
+
+@end
+
+@implementation RTEFontCacheKey
+
+- (NSUInteger)hash {
+    return self.name.hash ^ (NSUInteger)(self.size * 64) ^ ((NSUInteger)self.isBold << 1) ^ (NSUInteger)self.isItalic;
+}
+
+- (BOOL)isEqual:(id)object {
+    if (![object isKindOfClass:[RTEFontCacheKey class]]) {
+        return NO;
+    }
+    
+    RTEFontCacheKey *key = (RTEFontCacheKey *)object;
+    
+    return (key.size == self.size) && (key.isBold == self.isBold) && (key.isItalic == self.isItalic) && [key.name isEqualToString:self.name];
+}
+
+- (id)copyWithZone:(NSZone *)zone {
+    /// Keys are never mutated once stored.
+    return self;
+}
+
+@end
+
+@interface RTEFontCacheEntry : NSObject {
+    @public
+    /// Set by readers, cleared by the clock hand.
+    atomic_bool _referenced;
+}
+
+@property (nonatomic, strong) RTEFontCacheKey *key;
+/// nil if the provider couldn't resolve the key.
+@property (nonatomic, strong) NSFont *font;
+
+@end
+
+@implementation RTEFontCacheEntry
+
+@end
+
+@interface RTEFontCache () {
+    pthread_rwlock_t _lock;
+    atomic_ulong _hitCount;
+    atomic_ulong _missCount;
+    atomic_ulong _evictionCount;
+    NSUInteger _clockHand;
+}
+
+@property (nonatomic, strong) NSMutableDictionary<RTEFontCacheKey *, RTEFontCacheEntry *> *entries;
+/// The entries in the order the clock hand visits them.
+@property (nonatomic, strong) NSMutableArray<RTEFontCacheEntry *> *clock;
+
+@end
+
+@implementation RTEFontCache
+
+#pragma mark - Initialization -
+
++ (RTEFontCache *)sharedCache {
+    static RTEFontCache *sharedCache = nil;
+    static dispatch_once_t onceToken;
+    
+    dispatch_once(&onceToken, ^{
+        sharedCache = [[RTEFontCache alloc] initWithProvider:[[RTECoreTextFontProvider alloc] init] capacity:kDefaultFontCacheCapacity];
+    });
+    
+    return sharedCache;
+}
+
+- (instancetype)initWithProvider:(id<RTEFontProvider>)provider capacity:(NSUInteger)capacity {
+    if (self = [super init]) {
+        _provider = provider;
+        _capacity = MAX(capacity, 1);
+        _entries = [[NSMutableDictionary alloc] initWithCapacity:_capacity];
+        _clock = [[NSMutableArray alloc] initWithCapacity:_capacity];
+        _clockHand = 0;
+        atomic_init(&_hitCount, 0);
+        atomic_init(&_missCount, 0);
+        atomic_init(&_evictionCount, 0);
+        pthread_rwlock_init(&_lock, NULL);
+        
+        /// Newly installed fonts may resolve names that missed before, or resolve them differently.
+        [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(availableFontsDidChange:) name:RTEFontManagerDidUpdateAvailableFontsNotification object:nil];
+        [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(availableFontsDidChange:) name:NSFontSetChangedNotification object:nil];
+    }
+    
+    return self;
+}
+
+- (void)dealloc {
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+    pthread_rwlock_destroy(&_lock);
+}
+
+#pragma mark - Public Methods -
+
+- (NSUInteger)hitCount {
+    return atomic_load(&_hitCount);
+}
+
+- (NSUInteger)missCount {
+    return atomic_load(&_missCount);
+}
+
+- (NSUInteger)evictionCount {
+    return atomic_load(&_evictionCount);
+}
+
+- (NSFont *)fontWithName:(NSString *)name size:(CGFloat)size boldTrait:(BOOL)isBold italicTrait:(BOOL)isItalic {
+    if (name == nil) {
+        return nil;
+    }
+    
+    RTEFontCacheKey *key = [[RTEFontCacheKey alloc] init];
+    key.name = name;
+    key.size = size;
+    key.isBold = isBold;
+    key.isItalic = isItalic;
+    
+    pthread_rwlock_rdlock(&_lock);
+    RTEFontCacheEntry *entry = [self.entries objectForKey:key];
+    
+    if (entry != nil) {
+        atomic_store(&entry->_referenced, true);
+    }
+    
+    pthread_rwlock_unlock(&_lock);
+    
+    if (entry != nil) {
+        atomic_fetch_add(&_hitCount, 1);
+        RTE_TRACE_COUNTER("font cache hits", 1);
+        return entry.font;
+    }
+    
+    atomic_fetch_add(&_missCount, 1);
+    RTE_TRACE_COUNTER("font cache misses", 1);
+    
+    /// Resolve out of the lock, two threads missing the same key at once both ask the provider and the first one is kept.
+    NSFont *font = nil;
+    
+    {
+        RTE_TRACE_SCOPE("font provider lookup");
+        font = [self.provider fontWithName:name size:size boldTrait:isBold italicTrait:isItalic];
+    }
+    
+    pthread_rwlock_wrlock(&_lock);
+    RTEFontCacheEntry *existingEntry = [self.entries objectForKey:key];
+    
+    if (existingEntry != nil) {
+        font = existingEntry.font;
+    } else {
+        entry = [[RTEFontCacheEntry alloc] init];
+        entry.key = key;
+        entry.font = font;
+        atomic_init(&entry->_referenced, false);
+        
+        [self insertEntry:entry];
+    }
+    
+    pthread_rwlock_unlock(&_lock);
+    
+    return font;
+}
+
+- (void)removeAllFonts {
+    pthread_rwlock_wrlock(&_lock);
+    [self.entries removeAllObjects];
+    [self.clock removeAllObjects];
+    _clockHand = 0;
+    pthread_rwlock_unlock(&_lock);
+}
+
+- (void)resetStatistics {
+    atomic_store(&_hitCount, 0);
+    atomic_store(&_missCount, 0);
+    atomic_store(&_evictionCount, 0);
+}
+
+#pragma mark - Helper Methods -
+
+- (void)availableFontsDidChange:(NSNotification *)notification {
+    [self removeAllFonts];
+}
+
+/// Must be called with the write lock held.
+- (void)insertEntry:(RTEFontCacheEntry *)entry {
+    if (self.clock.count < self.capacity) {
+        [self.clock addObject:entry];
+        [self.entries setObject:entry forKey:entry.key];
+        return;
+    }
+    
+    /// Every entry is passed at most once with its bit set, so the hand stops within two turns.
+    while (YES) {
+        RTEFontCacheEntry *candidate = [self.clock objectAtIndex:_clockHand];
+        
+        if (atomic_exchange(&candidate->_referenced, false)) {
+            _clockHand = (_clockHand + 1) % self.clock.count;
+            continue;
+        }
+        
+        [self.entries removeObjectForKey:candidate.key];
+        [self.clock replaceObjectAtIndex:_clockHand withObject:entry];
+        [self.entries setObject:entry forKey:entry.key];
+        _clockHand = (_clockHand + 1) % self.clock.count;
+        atomic_fetch_add(&_evictionCount, 1);
+        break;
+    }
+}
+
+@end
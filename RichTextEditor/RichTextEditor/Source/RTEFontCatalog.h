@@ -0,0 +1,39 @@
+//
+//  RTEFontCatalog.h
+//  RichTextEditor
+//
+//  Created by lam1611 on 10/18/26.
+//
+
+#import <Foundation/Foundation.h>
+
+/// An immutable list of font family names in a compact binary format meant to be memory-mapped.
+///
+/// Layout, all integers little-endian:
+///   header:  magic "RTEFCAT1", uint32 version, uint32 count, uint64 fingerprint, uint32 slot count, uint32 blob length
+///   offsets: count + 1 uint32 offsets of the names in the blob, the last one is the blob length
+///   slots:   slot count uint32 entries of an open-addressing hash table, name index + 1, 0 for empty
+///   blob:    the UTF-8 names, not terminated
+/// Looking up a name hashes its UTF-8 bytes and probes the table, nothing is decoded up front.
+@interface RTEFontCatalog : NSObject
+
+/// Identifies the font set the catalog was built from.
+@property (nonatomic, assign, readonly) uint64_t fingerprint;
+@property (nonatomic, assign, readonly) NSUInteger count;
+
+/// A fingerprint of familyNames, independent of their order.
++ (uint64_t)fingerprintOfFamilyNames:(NSArray<NSString *> *_Nonnull)familyNames;
+
+/// Serializes familyNames, duplicates are dropped.
++ (NSData *_Nonnull)dataWithFamilyNames:(NSArray<NSString *> *_Nonnull)familyNames fingerprint:(uint64_t)fingerprint;
+
+/// Returns nil if data is not a valid catalog. data is kept, not copied, so it can be a mapped file.
+- (instancetype _Nullable)initWithData:(NSData *_Nonnull)data;
+/// Maps the catalog at url, nil if it doesn't exist or is not valid.
+- (instancetype _Nullable)initWithContentsOfURL:(NSURL *_Nonnull)url;
+
+- (BOOL)containsFamilyName:(NSString *_Nonnull)familyName;
+- (NSString *_Nonnull)familyNameAtIndex:(NSUInteger)index;
+- (NSArray<NSString *> *_Nonnull)familyNames;
+
+@end
@@ -0,0 +1,254 @@
+//
+//  RTEFontCatalog.m
+//  RichTextEditor
+//
+//  Created by lam1611 on 10/18/26.
+//
+
+#import "RTEFontCatalog.h"
+
+static const char kCatalogMagic[8] = {'R', 'T', 'E', 'F', 'C', 'A', 'T', '1'};
+static const uint32_t kCatalogVersion = 1;
+static const NSUInteger kCatalogHeaderLength = 8 + 4 + 4 + 8 + 4 + 4;
+/// Family names longer than this are hashed from the heap.
+static const NSUInteger kStackNameLength = 256;
+
+static uint64_t RTEFNV1aHash(const uint8_t *bytes, NSUInteger length, uint64_t hash) {
+    for (NSUInteger i = 0; i < length; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ULL;
+    }
+    
+    return hash;
+}
+
+static const uint64_t kFNV1aOffsetBasis = 0xcbf29ce484222325ULL;
+
+static uint32_t RTEReadUInt32(const uint8_t *bytes) {
+    return (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) | ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+}
+
+static uint64_t RTEReadUInt64(const uint8_t *bytes) {
+    return (uint64_t)RTEReadUInt32(bytes) | ((uint64_t)RTEReadUInt32(bytes + 4) << 32);
+}
+
+static void RTEAppendUInt32(NSMutableData *data, uint32_t value) {
+    uint8_t bytes[4] = {(uint8_t)value, (uint8_t)(value >> 8), (uint8_t)(value >> 16), (uint8_t)(value >> 24)};
+    [data appendBytes:bytes length:4];
+}
+
+static void RTEAppendUInt64(NSMutableData *data, uint64_t value) {
+    RTEAppendUInt32(data, (uint32_t)value);
+    RTEAppendUInt32(data, (uint32_t)(value >> 32));
+}
+
+@interface RTEFontCatalog () {
+    const uint8_t *_offsets;
+    const uint8_t *_slots;
+    const uint8_t *_blob;
+    uint32_t _numberOfSlots;
+    uint32_t _blobLength;
+}
+
+@property (nonatomic, strong) NSData *data;
+
+@end
+
+@implementation RTEFontCatalog
+
+#pragma mark - Initialization -
+
+- (instancetype)initWithContentsOfURL:(NSURL *)url {
+    NSData *data = [NSData dataWithContentsOfURL:url options:NSDataReadingMappedIfSafe error:nil];
+    
+    if (data == nil) {
+        return nil;
+    }
+    
+    return [self initWithData:data];
+}
+
+- (instancetype)initWithData:(NSData *)data {
+    if (self = [super init]) {
+        const uint8_t *bytes = data.bytes;
+        NSUInteger length = data.length;
+        
+        if ((length < kCatalogHeaderLength) || (memcmp(bytes, kCatalogMagic, sizeof(kCatalogMagic)) != 0) || (RTEReadUInt32(bytes + 8) != kCatalogVersion)) {
+            return nil;
+        }
+        
+        uint32_t count = RTEReadUInt32(bytes + 12);
+        uint64_t fingerprint = RTEReadUInt64(bytes + 16);
+        uint32_t numberOfSlots = RTEReadUInt32(bytes + 24);
+        uint32_t blobLength = RTEReadUInt32(bytes + 28);
+        uint64_t expectedLength = (uint64_t)kCatalogHeaderLength + ((uint64_t)count + 1) * 4 + (uint64_t)numberOfSlots * 4 + blobLength;
+        
+        /// The slot count is a power of two larger than the count, so probing always ends on an empty slot.
+        if ((expectedLength != length) || (numberOfSlots <= count) || ((numberOfSlots & (numberOfSlots - 1)) != 0)) {
+            return nil;
+        }
+        
+        _data = data;
+        _count = count;
+        _fingerprint = fingerprint;
+        _numberOfSlots = numberOfSlots;
+        _blobLength = blobLength;
+        _offsets = bytes + kCatalogHeaderLength;
+        _slots = _offsets + ((NSUInteger)count + 1) * 4;
+        _blob = _slots + (NSUInteger)numberOfSlots * 4;
+        
+        /// Validate once so lookups never read out of the blob.
+        uint32_t previousOffset = 0;
+        
+        for (uint32_t i = 0; i <= count; i++) {
+            uint32_t offset = RTEReadUInt32(_offsets + i * 4);
+            
+            if ((offset < previousOffset) || (offset > blobLength) || ((i == count) && (offset != blobLength))) {
+                return nil;
+            }
+            
+            previousOffset = offset;
+        }
+        
+        for (uint32_t i = 0; i < numberOfSlots; i++) {
+            if (RTEReadUInt32(_slots + i * 4) > count) {
+                return nil;
+            }
+        }
+    }
+    
+    return self;
+}
+
+#pragma mark - Public Methods -
+
++ (uint64_t)fingerprintOfFamilyNames:(NSArray<NSString *> *)familyNames {
+    NSArray<NSString *> *sortedFamilyNames = [familyNames sortedArrayUsingSelector:@selector(compare:)];
+    uint64_t hash = kFNV1aOffsetBasis;
+    
+    for (NSString *familyName in sortedFamilyNames) {
+        const char *utf8String = familyName.UTF8String;
+        
+        if (utf8String != NULL) {
+            /// Include the terminator so {"ab", "c"} and {"a", "bc"} differ.
+            hash = RTEFNV1aHash((const uint8_t *)utf8String, strlen(utf8String) + 1, hash);
+        }
+    }
+    
+    return hash;
+}
+
++ (NSData *)dataWithFamilyNames:(NSArray<NSString *> *)familyNames fingerprint:(uint64_t)fingerprint {
+    NSArray<NSString *> *uniqueFamilyNames = [[NSOrderedSet orderedSetWithArray:familyNames] array];
+    uint32_t count = (uint32_t)uniqueFamilyNames.count;
+    uint32_t numberOfSlots = 2;
+    
+    while (numberOfSlots < count * 2) {
+        numberOfSlots *= 2;
+    }
+    
+    NSMutableData *blob = [[NSMutableData alloc] init];
+    uint32_t *offsets = calloc((NSUInteger)count + 1, sizeof(uint32_t));
+    uint32_t *slots = calloc(numberOfSlots, sizeof(uint32_t));
+    
+    for (uint32_t i = 0; i < count; i++) {
+        NSData *name = [uniqueFamilyNames[i] dataUsingEncoding:NSUTF8StringEncoding];
+        uint32_t slot = (uint32_t)(RTEFNV1aHash(name.bytes, name.length, kFNV1aOffsetBasis) & (numberOfSlots - 1));
+        
+        while (slots[slot] != 0) {
+            slot = (slot + 1) & (numberOfSlots - 1);
+        }
+        
+        slots[slot] = i + 1;
+        offsets[i] = (uint32_t)blob.length;
+        [blob appendData:name];
+    }
+    
+    offsets[count] = (uint32_t)blob.length;
+    
+    NSMutableData *data = [[NSMutableData alloc] initWithCapacity:kCatalogHeaderLength + ((NSUInteger)count + 1 + numberOfSlots) * 4 + blob.length];
+    [data appendBytes:kCatalogMagic length:sizeof(kCatalogMagic)];
+    RTEAppendUInt32(data, kCatalogVersion);
+    RTEAppendUInt32(data, count);
+    RTEAppendUInt64(data, fingerprint);
+    RTEAppendUInt32(data, numberOfSlots);
+    RTEAppendUInt32(data, (uint32_t)blob.length);
+    
+    for (uint32_t i = 0; i <= count; i++) {
+        RTEAppendUInt32(data, offsets[i]);
+    }
+    
+    for (uint32_t i = 0; i < numberOfSlots; i++) {
+        RTEAppendUInt32(data, slots[i]);
+    }
+    
+    [data appendData:blob];
+    
+    free(offsets);
+    free(slots);
+    
+    return data;
+}
+
+- (BOOL)containsFamilyName:(NSString *)familyName {
+    char stackBuffer[kStackNameLength];
+    char *buffer = stackBuffer;
+    NSUInteger maximumLength = [familyName maximumLengthOfBytesUsingEncoding:NSUTF8StringEncoding] + 1;
+    NSUInteger length = 0;
+    BOOL found = NO;
+    
+    if (maximumLength > kStackNameLength) {
+        buffer = malloc(maximumLength);
+    }
+    
+    if ([familyName getBytes:buffer maxLength:maximumLength usedLength:&length encoding:NSUTF8StringEncoding options:0 range:NSMakeRange(0, familyName.length) remainingRange:NULL]) {
+        uint32_t slot = (uint32_t)(RTEFNV1aHash((const uint8_t *)buffer, length, kFNV1aOffsetBasis) & (_numberOfSlots - 1));
+        
+        for (uint32_t probes = 0; probes < _numberOfSlots; probes++) {
+            uint32_t entry = RTEReadUInt32(_slots + slot * 4);
+            
+            if (entry == 0) {
+                break;
+            }
+            
+            uint32_t start = RTEReadUInt32(_offsets + (entry - 1) * 4);
+            uint32_t end = RTEReadUInt32(_offsets + entry * 4);
+            
+            if ((end - start == length) && (memcmp(_blob + start, buffer, length) == 0)) {
+                found = YES;
+                break;
+            }
+            
+            slot = (slot + 1) & (_numberOfSlots - 1);
+        }
+    }
+    
+    if (buffer != stackBuffer) {
+        free(buffer);
+    }
+    
+    return found;
+}
+
+- (NSString *)familyNameAtIndex:(NSUInteger)index {
+    if (index >= self.count) {
+        return @"";
+    }
+    
+    uint32_t start = RTEReadUInt32(_offsets + index * 4);
+    uint32_t end = RTEReadUInt32(_offsets + (index + 1) * 4);
+    
+    return [[NSString alloc] initWithBytes:_blob + start length:end - start encoding:NSUTF8StringEncoding] ?: @"";
+}
+
+- (NSArray<NSString *> *)familyNames {
+    NSMutableArray<NSString *> *familyNames = [[NSMutableArray alloc] initWithCapacity:self.count];
+    
+    for (NSUInteger i = 0; i < self.count; i++) {
+        [familyNames addObject:[self familyNameAtIndex:i]];
+    }
+    
+    return familyNames;
+}
+
+@end
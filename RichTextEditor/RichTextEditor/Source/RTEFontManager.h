@@ -8,16 +8,23 @@
 
 #import <Cocoa/Cocoa.h>
 
+/// Posted on the main thread when the font catalog was rebuilt because the installed fonts changed.
+extern NSNotificationName const RTEFontManagerDidUpdateAvailableFontsNotification;
+
 @interface RTEFontManager : NSObject
 
 // MARK: -
 
+/// Waits for the font catalog if it is still being built on the first launch, and creates a font for every family.
 @property (nonatomic, strong, readonly) NSArray<NSFont *> *availableFonts;
+/// Never blocks: backed by the memory-mapped catalog, fonts are created on first lookup.
+/// Until the first catalog is built, a lookup checks the requested family only, and listing the keys scans the installed fonts.
 @property (nonatomic, strong, readonly) NSDictionary<NSString *, NSFont *> *availableFontsDictionary;
 
 // MARK: -
 
 + (RTEFontManager *)sharedManager;
+/// Maps the catalog persisted by the previous launch and validates it against the installed fonts in the background.
 + (void)startUp;
 
 @end
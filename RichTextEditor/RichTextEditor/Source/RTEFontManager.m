@@ -8,11 +8,122 @@
 
 #import "RTEFontManager.h"
 
+#import <CoreText/CoreText.h>
+#import <os/lock.h>
+
+#import "RTEFontCatalog.h"
+
+NSNotificationName const RTEFontManagerDidUpdateAvailableFontsNotification = @"RTEFontManagerDidUpdateAvailableFontsNotification";
+
+static NSString *const kFontCatalogFileName = @"FontCatalog.bin";
+static const CGFloat kAvailableFontSize = 12;
+
+static BOOL RTEIsUserFontFamily(NSString *family) {
+    NSFontCollection *collection = [NSFontCollection fontCollectionWithName:NSFontCollectionUser];
+    
+    return [collection matchingDescriptorsForFamily:family].count > 0;
+}
+
+/// The user font families among families, sorted by name.
+static NSArray<NSString *> *RTEUserFontFamilies(NSArray<NSString *> *families) {
+    NSMutableArray<NSString *> *userFontFamilies = [[NSMutableArray alloc] initWithCapacity:families.count];
+    
+    for (NSString *family in [families sortedArrayUsingSelector:@selector(compare:)]) {
+        if (RTEIsUserFontFamily(family)) {
+            [userFontFamilies addObject:family];
+        }
+    }
+    
+    return userFontFamilies;
+}
+
+/// Family name -> font, with the keys read from a font catalog and the fonts created on first lookup.
+/// Without a catalog a lookup checks the family against the installed fonts directly,
+/// and the keys are listed from the installed fonts the first time they are asked for.
+@interface RTEFontCatalogDictionary : NSDictionary<NSString *, NSFont *> {
+    os_unfair_lock _lock;
+}
+
+@property (nonatomic, strong) RTEFontCatalog *catalog;
+/// The catalog's family names, or the installed user font families when there is no catalog.
+@property (nonatomic, strong) NSArray<NSString *> *familyNames;
+/// Resolved lookups, NSNull for families that are not available.
+@property (nonatomic, strong) NSMutableDictionary<NSString *, id> *fonts;
+
+- (instancetype)initWithCatalog:(RTEFontCatalog *)catalog;
+
+@end
+
+@implementation RTEFontCatalogDictionary
+
+- (instancetype)initWithCatalog:(RTEFontCatalog *)catalog {
+    if (self = [super init]) {
+        _catalog = catalog;
+        _fonts = [[NSMutableDictionary alloc] init];
+        _lock = OS_UNFAIR_LOCK_INIT;
+    }
+    
+    return self;
+}
+
+- (NSUInteger)count {
+    return (self.catalog != nil) ? self.catalog.count : self.installedFamilyNames.count;
+}
+
+- (NSEnumerator *)keyEnumerator {
+    return [((self.catalog != nil) ? self.catalog.familyNames : self.installedFamilyNames) objectEnumerator];
+}
+
+- (NSFont *)objectForKey:(id)key {
+    if (![key isKindOfClass:[NSString class]]) {
+        return nil;
+    }
+    
+    os_unfair_lock_lock(&_lock);
+    id font = [self.fonts objectForKey:key];
+    os_unfair_lock_unlock(&_lock);
+    
+    if (font == nil) {
+        BOOL isAvailable = (self.catalog != nil) ? [self.catalog containsFamilyName:key] : RTEIsUserFontFamily(key);
+        font = isAvailable ? [NSFont fontWithName:key size:kAvailableFontSize] : nil;
+        
+        os_unfair_lock_lock(&_lock);
+        [self.fonts setObject:font ?: [NSNull null] forKey:key];
+        os_unfair_lock_unlock(&_lock);
+    }
+    
+    return (font != [NSNull null]) ? font : nil;
+}
+
+/// The same families the catalog would list, so the keys agree with -objectForKey:.
+- (NSArray<NSString *> *)installedFamilyNames {
+    os_unfair_lock_lock(&_lock);
+    NSArray<NSString *> *familyNames = self.familyNames;
+    os_unfair_lock_unlock(&_lock);
+    
+    if (familyNames == nil) {
+        NSArray<NSString *> *availableFontFamilies = (NSArray<NSString *> *)CFBridgingRelease(CTFontManagerCopyAvailableFontFamilyNames());
+        familyNames = RTEUserFontFamilies(availableFontFamilies);
+        
+        os_unfair_lock_lock(&_lock);
+        self.familyNames = familyNames;
+        os_unfair_lock_unlock(&_lock);
+    }
+    
+    return familyNames;
+}
+
+@end
+
 @interface RTEFontManager () {
-    NSMutableArray<NSFont *> *_availableFonts;
-    NSMutableDictionary<NSString *, NSFont *> *_availableFontsDictionary;
+    os_unfair_lock _lock;
+    RTEFontCatalogDictionary *_availableFontsDictionary;
+    NSArray<NSFont *> *_availableFonts;
 }
 
+/// Done once the catalog was validated or rebuilt.
+@property (nonatomic, strong) dispatch_group_t catalogGroup;
+
 @end
 
 @implementation RTEFontManager
@@ -35,20 +146,19 @@
 
 - (instancetype)init {
     if (self = [super init]) {
-        _availableFonts = [[NSMutableArray alloc] init];
-        _availableFontsDictionary = [[NSMutableDictionary alloc] init];
+        _lock = OS_UNFAIR_LOCK_INIT;
+        _catalogGroup = dispatch_group_create();
         
-        NSFontCollection *collection = [NSFontCollection fontCollectionWithName:NSFontCollectionUser];
-        NSArray<NSString *> *availableFontFamilies = [[NSFontManager sharedFontManager] availableFontFamilies];
+        NSURL *catalogURL = [RTEFontManager catalogURL];
+        RTEFontCatalog *catalog = (catalogURL != nil) ? [[RTEFontCatalog alloc] initWithContentsOfURL:catalogURL] : nil;
         
-        for (NSString *family in availableFontFamilies) {
-            if ([collection matchingDescriptorsForFamily:family].count > 0) {
-                NSFont *font = [NSFont fontWithName:family size:12];
-                
-                [_availableFonts addObject:font];
-                [_availableFontsDictionary setObject:font forKey:family];
-            }
-        }
+        _availableFontsDictionary = [[RTEFontCatalogDictionary alloc] initWithCatalog:catalog];
+        
+        dispatch_queue_t queue = dispatch_get_global_queue(QOS_CLASS_UTILITY, 0);
+        
+        dispatch_group_async(_catalogGroup, queue, ^{
+            [self validateCatalog:catalog atURL:catalogURL];
+        });
     }
     
     return self;
@@ -57,11 +167,45 @@
 // MARK: -
 
 - (NSArray<NSFont *> *)availableFonts {
-    return _availableFonts;
+    dispatch_group_wait(self.catalogGroup, DISPATCH_TIME_FOREVER);
+    
+    os_unfair_lock_lock(&_lock);
+    RTEFontCatalogDictionary *dictionary = _availableFontsDictionary;
+    NSArray<NSFont *> *availableFonts = _availableFonts;
+    os_unfair_lock_unlock(&_lock);
+    
+    if (availableFonts == nil) {
+        NSMutableArray<NSFont *> *fonts = [[NSMutableArray alloc] initWithCapacity:dictionary.count];
+        
+        for (NSString *family in dictionary.catalog.familyNames) {
+            NSFont *font = [dictionary objectForKey:family];
+            
+            if (font != nil) {
+                [fonts addObject:font];
+            }
+        }
+        
+        availableFonts = fonts;
+        
+        os_unfair_lock_lock(&_lock);
+        
+        /// Only keep the array if the catalog wasn't replaced meanwhile.
+        if (dictionary == _availableFontsDictionary) {
+            _availableFonts = availableFonts;
+        }
+        
+        os_unfair_lock_unlock(&_lock);
+    }
+    
+    return availableFonts;
 }
 
-- (NSDictionary<NSString *, NSFont *> *)availableFontsDictionary; {
-    return _availableFontsDictionary;
+- (NSDictionary<NSString *, NSFont *> *)availableFontsDictionary {
+    os_unfair_lock_lock(&_lock);
+    NSDictionary<NSString *, NSFont *> *dictionary = _availableFontsDictionary;
+    os_unfair_lock_unlock(&_lock);
+    
+    return dictionary;
 }
 
 // MARK: -
@@ -70,4 +214,53 @@
     [RTEFontManager sharedManager];
 }
 
+// MARK: -
+
++ (NSURL *)catalogURL {
+    NSURL *cachesURL = [[NSFileManager defaultManager] URLsForDirectory:NSCachesDirectory inDomains:NSUserDomainMask].firstObject;
+    
+    if (cachesURL == nil) {
+        return nil;
+    }
+    
+    NSString *bundleIdentifier = [[NSBundle bundleForClass:[RTEFontManager class]] bundleIdentifier] ?: @"RichTextEditor";
+    
+    return [[cachesURL URLByAppendingPathComponent:bundleIdentifier isDirectory:YES] URLByAppendingPathComponent:kFontCatalogFileName];
+}
+
+/// Keeps catalog if it was built from the installed font families, otherwise builds, persists and publishes a new one.
+- (void)validateCatalog:(RTEFontCatalog *)catalog atURL:(NSURL *)catalogURL {
+    /// CoreText is safe off the main thread, unlike NSFontManager.
+    NSArray<NSString *> *availableFontFamilies = (NSArray<NSString *> *)CFBridgingRelease(CTFontManagerCopyAvailableFontFamilyNames());
+    uint64_t fingerprint = [RTEFontCatalog fingerprintOfFamilyNames:availableFontFamilies];
+    
+    if ((catalog != nil) && (catalog.fingerprint == fingerprint)) {
+        return;
+    }
+    
+    NSArray<NSString *> *userFontFamilies = RTEUserFontFamilies(availableFontFamilies);
+    NSData *data = [RTEFontCatalog dataWithFamilyNames:userFontFamilies fingerprint:fingerprint];
+    RTEFontCatalog *newCatalog = [[RTEFontCatalog alloc] initWithData:data];
+    
+    if (catalogURL != nil) {
+        NSError *error = nil;
+        [[NSFileManager defaultManager] createDirectoryAtURL:[catalogURL URLByDeletingLastPathComponent] withIntermediateDirectories:YES attributes:nil error:nil];
+        
+        if (![data writeToURL:catalogURL options:NSDataWritingAtomic error:&error]) {
+            NSLog(@"%s [Line %d] failed to write font catalog: %@", __PRETTY_FUNCTION__, __LINE__, error);
+        }
+    }
+    
+    RTEFontCatalogDictionary *dictionary = [[RTEFontCatalogDictionary alloc] initWithCatalog:newCatalog];
+    
+    os_unfair_lock_lock(&_lock);
+    _availableFontsDictionary = dictionary;
+    _availableFonts = nil;
+    os_unfair_lock_unlock(&_lock);
+    
+    dispatch_async(dispatch_get_main_queue(), ^{
+        [[NSNotificationCenter defaultCenter] postNotificationName:RTEFontManagerDidUpdateAvailableFontsNotification object:self];
+    });
+}
+
 @end
@@ -0,0 +1,75 @@
+//
+//  RTEFormatIndex.h
+//  RichTextEditor
+//
+//  Created by lam1611 on 10/18/26.
+//
+
+#import <Cocoa/Cocoa.h>
+
+typedef NS_OPTIONS(uint32_t, RTEFormatAttributes) {
+    RTEFormatAttributeBold              = 1 << 0,
+    RTEFormatAttributeItalic            = 1 << 1,
+    RTEFormatAttributeUnderline         = 1 << 2,
+    RTEFormatAttributeStrikethrough     = 1 << 3,
+    RTEFormatAttributeLink              = 1 << 4,
+    RTEFormatAttributeBulletedList      = 1 << 5,
+    RTEFormatAttributeNumberedList      = 1 << 6,
+};
+
+typedef NS_ENUM(NSInteger, RTEFormatState) {
+    RTEFormatStateNone,
+    RTEFormatStateMixed,
+    RTEFormatStateAll,
+};
+
+/// The formatting of a range of text, an empty range has none.
+typedef struct {
+    /// Attributes of every character.
+    RTEFormatAttributes all;
+    /// Attributes of at least one character.
+    RTEFormatAttributes any;
+    /// 1 << alignment for each NSTextAlignment of the characters, a paragraph without a style counts as left aligned.
+    uint32_t alignments;
+} RTEFormatSummary;
+
+static inline RTEFormatState RTEFormatSummaryStateOfAttribute(RTEFormatSummary summary, RTEFormatAttributes attribute) {
+    if ((summary.any & attribute) == 0) {
+        return RTEFormatStateNone;
+    }
+    
+    return ((summary.all & attribute) == attribute) ? RTEFormatStateAll : RTEFormatStateMixed;
+}
+
+/// A balanced tree of the attribute runs of a string, for the toolbar state of a selection.
+///
+/// Each run carries the attributes above as a bitmask, each subtree the AND and OR of its runs and the set of alignments,
+/// so the summary of any range costs O(log n) instead of a walk over its characters.
+/// List attributes belong to every character of a paragraph starting with a list marker, including the '\n'.
+/// An edit delta rereads the runs of the paragraphs around the edit only, the runs after it are kept.
+@interface RTEFormatIndex : NSObject
+
+/// Length of the indexed string.
+@property (nonatomic, readonly) NSUInteger length;
+@property (nonatomic, readonly) NSUInteger numberOfRuns;
+
+- (instancetype _Nonnull)initWithAttributedString:(NSAttributedString *_Nonnull)attributedString;
+
+/// Applies an edit delta: the characters or attributes in range of the indexed string were replaced, giving attributedString.
+- (void)replaceCharactersInRange:(NSRange)range resultingAttributedString:(NSAttributedString *_Nonnull)attributedString;
+
+- (RTEFormatSummary)summaryOfRange:(NSRange)range;
+
+/// The summary of range found by walking the attribute runs of attributedString, the same as an index would give.
++ (RTEFormatSummary)summaryOfRange:(NSRange)range inAttributedString:(NSAttributedString *_Nonnull)attributedString;
+
+@end
+
+@interface NSTextStorage (RTEFormatIndex)
+
+/// Builds a format index for the receiver and keeps it in sync with every character and attribute edit.
+- (void)attachFormatIndex;
+/// The format index of the receiver, nil if none attached or while the receiver is being edited.
+- (RTEFormatIndex *_Nullable)RTEFormatIndex;
+
+@end
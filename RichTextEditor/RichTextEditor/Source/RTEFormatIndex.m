@@ -0,0 +1,456 @@
+//
+//  RTEFormatIndex.m
+//  RichTextEditor
+//
+//  Created by lam1611 on 10/18/26.
+//
+
+#import "RTEFormatIndex.h"
+
+#import <objc/runtime.h>
+
+#import "NSFont+RichTextEditor.h"
+#import "RTELayoutManager.h"
+#import "RTETrace.h"
+
+static const void *kFormatIndexKey = &kFormatIndexKey;
+
+/// A run of the string, and through totalLength and summary the whole subtree below it.
+/// Children and free list links are indexes into the node array, 0 is an empty subtree.
+typedef struct {
+    uint32_t left;
+    uint32_t right;
+    uint32_t priority;
+    RTEFormatAttributes attributes;
+    uint32_t alignment;
+    NSUInteger length;
+    NSUInteger totalLength;
+    RTEFormatSummary summary;
+} RTEFormatNode;
+
+/// A treap keyed by character position: in order the nodes are the runs of the string, by priority they form a heap,
+/// which keeps the depth logarithmic without rebalancing.
+typedef struct {
+    RTEFormatNode *nodes;
+    uint32_t capacity;
+    uint32_t count;
+    uint32_t freeList;
+    uint32_t root;
+    uint32_t random;
+    NSUInteger numberOfRuns;
+} RTEFormatTree;
+
+/// The summary of nothing, neutral to RTEFormatSummaryCombine().
+static const RTEFormatSummary kEmptySummary = {UINT32_MAX, 0, 0};
+
+static inline RTEFormatSummary RTEFormatSummaryCombine(RTEFormatSummary summary, RTEFormatSummary other) {
+    return (RTEFormatSummary){summary.all & other.all, summary.any | other.any, summary.alignments | other.alignments};
+}
+
+static void RTEFormatTreeReset(RTEFormatTree *tree) {
+    if (tree->nodes == NULL) {
+        tree->capacity = 64;
+        tree->nodes = malloc(tree->capacity * sizeof(RTEFormatNode));
+    }
+    
+    /// Node 0 is the empty subtree, it is never written again.
+    tree->nodes[0] = (RTEFormatNode){0, 0, 0, 0, 0, 0, 0, kEmptySummary};
+    tree->count = 1;
+    tree->freeList = 0;
+    tree->root = 0;
+    tree->random = 0x1611;
+    tree->numberOfRuns = 0;
+}
+
+static inline void RTEFormatTreeUpdate(RTEFormatTree *tree, uint32_t node) {
+    RTEFormatNode *nodes = tree->nodes;
+    RTEFormatNode *left = &nodes[nodes[node].left];
+    RTEFormatNode *right = &nodes[nodes[node].right];
+    RTEFormatSummary summary = {nodes[node].attributes, nodes[node].attributes, nodes[node].alignment};
+    
+    nodes[node].totalLength = left->totalLength + nodes[node].length + right->totalLength;
+    nodes[node].summary = RTEFormatSummaryCombine(RTEFormatSummaryCombine(left->summary, summary), right->summary);
+}
+
+/// Can move the node array, indexes stay valid but pointers into it do not.
+static uint32_t RTEFormatTreeAllocate(RTEFormatTree *tree, NSUInteger length, RTEFormatAttributes attributes, uint32_t alignment) {
+    uint32_t node = tree->freeList;
+    
+    if (node != 0) {
+        tree->freeList = tree->nodes[node].left;
+    } else {
+        if (tree->count == tree->capacity) {
+            tree->capacity *= 2;
+            tree->nodes = realloc(tree->nodes, tree->capacity * sizeof(RTEFormatNode));
+        }
+        
+        node = tree->count++;
+    }
+    
+    /// xorshift32, a fixed seed keeps the shape of the tree reproducible.
+    tree->random ^= tree->random << 13;
+    tree->random ^= tree->random >> 17;
+    tree->random ^= tree->random << 5;
+    
+    tree->nodes[node] = (RTEFormatNode){0, 0, tree->random, attributes, alignment, length, length, {attributes, attributes, alignment}};
+    tree->numberOfRuns++;
+    
+    return node;
+}
+
+static void RTEFormatTreeFree(RTEFormatTree *tree, uint32_t node) {
+    if (node == 0) {
+        return;
+    }
+    
+    RTEFormatTreeFree(tree, tree->nodes[node].left);
+    RTEFormatTreeFree(tree, tree->nodes[node].right);
+    tree->nodes[node].left = tree->freeList;
+    tree->freeList = node;
+    tree->numberOfRuns--;
+}
+
+/// Joins two subtrees, every run of left coming before every run of right.
+static uint32_t RTEFormatTreeMerge(RTEFormatTree *tree, uint32_t left, uint32_t right) {
+    if ((left == 0) || (right == 0)) {
+        return left | right;
+    }
+    
+    if (tree->nodes[left].priority > tree->nodes[right].priority) {
+        uint32_t child = RTEFormatTreeMerge(tree, tree->nodes[left].right, right);
+        tree->nodes[left].right = child;
+        RTEFormatTreeUpdate(tree, left);
+        
+        return left;
+    }
+    
+    uint32_t child = RTEFormatTreeMerge(tree, left, tree->nodes[right].left);
+    tree->nodes[right].left = child;
+    RTEFormatTreeUpdate(tree, right);
+    
+    return right;
+}
+
+/// Splits the subtree into the runs before location and the ones after, cutting the run across location in two.
+static void RTEFormatTreeSplit(RTEFormatTree *tree, uint32_t node, NSUInteger location, uint32_t *left, uint32_t *right) {
+    if (node == 0) {
+        *left = 0;
+        *right = 0;
+        
+        return;
+    }
+    
+    NSUInteger leftLength = tree->nodes[tree->nodes[node].left].totalLength;
+    NSUInteger runEnd = leftLength + tree->nodes[node].length;
+    uint32_t lower = 0;
+    uint32_t upper = 0;
+    
+    if (location <= leftLength) {
+        RTEFormatTreeSplit(tree, tree->nodes[node].left, location, &lower, &upper);
+        tree->nodes[node].left = upper;
+        RTEFormatTreeUpdate(tree, node);
+        *left = lower;
+        *right = node;
+    } else if (location >= runEnd) {
+        RTEFormatTreeSplit(tree, tree->nodes[node].right, location - runEnd, &lower, &upper);
+        tree->nodes[node].right = lower;
+        RTEFormatTreeUpdate(tree, node);
+        *left = node;
+        *right = upper;
+    } else {
+        uint32_t tail = RTEFormatTreeAllocate(tree, runEnd - location, tree->nodes[node].attributes, tree->nodes[node].alignment);
+        uint32_t rightChild = tree->nodes[node].right;
+        
+        tree->nodes[node].length = location - leftLength;
+        tree->nodes[node].right = 0;
+        RTEFormatTreeUpdate(tree, node);
+        *left = node;
+        *right = RTEFormatTreeMerge(tree, tail, rightChild);
+    }
+}
+
+/// The summary of the characters from start to end of the subtree. Below the node where start and end part,
+/// one side of each level is either skipped or taken whole, so this visits O(depth) nodes.
+static RTEFormatSummary RTEFormatTreeQuery(const RTEFormatTree *tree, uint32_t node, NSUInteger start, NSUInteger end) {
+    if ((node == 0) || (start >= end)) {
+        return kEmptySummary;
+    }
+    
+    const RTEFormatNode *current = &tree->nodes[node];
+    
+    if ((start == 0) && (end >= current->totalLength)) {
+        return current->summary;
+    }
+    
+    NSUInteger leftLength = tree->nodes[current->left].totalLength;
+    NSUInteger runEnd = leftLength + current->length;
+    RTEFormatSummary summary = kEmptySummary;
+    
+    if (start < leftLength) {
+        summary = RTEFormatSummaryCombine(summary, RTEFormatTreeQuery(tree, current->left, start, MIN(end, leftLength)));
+    }
+    
+    if ((start < runEnd) && (end > leftLength)) {
+        summary = RTEFormatSummaryCombine(summary, (RTEFormatSummary){current->attributes, current->attributes, current->alignment});
+    }
+    
+    if (end > runEnd) {
+        summary = RTEFormatSummaryCombine(summary, RTEFormatTreeQuery(tree, current->right, (start > runEnd) ? start - runEnd : 0, end - runEnd));
+    }
+    
+    return summary;
+}
+
+static RTEFormatAttributes RTEFormatAttributesOfDictionary(NSDictionary *attributes) {
+    RTEFormatAttributes formatAttributes = 0;
+    NSFont *font = [attributes objectForKey:NSFontAttributeName];
+    NSNumber *underlineStyle = [attributes objectForKey:NSUnderlineStyleAttributeName];
+    NSNumber *strikethroughStyle = [attributes objectForKey:NSStrikethroughStyleAttributeName];
+    
+    if (font != nil) {
+        formatAttributes |= [font isBold] ? RTEFormatAttributeBold : 0;
+        formatAttributes |= [font isItalic] ? RTEFormatAttributeItalic : 0;
+    }
+    
+    if ((underlineStyle != nil) && (underlineStyle.integerValue != NSUnderlineStyleNone)) {
+        formatAttributes |= RTEFormatAttributeUnderline;
+    }
+    
+    if ((strikethroughStyle != nil) && (strikethroughStyle.integerValue != NSUnderlineStyleNone)) {
+        formatAttributes |= RTEFormatAttributeStrikethrough;
+    }
+    
+    if ([attributes objectForKey:NSLinkAttributeName] != nil) {
+        formatAttributes |= RTEFormatAttributeLink;
+    }
+    
+    return formatAttributes;
+}
+
+static uint32_t RTEFormatAlignmentOfDictionary(NSDictionary *attributes) {
+    NSParagraphStyle *paragraphStyle = [attributes objectForKey:NSParagraphStyleAttributeName];
+    NSTextAlignment alignment = (paragraphStyle != nil) ? paragraphStyle.alignment : NSTextAlignmentLeft;
+    
+    return 1u << MIN((NSUInteger)alignment, 31);
+}
+
+static BOOL RTEFormatStringHasPrefixAtLocation(NSString *string, NSString *prefix, NSUInteger location) {
+    if (location + prefix.length > string.length) {
+        return NO;
+    }
+    
+    for (NSUInteger i = 0; i < prefix.length; i++) {
+        if ([string characterAtIndex:location + i] != [prefix characterAtIndex:i]) {
+            return NO;
+        }
+    }
+    
+    return YES;
+}
+
+/// Start of the paragraph containing location, a location at a '\n' belongs to the paragraph it terminates.
+static NSUInteger RTEFormatParagraphStart(NSString *string, NSUInteger location) {
+    NSRange newlineRange = [string rangeOfString:@"\n" options:NSLiteralSearch | NSBackwardsSearch range:NSMakeRange(0, location)];
+    
+    return (newlineRange.location == NSNotFound) ? 0 : newlineRange.location + 1;
+}
+
+/// End of the paragraph containing location, after its '\n'.
+static NSUInteger RTEFormatParagraphEnd(NSString *string, NSUInteger location) {
+    NSRange newlineRange = [string rangeOfString:@"\n" options:NSLiteralSearch range:NSMakeRange(location, string.length - location)];
+    
+    return (newlineRange.location == NSNotFound) ? string.length : newlineRange.location + 1;
+}
+
+/// Enumerates the attribute runs of range, with the list attributes of the paragraphs they are in.
+static void RTEFormatEnumerateRuns(NSAttributedString *attributedString, NSRange range, void (^block)(NSUInteger length, RTEFormatAttributes attributes, uint32_t alignment)) {
+    NSString *string = attributedString.string;
+    NSString *bulletString = [RTELayoutManager kBulletString];
+    NSString *numberingString = [RTELayoutManager kNumberingString];
+    NSUInteger location = range.location;
+    NSUInteger paragraphStart = RTEFormatParagraphStart(string, location);
+    
+    while (location < NSMaxRange(range)) {
+        NSUInteger paragraphEnd = MIN(RTEFormatParagraphEnd(string, location), NSMaxRange(range));
+        RTEFormatAttributes listAttributes = 0;
+        
+        if (RTEFormatStringHasPrefixAtLocation(string, bulletString, paragraphStart)) {
+            listAttributes = RTEFormatAttributeBulletedList;
+        } else if (RTEFormatStringHasPrefixAtLocation(string, numberingString, paragraphStart)) {
+            listAttributes = RTEFormatAttributeNumberedList;
+        }
+        
+        [attributedString enumerateAttributesInRange:NSMakeRange(location, paragraphEnd - location) options:NSAttributedStringEnumerationLongestEffectiveRangeNotRequired usingBlock:^(NSDictionary<NSAttributedStringKey, id> *attributes, NSRange attributesRange, BOOL *stop) {
+            block(attributesRange.length, RTEFormatAttributesOfDictionary(attributes) | listAttributes, RTEFormatAlignmentOfDictionary(attributes));
+        }];
+        
+        location = paragraphEnd;
+        paragraphStart = paragraphEnd;
+    }
+}
+
+@interface RTEFormatIndex () {
+    RTEFormatTree _tree;
+    NSUInteger _length;
+}
+
+@property (nonatomic, unsafe_unretained) NSTextStorage *textStorage;
+
+@end
+
+@implementation RTEFormatIndex
+
+#pragma mark - Initialization -
+
+- (instancetype)initWithAttributedString:(NSAttributedString *)attributedString {
+    if (self = [super init]) {
+        [self rebuildWithAttributedString:attributedString];
+    }
+    
+    return self;
+}
+
+- (void)dealloc {
+    if (self.textStorage != nil) {
+        [[NSNotificationCenter defaultCenter] removeObserver:self name:NSTextStorageDidProcessEditingNotification object:self.textStorage];
+    }
+    
+    free(_tree.nodes);
+}
+
+#pragma mark - Public Methods -
+
+- (NSUInteger)length {
+    return _length;
+}
+
+- (NSUInteger)numberOfRuns {
+    return _tree.numberOfRuns;
+}
+
+- (void)replaceCharactersInRange:(NSRange)range resultingAttributedString:(NSAttributedString *)attributedString {
+    NSString *string = attributedString.string;
+    NSInteger changeInLength = (NSInteger)string.length - (NSInteger)_length;
+    NSRange editedRange = NSMakeRange(range.location, range.length + changeInLength);
+    RTE_TRACE_SCOPE_WITH_ARGUMENT("update format index", editedRange.length);
+    
+    /// A list marker makes a whole paragraph a list item, and a '\n' moves the text after it into another paragraph,
+    /// so the runs of every paragraph the edit touches are read again.
+    NSUInteger start = RTEFormatParagraphStart(string, editedRange.location);
+    NSUInteger end = RTEFormatParagraphEnd(string, NSMaxRange(editedRange));
+    uint32_t before = 0;
+    uint32_t replaced = 0;
+    uint32_t after = 0;
+    
+    RTEFormatTreeSplit(&_tree, _tree.root, end - changeInLength, &before, &after);
+    RTEFormatTreeSplit(&_tree, before, start, &before, &replaced);
+    RTEFormatTreeFree(&_tree, replaced);
+    
+    uint32_t runs = [self treeOfRunsInRange:NSMakeRange(start, end - start) ofAttributedString:attributedString];
+    _tree.root = RTEFormatTreeMerge(&_tree, RTEFormatTreeMerge(&_tree, before, runs), after);
+    _length = string.length;
+}
+
+- (RTEFormatSummary)summaryOfRange:(NSRange)range {
+    NSUInteger start = MIN(range.location, _length);
+    NSUInteger end = MIN(NSMaxRange(range), _length);
+    RTEFormatSummary summary = RTEFormatTreeQuery(&_tree, _tree.root, start, end);
+    summary.all &= summary.any;
+    
+    return summary;
+}
+
++ (RTEFormatSummary)summaryOfRange:(NSRange)range inAttributedString:(NSAttributedString *)attributedString {
+    __block RTEFormatSummary summary = kEmptySummary;
+    NSUInteger start = MIN(range.location, attributedString.length);
+    NSUInteger end = MIN(NSMaxRange(range), attributedString.length);
+    
+    RTEFormatEnumerateRuns(attributedString, NSMakeRange(start, end - start), ^(NSUInteger length, RTEFormatAttributes attributes, uint32_t alignment) {
+        summary = RTEFormatSummaryCombine(summary, (RTEFormatSummary){attributes, attributes, alignment});
+    });
+    summary.all &= summary.any;
+    
+    return summary;
+}
+
+#pragma mark - Helper Methods -
+
+- (void)rebuildWithAttributedString:(NSAttributedString *)attributedString {
+    RTEFormatTreeReset(&_tree);
+    _tree.root = [self treeOfRunsInRange:NSMakeRange(0, attributedString.length) ofAttributedString:attributedString];
+    _length = attributedString.length;
+}
+
+/// A new subtree of the runs of range, neighbouring runs with the same attributes share a node.
+- (uint32_t)treeOfRunsInRange:(NSRange)range ofAttributedString:(NSAttributedString *)attributedString {
+    __block uint32_t root = 0;
+    __block NSUInteger pendingLength = 0;
+    __block RTEFormatAttributes pendingAttributes = 0;
+    __block uint32_t pendingAlignment = 0;
+    RTEFormatTree *tree = &_tree;
+    
+    RTEFormatEnumerateRuns(attributedString, range, ^(NSUInteger length, RTEFormatAttributes attributes, uint32_t alignment) {
+        if ((pendingLength > 0) && ((attributes != pendingAttributes) || (alignment != pendingAlignment))) {
+            root = RTEFormatTreeMerge(tree, root, RTEFormatTreeAllocate(tree, pendingLength, pendingAttributes, pendingAlignment));
+            pendingLength = 0;
+        }
+        
+        pendingLength += length;
+        pendingAttributes = attributes;
+        pendingAlignment = alignment;
+    });
+    
+    if (pendingLength > 0) {
+        root = RTEFormatTreeMerge(tree, root, RTEFormatTreeAllocate(tree, pendingLength, pendingAttributes, pendingAlignment));
+    }
+    
+    return root;
+}
+
+- (void)textStorageDidProcessEditing:(NSNotification *)notification {
+    NSTextStorage *textStorage = notification.object;
+    
+    if ([textStorage editedMask] == 0) {
+        return;
+    }
+    
+    /// The edited range covers the new characters, the replaced ones were changeInLength shorter or longer.
+    NSRange editedRange = [textStorage editedRange];
+    NSRange replacedRange = NSMakeRange(editedRange.location, editedRange.length - [textStorage changeInLength]);
+    
+    [self replaceCharactersInRange:replacedRange resultingAttributedString:textStorage];
+    
+    if (_length != textStorage.length) {
+        /// Should never happen, but rebuilding is cheaper than returning a wrong toolbar state.
+        [self rebuildWithAttributedString:textStorage];
+    }
+}
+
+@end
+
+@implementation NSTextStorage (RTEFormatIndex)
+
+- (void)attachFormatIndex {
+    if (objc_getAssociatedObject(self, kFormatIndexKey) != nil) {
+        return;
+    }
+    
+    RTEFormatIndex *formatIndex = [[RTEFormatIndex alloc] initWithAttributedString:self];
+    formatIndex.textStorage = self;
+    
+    [[NSNotificationCenter defaultCenter] addObserver:formatIndex selector:@selector(textStorageDidProcessEditing:) name:NSTextStorageDidProcessEditingNotification object:self];
+    objc_setAssociatedObject(self, kFormatIndexKey, formatIndex, OBJC_ASSOCIATION_RETAIN_NONATOMIC);
+}
+
+- (RTEFormatIndex *)RTEFormatIndex {
+    RTEFormatIndex *formatIndex = objc_getAssociatedObject(self, kFormatIndexKey);
+    
+    /// While the receiver is being edited, the index still describes it as it was before the edit.
+    if ((formatIndex == nil) || ([self editedMask] != 0) || (formatIndex.length != self.length)) {
+        return nil;
+    }
+    
+    return formatIndex;
+}
+
+@end
@@ -0,0 +1,58 @@
+//
+//  RTEFormatListCache.h
+//  RichTextEditor
+//
+//  Created by lam1611 on 10/18/26.
+//
+
+#import <Cocoa/Cocoa.h>
+
+typedef NS_ENUM(NSInteger, RTEFormatListType) {
+    RTEFormatListTypeNone           = 0,
+    RTEFormatListTypeBullet         = 1,
+    RTEFormatListTypeNumbering      = 2
+};
+
+/// Deepest nesting level of a list, deeper paragraphs are numbered at this level.
+static const NSUInteger kFormatListMaximumLevel = 15;
+
+/// Returns the nesting level of the list paragraph at paragraphRange.
+typedef NSUInteger (^RTEFormatListLevelProvider)(NSRange paragraphRange);
+
+/// The list type, level and number of every paragraph of a string, kept up to date from the edit deltas.
+/// Only the paragraphs touched by an edit are read again.
+///
+/// A list run is a sequence of list paragraphs, any other paragraph ends it. A numbered paragraph at level L
+/// counts the numbered paragraphs at level L since the last paragraph of its run with a level lower than L,
+/// so nested lists restart at 1 under every parent item. Bullets keep the numbering of their level going.
+///
+/// Numbers are answered from a min tree over the paragraph levels, which finds where the numbering restarts,
+/// and a Fenwick tree per level counting the numbered paragraphs, both in O(log n).
+/// Edits that keep the number of paragraphs, like toggling a list or changing an indent, update the trees in O(log n).
+/// Edits that insert or remove paragraphs shift the tables and rebuild the trees on the next query.
+@interface RTEFormatListCache : NSObject
+
+@property (nonatomic, readonly) NSUInteger length;
+@property (nonatomic, readonly) NSUInteger numberOfParagraphs;
+
+- (instancetype _Nonnull)initWithString:(NSString *_Nonnull)string;
+/// levelProvider is asked for the level of list paragraphs whenever they are read, all levels are 0 without it.
+- (instancetype _Nonnull)initWithString:(NSString *_Nonnull)string levelProvider:(RTEFormatListLevelProvider _Nullable)levelProvider;
+
+/// Applies an edit delta: the characters in range were replaced with string, resultingString is the string after the edit.
+/// Returns the range of paragraph indexes whose list type, level or number may have changed.
+- (NSRange)replaceCharactersInRange:(NSRange)range withString:(NSString *_Nonnull)string resultingString:(NSString *_Nonnull)resultingString;
+/// Asks the level provider again for the list paragraphs intersecting characterRange, after their attributes changed.
+/// Returns the range of paragraph indexes whose level or number may have changed, {NSNotFound, 0} if none.
+- (NSRange)updateLevelsOfParagraphsInRange:(NSRange)characterRange;
+
+- (NSUInteger)paragraphIndexAtLocation:(NSUInteger)location;
+- (NSRange)rangeOfParagraphAtIndex:(NSUInteger)paragraphIndex;
+
+- (RTEFormatListType)typeOfParagraphAtIndex:(NSUInteger)paragraphIndex;
+/// Nesting level of a list paragraph, 0 for other paragraphs.
+- (NSUInteger)levelOfParagraphAtIndex:(NSUInteger)paragraphIndex;
+/// Number drawn for a numbered paragraph, 0 for other paragraphs.
+- (NSInteger)numberOfParagraphAtIndex:(NSUInteger)paragraphIndex;
+
+@end
@@ -0,0 +1,422 @@
+//
+//  RTEFormatListCache.m
+//  RichTextEditor
+//
+//  Created by lam1611 on 10/18/26.
+//
+
+#import "RTEFormatListCache.h"
+
+#import "RTEParagraphIndex.h"
+
+/// Key of the paragraphs which are not in a list, lower than every level so they end every run.
+static const NSInteger kNoListKey = -1;
+
+/// Last index lower than end whose key is lower than bound, in the min tree node covering [lower, upper).
+static NSUInteger RTELastIndexWithKeyBelow(const NSInteger *keys, NSUInteger node, NSUInteger lower, NSUInteger upper, NSUInteger end, NSInteger bound) {
+    if ((lower >= end) || (keys[node] >= bound)) {
+        return NSNotFound;
+    }
+    
+    if (upper - lower == 1) {
+        return lower;
+    }
+    
+    NSUInteger middle = lower + (upper - lower) / 2;
+    NSUInteger index = RTELastIndexWithKeyBelow(keys, 2 * node + 1, middle, upper, end, bound);
+    
+    return (index != NSNotFound) ? index : RTELastIndexWithKeyBelow(keys, 2 * node, lower, middle, end, bound);
+}
+
+/// First index not lower than start whose key is lower than bound, in the min tree node covering [lower, upper).
+static NSUInteger RTEFirstIndexWithKeyBelow(const NSInteger *keys, NSUInteger node, NSUInteger lower, NSUInteger upper, NSUInteger start, NSInteger bound) {
+    if ((upper <= start) || (keys[node] >= bound)) {
+        return NSNotFound;
+    }
+    
+    if (upper - lower == 1) {
+        return lower;
+    }
+    
+    NSUInteger middle = lower + (upper - lower) / 2;
+    NSUInteger index = RTEFirstIndexWithKeyBelow(keys, 2 * node, lower, middle, start, bound);
+    
+    return (index != NSNotFound) ? index : RTEFirstIndexWithKeyBelow(keys, 2 * node + 1, middle, upper, start, bound);
+}
+
+@interface RTEFormatListCache () {
+    uint8_t *_types;
+    uint8_t *_levels;
+    NSUInteger _capacity;
+    
+    /// Min tree over the paragraph keys: kNoListKey for paragraphs out of a list, the level for list paragraphs.
+    NSInteger *_minimumKeys;
+    NSUInteger _numberOfLeaves;
+    /// Fenwick trees counting the numbered paragraphs of each level, allocated for the levels in use only.
+    NSUInteger *_numberedCounts[kFormatListMaximumLevel + 1];
+    /// Number of paragraphs the trees were built for.
+    NSUInteger _numberOfTreeParagraphs;
+    BOOL _treesAreValid;
+}
+
+@property (nonatomic, strong) RTEParagraphIndex *paragraphIndex;
+@property (nonatomic, copy) RTEFormatListLevelProvider levelProvider;
+
+@end
+
+@implementation RTEFormatListCache
+
+#pragma mark - Initialization -
+
+- (instancetype)initWithString:(NSString *)string {
+    return [self initWithString:string levelProvider:nil];
+}
+
+- (instancetype)initWithString:(NSString *)string levelProvider:(RTEFormatListLevelProvider)levelProvider {
+    if (self = [super init]) {
+        _levelProvider = [levelProvider copy];
+        _paragraphIndex = [[RTEParagraphIndex alloc] initWithString:string];
+        _capacity = MAX(_paragraphIndex.numberOfParagraphs, 16);
+        _types = malloc(_capacity * sizeof(uint8_t));
+        _levels = malloc(_capacity * sizeof(uint8_t));
+        _treesAreValid = NO;
+        
+        for (NSUInteger i = 0; i < _paragraphIndex.numberOfParagraphs; i++) {
+            [self readParagraphAtIndex:i inString:string];
+        }
+    }
+    
+    return self;
+}
+
+- (void)dealloc {
+    free(_types);
+    free(_levels);
+    free(_minimumKeys);
+    
+    for (NSUInteger level = 0; level <= kFormatListMaximumLevel; level++) {
+        free(_numberedCounts[level]);
+    }
+}
+
+#pragma mark - Public Methods -
+
+- (NSUInteger)length {
+    return self.paragraphIndex.length;
+}
+
+- (NSUInteger)numberOfParagraphs {
+    return self.paragraphIndex.numberOfParagraphs;
+}
+
+- (NSRange)replaceCharactersInRange:(NSRange)range withString:(NSString *)string resultingString:(NSString *)resultingString {
+    RTEParagraphIndex *paragraphIndex = self.paragraphIndex;
+    NSUInteger first = [paragraphIndex paragraphIndexAtLocation:range.location];
+    NSUInteger oldLast = [paragraphIndex paragraphIndexAtLocation:NSMaxRange(range)];
+    NSUInteger oldNumberOfParagraphs = paragraphIndex.numberOfParagraphs;
+    
+    [paragraphIndex replaceCharactersInRange:range withString:string];
+    
+    NSUInteger newLast = [paragraphIndex paragraphIndexAtLocation:range.location + string.length];
+    
+    if (paragraphIndex.length != resultingString.length) {
+        /// Should never happen, but rebuilding is cheaper than drawing wrong markers.
+        self.paragraphIndex = [[RTEParagraphIndex alloc] initWithString:resultingString];
+        paragraphIndex = self.paragraphIndex;
+        first = 0;
+        oldLast = oldNumberOfParagraphs - 1;
+        newLast = paragraphIndex.numberOfParagraphs - 1;
+    }
+    
+    NSUInteger oldCount = oldLast - first + 1;
+    NSUInteger newCount = newLast - first + 1;
+    
+    if (oldCount == newCount) {
+        /// The paragraphs stay where they are, only the tree paths of the edited ones change.
+        for (NSUInteger i = first; i <= newLast; i++) {
+            RTEFormatListType oldType = (RTEFormatListType)_types[i];
+            NSUInteger oldLevel = _levels[i];
+            
+            [self readParagraphAtIndex:i inString:resultingString];
+            [self updateTreesForParagraphAtIndex:i oldType:oldType oldLevel:oldLevel];
+        }
+    } else {
+        NSUInteger tailCount = oldNumberOfParagraphs - oldLast - 1;
+        NSUInteger numberOfParagraphs = paragraphIndex.numberOfParagraphs;
+        
+        if (numberOfParagraphs > _capacity) {
+            while (numberOfParagraphs > _capacity) {
+                _capacity *= 2;
+            }
+            
+            _types = realloc(_types, _capacity * sizeof(uint8_t));
+            _levels = realloc(_levels, _capacity * sizeof(uint8_t));
+        }
+        
+        memmove(_types + first + newCount, _types + first + oldCount, tailCount * sizeof(uint8_t));
+        memmove(_levels + first + newCount, _levels + first + oldCount, tailCount * sizeof(uint8_t));
+        
+        for (NSUInteger i = first; i <= newLast; i++) {
+            [self readParagraphAtIndex:i inString:resultingString];
+        }
+        
+        _treesAreValid = NO;
+    }
+    
+    return NSMakeRange(first, [self lastParagraphIndexOfRunAtIndex:newLast] - first + 1);
+}
+
+- (NSRange)updateLevelsOfParagraphsInRange:(NSRange)characterRange {
+    RTEFormatListLevelProvider levelProvider = self.levelProvider;
+    NSUInteger first = [self.paragraphIndex paragraphIndexAtLocation:characterRange.location];
+    NSUInteger last = [self.paragraphIndex paragraphIndexAtLocation:NSMaxRange(characterRange)];
+    NSUInteger firstChanged = NSNotFound;
+    NSUInteger lastChanged = NSNotFound;
+    
+    if (levelProvider == nil) {
+        return NSMakeRange(NSNotFound, 0);
+    }
+    
+    for (NSUInteger i = first; i <= last; i++) {
+        if (_types[i] == RTEFormatListTypeNone) {
+            continue;
+        }
+        
+        NSUInteger oldLevel = _levels[i];
+        NSUInteger level = MIN(levelProvider([self.paragraphIndex rangeOfParagraphAtIndex:i]), kFormatListMaximumLevel);
+        
+        if (level == oldLevel) {
+            continue;
+        }
+        
+        _levels[i] = (uint8_t)level;
+        [self updateTreesForParagraphAtIndex:i oldType:(RTEFormatListType)_types[i] oldLevel:oldLevel];
+        
+        firstChanged = (firstChanged == NSNotFound) ? i : firstChanged;
+        lastChanged = i;
+    }
+    
+    if (firstChanged == NSNotFound) {
+        return NSMakeRange(NSNotFound, 0);
+    }
+    
+    return NSMakeRange(firstChanged, [self lastParagraphIndexOfRunAtIndex:lastChanged] - firstChanged + 1);
+}
+
+- (NSUInteger)paragraphIndexAtLocation:(NSUInteger)location {
+    return [self.paragraphIndex paragraphIndexAtLocation:location];
+}
+
+- (NSRange)rangeOfParagraphAtIndex:(NSUInteger)paragraphIndex {
+    return [self.paragraphIndex rangeOfParagraphAtIndex:paragraphIndex];
+}
+
+- (RTEFormatListType)typeOfParagraphAtIndex:(NSUInteger)paragraphIndex {
+    if (paragraphIndex >= self.paragraphIndex.numberOfParagraphs) {
+        return RTEFormatListTypeNone;
+    }
+    
+    return (RTEFormatListType)_types[paragraphIndex];
+}
+
+- (NSUInteger)levelOfParagraphAtIndex:(NSUInteger)paragraphIndex {
+    if (paragraphIndex >= self.paragraphIndex.numberOfParagraphs) {
+        return 0;
+    }
+    
+    return _levels[paragraphIndex];
+}
+
+- (NSInteger)numberOfParagraphAtIndex:(NSUInteger)paragraphIndex {
+    if ([self typeOfParagraphAtIndex:paragraphIndex] != RTEFormatListTypeNumbering) {
+        return 0;
+    }
+    
+    [self buildTreesIfNeeded];
+    
+    /// The numbering restarts after the last paragraph above with a lower level, or out of a list.
+    NSUInteger level = _levels[paragraphIndex];
+    NSUInteger restartIndex = RTELastIndexWithKeyBelow(_minimumKeys, 1, 0, _numberOfLeaves, paragraphIndex, (NSInteger)level);
+    NSUInteger count = [self numberedCountAtLevel:level beforeIndex:paragraphIndex + 1];
+    
+    if (restartIndex != NSNotFound) {
+        count -= [self numberedCountAtLevel:level beforeIndex:restartIndex + 1];
+    }
+    
+    return (NSInteger)count;
+}
+
+#pragma mark - Helper Methods -
+
+- (void)readParagraphAtIndex:(NSUInteger)paragraphIndex inString:(NSString *)string {
+    NSRange paragraphRange = [self.paragraphIndex rangeOfParagraphAtIndex:paragraphIndex];
+    uint8_t type = [self typeOfParagraphWithRange:paragraphRange inString:string];
+    NSUInteger level = 0;
+    
+    if ((type != RTEFormatListTypeNone) && (self.levelProvider != nil)) {
+        level = MIN(self.levelProvider(paragraphRange), kFormatListMaximumLevel);
+    }
+    
+    _types[paragraphIndex] = type;
+    _levels[paragraphIndex] = (uint8_t)level;
+}
+
+- (uint8_t)typeOfParagraphWithRange:(NSRange)paragraphRange inString:(NSString *)string {
+    if (paragraphRange.length < 2) {
+        return RTEFormatListTypeNone;
+    }
+    
+    unichar characters[2];
+    [string getCharacters:characters range:NSMakeRange(paragraphRange.location, 2)];
+    
+    /// The control code followed by a non-breaking space, see +[RTELayoutManager kBulletString].
+    if (characters[1] != 0x00A0) {
+        return RTEFormatListTypeNone;
+    }
+    
+    if (characters[0] == 0x010) {
+        return RTEFormatListTypeBullet;
+    }
+    
+    if (characters[0] == 0x011) {
+        return RTEFormatListTypeNumbering;
+    }
+    
+    return RTEFormatListTypeNone;
+}
+
+- (NSInteger)keyOfParagraphAtIndex:(NSUInteger)paragraphIndex {
+    return (_types[paragraphIndex] == RTEFormatListTypeNone) ? kNoListKey : (NSInteger)_levels[paragraphIndex];
+}
+
+/// Index of the last paragraph of the list run containing paragraphIndex, paragraphIndex if it isn't in a list.
+- (NSUInteger)lastParagraphIndexOfRunAtIndex:(NSUInteger)paragraphIndex {
+    NSUInteger numberOfParagraphs = self.paragraphIndex.numberOfParagraphs;
+    
+    if (_treesAreValid) {
+        NSUInteger endIndex = RTEFirstIndexWithKeyBelow(_minimumKeys, 1, 0, _numberOfLeaves, paragraphIndex + 1, 0);
+        
+        return (endIndex != NSNotFound) ? endIndex - 1 : numberOfParagraphs - 1;
+    }
+    
+    NSUInteger last = paragraphIndex;
+    
+    while ((last + 1 < numberOfParagraphs) && (_types[last + 1] != RTEFormatListTypeNone)) {
+        last++;
+    }
+    
+    return last;
+}
+
+- (void)buildTreesIfNeeded {
+    if (_treesAreValid) {
+        return;
+    }
+    
+    NSUInteger numberOfParagraphs = self.paragraphIndex.numberOfParagraphs;
+    NSUInteger numberOfLeaves = 1;
+    
+    while (numberOfLeaves < numberOfParagraphs) {
+        numberOfLeaves *= 2;
+    }
+    
+    if (numberOfLeaves != _numberOfLeaves) {
+        _numberOfLeaves = numberOfLeaves;
+        _minimumKeys = realloc(_minimumKeys, 2 * numberOfLeaves * sizeof(NSInteger));
+    }
+    
+    for (NSUInteger i = 0; i < numberOfLeaves; i++) {
+        _minimumKeys[numberOfLeaves + i] = (i < numberOfParagraphs) ? [self keyOfParagraphAtIndex:i] : NSIntegerMax;
+    }
+    
+    for (NSUInteger node = numberOfLeaves - 1; node >= 1; node--) {
+        _minimumKeys[node] = MIN(_minimumKeys[2 * node], _minimumKeys[2 * node + 1]);
+    }
+    
+    for (NSUInteger level = 0; level <= kFormatListMaximumLevel; level++) {
+        free(_numberedCounts[level]);
+        _numberedCounts[level] = NULL;
+    }
+    
+    _numberOfTreeParagraphs = numberOfParagraphs;
+    
+    for (NSUInteger i = 0; i < numberOfParagraphs; i++) {
+        if (_types[i] == RTEFormatListTypeNumbering) {
+            [self numberedCountsAtLevel:_levels[i]][i + 1] += 1;
+        }
+    }
+    
+    /// Turn the counts into Fenwick trees in linear time.
+    for (NSUInteger level = 0; level <= kFormatListMaximumLevel; level++) {
+        NSUInteger *counts = _numberedCounts[level];
+        
+        if (counts == NULL) {
+            continue;
+        }
+        
+        for (NSUInteger i = 1; i <= numberOfParagraphs; i++) {
+            NSUInteger parent = i + (i & (~i + 1));
+            
+            if (parent <= numberOfParagraphs) {
+                counts[parent] += counts[i];
+            }
+        }
+    }
+    
+    _treesAreValid = YES;
+}
+
+- (NSUInteger *)numberedCountsAtLevel:(NSUInteger)level {
+    if (_numberedCounts[level] == NULL) {
+        _numberedCounts[level] = calloc(_numberOfTreeParagraphs + 1, sizeof(NSUInteger));
+    }
+    
+    return _numberedCounts[level];
+}
+
+/// Number of numbered paragraphs at level among the first count paragraphs.
+- (NSUInteger)numberedCountAtLevel:(NSUInteger)level beforeIndex:(NSUInteger)count {
+    NSUInteger *counts = _numberedCounts[level];
+    NSUInteger sum = 0;
+    
+    if (counts == NULL) {
+        return 0;
+    }
+    
+    for (NSUInteger i = count; i > 0; i -= (i & (~i + 1))) {
+        sum += counts[i];
+    }
+    
+    return sum;
+}
+
+- (void)addNumberedCount:(NSInteger)delta atLevel:(NSUInteger)level index:(NSUInteger)paragraphIndex {
+    NSUInteger *counts = [self numberedCountsAtLevel:level];
+    
+    for (NSUInteger i = paragraphIndex + 1; i <= _numberOfTreeParagraphs; i += (i & (~i + 1))) {
+        counts[i] = (NSUInteger)((NSInteger)counts[i] + delta);
+    }
+}
+
+- (void)updateTreesForParagraphAtIndex:(NSUInteger)paragraphIndex oldType:(RTEFormatListType)oldType oldLevel:(NSUInteger)oldLevel {
+    if (!_treesAreValid) {
+        return;
+    }
+    
+    if (oldType == RTEFormatListTypeNumbering) {
+        [self addNumberedCount:-1 atLevel:oldLevel index:paragraphIndex];
+    }
+    
+    if (_types[paragraphIndex] == RTEFormatListTypeNumbering) {
+        [self addNumberedCount:1 atLevel:_levels[paragraphIndex] index:paragraphIndex];
+    }
+    
+    NSUInteger node = _numberOfLeaves + paragraphIndex;
+    _minimumKeys[node] = [self keyOfParagraphAtIndex:paragraphIndex];
+    
+    for (node /= 2; node >= 1; node /= 2) {
+        _minimumKeys[node] = MIN(_minimumKeys[2 * node], _minimumKeys[2 * node + 1]);
+    }
+}
+
+@end
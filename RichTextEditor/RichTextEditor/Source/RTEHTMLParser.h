@@ -0,0 +1,28 @@
+//
+//  RTEHTMLParser.h
+//  RichTextEditor
+//
+//  Created by lam1611 on 10/18/26.
+//
+
+#import <Cocoa/Cocoa.h>
+
+/// Converts the HTML written by RTEHTMLSerializer back to an NSAttributedString in a single pass.
+/// Text, attribute runs, paragraph styles and the bullet and numbering markers are all built while
+/// reading the markup, there are no further passes over the document.
+/// HTML from other sources is not handled, the parser returns nil so the caller can fall back to the AppKit importer.
+@interface RTEHTMLParser : NSObject
+
+/// Attributes used where the HTML doesn't specify a font or color, the same as the defaultAttributes of
+/// +[RichTextEditor attributedStringFromHTMLString:defaultAttributes:].
+@property (nonatomic, copy, readonly, nonnull) NSDictionary<NSAttributedStringKey, id> *defaultAttributes;
+
+- (instancetype _Nonnull)initWithDefaultAttributes:(NSDictionary<NSAttributedStringKey, id> *_Nonnull)defaultAttributes;
+
+/// YES if the generator meta tag of htmlString says it was exported by this editor.
++ (BOOL)isExportedHTML:(NSString *_Nonnull)htmlString;
+
+/// Returns nil if htmlString wasn't exported by this editor or contains markup the serializer never writes.
+- (NSAttributedString *_Nullable)attributedStringFromHTMLString:(NSString *_Nonnull)htmlString;
+
+@end
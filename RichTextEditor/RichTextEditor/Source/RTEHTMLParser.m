@@ -0,0 +1,721 @@
+//
+//  RTEHTMLParser.m
+//  RichTextEditor
+//
+//  Created by lam1611 on 10/18/26.
+//
+
+#import "RTEHTMLParser.h"
+
+#import "RTEDefiniens.h"
+#import "RTEFontManager.h"
+#import "RTEHTMLSniffer.h"
+#import "RTELayoutManager.h"
+#import "NSFont+RichTextEditor.h"
+
+typedef struct {
+    NSUInteger location;
+    NSUInteger length;
+    __unsafe_unretained NSDictionary *attributes;
+} RTEHTMLRun;
+
+typedef struct {
+    NSUInteger location;
+    NSUInteger length;
+    __unsafe_unretained NSParagraphStyle *paragraphStyle;
+} RTEHTMLParagraph;
+
+@interface RTEHTMLParser () {
+    const unichar *_characters;
+    NSUInteger _length;
+    NSUInteger _position;
+    
+    unichar *_text;
+    NSUInteger _textLength;
+    NSUInteger _textCapacity;
+    
+    RTEHTMLRun *_runs;
+    NSUInteger _numberOfRuns;
+    NSUInteger _runsCapacity;
+    
+    RTEHTMLParagraph *_paragraphs;
+    NSUInteger _numberOfParagraphs;
+    NSUInteger _paragraphsCapacity;
+}
+
+/// Keep the objects referenced by the runs and paragraphs alive.
+@property (nonatomic, strong) NSMutableDictionary<NSString *, NSDictionary *> *runAttributes;
+@property (nonatomic, strong) NSMutableDictionary<NSString *, NSParagraphStyle *> *paragraphStyles;
+@property (nonatomic, strong) NSDictionary *plainRunAttributes;
+
+@end
+
+@implementation RTEHTMLParser
+
+#pragma mark - Initialization -
+
+- (instancetype)initWithDefaultAttributes:(NSDictionary<NSAttributedStringKey, id> *)defaultAttributes {
+    if (self = [super init]) {
+        _defaultAttributes = [defaultAttributes copy];
+        _runAttributes = [[NSMutableDictionary alloc] init];
+        _paragraphStyles = [[NSMutableDictionary alloc] init];
+    }
+    
+    return self;
+}
+
+- (void)dealloc {
+    free(_text);
+    free(_runs);
+    free(_paragraphs);
+}
+
+#pragma mark - Public Methods -
+
++ (BOOL)isExportedHTML:(NSString *)htmlString {
+    return [RTEHTMLSniffer sniffString:htmlString] == RTEHTMLSnifferResultExportedHTML;
+}
+
+- (NSAttributedString *)attributedStringFromHTMLString:(NSString *)htmlString {
+    if (![[self class] isExportedHTML:htmlString]) {
+        return nil;
+    }
+    
+    NSUInteger length = htmlString.length;
+    unichar *characters = malloc(MAX(length, 1) * sizeof(unichar));
+    [htmlString getCharacters:characters range:NSMakeRange(0, length)];
+    
+    _characters = characters;
+    _length = length;
+    _position = 0;
+    _textLength = 0;
+    _numberOfRuns = 0;
+    _numberOfParagraphs = 0;
+    self.plainRunAttributes = [self attributesForSpanStyle:@"" link:nil];
+    
+    BOOL succeeded = [self parseDocument];
+    NSAttributedString *attributedString = succeeded ? [self buildAttributedString] : nil;
+    
+    free(characters);
+    _characters = NULL;
+    [self.runAttributes removeAllObjects];
+    [self.paragraphStyles removeAllObjects];
+    
+    return attributedString;
+}
+
+#pragma mark - Parsing -
+
+- (BOOL)parseDocument {
+    /// Everything before the body is the fixed head written by the serializer.
+    NSString *tagName = nil;
+    NSDictionary<NSString *, NSString *> *tagAttributes = nil;
+    
+    while ([self skipToCharacter:'<']) {
+        if (![self readTagName:&tagName attributes:&tagAttributes]) {
+            return NO;
+        }
+        
+        if ([tagName isEqualToString:@"body"]) {
+            break;
+        }
+    }
+    
+    if (_position >= _length) {
+        return NO;
+    }
+    
+    BOOL paragraphOpened = NO;
+    NSUInteger paragraphLocation = 0;
+    NSString *paragraphStyleString = nil;
+    NSString *link = nil;
+    NSDictionary *spanAttributes = nil;
+    NSDictionary *lastAttributes = self.plainRunAttributes;
+    
+    while (_position < _length) {
+        unichar character = _characters[_position];
+        
+        if (character == '<') {
+            if (![self readTagName:&tagName attributes:&tagAttributes]) {
+                return NO;
+            }
+            
+            if ([tagName isEqualToString:@"p"]) {
+                if (paragraphOpened) {
+                    return NO;
+                }
+                
+                paragraphOpened = YES;
+                paragraphLocation = _textLength;
+                paragraphStyleString = [tagAttributes objectForKey:@"style"] ?: @"";
+            } else if ([tagName isEqualToString:@"/p"] || ([tagName isEqualToString:@"br"] && paragraphOpened && (_textLength > paragraphLocation))) {
+                if (!paragraphOpened) {
+                    return NO;
+                }
+                
+                /// The newline belongs to the paragraph and takes the attributes of its last character.
+                [self appendCharacter:'\n' attributes:lastAttributes];
+                [self addParagraphWithRange:NSMakeRange(paragraphLocation, _textLength - paragraphLocation) style:paragraphStyleString];
+                
+                if ([tagName isEqualToString:@"br"]) {
+                    paragraphLocation = _textLength;
+                } else {
+                    paragraphOpened = NO;
+                }
+            } else if ([tagName isEqualToString:@"br"]) {
+                /// Written into empty paragraphs only to keep their height.
+                continue;
+            } else if ([tagName isEqualToString:@"span"]) {
+                if (!paragraphOpened || (spanAttributes != nil)) {
+                    return NO;
+                }
+                
+                spanAttributes = [self attributesForSpanStyle:([tagAttributes objectForKey:@"style"] ?: @"") link:link];
+            } else if ([tagName isEqualToString:@"/span"]) {
+                spanAttributes = nil;
+            } else if ([tagName isEqualToString:@"a"]) {
+                link = [tagAttributes objectForKey:@"href"];
+            } else if ([tagName isEqualToString:@"/a"]) {
+                link = nil;
+            } else if ([tagName isEqualToString:@"/body"]) {
+                break;
+            } else {
+                return NO;
+            }
+        } else {
+            if (character == '&') {
+                if (![self readEntity:&character]) {
+                    return NO;
+                }
+            } else {
+                _position++;
+            }
+            
+            if (!paragraphOpened) {
+                /// The serializer never writes text between paragraphs.
+                if (character != ' ' && character != '\n' && character != '\r' && character != '\t') {
+                    return NO;
+                }
+                
+                continue;
+            }
+            
+            lastAttributes = spanAttributes ?: self.plainRunAttributes;
+            [self appendCharacter:character attributes:lastAttributes];
+        }
+    }
+    
+    if (paragraphOpened) {
+        [self appendCharacter:'\n' attributes:lastAttributes];
+        [self addParagraphWithRange:NSMakeRange(paragraphLocation, _textLength - paragraphLocation) style:paragraphStyleString];
+    }
+    
+    return YES;
+}
+
+/// Moves to the next occurrence of character, returns NO at the end of the document.
+- (BOOL)skipToCharacter:(unichar)character {
+    while (_position < _length && _characters[_position] != character) {
+        _position++;
+    }
+    
+    return _position < _length;
+}
+
+/// Reads the tag at the current position, '<' included. Closing tags are named with a leading '/'.
+/// Only double or single quoted attribute values are accepted, that's all the serializer writes.
+- (BOOL)readTagName:(NSString **)tagName attributes:(NSDictionary<NSString *, NSString *> **)attributes {
+    NSUInteger position = _position + 1;
+    NSUInteger nameStart = position;
+    NSMutableDictionary *tagAttributes = nil;
+    
+    if (position < _length && _characters[position] == '/') {
+        position++;
+    }
+    
+    if (position < _length && _characters[position] == '!') {
+        /// <!DOCTYPE html>
+        position++;
+    }
+    
+    while (position < _length && _characters[position] < 0x80 && (isalnum(_characters[position]) || _characters[position] == '-')) {
+        position++;
+    }
+    
+    if (position == nameStart) {
+        return NO;
+    }
+    
+    *tagName = [[[NSString alloc] initWithCharacters:_characters + nameStart length:position - nameStart] lowercaseString];
+    
+    while (position < _length) {
+        unichar character = _characters[position];
+        
+        if (character == '>') {
+            _position = position + 1;
+            *attributes = tagAttributes;
+            return YES;
+        }
+        
+        if (character == ' ' || character == '\n' || character == '\t' || character == '/') {
+            position++;
+            continue;
+        }
+        
+        NSUInteger attributeNameStart = position;
+        
+        while (position < _length && _characters[position] != '=' && _characters[position] != '>' && _characters[position] != ' ') {
+            position++;
+        }
+        
+        NSString *attributeName = [[[NSString alloc] initWithCharacters:_characters + attributeNameStart length:position - attributeNameStart] lowercaseString];
+        NSString *attributeValue = @"";
+        
+        if (position < _length && _characters[position] == '=') {
+            position++;
+            
+            if (position >= _length || (_characters[position] != '"' && _characters[position] != '\'')) {
+                return NO;
+            }
+            
+            unichar quote = _characters[position++];
+            NSUInteger valueStart = position;
+            
+            while (position < _length && _characters[position] != quote) {
+                position++;
+            }
+            
+            if (position >= _length) {
+                return NO;
+            }
+            
+            attributeValue = [self unescapedStringWithRange:NSMakeRange(valueStart, position - valueStart)];
+            
+            if (attributeValue == nil) {
+                return NO;
+            }
+            
+            position++;
+        }
+        
+        if (tagAttributes == nil) {
+            tagAttributes = [[NSMutableDictionary alloc] init];
+        }
+        
+        [tagAttributes setObject:attributeValue forKey:attributeName];
+    }
+    
+    return NO;
+}
+
+/// Reads the character reference at the current position, '&' included.
+- (BOOL)readEntity:(unichar *)character {
+    NSUInteger position = _position + 1;
+    NSUInteger nameStart = position;
+    
+    while (position < _length && _characters[position] != ';' && (position - nameStart) < 8) {
+        position++;
+    }
+    
+    if (position >= _length || _characters[position] != ';') {
+        return NO;
+    }
+    
+    NSUInteger nameLength = position - nameStart;
+    const unichar *name = _characters + nameStart;
+    unichar value = 0;
+    
+    if (nameLength >= 2 && name[0] == '#') {
+        BOOL isHexadecimal = (name[1] == 'x' || name[1] == 'X');
+        NSUInteger digitsStart = isHexadecimal ? 2 : 1;
+        uint32_t codePoint = 0;
+        
+        if (nameLength <= digitsStart) {
+            return NO;
+        }
+        
+        for (NSUInteger i = digitsStart; i < nameLength; i++) {
+            unichar digit = name[i];
+            uint32_t digitValue;
+            
+            if (digit >= '0' && digit <= '9') {
+                digitValue = digit - '0';
+            } else if (isHexadecimal && digit >= 'a' && digit <= 'f') {
+                digitValue = digit - 'a' + 10;
+            } else if (isHexadecimal && digit >= 'A' && digit <= 'F') {
+                digitValue = digit - 'A' + 10;
+            } else {
+                return NO;
+            }
+            
+            codePoint = codePoint * (isHexadecimal ? 16 : 10) + digitValue;
+        }
+        
+        /// Only the references written by the serializer, which never leave the BMP.
+        if (codePoint == 0 || codePoint > 0xFFFF) {
+            return NO;
+        }
+        
+        value = (unichar)codePoint;
+    } else if (nameLength == 3 && name[0] == 'a' && name[1] == 'm' && name[2] == 'p') {
+        value = '&';
+    } else if (nameLength == 2 && name[0] == 'l' && name[1] == 't') {
+        value = '<';
+    } else if (nameLength == 2 && name[0] == 'g' && name[1] == 't') {
+        value = '>';
+    } else if (nameLength == 4 && name[0] == 'q' && name[1] == 'u' && name[2] == 'o' && name[3] == 't') {
+        value = '"';
+    } else if (nameLength == 4 && name[0] == 'a' && name[1] == 'p' && name[2] == 'o' && name[3] == 's') {
+        value = '\'';
+    } else if (nameLength == 4 && name[0] == 'n' && name[1] == 'b' && name[2] == 's' && name[3] == 'p') {
+        value = 0x00A0;
+    } else {
+        return NO;
+    }
+    
+    *character = value;
+    _position = position + 1;
+    
+    return YES;
+}
+
+- (NSString *)unescapedStringWithRange:(NSRange)range {
+    NSMutableString *string = [NSMutableString stringWithCapacity:range.length];
+    NSUInteger savedPosition = _position;
+    NSUInteger position = range.location;
+    
+    while (position < NSMaxRange(range)) {
+        unichar character = _characters[position];
+        
+        if (character == '&') {
+            _position = position;
+            
+            if (![self readEntity:&character] || _position > NSMaxRange(range)) {
+                _position = savedPosition;
+                return nil;
+            }
+            
+            position = _position;
+        } else {
+            position++;
+        }
+        
+        [string appendFormat:@"%C", character];
+    }
+    
+    _position = savedPosition;
+    
+    return string;
+}
+
+#pragma mark - Styles -
+
+- (NSDictionary *)attributesForSpanStyle:(NSString *)style link:(NSString *)link {
+    NSString *key = (link != nil) ? [NSString stringWithFormat:@"%@\n%@", style, link] : style;
+    NSDictionary *attributes = [self.runAttributes objectForKey:key];
+    
+    if (attributes != nil) {
+        return attributes;
+    }
+    
+    NSMutableDictionary *runAttributes = [[NSMutableDictionary alloc] init];
+    NSFont *defaultFont = [self.defaultAttributes objectForKey:NSFontAttributeName];
+    NSString *familyName = nil;
+    CGFloat fontSize = [defaultFont isKindOfClass:[NSFont class]] ? defaultFont.pointSize : [NSFont systemFontSize];
+    BOOL isBold = NO;
+    BOOL isItalic = NO;
+    BOOL hasUnderline = NO;
+    BOOL hasStrikethrough = NO;
+    NSColor *foregroundColor = nil;
+    NSColor *backgroundColor = nil;
+    
+    for (NSString *declaration in [style componentsSeparatedByString:@";"]) {
+        NSRange separatorRange = [declaration rangeOfString:@":"];
+        
+        if (separatorRange.location == NSNotFound) {
+            continue;
+        }
+        
+        NSString *property = [[declaration substringToIndex:separatorRange.location] stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceCharacterSet]];
+        NSString *value = [[declaration substringFromIndex:NSMaxRange(separatorRange)] stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceCharacterSet]];
+        
+        if ([property isEqualToString:@"font-family"]) {
+            if (value.length >= 2 && [value hasPrefix:@"'"] && [value hasSuffix:@"'"]) {
+                value = [value substringWithRange:NSMakeRange(1, value.length - 2)];
+            }
+            
+            familyName = [value stringByReplacingOccurrencesOfString:@"\\'" withString:@"'"];
+        } else if ([property isEqualToString:@"font-size"]) {
+            CGFloat size = [value doubleValue];
+            
+            if (size > 0) {
+                fontSize = size;
+            }
+        } else if ([property isEqualToString:@"font-weight"]) {
+            isBold = [value isEqualToString:@"bold"];
+        } else if ([property isEqualToString:@"font-style"]) {
+            isItalic = [value isEqualToString:@"italic"];
+        } else if ([property isEqualToString:@"text-decoration"]) {
+            hasUnderline = [value containsString:@"underline"];
+            hasStrikethrough = [value containsString:@"line-through"];
+        } else if ([property isEqualToString:@"color"]) {
+            foregroundColor = [self colorFromString:value];
+        } else if ([property isEqualToString:@"background-color"]) {
+            backgroundColor = [self colorFromString:value];
+        }
+    }
+    
+    NSFont *font = [self fontWithFamilyName:familyName size:fontSize boldTrait:isBold italicTrait:isItalic];
+    
+    if (font != nil) {
+        [runAttributes setObject:font forKey:NSFontAttributeName];
+    }
+    
+    if (foregroundColor == nil) {
+        /// Set default color in case of no available color found, the same as the AppKit import.
+        id defaultColor = [self.defaultAttributes objectForKey:NSForegroundColorAttributeName];
+        foregroundColor = [defaultColor isKindOfClass:[NSColor class]] ? defaultColor : nil;
+    }
+    
+    if (foregroundColor != nil) {
+        [runAttributes setObject:foregroundColor forKey:NSForegroundColorAttributeName];
+    }
+    
+    if (backgroundColor != nil) {
+        [runAttributes setObject:backgroundColor forKey:NSBackgroundColorAttributeName];
+    }
+    
+    if (hasUnderline) {
+        [runAttributes setObject:[NSNumber numberWithInteger:NSUnderlineStyleSingle] forKey:NSUnderlineStyleAttributeName];
+    }
+    
+    if (hasStrikethrough) {
+        [runAttributes setObject:[NSNumber numberWithInteger:NSUnderlineStyleSingle] forKey:NSStrikethroughStyleAttributeName];
+    }
+    
+    if (link.length > 0) {
+        [runAttributes setObject:link forKey:NSLinkAttributeName];
+    }
+    
+    attributes = [runAttributes copy];
+    [self.runAttributes setObject:attributes forKey:key];
+    
+    return attributes;
+}
+
+- (NSFont *)fontWithFamilyName:(NSString *)familyName size:(CGFloat)size boldTrait:(BOOL)isBold italicTrait:(BOOL)isItalic {
+    NSFont *font = nil;
+    NSFont *defaultFont = [self.defaultAttributes objectForKey:NSFontAttributeName];
+    
+    if ([familyName hasPrefix:@"."]) {
+        /// The system font can't be created by name. Parsing runs on worker threads, so the traits go through
+        /// the font descriptor rather than NSFontManager, which is main-thread only.
+        NSFont *systemFont = [NSFont systemFontOfSize:size];
+        NSFontDescriptorSymbolicTraits traits = systemFont.fontDescriptor.symbolicTraits;
+        
+        if (isBold) {
+            traits |= NSFontDescriptorTraitBold;
+        }
+        
+        if (isItalic) {
+            traits |= NSFontDescriptorTraitItalic;
+        }
+        
+        if (traits != systemFont.fontDescriptor.symbolicTraits) {
+            font = [NSFont fontWithDescriptor:[systemFont.fontDescriptor fontDescriptorWithSymbolicTraits:traits] size:size];
+        }
+        
+        return font ?: systemFont;
+    }
+    
+    if ((familyName.length > 0) && ([[[RTEFontManager sharedManager] availableFontsDictionary] objectForKey:familyName] != nil)) {
+        font = [NSFont fontWithName:familyName size:size boldTrait:isBold italicTrait:isItalic];
+    }
+    
+    /// Set default font in case of no available font found, the same as the AppKit import.
+    if ((font == nil) && [defaultFont isKindOfClass:[NSFont class]]) {
+        font = [NSFont fontWithName:defaultFont.fontName size:size boldTrait:isBold italicTrait:isItalic];
+        
+        if (font == nil) {
+            font = [defaultFont fontWithBoldTrait:isBold italicTrait:isItalic andSize:size];
+        }
+    }
+    
+    if ((font == nil) && (familyName.length > 0)) {
+        font = [NSFont fontWithName:familyName size:size boldTrait:isBold italicTrait:isItalic];
+    }
+    
+    return font ?: [NSFont systemFontOfSize:size];
+}
+
+- (NSColor *)colorFromString:(NSString *)string {
+    if ([string hasPrefix:@"#"] && string.length == 7) {
+        unsigned int rgb = 0;
+        
+        if (![[NSScanner scannerWithString:[string substringFromIndex:1]] scanHexInt:&rgb]) {
+            return nil;
+        }
+        
+        return [NSColor colorWithSRGBRed:((rgb >> 16) & 0xFF) / 255.0 green:((rgb >> 8) & 0xFF) / 255.0 blue:(rgb & 0xFF) / 255.0 alpha:1.0];
+    }
+    
+    if ([string hasPrefix:@"rgb"]) {
+        NSRange openRange = [string rangeOfString:@"("];
+        NSRange closeRange = [string rangeOfString:@")"];
+        
+        if (openRange.location == NSNotFound || closeRange.location == NSNotFound || closeRange.location < openRange.location) {
+            return nil;
+        }
+        
+        NSArray<NSString *> *components = [[string substringWithRange:NSMakeRange(NSMaxRange(openRange), closeRange.location - NSMaxRange(openRange))] componentsSeparatedByString:@","];
+        
+        if (components.count < 3) {
+            return nil;
+        }
+        
+        CGFloat alpha = (components.count > 3) ? [components[3] doubleValue] : 1.0;
+        
+        return [NSColor colorWithSRGBRed:[components[0] doubleValue] / 255.0 green:[components[1] doubleValue] / 255.0 blue:[components[2] doubleValue] / 255.0 alpha:alpha];
+    }
+    
+    return nil;
+}
+
+- (NSParagraphStyle *)paragraphStyleForStyle:(NSString *)style {
+    NSParagraphStyle *paragraphStyle = [self.paragraphStyles objectForKey:style];
+    
+    if (paragraphStyle != nil) {
+        return paragraphStyle;
+    }
+    
+    NSMutableParagraphStyle *mutableParagraphStyle = [[NSMutableParagraphStyle alloc] init];
+    CGFloat textIndent = 0;
+    CGFloat marginLeft = 0;
+    
+    for (NSString *declaration in [style componentsSeparatedByString:@";"]) {
+        NSRange separatorRange = [declaration rangeOfString:@":"];
+        
+        if (separatorRange.location == NSNotFound) {
+            continue;
+        }
+        
+        NSString *property = [[declaration substringToIndex:separatorRange.location] stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceCharacterSet]];
+        NSString *value = [[declaration substringFromIndex:NSMaxRange(separatorRange)] stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceCharacterSet]];
+        
+        if ([property isEqualToString:@"text-align"]) {
+            if ([value isEqualToString:@"left"]) {
+                mutableParagraphStyle.alignment = NSTextAlignmentLeft;
+            } else if ([value isEqualToString:@"center"]) {
+                mutableParagraphStyle.alignment = NSTextAlignmentCenter;
+            } else if ([value isEqualToString:@"right"]) {
+                mutableParagraphStyle.alignment = NSTextAlignmentRight;
+            } else if ([value isEqualToString:@"justify"]) {
+                mutableParagraphStyle.alignment = NSTextAlignmentJustified;
+            }
+        } else if ([property isEqualToString:@"text-indent"]) {
+            textIndent = [value doubleValue];
+        } else if ([property isEqualToString:@"margin-left"]) {
+            marginLeft = [value doubleValue];
+        }
+    }
+    
+    mutableParagraphStyle.headIndent = MAX(marginLeft, 0);
+    mutableParagraphStyle.firstLineHeadIndent = MAX(marginLeft + textIndent, 0);
+    
+    paragraphStyle = [mutableParagraphStyle copy];
+    [self.paragraphStyles setObject:paragraphStyle forKey:style];
+    
+    return paragraphStyle;
+}
+
+#pragma mark - Building -
+
+- (void)appendCharacter:(unichar)character attributes:(NSDictionary *)attributes {
+    if (_textLength == _textCapacity) {
+        _textCapacity = MAX(_textCapacity * 2, 4096);
+        _text = realloc(_text, _textCapacity * sizeof(unichar));
+    }
+    
+    _text[_textLength] = character;
+    
+    if ((_numberOfRuns > 0) && (_runs[_numberOfRuns - 1].attributes == attributes)) {
+        _runs[_numberOfRuns - 1].length++;
+    } else {
+        if (_numberOfRuns == _runsCapacity) {
+            _runsCapacity = MAX(_runsCapacity * 2, 256);
+            _runs = realloc(_runs, _runsCapacity * sizeof(RTEHTMLRun));
+        }
+        
+        _runs[_numberOfRuns++] = (RTEHTMLRun){_textLength, 1, attributes};
+    }
+    
+    _textLength++;
+}
+
+- (void)addParagraphWithRange:(NSRange)range style:(NSString *)style {
+    NSParagraphStyle *paragraphStyle = [self paragraphStyleForStyle:style];
+    BOOL hasFormatList = (range.length >= 2) && (_text[range.location] == 0x010 || _text[range.location] == 0x011) && (_text[range.location + 1] == 0x00A0);
+    
+    if (hasFormatList && paragraphStyle.firstLineHeadIndent == 0) {
+        /// A list item without its indentation, indent it the same as -userSelectedFormatListWithType: does.
+        NSString *formatListString = (_text[range.location] == 0x010) ? [RTELayoutManager kBulletString] : [RTELayoutManager kNumberingString];
+        NSString *key = [NSString stringWithFormat:@"%@\n%@", formatListString, style];
+        NSParagraphStyle *listParagraphStyle = [self.paragraphStyles objectForKey:key];
+        
+        if (listParagraphStyle == nil) {
+            NSDictionary *attributes = [self attributesAtTextLocation:range.location];
+            NSMutableParagraphStyle *mutableParagraphStyle = [paragraphStyle mutableCopy];
+            CGSize expectedStringSize = [formatListString sizeWithAttributes:attributes];
+            
+            mutableParagraphStyle.firstLineHeadIndent = kFirstLineHeadIndent;
+            mutableParagraphStyle.headIndent = expectedStringSize.width + kFirstLineHeadIndent;
+            listParagraphStyle = [mutableParagraphStyle copy];
+            [self.paragraphStyles setObject:listParagraphStyle forKey:key];
+        }
+        
+        paragraphStyle = listParagraphStyle;
+    }
+    
+    if ((_numberOfParagraphs > 0) && (_paragraphs[_numberOfParagraphs - 1].paragraphStyle == paragraphStyle)) {
+        _paragraphs[_numberOfParagraphs - 1].length += range.length;
+        return;
+    }
+    
+    if (_numberOfParagraphs == _paragraphsCapacity) {
+        _paragraphsCapacity = MAX(_paragraphsCapacity * 2, 256);
+        _paragraphs = realloc(_paragraphs, _paragraphsCapacity * sizeof(RTEHTMLParagraph));
+    }
+    
+    _paragraphs[_numberOfParagraphs++] = (RTEHTMLParagraph){range.location, range.length, paragraphStyle};
+}
+
+- (NSDictionary *)attributesAtTextLocation:(NSUInteger)location {
+    for (NSUInteger i = _numberOfRuns; i > 0; i--) {
+        if (_runs[i - 1].location <= location) {
+            return _runs[i - 1].attributes;
+        }
+    }
+    
+    return self.plainRunAttributes;
+}
+
+- (NSAttributedString *)buildAttributedString {
+    NSString *string = [[NSString alloc] initWithCharacters:_text length:_textLength];
+    NSMutableAttributedString *attributedString = [[NSMutableAttributedString alloc] initWithString:string];
+    
+    [attributedString beginEditing];
+    
+    for (NSUInteger i = 0; i < _numberOfRuns; i++) {
+        [attributedString setAttributes:_runs[i].attributes range:NSMakeRange(_runs[i].location, _runs[i].length)];
+    }
+    
+    for (NSUInteger i = 0; i < _numberOfParagraphs; i++) {
+        [attributedString addAttribute:NSParagraphStyleAttributeName value:_paragraphs[i].paragraphStyle range:NSMakeRange(_paragraphs[i].location, _paragraphs[i].length)];
+    }
+    
+    [attributedString endEditing];
+    
+    return attributedString;
+}
+
+@end
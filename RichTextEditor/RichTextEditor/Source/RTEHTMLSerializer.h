@@ -0,0 +1,31 @@
+//
+//  RTEHTMLSerializer.h
+//  RichTextEditor
+//
+//  Created by lam1611 on 10/18/26.
+//
+
+#import <Cocoa/Cocoa.h>
+
+/// Converts an NSAttributedString to HTML in a single pass over its attribute runs.
+/// Every paragraph becomes a <p>, adjacent runs with the same formatting are merged into one <span>,
+/// and the bullet and numbering markers are written inline as character references.
+/// The output is written to a buffer owned by the serializer and reused by the next call,
+/// so one serializer must not be used by two threads at the same time.
+@interface RTEHTMLSerializer : NSObject
+
+/// A serializer owned by the calling thread. It lives as long as the thread, so a buffer grown by a long document
+/// is released after the call rather than kept.
++ (RTEHTMLSerializer *_Nonnull)threadSerializer;
+
+- (NSString *_Nonnull)HTMLStringFromAttributedString:(NSAttributedString *_Nonnull)attributedString;
+
+/// The markup before and after the paragraphs of a document.
++ (NSString *_Nonnull)documentHeader;
++ (NSString *_Nonnull)documentFooter;
+
+/// The <p> of the paragraph starting at location alone, the document is the header, the fragments of all its paragraphs in order
+/// and the footer. paragraphEnd is set to the location of the paragraph's '\n', or the length for the last paragraph.
+- (NSString *_Nonnull)HTMLFragmentOfParagraphAtLocation:(NSUInteger)location ofAttributedString:(NSAttributedString *_Nonnull)attributedString paragraphEnd:(NSUInteger *_Nullable)paragraphEnd;
+
+@end
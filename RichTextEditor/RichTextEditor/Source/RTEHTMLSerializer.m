@@ -0,0 +1,466 @@
+//
+//  RTEHTMLSerializer.m
+//  RichTextEditor
+//
+//  Created by lam1611 on 10/18/26.
+//
+
+#import "RTEHTMLSerializer.h"
+
+#import "RTEDefiniens.h"
+#import "NSFont+RichTextEditor.h"
+
+static const NSUInteger kChunkLength = 4096;
+/// A serializer lives as long as its thread, a larger buffer or more cached styles than this are let go after each call.
+static const NSUInteger kMaximumRetainedCapacity = 256 * 1024;
+static const NSUInteger kMaximumCachedStyles = 256;
+static NSString *const kThreadSerializerKey = @"RTEHTMLSerializer";
+
+@interface RTEHTMLSerializer () {
+    unichar *_buffer;
+    NSUInteger _length;
+    NSUInteger _capacity;
+    unichar _chunk[kChunkLength];
+    /// The run tag of the last attributes seen, only kept for one call as the dictionary may be freed after it.
+    NSDictionary *_lastAttributes;
+    NSString *_lastRunTag;
+}
+
+@property (nonatomic, strong) NSMutableDictionary<NSFont *, NSString *> *fontStyles;
+@property (nonatomic, strong) NSMutableDictionary<NSColor *, NSString *> *colorStyles;
+
+@end
+
+@implementation RTEHTMLSerializer
+
+#pragma mark - Initialization -
+
++ (RTEHTMLSerializer *)threadSerializer {
+    NSMutableDictionary *threadDictionary = [[NSThread currentThread] threadDictionary];
+    RTEHTMLSerializer *serializer = [threadDictionary objectForKey:kThreadSerializerKey];
+    
+    if (serializer == nil) {
+        serializer = [[RTEHTMLSerializer alloc] init];
+        [threadDictionary setObject:serializer forKey:kThreadSerializerKey];
+    }
+    
+    return serializer;
+}
+
+- (instancetype)init {
+    if (self = [super init]) {
+        _capacity = kChunkLength;
+        _buffer = malloc(_capacity * sizeof(unichar));
+        _length = 0;
+        _fontStyles = [[NSMutableDictionary alloc] init];
+        _colorStyles = [[NSMutableDictionary alloc] init];
+    }
+    
+    return self;
+}
+
+- (void)dealloc {
+    free(_buffer);
+}
+
+#pragma mark - Public Methods -
+
++ (NSString *)documentHeader {
+    static NSString *documentHeader = nil;
+    static dispatch_once_t onceToken;
+    
+    dispatch_once(&onceToken, ^{
+        documentHeader = [NSString stringWithFormat:@"<!DOCTYPE html><html><head><meta charset=\"UTF-8\"><meta name=\"generator\" content=\"%@\"><style>p{margin:0;white-space:pre-wrap}</style></head><body>", kHTMLGenerator];
+    });
+    
+    return documentHeader;
+}
+
++ (NSString *)documentFooter {
+    return @"</body></html>";
+}
+
+- (NSString *)HTMLStringFromAttributedString:(NSAttributedString *)attributedString {
+    NSUInteger length = attributedString.length;
+    NSUInteger location = 0;
+    
+    _length = 0;
+    _lastAttributes = nil;
+    _lastRunTag = nil;
+    
+    [self appendString:[RTEHTMLSerializer documentHeader]];
+    
+    while (YES) {
+        NSUInteger paragraphEnd = [self appendParagraphAtLocation:location ofAttributedString:attributedString];
+        
+        if (paragraphEnd >= length) {
+            break;
+        }
+        
+        location = paragraphEnd + 1;
+    }
+    
+    [self appendString:[RTEHTMLSerializer documentFooter]];
+    
+    NSString *htmlString = [[NSString alloc] initWithCharacters:_buffer length:_length];
+    [self trimRetainedMemory];
+    
+    return htmlString;
+}
+
+- (NSString *)HTMLFragmentOfParagraphAtLocation:(NSUInteger)location ofAttributedString:(NSAttributedString *)attributedString paragraphEnd:(NSUInteger *)paragraphEnd {
+    _length = 0;
+    _lastAttributes = nil;
+    _lastRunTag = nil;
+    
+    NSUInteger end = [self appendParagraphAtLocation:location ofAttributedString:attributedString];
+    
+    if (paragraphEnd != NULL) {
+        *paragraphEnd = end;
+    }
+    
+    NSString *fragment = [[NSString alloc] initWithCharacters:_buffer length:_length];
+    [self trimRetainedMemory];
+    
+    return fragment;
+}
+
+#pragma mark - Helper Methods -
+
+/// Writes the paragraph starting at location as a <p> and returns the location of its '\n', the length for the last one.
+- (NSUInteger)appendParagraphAtLocation:(NSUInteger)location ofAttributedString:(NSAttributedString *)attributedString {
+    NSString *string = attributedString.string;
+    NSUInteger length = string.length;
+    NSString *openedRunTag = nil;
+    BOOL paragraphIsEmpty = YES;
+    NSParagraphStyle *paragraphStyle = nil;
+    
+    /// An empty last paragraph has no characters of its own, it takes the style of the '\n' before it.
+    if (location < length) {
+        paragraphStyle = [attributedString attribute:NSParagraphStyleAttributeName atIndex:location effectiveRange:NULL];
+    } else if (location > 0) {
+        paragraphStyle = [attributedString attribute:NSParagraphStyleAttributeName atIndex:location - 1 effectiveRange:NULL];
+    }
+    
+    [self openParagraphWithStyle:paragraphStyle];
+    
+    while (location < length) {
+        NSRange runRange;
+        NSDictionary *attributes = [attributedString attributesAtIndex:location effectiveRange:&runRange];
+        NSUInteger runEnd = NSMaxRange(runRange);
+        
+        /// Text storages share the attributes dictionary between runs, so the tag is usually built once.
+        if (attributes != _lastAttributes) {
+            _lastRunTag = [self runTagForAttributes:attributes];
+            _lastAttributes = attributes;
+        }
+        
+        while (location < runEnd) {
+            NSUInteger chunkLength = MIN(kChunkLength, runEnd - location);
+            NSUInteger newline = 0;
+            
+            [string getCharacters:_chunk range:NSMakeRange(location, chunkLength)];
+            
+            while ((newline < chunkLength) && (_chunk[newline] != '\n')) {
+                newline++;
+            }
+            
+            if (newline > 0) {
+                /// Adjacent runs with the same formatting keep writing into the opened span.
+                if (![openedRunTag isEqualToString:_lastRunTag]) {
+                    [self closeRunTag:openedRunTag];
+                    [self appendString:_lastRunTag];
+                    openedRunTag = _lastRunTag;
+                }
+                
+                [self appendEscapedCharacters:_chunk length:newline];
+                paragraphIsEmpty = NO;
+            }
+            
+            if (newline < chunkLength) {
+                [self closeRunTag:openedRunTag];
+                [self closeParagraph:paragraphIsEmpty];
+                
+                return location + newline;
+            }
+            
+            location += chunkLength;
+        }
+    }
+    
+    [self closeRunTag:openedRunTag];
+    [self closeParagraph:paragraphIsEmpty];
+    
+    return length;
+}
+
+#pragma mark - Markup -
+
+- (void)openParagraphWithStyle:(NSParagraphStyle *)paragraphStyle {
+    NSString *textAlignmentString = [self htmlTextAlignmentString:paragraphStyle.alignment];
+    CGFloat textIndent = paragraphStyle.firstLineHeadIndent - paragraphStyle.headIndent;
+    CGFloat marginLeft = paragraphStyle.headIndent;
+    
+    if ((textAlignmentString == nil) && (textIndent == 0) && (marginLeft <= 0)) {
+        [self appendASCII:"<p>"];
+        return;
+    }
+    
+    NSMutableString *style = [NSMutableString string];
+    
+    if (textAlignmentString != nil) {
+        [style appendFormat:@"text-align:%@;", textAlignmentString];
+    }
+    
+    if (textIndent != 0) {
+        [style appendFormat:@"text-indent:%gpx;", textIndent];
+    }
+    
+    if (marginLeft > 0) {
+        [style appendFormat:@"margin-left:%gpx;", marginLeft];
+    }
+    
+    [self appendASCII:"<p style=\""];
+    [self appendString:style];
+    [self appendASCII:"\">"];
+}
+
+- (void)closeParagraph:(BOOL)paragraphIsEmpty {
+    /// An empty <p> has no height, keep the blank line.
+    [self appendASCII:paragraphIsEmpty ? "<br></p>" : "</p>"];
+}
+
+- (NSString *)runTagForAttributes:(NSDictionary<NSAttributedStringKey, id> *)attributes {
+    NSMutableString *runTag = [NSMutableString string];
+    id link = [attributes objectForKey:NSLinkAttributeName];
+    NSString *linkString = [link isKindOfClass:[NSURL class]] ? [(NSURL *)link absoluteString] : ([link isKindOfClass:[NSString class]] ? (NSString *)link : nil);
+    NSFont *font = [attributes objectForKey:NSFontAttributeName];
+    NSColor *foregroundColor = [attributes objectForKey:NSForegroundColorAttributeName];
+    NSColor *backgroundColor = [attributes objectForKey:NSBackgroundColorAttributeName];
+    NSNumber *underline = [attributes objectForKey:NSUnderlineStyleAttributeName];
+    NSNumber *strikethrough = [attributes objectForKey:NSStrikethroughStyleAttributeName];
+    BOOL hasUnderline = (underline != nil) && (underline.integerValue != NSUnderlineStyleNone);
+    BOOL hasStrikethrough = (strikethrough != nil) && (strikethrough.integerValue != NSUnderlineStyleNone);
+    
+    if (linkString.length > 0) {
+        [runTag appendFormat:@"<a href=\"%@\">", [self escapedString:linkString]];
+    }
+    
+    [runTag appendString:@"<span style=\""];
+    
+    if ([font isKindOfClass:[NSFont class]]) {
+        [runTag appendString:[self styleForFont:font]];
+    }
+    
+    if (hasUnderline || hasStrikethrough) {
+        [runTag appendFormat:@"text-decoration:%@;", (hasUnderline && hasStrikethrough) ? @"underline line-through" : (hasUnderline ? @"underline" : @"line-through")];
+    }
+    
+    if ([foregroundColor isKindOfClass:[NSColor class]]) {
+        NSString *color = [self styleForColor:foregroundColor];
+        
+        if (color != nil) {
+            [runTag appendFormat:@"color:%@;", color];
+        }
+    }
+    
+    if ([backgroundColor isKindOfClass:[NSColor class]]) {
+        NSString *color = [self styleForColor:backgroundColor];
+        
+        if (color != nil) {
+            [runTag appendFormat:@"background-color:%@;", color];
+        }
+    }
+    
+    [runTag appendString:@"\">"];
+    
+    return runTag;
+}
+
+- (void)closeRunTag:(NSString *)runTag {
+    if (runTag == nil) {
+        return;
+    }
+    
+    [self appendASCII:[runTag hasPrefix:@"<a "] ? "</span></a>" : "</span>"];
+}
+
+- (NSString *)styleForFont:(NSFont *)font {
+    NSString *style = [self.fontStyles objectForKey:font];
+    
+    if (style == nil) {
+        NSString *familyName = [[self escapedString:(font.familyName ?: font.fontName)] stringByReplacingOccurrencesOfString:@"'" withString:@"\\'"];
+        NSMutableString *fontStyle = [NSMutableString stringWithFormat:@"font-family:'%@';font-size:%gpx;", familyName, font.pointSize];
+        
+        if ([font isBold]) {
+            [fontStyle appendString:@"font-weight:bold;"];
+        }
+        
+        if ([font isItalic]) {
+            [fontStyle appendString:@"font-style:italic;"];
+        }
+        
+        style = fontStyle;
+        [self.fontStyles setObject:style forKey:font];
+    }
+    
+    return style;
+}
+
+- (NSString *)styleForColor:(NSColor *)color {
+    NSString *style = [self.colorStyles objectForKey:color];
+    
+    if (style == nil) {
+        NSColor *rgbColor = [color colorUsingColorSpace:[NSColorSpace sRGBColorSpace]];
+        
+        if (rgbColor == nil) {
+            return nil;
+        }
+        
+        int red = (int)round(rgbColor.redComponent * 255.0);
+        int green = (int)round(rgbColor.greenComponent * 255.0);
+        int blue = (int)round(rgbColor.blueComponent * 255.0);
+        
+        if (rgbColor.alphaComponent < 1.0) {
+            style = [NSString stringWithFormat:@"rgba(%d,%d,%d,%g)", red, green, blue, rgbColor.alphaComponent];
+        } else {
+            style = [NSString stringWithFormat:@"#%02x%02x%02x", red, green, blue];
+        }
+        
+        [self.colorStyles setObject:style forKey:color];
+    }
+    
+    return style;
+}
+
+- (NSString *)htmlTextAlignmentString:(NSTextAlignment)textAlignment {
+    switch (textAlignment) {
+        case NSTextAlignmentLeft:
+            return @"left";
+        case NSTextAlignmentCenter:
+            return @"center";
+        case NSTextAlignmentRight:
+            return @"right";
+        case NSTextAlignmentJustified:
+            return @"justify";
+        default:
+            return nil;
+    }
+}
+
+#pragma mark - Buffer -
+
+- (void)reserveCapacity:(NSUInteger)additionalLength {
+    if (_length + additionalLength > _capacity) {
+        while (_length + additionalLength > _capacity) {
+            _capacity *= 2;
+        }
+        
+        _buffer = realloc(_buffer, _capacity * sizeof(unichar));
+    }
+}
+
+- (void)trimRetainedMemory {
+    _length = 0;
+    _lastAttributes = nil;
+    _lastRunTag = nil;
+    
+    if (_capacity > kMaximumRetainedCapacity) {
+        _capacity = kChunkLength;
+        _buffer = realloc(_buffer, _capacity * sizeof(unichar));
+    }
+    
+    if (self.fontStyles.count > kMaximumCachedStyles) {
+        [self.fontStyles removeAllObjects];
+    }
+    
+    if (self.colorStyles.count > kMaximumCachedStyles) {
+        [self.colorStyles removeAllObjects];
+    }
+}
+
+- (void)appendASCII:(const char *)characters {
+    NSUInteger length = strlen(characters);
+    
+    [self reserveCapacity:length];
+    
+    for (NSUInteger i = 0; i < length; i++) {
+        _buffer[_length++] = (unichar)characters[i];
+    }
+}
+
+- (void)appendString:(NSString *)string {
+    NSUInteger length = string.length;
+    
+    [self reserveCapacity:length];
+    [string getCharacters:_buffer + _length range:NSMakeRange(0, length)];
+    _length += length;
+}
+
+/// Escapes the markup characters. Control characters, which include the bullet and numbering
+/// control codes, and non-breaking spaces are written as character references so they survive
+/// whitespace handling of HTML readers. NUL can't be a character reference, it becomes U+FFFD.
+- (void)appendEscapedCharacters:(const unichar *)characters length:(NSUInteger)length {
+    /// The longest replacement is "&nbsp;" or "&#x10;", six characters.
+    [self reserveCapacity:length * 6];
+    
+    for (NSUInteger i = 0; i < length; i++) {
+        unichar character = characters[i];
+        const char *replacement = NULL;
+        char reference[7];
+        
+        switch (character) {
+            case 0x0000:
+                character = 0xFFFD;
+                break;
+            case '&':
+                replacement = "&amp;";
+                break;
+            case '<':
+                replacement = "&lt;";
+                break;
+            case '>':
+                replacement = "&gt;";
+                break;
+            case '"':
+                replacement = "&quot;";
+                break;
+            case 0x00A0:
+                replacement = "&nbsp;";
+                break;
+            case '\t':
+                break;
+            default:
+                if (character < 0x20) {
+                    snprintf(reference, sizeof(reference), "&#x%x;", character);
+                    replacement = reference;
+                }
+                break;
+        }
+        
+        if (replacement != NULL) {
+            for (const char *c = replacement; *c != '\0'; c++) {
+                _buffer[_length++] = (unichar)*c;
+            }
+        } else {
+            _buffer[_length++] = character;
+        }
+    }
+}
+
+- (NSString *)escapedString:(NSString *)string {
+    NSUInteger length = string.length;
+    unichar *characters = malloc(MAX(length, 1) * sizeof(unichar));
+    NSUInteger savedLength = _length;
+    
+    [string getCharacters:characters range:NSMakeRange(0, length)];
+    [self appendEscapedCharacters:characters length:length];
+    free(characters);
+    
+    NSString *escapedString = [[NSString alloc] initWithCharacters:_buffer + savedLength length:_length - savedLength];
+    _length = savedLength;
+    
+    return escapedString;
+}
+
+@end
@@ -0,0 +1,28 @@
+//
+//  RTEHTMLSniffer.h
+//  RichTextEditor
+//
+//  Created by lam1611 on 10/18/26.
+//
+
+#import <Cocoa/Cocoa.h>
+
+typedef NS_ENUM(NSInteger, RTEHTMLSnifferResult) {
+    /// No tag found, the string is plain text.
+    RTEHTMLSnifferResultPlainText       = 0,
+    /// At least one tag found.
+    RTEHTMLSnifferResultMarkup          = 1,
+    /// The string starts like the HTML written by RTEHTMLSerializer, RTEHTMLParser can import it.
+    RTEHTMLSnifferResultExportedHTML    = 2
+};
+
+/// Tells whether a string contains HTML in a single forward pass without allocating.
+/// Scanning stops at the first complete tag. A failed tag candidate never rescans the characters it consumed,
+/// so the cost is linear in the length of the string whatever the input looks like.
+/// A tag is '<', an optional '/', a name, attributes with quoted, unquoted or no values, an optional '/' and '>'.
+/// Quoted values containing '<' are not accepted, the '<' starts the next candidate instead.
+@interface RTEHTMLSniffer : NSObject
+
++ (RTEHTMLSnifferResult)sniffString:(NSString *_Nonnull)string;
+
+@end
@@ -0,0 +1,202 @@
+//
+//  RTEHTMLSniffer.m
+//  RichTextEditor
+//
+//  Created by lam1611 on 10/18/26.
+//
+
+#import "RTEHTMLSniffer.h"
+
+#import "RTEDefiniens.h"
+
+/// The generator meta tag is written right after the charset, it is searched in the beginning of the document only.
+static const CFIndex kGeneratorSearchLength = 512;
+static const char *kGeneratorTagPrefix = "<meta name=\"generator\" content=\"";
+static const char *kGeneratorTagSuffix = "\">";
+
+static inline BOOL RTEIsWhitespace(UniChar character) {
+    return character == ' ' || character == '\t' || character == '\n' || character == '\r' || character == '\f';
+}
+
+static inline BOOL RTEIsNameCharacter(UniChar character) {
+    return (character >= 'a' && character <= 'z') || (character >= 'A' && character <= 'Z') || (character >= '0' && character <= '9') || character == '_' || character == '-' || character == ':';
+}
+
+@implementation RTEHTMLSniffer
+
+#pragma mark - Public Methods -
+
++ (RTEHTMLSnifferResult)sniffString:(NSString *)string {
+    CFStringRef cfString = (__bridge CFStringRef)string;
+    CFIndex length = CFStringGetLength(cfString);
+    CFStringInlineBuffer buffer;
+    CFIndex position = 0;
+    
+    CFStringInitInlineBuffer(cfString, &buffer, CFRangeMake(0, length));
+    
+    while (position < length) {
+        if (CFStringGetCharacterFromInlineBuffer(&buffer, position) != '<') {
+            position++;
+            continue;
+        }
+        
+        CFIndex end = [self endOfTagAtLocation:position inBuffer:&buffer length:length];
+        
+        if (end > 0) {
+            return [self hasGeneratorTagInBuffer:&buffer length:length] ? RTEHTMLSnifferResultExportedHTML : RTEHTMLSnifferResultMarkup;
+        }
+        
+        /// The candidate failed at the returned position at the latest, and only a '<' can make it fail early.
+        position = MAX(-end - 1, position + 1);
+    }
+    
+    return RTEHTMLSnifferResultPlainText;
+}
+
+#pragma mark - Helper Methods -
+
+/// Position after the '>' of the tag starting at location, or -(failure position) - 1 if there is no tag.
+/// The failure position is where the scan stopped, nothing before it can start another tag.
++ (CFIndex)endOfTagAtLocation:(CFIndex)location inBuffer:(CFStringInlineBuffer *)buffer length:(CFIndex)length {
+    CFIndex position = location + 1;
+
+#define RTE_CHARACTER_AT(index) (((index) < length) ? CFStringGetCharacterFromInlineBuffer(buffer, (index)) : 0)
+#define RTE_FAIL_AT(index) return -(MIN((index), length)) - 1
+    
+    if (RTE_CHARACTER_AT(position) == '/') {
+        position++;
+    }
+    
+    if (!RTEIsNameCharacter(RTE_CHARACTER_AT(position))) {
+        RTE_FAIL_AT(position);
+    }
+    
+    while (RTEIsNameCharacter(RTE_CHARACTER_AT(position))) {
+        position++;
+    }
+    
+    while (position < length) {
+        UniChar character = RTE_CHARACTER_AT(position);
+        
+        if (character == '>') {
+            return position + 1;
+        }
+        
+        if (character == '/' && RTE_CHARACTER_AT(position + 1) == '>') {
+            return position + 2;
+        }
+        
+        if (!RTEIsWhitespace(character)) {
+            RTE_FAIL_AT(position);
+        }
+        
+        while (RTEIsWhitespace(RTE_CHARACTER_AT(position))) {
+            position++;
+        }
+        
+        if (!RTEIsNameCharacter(RTE_CHARACTER_AT(position))) {
+            /// Trailing whitespace before '>' or '/>'.
+            continue;
+        }
+        
+        while (RTEIsNameCharacter(RTE_CHARACTER_AT(position))) {
+            position++;
+        }
+        
+        CFIndex valuePosition = position;
+        
+        while (RTEIsWhitespace(RTE_CHARACTER_AT(valuePosition))) {
+            valuePosition++;
+        }
+        
+        if (RTE_CHARACTER_AT(valuePosition) != '=') {
+            /// An attribute without a value.
+            continue;
+        }
+        
+        position = valuePosition + 1;
+        
+        while (RTEIsWhitespace(RTE_CHARACTER_AT(position))) {
+            position++;
+        }
+        
+        UniChar quote = RTE_CHARACTER_AT(position);
+        
+        if (quote == '"' || quote == '\'') {
+            position++;
+            
+            while (position < length && RTE_CHARACTER_AT(position) != quote) {
+                if (RTE_CHARACTER_AT(position) == '<') {
+                    RTE_FAIL_AT(position);
+                }
+                
+                position++;
+            }
+            
+            if (position >= length) {
+                RTE_FAIL_AT(position);
+            }
+            
+            position++;
+        } else {
+            while (position < length) {
+                character = RTE_CHARACTER_AT(position);
+                
+                if (RTEIsWhitespace(character) || character == '>' || character == '"' || character == '\'' || character == '=' || character == '<' || character == '`') {
+                    break;
+                }
+                
+                position++;
+            }
+            
+            if (RTE_CHARACTER_AT(position) == '<') {
+                RTE_FAIL_AT(position);
+            }
+        }
+    }
+    
+    RTE_FAIL_AT(position);
+
+#undef RTE_FAIL_AT
+#undef RTE_CHARACTER_AT
+}
+
+/// YES if the generator meta tag written by RTEHTMLSerializer is found in the beginning of the buffer.
++ (BOOL)hasGeneratorTagInBuffer:(CFStringInlineBuffer *)buffer length:(CFIndex)length {
+    NSString *generator = (NSString *)kHTMLGenerator;
+    CFIndex prefixLength = (CFIndex)strlen(kGeneratorTagPrefix);
+    CFIndex suffixLength = (CFIndex)strlen(kGeneratorTagSuffix);
+    CFIndex generatorLength = (CFIndex)generator.length;
+    CFIndex tagLength = prefixLength + generatorLength + suffixLength;
+    CFIndex searchLength = MIN(length, kGeneratorSearchLength);
+    
+    for (CFIndex location = 0; location + tagLength <= searchLength; location++) {
+        CFIndex i = 0;
+        
+        while (i < tagLength) {
+            UniChar expected;
+            
+            if (i < prefixLength) {
+                expected = (UniChar)kGeneratorTagPrefix[i];
+            } else if (i < prefixLength + generatorLength) {
+                expected = [generator characterAtIndex:(NSUInteger)(i - prefixLength)];
+            } else {
+                expected = (UniChar)kGeneratorTagSuffix[i - prefixLength - generatorLength];
+            }
+            
+            if (CFStringGetCharacterFromInlineBuffer(buffer, location + i) != expected) {
+                break;
+            }
+            
+            i++;
+        }
+        
+        if (i == tagLength) {
+            return YES;
+        }
+    }
+    
+    return NO;
+}
+
+@end
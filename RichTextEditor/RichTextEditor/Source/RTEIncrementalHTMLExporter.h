@@ -0,0 +1,43 @@
+//
+//  RTEIncrementalHTMLExporter.h
+//  RichTextEditor
+//
+//  Created by lam1611 on 10/18/26.
+//
+
+#import <Cocoa/Cocoa.h>
+
+/// Exports a document to HTML again and again, serializing only the paragraphs edited since the last export.
+///
+/// The HTML of each paragraph is cached as a UTF-8 fragment. Edit deltas mark the paragraphs they touch as dirty,
+/// an export serializes the dirty ones and puts the document together from the fragments, the same HTML as
+/// +[RichTextEditor htmlStringFromAttributedText:]. Writing to a file hands the fragments to writev(2) as they are.
+@interface RTEIncrementalHTMLExporter : NSObject
+
+/// Length of the indexed string.
+@property (nonatomic, readonly) NSUInteger length;
+@property (nonatomic, readonly) NSUInteger numberOfParagraphs;
+/// Paragraphs to be serialized by the next export.
+@property (nonatomic, readonly) NSUInteger numberOfDirtyParagraphs;
+
+/// Starts with every paragraph of string dirty.
+- (instancetype _Nonnull)initWithString:(NSString *_Nonnull)string;
+
+/// Applies an edit delta: the characters or attributes in range of the indexed string were replaced, giving string.
+- (void)replaceCharactersInRange:(NSRange)range resultingString:(NSString *_Nonnull)string;
+
+/// The HTML of attributedString, the indexed string.
+- (NSString *_Nonnull)HTMLStringFromAttributedString:(NSAttributedString *_Nonnull)attributedString;
+/// Writes the UTF-8 HTML of attributedString, the indexed string, to a temporary file and moves it over url.
+- (BOOL)writeHTMLFromAttributedString:(NSAttributedString *_Nonnull)attributedString toURL:(NSURL *_Nonnull)url error:(NSError *_Nullable *_Nullable)error;
+
+@end
+
+@interface NSTextStorage (RTEIncrementalHTMLExporter)
+
+/// Starts tracking the paragraphs the receiver's edits make dirty, all of them are dirty until the first export.
+- (void)attachIncrementalHTMLExporter;
+/// The HTML exporter of the receiver, nil if none attached or while the receiver is being edited.
+- (RTEIncrementalHTMLExporter *_Nullable)RTEIncrementalHTMLExporter;
+
+@end
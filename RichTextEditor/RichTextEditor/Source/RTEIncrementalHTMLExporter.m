@@ -0,0 +1,368 @@
+//
+//  RTEIncrementalHTMLExporter.m
+//  RichTextEditor
+//
+//  Created by lam1611 on 10/18/26.
+//
+
+#import "RTEIncrementalHTMLExporter.h"
+
+#import <fcntl.h>
+#import <objc/runtime.h>
+#import <sys/uio.h>
+
+#import "RTEHTMLSerializer.h"
+#import "RTETrace.h"
+
+static const void *kIncrementalHTMLExporterKey = &kIncrementalHTMLExporterKey;
+
+/// The UTF-8 document header and footer, kept for the life of the process so writev can point into them.
+static NSData *RTEHTMLDocumentHeaderData(void) {
+    static NSData *documentHeaderData = nil;
+    static dispatch_once_t onceToken;
+    
+    dispatch_once(&onceToken, ^{
+        documentHeaderData = [[RTEHTMLSerializer documentHeader] dataUsingEncoding:NSUTF8StringEncoding];
+    });
+    
+    return documentHeaderData;
+}
+
+static NSData *RTEHTMLDocumentFooterData(void) {
+    static NSData *documentFooterData = nil;
+    static dispatch_once_t onceToken;
+    
+    dispatch_once(&onceToken, ^{
+        documentFooterData = [[RTEHTMLSerializer documentFooter] dataUsingEncoding:NSUTF8StringEncoding];
+    });
+    
+    return documentFooterData;
+}
+
+/// Writes every byte of count buffers, going on after short writes and interrupts.
+static BOOL RTEWriteVectors(int fileDescriptor, struct iovec *vectors, NSUInteger count) {
+    while (count > 0) {
+        ssize_t written = writev(fileDescriptor, vectors, (int)MIN(count, (NSUInteger)IOV_MAX));
+        
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            
+            return NO;
+        }
+        
+        while ((count > 0) && ((size_t)written >= vectors->iov_len)) {
+            written -= vectors->iov_len;
+            vectors++;
+            count--;
+        }
+        
+        if (count > 0) {
+            vectors->iov_base = (uint8_t *)vectors->iov_base + written;
+            vectors->iov_len -= written;
+        }
+    }
+    
+    return YES;
+}
+
+@interface RTEIncrementalHTMLExporter () {
+    NSUInteger *_paragraphStarts;
+    /// Whether each paragraph has a character other than whitespace, valid for the clean paragraphs.
+    BOOL *_paragraphHasText;
+    NSUInteger _numberOfParagraphs;
+    NSUInteger _capacity;
+    NSUInteger _length;
+    NSUInteger _numberOfDirtyParagraphs;
+}
+
+/// The UTF-8 HTML of each paragraph, NSNull for the dirty ones.
+@property (nonatomic, strong) NSMutableArray *fragments;
+@property (nonatomic, unsafe_unretained) NSTextStorage *textStorage;
+
+@end
+
+@implementation RTEIncrementalHTMLExporter
+
+#pragma mark - Initialization -
+
+- (instancetype)initWithString:(NSString *)string {
+    if (self = [super init]) {
+        _capacity = 16;
+        _paragraphStarts = malloc(_capacity * sizeof(NSUInteger));
+        _paragraphHasText = malloc(_capacity * sizeof(BOOL));
+        _paragraphStarts[0] = 0;
+        _paragraphHasText[0] = NO;
+        _numberOfParagraphs = 1;
+        _numberOfDirtyParagraphs = 1;
+        _length = 0;
+        _fragments = [[NSMutableArray alloc] initWithObjects:[NSNull null], nil];
+        
+        [self replaceCharactersInRange:NSMakeRange(0, 0) resultingString:string];
+    }
+    
+    return self;
+}
+
+- (void)dealloc {
+    if (self.textStorage != nil) {
+        [[NSNotificationCenter defaultCenter] removeObserver:self name:NSTextStorageDidProcessEditingNotification object:self.textStorage];
+    }
+    
+    free(_paragraphStarts);
+    free(_paragraphHasText);
+}
+
+#pragma mark - Public Methods -
+
+- (NSUInteger)length {
+    return _length;
+}
+
+- (NSUInteger)numberOfParagraphs {
+    return _numberOfParagraphs;
+}
+
+- (NSUInteger)numberOfDirtyParagraphs {
+    return _numberOfDirtyParagraphs;
+}
+
+- (void)replaceCharactersInRange:(NSRange)range resultingString:(NSString *)string {
+    NSInteger changeInLength = (NSInteger)string.length - (NSInteger)_length;
+    NSUInteger first = [self upperBoundOfLocation:range.location] - 1;
+    NSUInteger last = [self upperBoundOfLocation:NSMaxRange(range)] - 1;
+    NSUInteger regionStart = _paragraphStarts[first];
+    BOOL regionIsLast = (last + 1 == _numberOfParagraphs);
+    NSUInteger regionEnd = regionIsLast ? string.length : _paragraphStarts[last + 1] + changeInLength;
+    NSMutableArray<NSNumber *> *starts = [[NSMutableArray alloc] initWithObjects:@(regionStart), nil];
+    NSUInteger location = regionStart;
+    
+    /// The paragraphs from first to last are replaced by the ones now between their start and the next untouched paragraph.
+    while (location < regionEnd) {
+        NSRange newlineRange = [string rangeOfString:@"\n" options:NSLiteralSearch range:NSMakeRange(location, regionEnd - location)];
+        
+        if ((newlineRange.location == NSNotFound) || ((newlineRange.location + 1 == regionEnd) && !regionIsLast)) {
+            break;
+        }
+        
+        location = newlineRange.location + 1;
+        [starts addObject:@(location)];
+    }
+    
+    NSUInteger removedCount = last - first + 1;
+    NSUInteger insertedCount = starts.count;
+    
+    for (NSUInteger i = first; i <= last; i++) {
+        _numberOfDirtyParagraphs -= (self.fragments[i] == [NSNull null]) ? 1 : 0;
+    }
+    
+    if (_numberOfParagraphs - removedCount + insertedCount > _capacity) {
+        while (_numberOfParagraphs - removedCount + insertedCount > _capacity) {
+            _capacity *= 2;
+        }
+        
+        _paragraphStarts = realloc(_paragraphStarts, _capacity * sizeof(NSUInteger));
+        _paragraphHasText = realloc(_paragraphHasText, _capacity * sizeof(BOOL));
+    }
+    
+    NSUInteger tailCount = _numberOfParagraphs - last - 1;
+    
+    memmove(_paragraphStarts + first + insertedCount, _paragraphStarts + last + 1, tailCount * sizeof(NSUInteger));
+    memmove(_paragraphHasText + first + insertedCount, _paragraphHasText + last + 1, tailCount * sizeof(BOOL));
+    
+    for (NSUInteger i = 0; i < insertedCount; i++) {
+        _paragraphStarts[first + i] = starts[i].unsignedIntegerValue;
+        _paragraphHasText[first + i] = NO;
+    }
+    
+    for (NSUInteger i = first + insertedCount; i < first + insertedCount + tailCount; i++) {
+        _paragraphStarts[i] += changeInLength;
+    }
+    
+    NSMutableArray *dirtyFragments = [[NSMutableArray alloc] initWithCapacity:insertedCount];
+    
+    for (NSUInteger i = 0; i < insertedCount; i++) {
+        [dirtyFragments addObject:[NSNull null]];
+    }
+    
+    [self.fragments replaceObjectsInRange:NSMakeRange(first, removedCount) withObjectsFromArray:dirtyFragments];
+    _numberOfParagraphs = _numberOfParagraphs - removedCount + insertedCount;
+    _numberOfDirtyParagraphs += insertedCount;
+    _length = string.length;
+}
+
+- (NSString *)HTMLStringFromAttributedString:(NSAttributedString *)attributedString {
+    if (![self serializeDirtyParagraphsOfAttributedString:attributedString]) {
+        return @"";
+    }
+    
+    NSMutableData *data = [[NSMutableData alloc] init];
+    
+    [self enumerateDocumentDataOfAttributedString:attributedString usingBlock:^(NSData *fragment) {
+        [data appendData:fragment];
+    }];
+    
+    return [[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding];
+}
+
+- (BOOL)writeHTMLFromAttributedString:(NSAttributedString *)attributedString toURL:(NSURL *)url error:(NSError **)error {
+    RTE_TRACE_SCOPE_WITH_ARGUMENT("write incremental html", attributedString.length);
+    BOOL hasText = [self serializeDirtyParagraphsOfAttributedString:attributedString];
+    NSString *temporaryPath = [url.path stringByAppendingString:@".rte-tmp"];
+    int fileDescriptor = open(temporaryPath.fileSystemRepresentation, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    
+    if (fileDescriptor < 0) {
+        if (error != NULL) {
+            *error = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:@{NSFilePathErrorKey: temporaryPath}];
+        }
+        
+        return NO;
+    }
+    
+    /// The fragments stay retained by the cache while writev reads them, nothing is copied into one buffer.
+    struct iovec *vectors = malloc((_numberOfParagraphs + 3) * sizeof(struct iovec));
+    __block NSUInteger count = 0;
+    
+    if (hasText) {
+        [self enumerateDocumentDataOfAttributedString:attributedString usingBlock:^(NSData *fragment) {
+            vectors[count++] = (struct iovec){(void *)fragment.bytes, fragment.length};
+        }];
+    }
+    
+    BOOL success = RTEWriteVectors(fileDescriptor, vectors, count) && (fsync(fileDescriptor) == 0);
+    int writeError = errno;
+    
+    free(vectors);
+    close(fileDescriptor);
+    
+    if (success && (rename(temporaryPath.fileSystemRepresentation, url.path.fileSystemRepresentation) != 0)) {
+        success = NO;
+        writeError = errno;
+    }
+    
+    if (!success) {
+        unlink(temporaryPath.fileSystemRepresentation);
+        NSLog(@"%s [Line %d] Failed writing %@: %s", __PRETTY_FUNCTION__, __LINE__, url.path, strerror(writeError));
+        
+        if (error != NULL) {
+            *error = [NSError errorWithDomain:NSPOSIXErrorDomain code:writeError userInfo:@{NSFilePathErrorKey: url.path}];
+        }
+    }
+    
+    return success;
+}
+
+#pragma mark - Helper Methods -
+
+/// Index of the first paragraph starting after location.
+- (NSUInteger)upperBoundOfLocation:(NSUInteger)location {
+    NSUInteger lower = 0;
+    NSUInteger upper = _numberOfParagraphs;
+    
+    while (lower < upper) {
+        NSUInteger middle = lower + (upper - lower) / 2;
+        
+        if (_paragraphStarts[middle] <= location) {
+            lower = middle + 1;
+        } else {
+            upper = middle;
+        }
+    }
+    
+    return lower;
+}
+
+/// Serializes the dirty paragraphs and returns whether the document has text other than whitespace,
+/// a document without any is exported as an empty string.
+- (BOOL)serializeDirtyParagraphsOfAttributedString:(NSAttributedString *)attributedString {
+    RTE_TRACE_SCOPE_WITH_ARGUMENT("serialize dirty paragraphs", _numberOfDirtyParagraphs);
+    NSString *string = attributedString.string;
+    NSCharacterSet *textCharacterSet = [[NSCharacterSet whitespaceAndNewlineCharacterSet] invertedSet];
+    RTEHTMLSerializer *serializer = [RTEHTMLSerializer threadSerializer];
+    BOOL hasText = NO;
+    
+    for (NSUInteger i = 0; i < _numberOfParagraphs; i++) {
+        if (self.fragments[i] == [NSNull null]) {
+            NSUInteger paragraphEnd = 0;
+            NSString *fragment = [serializer HTMLFragmentOfParagraphAtLocation:_paragraphStarts[i] ofAttributedString:attributedString paragraphEnd:&paragraphEnd];
+            NSRange paragraphRange = NSMakeRange(_paragraphStarts[i], paragraphEnd - _paragraphStarts[i]);
+            
+            self.fragments[i] = [fragment dataUsingEncoding:NSUTF8StringEncoding allowLossyConversion:YES];
+            _paragraphHasText[i] = ([string rangeOfCharacterFromSet:textCharacterSet options:NSLiteralSearch range:paragraphRange].location != NSNotFound);
+        }
+        
+        hasText = hasText || _paragraphHasText[i];
+    }
+    
+    _numberOfDirtyParagraphs = 0;
+    
+    return hasText;
+}
+
+/// Calls block with the header, the fragment of every paragraph and the footer, in order. Every one of them outlives the call.
+- (void)enumerateDocumentDataOfAttributedString:(NSAttributedString *)attributedString usingBlock:(void (^)(NSData *fragment))block {
+    block(RTEHTMLDocumentHeaderData());
+    
+    for (NSUInteger i = 0; i < _numberOfParagraphs; i++) {
+        NSData *fragment = self.fragments[i];
+        
+        /// An empty last paragraph takes the style of the '\n' before it, which is edited as part of the paragraph before.
+        if ((i + 1 == _numberOfParagraphs) && (i > 0) && (_paragraphStarts[i] == _length)) {
+            fragment = [[[RTEHTMLSerializer threadSerializer] HTMLFragmentOfParagraphAtLocation:_length ofAttributedString:attributedString paragraphEnd:NULL] dataUsingEncoding:NSUTF8StringEncoding allowLossyConversion:YES];
+            self.fragments[i] = fragment;
+        }
+        
+        block(fragment);
+    }
+    
+    block(RTEHTMLDocumentFooterData());
+}
+
+- (void)textStorageDidProcessEditing:(NSNotification *)notification {
+    NSTextStorage *textStorage = notification.object;
+    
+    if ([textStorage editedMask] == 0) {
+        return;
+    }
+    
+    /// The edited range covers the new characters, the replaced ones were changeInLength shorter or longer.
+    NSRange editedRange = [textStorage editedRange];
+    NSRange replacedRange = NSMakeRange(editedRange.location, editedRange.length - [textStorage changeInLength]);
+    
+    [self replaceCharactersInRange:replacedRange resultingString:textStorage.string];
+    
+    if (_length != textStorage.length) {
+        /// Should never happen, but serializing everything again is cheaper than saving a wrong document.
+        [self replaceCharactersInRange:NSMakeRange(0, _length) resultingString:textStorage.string];
+    }
+}
+
+@end
+
+@implementation NSTextStorage (RTEIncrementalHTMLExporter)
+
+- (void)attachIncrementalHTMLExporter {
+    if (objc_getAssociatedObject(self, kIncrementalHTMLExporterKey) != nil) {
+        return;
+    }
+    
+    RTEIncrementalHTMLExporter *exporter = [[RTEIncrementalHTMLExporter alloc] initWithString:self.string];
+    exporter.textStorage = self;
+    
+    [[NSNotificationCenter defaultCenter] addObserver:exporter selector:@selector(textStorageDidProcessEditing:) name:NSTextStorageDidProcessEditingNotification object:self];
+    objc_setAssociatedObject(self, kIncrementalHTMLExporterKey, exporter, OBJC_ASSOCIATION_RETAIN_NONATOMIC);
+}
+
+- (RTEIncrementalHTMLExporter *)RTEIncrementalHTMLExporter {
+    RTEIncrementalHTMLExporter *exporter = objc_getAssociatedObject(self, kIncrementalHTMLExporterKey);
+    
+    /// While the receiver is being edited, the dirty paragraphs are not known yet.
+    if ((exporter == nil) || ([self editedMask] != 0) || (exporter.length != self.length)) {
+        return nil;
+    }
+    
+    return exporter;
+}
+
+@end
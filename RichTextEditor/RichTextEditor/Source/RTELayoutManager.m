@@ -9,94 +9,307 @@
 #import "RTELayoutManager.h"
 
 #import "RTEDefiniens.h"
-#import "NSAttributedString+RichTextEditor.h"
+#import "RTEFormatListCache.h"
+#import "RTETrace.h"
+
+/// The appearance of a marker, shared by every list item with the same marker text and font.
+@interface RTEFormatListMarker : NSObject
+
+@property (nonatomic, strong) NSAttributedString *attributedString;
+@property (nonatomic, assign) NSSize size;
+/// The firstLineHeadIndent the paragraph needs so its text starts after the marker.
+@property (nonatomic, assign) CGFloat firstLineHeadIndent;
+
+@end
+
+@implementation RTEFormatListMarker
+
+@end
+
+@interface RTELayoutManager ()
+
+@property (nonatomic, strong) RTEFormatListCache *formatListCache;
+@property (nonatomic, strong) NSMutableDictionary<NSString *, RTEFormatListMarker *> *formatListMarkers;
+@property (nonatomic, strong) NSParagraphStyle *formatListMarkerParagraphStyle;
+/// firstLineHeadIndent values found while drawing, applied to the text storage once the drawing is done.
+@property (nonatomic, strong) NSMutableDictionary<NSNumber *, NSNumber *> *pendingFirstLineHeadIndents;
+@property (nonatomic, strong) NSMutableDictionary<NSString *, NSNumber *> *formatListStringWidths;
+
+@end
 
 @implementation RTELayoutManager
 
 #pragma mark -
 
+- (void)setTextStorage:(NSTextStorage *)textStorage {
+    [super setTextStorage:textStorage];
+    
+    self.formatListCache = nil;
+}
+
+- (void)setBulletNumberingColor:(NSColor *)bulletNumberingColor {
+    _bulletNumberingColor = bulletNumberingColor;
+    
+    [self invalidateFormatListMarkers];
+}
+
+- (void)setBulletNumberingIndent:(CGFloat)bulletNumberingIndent {
+    _bulletNumberingIndent = bulletNumberingIndent;
+    
+    [self invalidateFormatListMarkers];
+}
+
+- (void)setFirstLineHeadIndent:(CGFloat)firstLineHeadIndent {
+    _firstLineHeadIndent = firstLineHeadIndent;
+    
+    /// The list levels are measured in steps of firstLineHeadIndent.
+    self.formatListCache = nil;
+    [self invalidateFormatListMarkers];
+}
+
+- (void)processEditingForTextStorage:(NSTextStorage *)textStorage edited:(NSTextStorageEditActions)editMask range:(NSRange)newCharRange changeInLength:(NSInteger)delta invalidatedRange:(NSRange)invalidatedCharRange {
+    RTE_TRACE_SCOPE("update format list layout");
+    NSRange changedParagraphs = NSMakeRange(NSNotFound, 0);
+    
+    if (((editMask & NSTextStorageEditedCharacters) != 0) && (self.formatListCache != nil)) {
+        /// The edited range covers the new characters, the replaced ones were changeInLength shorter or longer.
+        NSRange replacedRange = NSMakeRange(newCharRange.location, newCharRange.length - delta);
+        
+        changedParagraphs = [self.formatListCache replaceCharactersInRange:replacedRange withString:[textStorage.string substringWithRange:newCharRange] resultingString:textStorage.string];
+    }
+    
+    if (((editMask & NSTextStorageEditedAttributes) != 0) && (self.formatListCache != nil)) {
+        /// Indenting a list item changes its level.
+        NSRange changedLevels = [self.formatListCache updateLevelsOfParagraphsInRange:newCharRange];
+        
+        if (changedLevels.location != NSNotFound) {
+            changedParagraphs = (changedParagraphs.location != NSNotFound) ? NSUnionRange(changedParagraphs, changedLevels) : changedLevels;
+        }
+    }
+    
+    [super processEditingForTextStorage:textStorage edited:editMask range:newCharRange changeInLength:delta invalidatedRange:invalidatedCharRange];
+    
+    if (changedParagraphs.location != NSNotFound) {
+        /// Numbers below the edit may change without their lines being laid out again.
+        NSRange firstRange = [self.formatListCache rangeOfParagraphAtIndex:changedParagraphs.location];
+        NSRange lastRange = [self.formatListCache rangeOfParagraphAtIndex:NSMaxRange(changedParagraphs) - 1];
+        
+        [self invalidateDisplayForCharacterRange:NSMakeRange(firstRange.location, NSMaxRange(lastRange) - firstRange.location)];
+    }
+}
+
 - (void)drawGlyphsForGlyphRange:(NSRange)glyphsToShow atPoint:(NSPoint)origin {
-    [self updateFormatListLayout];
+    [self drawFormatListMarkersForGlyphRange:glyphsToShow atPoint:origin];
     [super drawGlyphsForGlyphRange:glyphsToShow atPoint:origin];
 }
 
 #pragma mark -
 
-- (void)updateFormatListLayout {
+- (void)drawFormatListMarkersForGlyphRange:(NSRange)glyphsToShow atPoint:(NSPoint)origin {
+    RTE_TRACE_SCOPE_WITH_ARGUMENT("drawFormatListMarkers", glyphsToShow.length);
     NSTextStorage *textStorage = [self textStorage];
     NSTextContainer *textContainer = [[self textContainers] firstObject];
-    CGFloat lineFragmentPadding = [textContainer lineFragmentPadding];
-    NSColor *bulletNumberingColor = self.bulletNumberingColor;
-    CGFloat bulletNumberingIndent = self.bulletNumberingIndent;
-    CGFloat firstLineHeadIndent = self.firstLineHeadIndent;
-    
-    if ((textStorage != nil) && (textContainer != nil)) {
-        NSString *bulletString = [[self class] kBulletString];
-        NSString *numberingString = [[self class] kNumberingString];
-        __block NSInteger numbering = 0;
-        __block NSInteger rangeOffset = 0;
-        
-        [textStorage enumarateParagraphsInRange:NSMakeRange(0, textStorage.length) withBlock:^(NSRange paragraphRange) {
-            NSString *substring = [textStorage.string substringWithRange:paragraphRange];
-            BOOL paragraphHasBullet = [substring hasPrefix:bulletString];
-            BOOL paragraphHasNumbering = [substring hasPrefix:numberingString];
-            
-            if (paragraphHasNumbering) {
-                numbering += 1;
-            } else if (!paragraphHasBullet && !paragraphHasNumbering) {
-                numbering = 0;
-            }
-            
-            if (paragraphHasBullet || paragraphHasNumbering) {
-                NSString *formatListString = paragraphHasBullet ? bulletString : numberingString;
-                
-                rangeOffset = rangeOffset + formatListString.length;
-                
-                NSDictionary *dictionary = [textStorage attributesAtIndex:MAX(paragraphRange.location + ((paragraphRange.length > formatListString.length) ? rangeOffset : 0), 0)];
-                
-                if ([dictionary objectForKey:NSFontAttributeName] == nil) {
-                    dictionary = [textStorage attributesAtIndex:MAX(paragraphRange.location, 0)];
-                }
-                
-                NSRect paragraphRect = [self boundingRectForGlyphRange:paragraphRange inTextContainer:textContainer];
-                NSRect usedRect = (paragraphRect.origin.x < firstLineHeadIndent + lineFragmentPadding) ? NSMakeRect(firstLineHeadIndent + lineFragmentPadding, paragraphRect.origin.y, paragraphRect.size.width, paragraphRect.size.height) : paragraphRect;
-                
-                NSFont *font = [dictionary objectForKey:NSFontAttributeName];
-                NSFont *bulletFont = [NSFont fontWithName:font.familyName size:font.pointSize];
-                NSMutableParagraphStyle *paragraphStyle = [[NSMutableParagraphStyle alloc] init];
-                [paragraphStyle setAlignment:NSTextAlignmentLeft];
-                NSDictionary *attributes = @{NSFontAttributeName: (bulletFont != nil) ? bulletFont : font,
-                                             NSForegroundColorAttributeName: bulletNumberingColor,
-                                             NSParagraphStyleAttributeName: paragraphStyle};
-                NSMutableAttributedString *formatListAttributedString = [[NSMutableAttributedString alloc] initWithString:(paragraphHasBullet ? @"•" : [NSString stringWithFormat:@"%ld", numbering]) attributes:attributes];
-                
-                NSRect boundingRect = [formatListAttributedString boundingRectWithSize:NSMakeSize(FLT_MAX, FLT_MAX) options:(NSStringDrawingUsesLineFragmentOrigin | NSStringDrawingUsesFontLeading) context:nil];
-                CGFloat singleLineHeight = NSHeight([self boundingRectForGlyphRange:NSMakeRange(paragraphRange.location, formatListAttributedString.length) inTextContainer:textContainer]);
-                NSPoint origin = NSMakePoint(bulletNumberingIndent, NSMinY(usedRect) + (NSHeight(usedRect) - NSHeight(boundingRect)) - (NSHeight(paragraphRect) - singleLineHeight));
-                NSRect drawRect = NSMakeRect(origin.x, origin.y, NSWidth(boundingRect), NSHeight(boundingRect));
-                
-                [formatListAttributedString drawWithRect:drawRect options:(NSStringDrawingUsesLineFragmentOrigin | NSStringDrawingUsesFontLeading) context:nil];
-                
-                /// Update the paragraphStyle's firstLineHeadIndent in case of drawing rect of bullets or numberings
-                /// exceeds the firstLineHeadIndent value
-                {
-                    CGSize expectedStringSize = [formatListString sizeWithAttributes:dictionary];
-                    CGFloat lineHeadIndent = (NSMaxX(drawRect) > firstLineHeadIndent) ? (NSMaxX(drawRect) + expectedStringSize.width) : firstLineHeadIndent;
-                    NSMutableParagraphStyle *paragraphStyle = [[dictionary objectForKey:NSParagraphStyleAttributeName] mutableCopy];
-                    
-                    if (!paragraphStyle) {
-                        paragraphStyle = [[NSMutableParagraphStyle alloc] init];
-                    }
-                    
-                    if (lineHeadIndent != paragraphStyle.firstLineHeadIndent) {
-                        paragraphStyle.firstLineHeadIndent = lineHeadIndent;
-                        
-                        [textStorage addAttribute:NSParagraphStyleAttributeName value:paragraphStyle range:paragraphRange];
-                    }
-                }
-            }
+    
+    if ((textStorage == nil) || (textContainer == nil) || (textStorage.length == 0)) {
+        return;
+    }
+    
+    if ((self.formatListCache == nil) || (self.formatListCache.length != textStorage.length)) {
+        __weak RTELayoutManager *weakSelf = self;
+        
+        self.formatListCache = [[RTEFormatListCache alloc] initWithString:textStorage.string levelProvider:^NSUInteger(NSRange paragraphRange) {
+            return [weakSelf formatListLevelOfParagraphWithRange:paragraphRange];
         }];
     }
+    
+    RTEFormatListCache *formatListCache = self.formatListCache;
+    NSRange characterRange = [self characterRangeForGlyphRange:glyphsToShow actualGlyphRange:NULL];
+    NSUInteger firstParagraph = [formatListCache paragraphIndexAtLocation:characterRange.location];
+    NSUInteger lastParagraph = [formatListCache paragraphIndexAtLocation:NSMaxRange(characterRange)];
+    NSUInteger formatListLength = [[self class] kBulletString].length;
+    
+    for (NSUInteger paragraphIndex = firstParagraph; paragraphIndex <= lastParagraph; paragraphIndex++) {
+        RTEFormatListType type = [formatListCache typeOfParagraphAtIndex:paragraphIndex];
+        
+        if (type == RTEFormatListTypeNone) {
+            continue;
+        }
+        
+        /// The marker sits on the first line, which isn't drawn unless the paragraph starts in the range.
+        NSRange paragraphRange = [formatListCache rangeOfParagraphAtIndex:paragraphIndex];
+        
+        if (!NSLocationInRange(paragraphRange.location, characterRange)) {
+            continue;
+        }
+        
+        NSDictionary *dictionary = [textStorage attributesAtIndex:paragraphRange.location + ((paragraphRange.length > formatListLength) ? formatListLength : 0) effectiveRange:NULL];
+        
+        if ([dictionary objectForKey:NSFontAttributeName] == nil) {
+            dictionary = [textStorage attributesAtIndex:paragraphRange.location effectiveRange:NULL];
+        }
+        
+        NSString *markerText = (type == RTEFormatListTypeBullet) ? @"•" : [NSString stringWithFormat:@"%ld", (long)[formatListCache numberOfParagraphAtIndex:paragraphIndex]];
+        RTEFormatListMarker *marker = [self formatListMarkerWithText:markerText type:type font:[dictionary objectForKey:NSFontAttributeName]];
+        CGFloat levelIndent = [formatListCache levelOfParagraphAtIndex:paragraphIndex] * self.firstLineHeadIndent;
+        
+        /// Align the bottom of the marker with the bottom of the first line.
+        NSRange markerGlyphRange = [self glyphRangeForCharacterRange:NSMakeRange(paragraphRange.location, formatListLength) actualCharacterRange:NULL];
+        NSRect markerLineRect = [self boundingRectForGlyphRange:markerGlyphRange inTextContainer:textContainer];
+        NSRect drawRect = NSMakeRect(origin.x + self.bulletNumberingIndent + levelIndent, origin.y + NSMaxY(markerLineRect) - marker.size.height, marker.size.width, marker.size.height);
+        
+        [marker.attributedString drawWithRect:drawRect options:(NSStringDrawingUsesLineFragmentOrigin | NSStringDrawingUsesFontLeading) context:nil];
+        
+        NSParagraphStyle *paragraphStyle = [dictionary objectForKey:NSParagraphStyleAttributeName];
+        CGFloat firstLineHeadIndent = (paragraphStyle != nil) ? paragraphStyle.firstLineHeadIndent : 0;
+        
+        if (marker.firstLineHeadIndent + levelIndent != firstLineHeadIndent) {
+            [self setPendingFirstLineHeadIndent:marker.firstLineHeadIndent + levelIndent forParagraphAtLocation:paragraphRange.location];
+        }
+    }
+}
+
+/// Every indentation step of -[RichTextEditor userSelectedParagraphIndentation:] nests the list item one level deeper.
+/// The level is taken from the headIndent, which is (level + 1) * firstLineHeadIndent plus the width of the list string.
+/// The firstLineHeadIndent can't be used, drawing widens it to fit the marker.
+- (NSUInteger)formatListLevelOfParagraphWithRange:(NSRange)paragraphRange {
+    NSTextStorage *textStorage = [self textStorage];
+    NSUInteger formatListLength = [[self class] kBulletString].length;
+    
+    if ((self.firstLineHeadIndent <= 0) || (paragraphRange.location >= textStorage.length) || (paragraphRange.length < formatListLength)) {
+        return 0;
+    }
+    
+    NSDictionary *dictionary = [textStorage attributesAtIndex:paragraphRange.location effectiveRange:NULL];
+    NSParagraphStyle *paragraphStyle = [dictionary objectForKey:NSParagraphStyleAttributeName];
+    NSString *formatListString = [textStorage.string substringWithRange:NSMakeRange(paragraphRange.location, formatListLength)];
+    CGFloat formatListWidth = [self widthOfFormatListString:formatListString font:[dictionary objectForKey:NSFontAttributeName]];
+    NSInteger level = lround((paragraphStyle.headIndent - formatListWidth) / self.firstLineHeadIndent) - 1;
+    
+    return (NSUInteger)MAX(level, 0);
+}
+
+- (CGFloat)widthOfFormatListString:(NSString *)formatListString font:(NSFont *)font {
+    NSString *key = [NSString stringWithFormat:@"%@\n%@\n%g", formatListString, font.fontName, font.pointSize];
+    NSNumber *width = [self.formatListStringWidths objectForKey:key];
+    
+    if (width == nil) {
+        if (self.formatListStringWidths == nil) {
+            self.formatListStringWidths = [[NSMutableDictionary alloc] init];
+        }
+        
+        width = [NSNumber numberWithDouble:((font != nil) ? [formatListString sizeWithAttributes:@{NSFontAttributeName: font}] : [formatListString sizeWithAttributes:@{}]).width];
+        [self.formatListStringWidths setObject:width forKey:key];
+    }
+    
+    return width.doubleValue;
+}
+
+- (RTEFormatListMarker *)formatListMarkerWithText:(NSString *)text type:(RTEFormatListType)type font:(NSFont *)font {
+    NSString *key = [NSString stringWithFormat:@"%@\n%@\n%g", text, font.fontName, font.pointSize];
+    RTEFormatListMarker *marker = [self.formatListMarkers objectForKey:key];
+    
+    if (marker != nil) {
+        return marker;
+    }
+    
+    if (self.formatListMarkers == nil) {
+        self.formatListMarkers = [[NSMutableDictionary alloc] init];
+    }
+    
+    if (self.formatListMarkerParagraphStyle == nil) {
+        NSMutableParagraphStyle *paragraphStyle = [[NSMutableParagraphStyle alloc] init];
+        [paragraphStyle setAlignment:NSTextAlignmentLeft];
+        self.formatListMarkerParagraphStyle = paragraphStyle;
+    }
+    
+    NSFont *bulletFont = [NSFont fontWithName:font.familyName size:font.pointSize];
+    NSMutableDictionary *attributes = [[NSMutableDictionary alloc] init];
+    
+    if ((bulletFont != nil) || (font != nil)) {
+        [attributes setObject:((bulletFont != nil) ? bulletFont : font) forKey:NSFontAttributeName];
+    }
+    
+    if (self.bulletNumberingColor != nil) {
+        [attributes setObject:self.bulletNumberingColor forKey:NSForegroundColorAttributeName];
+    }
+    
+    [attributes setObject:self.formatListMarkerParagraphStyle forKey:NSParagraphStyleAttributeName];
+    
+    marker = [[RTEFormatListMarker alloc] init];
+    marker.attributedString = [[NSAttributedString alloc] initWithString:text attributes:attributes];
+    marker.size = [marker.attributedString boundingRectWithSize:NSMakeSize(FLT_MAX, FLT_MAX) options:(NSStringDrawingUsesLineFragmentOrigin | NSStringDrawingUsesFontLeading) context:nil].size;
+    
+    /// Update the paragraphStyle's firstLineHeadIndent in case of drawing rect of bullets or numberings
+    /// exceeds the firstLineHeadIndent value
+    {
+        NSString *formatListString = (type == RTEFormatListTypeBullet) ? [[self class] kBulletString] : [[self class] kNumberingString];
+        CGSize expectedStringSize = (font != nil) ? [formatListString sizeWithAttributes:@{NSFontAttributeName: font}] : [formatListString sizeWithAttributes:@{}];
+        CGFloat markerMaxX = self.bulletNumberingIndent + marker.size.width;
+        
+        marker.firstLineHeadIndent = (markerMaxX > self.firstLineHeadIndent) ? (markerMaxX + expectedStringSize.width) : self.firstLineHeadIndent;
+    }
+    
+    [self.formatListMarkers setObject:marker forKey:key];
+    
+    return marker;
+}
+
+- (void)invalidateFormatListMarkers {
+    [self.formatListMarkers removeAllObjects];
+    
+    if (self.textStorage.length > 0) {
+        [self invalidateDisplayForCharacterRange:NSMakeRange(0, self.textStorage.length)];
+    }
+}
+
+/// The text storage must not be edited while drawing, the indents are applied on the next turn of the run loop.
+- (void)setPendingFirstLineHeadIndent:(CGFloat)firstLineHeadIndent forParagraphAtLocation:(NSUInteger)location {
+    if (self.pendingFirstLineHeadIndents == nil) {
+        self.pendingFirstLineHeadIndents = [[NSMutableDictionary alloc] init];
+    }
+    
+    if (self.pendingFirstLineHeadIndents.count == 0) {
+        [self performSelector:@selector(applyPendingFirstLineHeadIndents) withObject:nil afterDelay:0];
+    }
+    
+    [self.pendingFirstLineHeadIndents setObject:[NSNumber numberWithDouble:firstLineHeadIndent] forKey:[NSNumber numberWithUnsignedInteger:location]];
+}
+
+- (void)applyPendingFirstLineHeadIndents {
+    NSTextStorage *textStorage = [self textStorage];
+    NSDictionary<NSNumber *, NSNumber *> *pendingFirstLineHeadIndents = [self.pendingFirstLineHeadIndents copy];
+    
+    [self.pendingFirstLineHeadIndents removeAllObjects];
+    
+    if ((textStorage == nil) || (self.formatListCache == nil) || (self.formatListCache.length != textStorage.length)) {
+        return;
+    }
+    
+    [textStorage beginEditing];
+    
+    [pendingFirstLineHeadIndents enumerateKeysAndObjectsUsingBlock:^(NSNumber *location, NSNumber *firstLineHeadIndent, BOOL *stop) {
+        NSUInteger paragraphIndex = [self.formatListCache paragraphIndexAtLocation:location.unsignedIntegerValue];
+        NSRange paragraphRange = [self.formatListCache rangeOfParagraphAtIndex:paragraphIndex];
+        
+        /// Skip paragraphs edited since they were drawn.
+        if ((paragraphRange.location != location.unsignedIntegerValue) || ([self.formatListCache typeOfParagraphAtIndex:paragraphIndex] == RTEFormatListTypeNone)) {
+            return;
+        }
+        
+        NSMutableParagraphStyle *paragraphStyle = [[textStorage attribute:NSParagraphStyleAttributeName atIndex:paragraphRange.location effectiveRange:NULL] mutableCopy];
+        
+        if (!paragraphStyle) {
+            paragraphStyle = [[NSMutableParagraphStyle alloc] init];
+        }
+        
+        if (paragraphStyle.firstLineHeadIndent != firstLineHeadIndent.doubleValue) {
+            paragraphStyle.firstLineHeadIndent = firstLineHeadIndent.doubleValue;
+            
+            [textStorage addAttribute:NSParagraphStyleAttributeName value:paragraphStyle range:paragraphRange];
+        }
+    }];
+    
+    [textStorage endEditing];
 }
 
 #pragma mark -
@@ -0,0 +1,54 @@
+//
+//  RTELinkValidator.h
+//  RichTextEditor
+//
+//  Created by lam1611 on 10/18/26.
+//
+
+#import <Cocoa/Cocoa.h>
+
+/// Checks that links answer a HEAD request with a 2xx status, sharing the work between callers.
+///
+/// A URL is requested at most once at a time however many callers ask for it, and its result is cached for
+/// cacheLifetime seconds, keeping the cacheCapacity most recently used. Requests wait in a queue while maximumConcurrentRequests are running, or
+/// maximumConcurrentRequestsPerHost to the same host, so a document with hundreds of links to a few hosts
+/// doesn't flood them. URLs that aren't a single well-formed link with a host are invalid without a request.
+@interface RTELinkValidator : NSObject
+
+/// The settings can be changed from any thread, a change applies to the validations asked for after it.
+/// Defaults to 8.
+@property (nonatomic, assign) NSUInteger maximumConcurrentRequests;
+/// Defaults to 2.
+@property (nonatomic, assign) NSUInteger maximumConcurrentRequestsPerHost;
+/// Seconds a result is reused for. Defaults to 300.
+@property (nonatomic, assign) NSTimeInterval cacheLifetime;
+/// Seconds before a request counts as failed. Defaults to 10.
+@property (nonatomic, assign) NSTimeInterval timeoutInterval;
+/// Results kept before the least recently used are dropped, URLs waiting for their request aside. Defaults to 4096.
+@property (nonatomic, assign) NSUInteger cacheCapacity;
+
+/// Shared by the editors of the app so they share one cache.
++ (RTELinkValidator *_Nonnull)sharedValidator;
+
+/// The requests go through a session of its own made with configuration.
+- (instancetype _Nonnull)initWithSessionConfiguration:(NSURLSessionConfiguration *_Nonnull)configuration;
+
+/// YES if string is a single link with a host, the same check NSDataDetector makes when the link is typed.
++ (BOOL)isWellFormedURLString:(NSString *_Nonnull)string;
+
+/// The distinct links of attributedString in the order they first appear, read as -hyperlinkFromTextRange: reads them.
++ (NSArray<NSURL *> *_Nonnull)linksInAttributedString:(NSAttributedString *_Nonnull)attributedString;
+
+/// Calls completion on the main queue, right away if the result of url is cached.
+- (void)validateURL:(NSURL *_Nonnull)url completion:(void (^_Nonnull)(BOOL isValid))completion;
+
+/// Validates every URL and calls completion once on the main queue with the result of each.
+- (void)validateURLs:(NSArray<NSURL *> *_Nonnull)urls completion:(void (^_Nonnull)(NSDictionary<NSURL *, NSNumber *> *_Nonnull results))completion;
+/// Validates the links of attributedString, see linksInAttributedString:.
+- (void)validateLinksInAttributedString:(NSAttributedString *_Nonnull)attributedString completion:(void (^_Nonnull)(NSDictionary<NSURL *, NSNumber *> *_Nonnull results))completion;
+
+/// The cached result of url, nil if there is none or it expired.
+- (NSNumber *_Nullable)cachedValidityOfURL:(NSURL *_Nonnull)url;
+- (void)removeAllCachedResults;
+
+@end
@@ -0,0 +1,404 @@
+//
+//  RTELinkValidator.m
+//  RichTextEditor
+//
+//  Created by lam1611 on 10/18/26.
+//
+
+#import "RTELinkValidator.h"
+
+#import "RTETrace.h"
+#import "NSAttributedString+RichTextEditor.h"
+
+static const NSUInteger kLinkValidatorDefaultCacheCapacity = 4096;
+
+/// The validation of one URL, from the moment it is asked for until its cached result expires.
+@interface RTELinkValidation : NSObject
+
+@property (nonatomic, strong) NSURL *url;
+@property (nonatomic, copy) NSString *host;
+/// Waiting for the result, nil once it is known.
+@property (nonatomic, strong) NSMutableArray<void (^)(BOOL isValid)> *handlers;
+@property (nonatomic, assign) BOOL isValid;
+@property (nonatomic, assign) NSTimeInterval expirationTime;
+
+@end
+
+@implementation RTELinkValidation
+
+@end
+
+@interface RTELinkValidator () {
+    /// Backing the public settings, owned by the state queue like the properties below.
+    NSUInteger _maximumConcurrentRequests;
+    NSUInteger _maximumConcurrentRequestsPerHost;
+    NSTimeInterval _cacheLifetime;
+    NSTimeInterval _timeoutInterval;
+    NSUInteger _cacheCapacity;
+}
+
+@property (nonatomic, strong) NSURLSession *session;
+/// Owns every property below.
+@property (nonatomic, strong) dispatch_queue_t stateQueue;
+/// Keyed by the absolute string of the URL.
+@property (nonatomic, strong) NSMutableDictionary<NSString *, RTELinkValidation *> *validations;
+/// The keys of validations, least recently used first.
+@property (nonatomic, strong) NSMutableOrderedSet<NSString *> *validationKeysByUse;
+@property (nonatomic, strong) NSMutableArray<RTELinkValidation *> *queuedValidations;
+@property (nonatomic, strong) NSCountedSet<NSString *> *runningRequestsPerHost;
+@property (nonatomic, assign) NSUInteger numberOfRunningRequests;
+
+@end
+
+@implementation RTELinkValidator
+
+#pragma mark - Initialization -
+
++ (RTELinkValidator *)sharedValidator {
+    static RTELinkValidator *_sharedInstance = nil;
+    static dispatch_once_t onceToken;
+    
+    dispatch_once(&onceToken, ^{
+        _sharedInstance = [[RTELinkValidator alloc] init];
+    });
+    
+    return _sharedInstance;
+}
+
+- (instancetype)init {
+    return [self initWithSessionConfiguration:[NSURLSessionConfiguration ephemeralSessionConfiguration]];
+}
+
+- (instancetype)initWithSessionConfiguration:(NSURLSessionConfiguration *)configuration {
+    if (self = [super init]) {
+        _maximumConcurrentRequests = 8;
+        _maximumConcurrentRequestsPerHost = 2;
+        _cacheLifetime = 300;
+        _timeoutInterval = 10;
+        _cacheCapacity = kLinkValidatorDefaultCacheCapacity;
+        _session = [NSURLSession sessionWithConfiguration:configuration];
+        _stateQueue = dispatch_queue_create("RTELinkValidator.state", DISPATCH_QUEUE_SERIAL);
+        _validations = [[NSMutableDictionary alloc] init];
+        _validationKeysByUse = [[NSMutableOrderedSet alloc] init];
+        _queuedValidations = [[NSMutableArray alloc] init];
+        _runningRequestsPerHost = [[NSCountedSet alloc] init];
+    }
+    
+    return self;
+}
+
+- (void)dealloc {
+    [_session invalidateAndCancel];
+}
+
+#pragma mark - Public Methods -
+
+/// The settings are read and written on the state queue, where the code below reads their instance variables directly.
+- (NSUInteger)maximumConcurrentRequests {
+    __block NSUInteger maximumConcurrentRequests = 0;
+    
+    dispatch_sync(self.stateQueue, ^{
+        maximumConcurrentRequests = self->_maximumConcurrentRequests;
+    });
+    
+    return maximumConcurrentRequests;
+}
+
+- (void)setMaximumConcurrentRequests:(NSUInteger)maximumConcurrentRequests {
+    dispatch_async(self.stateQueue, ^{
+        self->_maximumConcurrentRequests = maximumConcurrentRequests;
+        [self startQueuedRequests];
+    });
+}
+
+- (NSUInteger)maximumConcurrentRequestsPerHost {
+    __block NSUInteger maximumConcurrentRequestsPerHost = 0;
+    
+    dispatch_sync(self.stateQueue, ^{
+        maximumConcurrentRequestsPerHost = self->_maximumConcurrentRequestsPerHost;
+    });
+    
+    return maximumConcurrentRequestsPerHost;
+}
+
+- (void)setMaximumConcurrentRequestsPerHost:(NSUInteger)maximumConcurrentRequestsPerHost {
+    dispatch_async(self.stateQueue, ^{
+        self->_maximumConcurrentRequestsPerHost = maximumConcurrentRequestsPerHost;
+        [self startQueuedRequests];
+    });
+}
+
+- (NSTimeInterval)cacheLifetime {
+    __block NSTimeInterval cacheLifetime = 0;
+    
+    dispatch_sync(self.stateQueue, ^{
+        cacheLifetime = self->_cacheLifetime;
+    });
+    
+    return cacheLifetime;
+}
+
+- (void)setCacheLifetime:(NSTimeInterval)cacheLifetime {
+    dispatch_async(self.stateQueue, ^{
+        self->_cacheLifetime = cacheLifetime;
+    });
+}
+
+- (NSTimeInterval)timeoutInterval {
+    __block NSTimeInterval timeoutInterval = 0;
+    
+    dispatch_sync(self.stateQueue, ^{
+        timeoutInterval = self->_timeoutInterval;
+    });
+    
+    return timeoutInterval;
+}
+
+- (void)setTimeoutInterval:(NSTimeInterval)timeoutInterval {
+    dispatch_async(self.stateQueue, ^{
+        self->_timeoutInterval = timeoutInterval;
+    });
+}
+
+- (NSUInteger)cacheCapacity {
+    __block NSUInteger cacheCapacity = 0;
+    
+    dispatch_sync(self.stateQueue, ^{
+        cacheCapacity = self->_cacheCapacity;
+    });
+    
+    return cacheCapacity;
+}
+
+- (void)setCacheCapacity:(NSUInteger)cacheCapacity {
+    dispatch_async(self.stateQueue, ^{
+        self->_cacheCapacity = cacheCapacity;
+        [self evictValidationsOverCapacity];
+    });
+}
+
++ (BOOL)isWellFormedURLString:(NSString *)string {
+    static NSDataDetector *detector = nil;
+    static dispatch_once_t onceToken;
+    
+    /// Building a detector is expensive, one is shared by every thread.
+    dispatch_once(&onceToken, ^{
+        NSError *error = nil;
+        detector = [NSDataDetector dataDetectorWithTypes:NSTextCheckingTypeLink error:&error];
+        
+        if (detector == nil) {
+            NSLog(@"%s [Line %d] failed with error: %@", __PRETTY_FUNCTION__, __LINE__, error);
+        }
+    });
+    
+    if ((detector == nil) || (string.length == 0)) {
+        return NO;
+    }
+    
+    NSRange match = [detector rangeOfFirstMatchInString:string options:kNilOptions range:NSMakeRange(0, string.length)];
+    
+    return (match.location == 0) && (match.length == string.length) && ([NSURL URLWithString:string].host.length > 0);
+}
+
++ (NSArray<NSURL *> *)linksInAttributedString:(NSAttributedString *)attributedString {
+    NSMutableArray<NSURL *> *links = [[NSMutableArray alloc] init];
+    NSMutableSet<NSString *> *seenLinks = [[NSMutableSet alloc] init];
+    
+    [attributedString enumerateAttribute:NSLinkAttributeName inRange:NSMakeRange(0, attributedString.length) options:kNilOptions usingBlock:^(id value, NSRange range, BOOL *stop) {
+        NSURL *url = (value != nil) ? [attributedString hyperlinkFromTextRange:range] : nil;
+        
+        if ((url != nil) && ![seenLinks containsObject:url.absoluteString]) {
+            [seenLinks addObject:url.absoluteString];
+            [links addObject:url];
+        }
+    }];
+    
+    return links;
+}
+
+- (void)validateURL:(NSURL *)url completion:(void (^)(BOOL))completion {
+    dispatch_async(self.stateQueue, ^{
+        [self lookUpURL:url handler:^(BOOL isValid) {
+            dispatch_async(dispatch_get_main_queue(), ^{
+                completion(isValid);
+            });
+        }];
+    });
+}
+
+- (void)validateURLs:(NSArray<NSURL *> *)urls completion:(void (^)(NSDictionary<NSURL *, NSNumber *> *))completion {
+    NSArray<NSURL *> *batch = [urls copy];
+    
+    dispatch_async(self.stateQueue, ^{
+        RTE_TRACE_SCOPE_WITH_ARGUMENT("validate links", batch.count);
+        NSMutableDictionary<NSURL *, NSNumber *> *results = [[NSMutableDictionary alloc] initWithCapacity:batch.count];
+        __block NSUInteger remaining = batch.count + 1;
+        void (^finishOne)(void) = ^{
+            if (--remaining == 0) {
+                dispatch_async(dispatch_get_main_queue(), ^{
+                    completion(results);
+                });
+            }
+        };
+        
+        for (NSURL *url in batch) {
+            [self lookUpURL:url handler:^(BOOL isValid) {
+                [results setObject:[NSNumber numberWithBool:isValid] forKey:url];
+                finishOne();
+            }];
+        }
+        
+        /// Cached results are handled before the loop ends, the batch must not complete in the middle of it.
+        finishOne();
+    });
+}
+
+- (void)validateLinksInAttributedString:(NSAttributedString *)attributedString completion:(void (^)(NSDictionary<NSURL *, NSNumber *> *))completion {
+    [self validateURLs:[[self class] linksInAttributedString:attributedString] completion:completion];
+}
+
+- (NSNumber *)cachedValidityOfURL:(NSURL *)url {
+    __block NSNumber *validity = nil;
+    
+    dispatch_sync(self.stateQueue, ^{
+        RTELinkValidation *validation = [self.validations objectForKey:url.absoluteString];
+        
+        if ((validation != nil) && (validation.handlers == nil) && (validation.expirationTime > [NSDate timeIntervalSinceReferenceDate])) {
+            validity = [NSNumber numberWithBool:validation.isValid];
+        }
+    });
+    
+    return validity;
+}
+
+- (void)removeAllCachedResults {
+    dispatch_async(self.stateQueue, ^{
+        /// Validations still waiting for their request stay, their handlers are called when it finishes.
+        for (NSString *key in [self.validations allKeys]) {
+            if ([self.validations objectForKey:key].handlers == nil) {
+                [self removeValidationForKey:key];
+            }
+        }
+    });
+}
+
+#pragma mark - Helper Methods -
+
+/// Runs on the state queue, so does handler. Joins the validation of url if one is cached or waiting for its request.
+- (void)lookUpURL:(NSURL *)url handler:(void (^)(BOOL isValid))handler {
+    NSString *key = url.absoluteString ?: @"";
+    RTELinkValidation *validation = [self.validations objectForKey:key];
+    
+    if ((validation != nil) && (validation.handlers == nil) && (validation.expirationTime <= [NSDate timeIntervalSinceReferenceDate])) {
+        [self removeValidationForKey:key];
+        validation = nil;
+    }
+    
+    if (validation != nil) {
+        [self.validationKeysByUse removeObject:key];
+        [self.validationKeysByUse addObject:key];
+        
+        if (validation.handlers != nil) {
+            [validation.handlers addObject:handler];
+        } else {
+            handler(validation.isValid);
+        }
+        
+        return;
+    }
+    
+    if (![[self class] isWellFormedURLString:key]) {
+        handler(NO);
+        return;
+    }
+    
+    validation = [[RTELinkValidation alloc] init];
+    validation.url = url;
+    validation.host = [url.host lowercaseString];
+    validation.handlers = [[NSMutableArray alloc] initWithObjects:handler, nil];
+    
+    [self.validations setObject:validation forKey:key];
+    [self.validationKeysByUse addObject:key];
+    [self evictValidationsOverCapacity];
+    [self.queuedValidations addObject:validation];
+    [self startQueuedRequests];
+}
+
+/// Starts the queued requests in order as long as the limits allow, skipping those whose host is busy.
+- (void)startQueuedRequests {
+    NSUInteger maximumConcurrentRequests = MAX(_maximumConcurrentRequests, 1);
+    NSUInteger maximumConcurrentRequestsPerHost = MAX(_maximumConcurrentRequestsPerHost, 1);
+    NSUInteger index = 0;
+    
+    while ((index < self.queuedValidations.count) && (self.numberOfRunningRequests < maximumConcurrentRequests)) {
+        RTELinkValidation *validation = [self.queuedValidations objectAtIndex:index];
+        
+        if ([self.runningRequestsPerHost countForObject:validation.host] >= maximumConcurrentRequestsPerHost) {
+            index++;
+            continue;
+        }
+        
+        [self.queuedValidations removeObjectAtIndex:index];
+        [self startRequestForValidation:validation];
+    }
+}
+
+- (void)startRequestForValidation:(RTELinkValidation *)validation {
+    NSMutableURLRequest *request = [NSMutableURLRequest requestWithURL:validation.url cachePolicy:NSURLRequestReloadIgnoringLocalCacheData timeoutInterval:_timeoutInterval];
+    [request setHTTPMethod:@"HEAD"];
+    
+    self.numberOfRunningRequests++;
+    [self.runningRequestsPerHost addObject:validation.host];
+    
+    NSURLSessionDataTask *task = [self.session dataTaskWithRequest:request completionHandler:^(NSData *data, NSURLResponse *response, NSError *error) {
+        NSInteger statusCode = [response isKindOfClass:[NSHTTPURLResponse class]] ? ((NSHTTPURLResponse *)response).statusCode : 0;
+        BOOL isValid = (error == nil) && (statusCode >= 200) && (statusCode < 300);
+        
+        dispatch_async(self.stateQueue, ^{
+            [self finishValidation:validation isValid:isValid];
+        });
+    }];
+    
+    [task resume];
+}
+
+- (void)finishValidation:(RTELinkValidation *)validation isValid:(BOOL)isValid {
+    NSArray<void (^)(BOOL isValid)> *handlers = validation.handlers;
+    
+    self.numberOfRunningRequests--;
+    [self.runningRequestsPerHost removeObject:validation.host];
+    
+    validation.isValid = isValid;
+    validation.expirationTime = [NSDate timeIntervalSinceReferenceDate] + _cacheLifetime;
+    validation.handlers = nil;
+    
+    for (void (^handler)(BOOL isValid) in handlers) {
+        handler(isValid);
+    }
+    
+    [self startQueuedRequests];
+}
+
+- (void)removeValidationForKey:(NSString *)key {
+    [self.validations removeObjectForKey:key];
+    [self.validationKeysByUse removeObject:key];
+}
+
+/// Drops the least recently used results until at most cacheCapacity validations are left.
+/// Validations still waiting for their request are skipped, their callers are joined to them.
+- (void)evictValidationsOverCapacity {
+    NSUInteger index = 0;
+    
+    while ((self.validations.count > _cacheCapacity) && (index < self.validationKeysByUse.count)) {
+        NSString *key = [self.validationKeysByUse objectAtIndex:index];
+        
+        if ([self.validations objectForKey:key].handlers != nil) {
+            index++;
+            continue;
+        }
+        
+        [self removeValidationForKey:key];
+    }
+}
+
+@end
@@ -0,0 +1,44 @@
+//
+//  RTEParagraphIndex.h
+//  RichTextEditor
+//
+//  Created by lam1611 on 10/18/26.
+//
+
+#import <Cocoa/Cocoa.h>
+
+/// A sorted table of paragraph starts of a string.
+/// Paragraphs are separated by '\n' only, the same as -[NSAttributedString firstParagraphRangeFromTextRange:].
+/// Looking up a paragraph costs O(log n), enumerating k paragraphs costs O(log n + k).
+/// The table is kept up to date from the edit deltas, so the string is never scanned again after building.
+@interface RTEParagraphIndex : NSObject
+
+/// Length of the indexed string.
+@property (nonatomic, readonly) NSUInteger length;
+/// Number of paragraphs, an empty string has one empty paragraph.
+@property (nonatomic, readonly) NSUInteger numberOfParagraphs;
+
+- (instancetype _Nonnull)initWithString:(NSString *_Nonnull)string;
+
+/// Applies an edit delta: the characters in range of the indexed string were replaced with string.
+- (void)replaceCharactersInRange:(NSRange)range withString:(NSString *_Nonnull)string;
+
+/// Index of the paragraph containing location. A location at a '\n' belongs to the paragraph it terminates.
+- (NSUInteger)paragraphIndexAtLocation:(NSUInteger)location;
+/// Range of the paragraph at paragraphIndex, excluding its terminating '\n'.
+- (NSRange)rangeOfParagraphAtIndex:(NSUInteger)paragraphIndex;
+/// Same result as -[NSAttributedString firstParagraphRangeFromTextRange:] for the indexed string.
+- (NSRange)paragraphRangeAtLocation:(NSUInteger)location;
+/// Enumerates the paragraphs intersecting range, the same ones as -[NSAttributedString rangeOfParagraphsFromTextRange:].
+- (void)enumerateParagraphsInRange:(NSRange)range usingBlock:(void (^_Nonnull)(NSRange paragraphRange, BOOL *_Nonnull stop))block;
+
+@end
+
+@interface NSTextStorage (RTEParagraphIndex)
+
+/// Builds a paragraph index for the receiver and keeps it in sync with every character edit.
+- (void)attachParagraphIndex;
+/// The paragraph index of the receiver, nil if none attached or while characters are being edited.
+- (RTEParagraphIndex *_Nullable)RTEParagraphIndex;
+
+@end
@@ -0,0 +1,232 @@
+//
+//  RTEParagraphIndex.m
+//  RichTextEditor
+//
+//  Created by lam1611 on 10/18/26.
+//
+
+#import "RTEParagraphIndex.h"
+
+#import <objc/runtime.h>
+
+static const NSUInteger kScanBufferLength = 4096;
+static const void *kParagraphIndexKey = &kParagraphIndexKey;
+
+@interface RTEParagraphIndex () {
+    NSUInteger *_paragraphStarts;
+    NSUInteger _numberOfParagraphs;
+    NSUInteger _capacity;
+    NSUInteger _length;
+}
+
+@property (nonatomic, unsafe_unretained) NSTextStorage *textStorage;
+
+@end
+
+@implementation RTEParagraphIndex
+
+#pragma mark - Initialization -
+
+- (instancetype)initWithString:(NSString *)string {
+    if (self = [super init]) {
+        _capacity = 16;
+        _paragraphStarts = malloc(_capacity * sizeof(NSUInteger));
+        _paragraphStarts[0] = 0;
+        _numberOfParagraphs = 1;
+        _length = 0;
+        
+        [self replaceCharactersInRange:NSMakeRange(0, 0) withString:string];
+    }
+    
+    return self;
+}
+
+- (void)dealloc {
+    if (self.textStorage != nil) {
+        [[NSNotificationCenter defaultCenter] removeObserver:self name:NSTextStorageDidProcessEditingNotification object:self.textStorage];
+    }
+    
+    free(_paragraphStarts);
+}
+
+#pragma mark - Public Methods -
+
+- (NSUInteger)length {
+    return _length;
+}
+
+- (NSUInteger)numberOfParagraphs {
+    return _numberOfParagraphs;
+}
+
+- (void)replaceCharactersInRange:(NSRange)range withString:(NSString *)string {
+    if (range.location > _length) {
+        range.location = _length;
+    }
+    
+    if (NSMaxRange(range) > _length) {
+        range.length = _length - range.location;
+    }
+    
+    /// Paragraph starts created by the newlines of the replaced characters lie in (location, maxRange].
+    NSUInteger lower = [self upperBoundOfLocation:range.location];
+    NSUInteger upper = [self upperBoundOfLocation:NSMaxRange(range)];
+    NSUInteger replacingLength = string.length;
+    NSInteger delta = (NSInteger)replacingLength - (NSInteger)range.length;
+    
+    NSUInteger insertedCapacity = 16;
+    NSUInteger insertedCount = 0;
+    NSUInteger *insertedStarts = malloc(insertedCapacity * sizeof(NSUInteger));
+    unichar buffer[kScanBufferLength];
+    
+    for (NSUInteger location = 0; location < replacingLength; location += kScanBufferLength) {
+        NSUInteger chunkLength = MIN(kScanBufferLength, replacingLength - location);
+        [string getCharacters:buffer range:NSMakeRange(location, chunkLength)];
+        
+        for (NSUInteger i = 0; i < chunkLength; i++) {
+            if (buffer[i] == '\n') {
+                if (insertedCount == insertedCapacity) {
+                    insertedCapacity *= 2;
+                    insertedStarts = realloc(insertedStarts, insertedCapacity * sizeof(NSUInteger));
+                }
+                
+                insertedStarts[insertedCount++] = range.location + location + i + 1;
+            }
+        }
+    }
+    
+    NSUInteger tailCount = _numberOfParagraphs - upper;
+    NSUInteger numberOfParagraphs = lower + insertedCount + tailCount;
+    
+    if (numberOfParagraphs > _capacity) {
+        while (numberOfParagraphs > _capacity) {
+            _capacity *= 2;
+        }
+        
+        _paragraphStarts = realloc(_paragraphStarts, _capacity * sizeof(NSUInteger));
+    }
+    
+    memmove(_paragraphStarts + lower + insertedCount, _paragraphStarts + upper, tailCount * sizeof(NSUInteger));
+    memcpy(_paragraphStarts + lower, insertedStarts, insertedCount * sizeof(NSUInteger));
+    free(insertedStarts);
+    
+    if (delta != 0) {
+        NSUInteger *tail = _paragraphStarts + lower + insertedCount;
+        
+        for (NSUInteger i = 0; i < tailCount; i++) {
+            tail[i] = (NSUInteger)((NSInteger)tail[i] + delta);
+        }
+    }
+    
+    _numberOfParagraphs = numberOfParagraphs;
+    _length = (NSUInteger)((NSInteger)_length + delta);
+}
+
+- (NSUInteger)paragraphIndexAtLocation:(NSUInteger)location {
+    return [self upperBoundOfLocation:MIN(location, _length)] - 1;
+}
+
+- (NSRange)rangeOfParagraphAtIndex:(NSUInteger)paragraphIndex {
+    if (paragraphIndex >= _numberOfParagraphs) {
+        return NSMakeRange(NSNotFound, 0);
+    }
+    
+    NSUInteger start = _paragraphStarts[paragraphIndex];
+    NSUInteger end = (paragraphIndex + 1 < _numberOfParagraphs) ? (_paragraphStarts[paragraphIndex + 1] - 1) : _length;
+    
+    return NSMakeRange(start, end - start);
+}
+
+- (NSRange)paragraphRangeAtLocation:(NSUInteger)location {
+    if ((_length == 0) || (location > _length)) {
+        return NSMakeRange(0, 0);
+    }
+    
+    return [self rangeOfParagraphAtIndex:[self paragraphIndexAtLocation:location]];
+}
+
+- (void)enumerateParagraphsInRange:(NSRange)range usingBlock:(void (^)(NSRange paragraphRange, BOOL *stop))block {
+    BOOL stop = NO;
+    
+    if (range.location > _length) {
+        block(NSMakeRange(0, 0), &stop);
+        return;
+    }
+    
+    NSUInteger first = [self paragraphIndexAtLocation:range.location];
+    NSUInteger last = [self paragraphIndexAtLocation:MIN(NSMaxRange(range), _length)];
+    
+    for (NSUInteger paragraphIndex = first; (paragraphIndex <= last) && !stop; paragraphIndex++) {
+        block([self rangeOfParagraphAtIndex:paragraphIndex], &stop);
+    }
+}
+
+#pragma mark - Helper Methods -
+
+/// Index of the first paragraph starting after location.
+- (NSUInteger)upperBoundOfLocation:(NSUInteger)location {
+    NSUInteger lower = 0;
+    NSUInteger upper = _numberOfParagraphs;
+    
+    while (lower < upper) {
+        NSUInteger middle = lower + (upper - lower) / 2;
+        
+        if (_paragraphStarts[middle] <= location) {
+            lower = middle + 1;
+        } else {
+            upper = middle;
+        }
+    }
+    
+    return lower;
+}
+
+- (void)textStorageDidProcessEditing:(NSNotification *)notification {
+    NSTextStorage *textStorage = notification.object;
+    
+    if (([textStorage editedMask] & NSTextStorageEditedCharacters) == 0) {
+        return;
+    }
+    
+    /// The edited range covers the new characters, the replaced ones were changeInLength shorter or longer.
+    NSRange editedRange = [textStorage editedRange];
+    NSRange replacedRange = NSMakeRange(editedRange.location, editedRange.length - [textStorage changeInLength]);
+    
+    [self replaceCharactersInRange:replacedRange withString:[textStorage.string substringWithRange:editedRange]];
+    
+    if (_length != textStorage.length) {
+        /// Should never happen, but rebuilding is cheaper than returning wrong paragraphs.
+        _numberOfParagraphs = 1;
+        _length = 0;
+        [self replaceCharactersInRange:NSMakeRange(0, 0) withString:textStorage.string];
+    }
+}
+
+@end
+
+@implementation NSTextStorage (RTEParagraphIndex)
+
+- (void)attachParagraphIndex {
+    if (objc_getAssociatedObject(self, kParagraphIndexKey) != nil) {
+        return;
+    }
+    
+    RTEParagraphIndex *paragraphIndex = [[RTEParagraphIndex alloc] initWithString:self.string];
+    paragraphIndex.textStorage = self;
+    
+    [[NSNotificationCenter defaultCenter] addObserver:paragraphIndex selector:@selector(textStorageDidProcessEditing:) name:NSTextStorageDidProcessEditingNotification object:self];
+    objc_setAssociatedObject(self, kParagraphIndexKey, paragraphIndex, OBJC_ASSOCIATION_RETAIN_NONATOMIC);
+}
+
+- (RTEParagraphIndex *)RTEParagraphIndex {
+    RTEParagraphIndex *paragraphIndex = objc_getAssociatedObject(self, kParagraphIndexKey);
+    
+    /// While characters are being edited, the index still describes the string before the edit.
+    if ((paragraphIndex == nil) || (([self editedMask] & NSTextStorageEditedCharacters) != 0) || (paragraphIndex.length != self.length)) {
+        return nil;
+    }
+    
+    return paragraphIndex;
+}
+
+@end
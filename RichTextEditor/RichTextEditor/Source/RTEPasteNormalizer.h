@@ -0,0 +1,40 @@
+//
+//  RTEPasteNormalizer.h
+//  RichTextEditor
+//
+//  Created by lam1611 on 10/18/26.
+//
+
+#import <Foundation/Foundation.h>
+
+/// Carries a normalization across chunks of the same text.
+typedef struct {
+    /// YES once a character was written, whitespace before the first one is dropped.
+    BOOL hasOutput;
+    /// YES after whitespace that gets written as a single space before the next character, whitespace at the end is dropped.
+    BOOL hasPendingSpace;
+} RTEPasteNormalizerState;
+
+/// Normalizes length characters into normalizedCharacters in a single pass and returns the number written, at most length + 1.
+/// Runs of whitespace and newlines become one space, whitespace at both ends is trimmed across the chunks sharing state,
+/// and control characters are dropped, including the 0x10 and 0x11 list markers of text copied out of an editor.
+/// Printable ASCII is classified eight characters at a time, blocks without spaces are copied as is.
+FOUNDATION_EXPORT NSUInteger RTEPasteNormalizeCharacters(const unichar *_Nonnull characters, NSUInteger length, unichar *_Nonnull normalizedCharacters, RTEPasteNormalizerState *_Nonnull state);
+
+/// Flattens pasted text for single line editors, either at once or a chunk at a time.
+@interface RTEPasteNormalizer : NSObject
+
+@property (nonatomic, copy, readonly, nonnull) NSString *string;
+/// Characters of string normalized so far.
+@property (nonatomic, assign, readonly) NSUInteger consumedLength;
+@property (nonatomic, assign, readonly) BOOL isFinished;
+
++ (NSString *_Nonnull)normalizedString:(NSString *_Nonnull)string;
+
+- (instancetype _Nonnull)initWithString:(NSString *_Nonnull)string;
+
+/// Normalizes up to length more characters of string, fewer to keep surrogate pairs together.
+/// The result can be empty when the characters were all whitespace, it is nil once string is consumed.
+- (NSString *_Nullable)nextChunkWithMaximumLength:(NSUInteger)length;
+
+@end
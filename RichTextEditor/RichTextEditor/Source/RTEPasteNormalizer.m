@@ -0,0 +1,191 @@
+//
+//  RTEPasteNormalizer.m
+//  RichTextEditor
+//
+//  Created by lam1611 on 10/18/26.
+//
+
+#import "RTEPasteNormalizer.h"
+
+#import "RTETrace.h"
+
+static const NSUInteger kNormalizerChunkLength = 64 * 1024;
+
+/// Eight UTF-16 units, compiled to a single SSE or NEON register.
+typedef uint16_t RTEPasteVector __attribute__((ext_vector_type(8)));
+typedef int16_t RTEPasteMask __attribute__((ext_vector_type(8)));
+
+/// The characters of +[NSCharacterSet whitespaceAndNewlineCharacterSet].
+static inline BOOL RTEPasteIsWhitespace(unichar character) {
+    switch (character) {
+        case 0x0009 ... 0x000D:
+        case 0x0020:
+        case 0x0085:
+        case 0x00A0:
+        case 0x1680:
+        case 0x2000 ... 0x200A:
+        case 0x2028:
+        case 0x2029:
+        case 0x202F:
+        case 0x205F:
+        case 0x3000:
+            return YES;
+        default:
+            return NO;
+    }
+}
+
+/// C0 and C1 controls, checked after whitespace.
+static inline BOOL RTEPasteIsControl(unichar character) {
+    return (character < 0x20) || ((character >= 0x7F) && (character <= 0x9F));
+}
+
+NSUInteger RTEPasteNormalizeCharacters(const unichar *characters, NSUInteger length, unichar *normalizedCharacters, RTEPasteNormalizerState *state) {
+    const RTEPasteVector space = 0x20;
+    const RTEPasteVector deleteCharacter = 0x7F;
+    unichar *output = normalizedCharacters;
+    NSUInteger i = 0;
+    
+    while (i < length) {
+        if (length - i >= 8) {
+            RTEPasteVector block;
+            memcpy(&block, characters + i, sizeof(block));
+            
+            RTEPasteMask isPrintable = (block >= space) & (block < deleteCharacter);
+            RTEPasteMask isSpace = (block == space);
+            uint64_t printableLanes[2];
+            uint64_t spaceLanes[2];
+            memcpy(printableLanes, &isPrintable, sizeof(printableLanes));
+            memcpy(spaceLanes, &isSpace, sizeof(spaceLanes));
+            
+            if ((printableLanes[0] & printableLanes[1]) == UINT64_MAX) {
+                if ((spaceLanes[0] | spaceLanes[1]) == 0) {
+                    /// No spaces to collapse, the block is copied as is.
+                    if (state->hasPendingSpace) {
+                        *output++ = ' ';
+                        state->hasPendingSpace = NO;
+                    }
+                    
+                    memcpy(output, characters + i, sizeof(block));
+                    output += 8;
+                    state->hasOutput = YES;
+                } else {
+                    /// Printable ASCII, only the spaces need a look.
+                    for (NSUInteger j = i; j < i + 8; j++) {
+                        if (characters[j] == ' ') {
+                            state->hasPendingSpace = state->hasOutput;
+                        } else {
+                            if (state->hasPendingSpace) {
+                                *output++ = ' ';
+                                state->hasPendingSpace = NO;
+                            }
+                            
+                            *output++ = characters[j];
+                            state->hasOutput = YES;
+                        }
+                    }
+                }
+                
+                i += 8;
+                continue;
+            }
+        }
+        
+        /// Scalar up to the end of the block that failed the check.
+        NSUInteger end = MIN(i + 8, length);
+        
+        for (; i < end; i++) {
+            unichar character = characters[i];
+            
+            if (RTEPasteIsWhitespace(character)) {
+                state->hasPendingSpace = state->hasOutput;
+            } else if (!RTEPasteIsControl(character)) {
+                if (state->hasPendingSpace) {
+                    *output++ = ' ';
+                    state->hasPendingSpace = NO;
+                }
+                
+                *output++ = character;
+                state->hasOutput = YES;
+            }
+        }
+    }
+    
+    return output - normalizedCharacters;
+}
+
+@interface RTEPasteNormalizer () {
+    RTEPasteNormalizerState _state;
+    unichar *_characters;
+    unichar *_normalizedCharacters;
+    NSUInteger _bufferLength;
+}
+
+@end
+
+@implementation RTEPasteNormalizer
+
+#pragma mark - Initialization -
+
+- (instancetype)initWithString:(NSString *)string {
+    if (self = [super init]) {
+        _string = [string copy];
+        _state = (RTEPasteNormalizerState){NO, NO};
+    }
+    
+    return self;
+}
+
+- (void)dealloc {
+    free(_characters);
+    free(_normalizedCharacters);
+}
+
+#pragma mark - Public Methods -
+
++ (NSString *)normalizedString:(NSString *)string {
+    RTE_TRACE_SCOPE_WITH_ARGUMENT("normalize pasted text", string.length);
+    RTEPasteNormalizer *normalizer = [[RTEPasteNormalizer alloc] initWithString:string];
+    NSMutableString *normalizedString = [[NSMutableString alloc] initWithCapacity:string.length];
+    NSString *chunk = nil;
+    
+    while ((chunk = [normalizer nextChunkWithMaximumLength:kNormalizerChunkLength]) != nil) {
+        [normalizedString appendString:chunk];
+    }
+    
+    return normalizedString;
+}
+
+- (BOOL)isFinished {
+    return self.consumedLength >= self.string.length;
+}
+
+- (NSString *)nextChunkWithMaximumLength:(NSUInteger)length {
+    if (self.isFinished) {
+        return nil;
+    }
+    
+    NSUInteger chunkLength = MIN(MAX(length, 2), self.string.length - self.consumedLength);
+    
+    if (chunkLength > _bufferLength) {
+        free(_characters);
+        free(_normalizedCharacters);
+        _characters = malloc(chunkLength * sizeof(unichar));
+        _normalizedCharacters = malloc((chunkLength + 1) * sizeof(unichar));
+        _bufferLength = chunkLength;
+    }
+    
+    [self.string getCharacters:_characters range:NSMakeRange(self.consumedLength, chunkLength)];
+    
+    /// Leave a trailing high surrogate for the next chunk, so the halves of a pair are never inserted apart.
+    if ((self.consumedLength + chunkLength < self.string.length) && CFStringIsSurrogateHighCharacter(_characters[chunkLength - 1])) {
+        chunkLength -= 1;
+    }
+    
+    NSUInteger normalizedLength = RTEPasteNormalizeCharacters(_characters, chunkLength, _normalizedCharacters, &_state);
+    _consumedLength += chunkLength;
+    
+    return [[NSString alloc] initWithCharacters:_normalizedCharacters length:normalizedLength];
+}
+
+@end
@@ -0,0 +1,37 @@
+//
+//  RTEProgressiveHTMLLoader.h
+//  RichTextEditor
+//
+//  Created by lam1611 on 10/18/26.
+//
+
+#import <Cocoa/Cocoa.h>
+
+/// Called on the main queue with each parsed chunk of the document, in order. Appending every chunk to the first one
+/// gives the same text as +[RichTextEditor attributedStringFromHTMLString:defaultAttributes:] without its trailing newline.
+typedef void (^RTEProgressiveHTMLLoaderChunkHandler)(NSAttributedString *_Nonnull chunk, NSUInteger index, BOOL isLastChunk);
+
+/// Loads a document exported by this editor a chunk at a time, so the start of a long document can be shown right away.
+///
+/// The body of the HTML is split between paragraphs into a short first chunk and longer later ones. The first chunk is
+/// parsed on the calling thread, the others one after another on a background queue, and each is handed to the chunk
+/// handler on the main queue. The next chunk is parsed while the handler takes the current one, so no more than
+/// two parsed chunks are held at a time.
+@interface RTEProgressiveHTMLLoader : NSObject
+
+/// Counts the chunks handed to the chunk handler. Cancelling it stops the load after the chunk being handed over.
+@property (nonatomic, strong, readonly, nonnull) NSProgress *progress;
+@property (nonatomic, readonly) NSUInteger numberOfChunks;
+
+/// Splits the body of htmlString after the closing tag of a paragraph once a chunk is at least chunkLength characters,
+/// the first one firstChunkLength. Returns nil if htmlString wasn't exported by this editor.
++ (NSArray<NSValue *> *_Nullable)chunkRangesOfHTMLString:(NSString *_Nonnull)htmlString firstChunkLength:(NSUInteger)firstChunkLength chunkLength:(NSUInteger)chunkLength;
+
+/// Returns nil if htmlString wasn't exported by this editor, it has to be converted as a whole.
+- (instancetype _Nullable)initWithHTMLString:(NSString *_Nonnull)htmlString defaultAttributes:(NSDictionary<NSAttributedStringKey, id> *_Nonnull)defaultAttributes firstChunkLength:(NSUInteger)firstChunkLength chunkLength:(NSUInteger)chunkLength;
+
+/// Hands the first chunk to chunkHandler before returning and the others later, then calls completion on the main queue.
+/// finished is NO if the load was cancelled or a chunk failed to parse. Call on the main thread, once.
+- (void)loadWithChunkHandler:(RTEProgressiveHTMLLoaderChunkHandler _Nonnull)chunkHandler completion:(void (^_Nullable)(BOOL finished))completion;
+
+@end
@@ -0,0 +1,229 @@
+//
+//  RTEProgressiveHTMLLoader.m
+//  RichTextEditor
+//
+//  Created by lam1611 on 10/18/26.
+//
+
+#import "RTEProgressiveHTMLLoader.h"
+
+#import "RTEHTMLParser.h"
+#import "RTETrace.h"
+
+@interface RTEProgressiveHTMLLoader ()
+
+@property (nonatomic, strong, readwrite) NSProgress *progress;
+@property (nonatomic, copy) NSString *htmlString;
+/// Everything up to and including the body tag, put in front of every chunk so it parses on its own.
+@property (nonatomic, copy) NSString *documentHead;
+@property (nonatomic, copy) NSArray<NSValue *> *chunkRanges;
+/// Used by one chunk at a time, the first on the main thread and the others on the parse queue.
+@property (nonatomic, strong) RTEHTMLParser *parser;
+@property (nonatomic, strong) dispatch_queue_t parseQueue;
+/// Attributes of the newline ending the last parsed chunk, see -carryAttributesIntoChunk:.
+@property (nonatomic, strong) NSDictionary *carriedAttributes;
+@property (nonatomic, copy) RTEProgressiveHTMLLoaderChunkHandler chunkHandler;
+@property (nonatomic, copy) void (^completion)(BOOL finished);
+@property (nonatomic, assign, getter=isLoading) BOOL loading;
+
+@end
+
+@implementation RTEProgressiveHTMLLoader
+
+#pragma mark - Initialization -
+
+- (instancetype)initWithHTMLString:(NSString *)htmlString defaultAttributes:(NSDictionary<NSAttributedStringKey, id> *)defaultAttributes firstChunkLength:(NSUInteger)firstChunkLength chunkLength:(NSUInteger)chunkLength {
+    NSArray<NSValue *> *chunkRanges = [[self class] chunkRangesOfHTMLString:htmlString firstChunkLength:firstChunkLength chunkLength:chunkLength];
+    
+    if (chunkRanges == nil) {
+        return nil;
+    }
+    
+    if (self = [super init]) {
+        _htmlString = [htmlString copy];
+        _documentHead = [_htmlString substringToIndex:[[chunkRanges firstObject] rangeValue].location];
+        _chunkRanges = chunkRanges;
+        _parser = [[RTEHTMLParser alloc] initWithDefaultAttributes:defaultAttributes];
+        _parseQueue = dispatch_queue_create("RTEProgressiveHTMLLoader.parse", dispatch_queue_attr_make_with_qos_class(DISPATCH_QUEUE_SERIAL, QOS_CLASS_USER_INITIATED, 0));
+        _progress = [NSProgress progressWithTotalUnitCount:chunkRanges.count];
+        _progress.cancellable = YES;
+    }
+    
+    return self;
+}
+
+#pragma mark - Public Methods -
+
++ (NSArray<NSValue *> *)chunkRangesOfHTMLString:(NSString *)htmlString firstChunkLength:(NSUInteger)firstChunkLength chunkLength:(NSUInteger)chunkLength {
+    if (![RTEHTMLParser isExportedHTML:htmlString]) {
+        return nil;
+    }
+    
+    NSRange bodyTagRange = [htmlString rangeOfString:@"<body>" options:NSCaseInsensitiveSearch];
+    
+    if (bodyTagRange.location == NSNotFound) {
+        return nil;
+    }
+    
+    NSUInteger location = NSMaxRange(bodyTagRange);
+    NSUInteger bodyEnd = [htmlString rangeOfString:@"</body>" options:NSCaseInsensitiveSearch | NSBackwardsSearch range:NSMakeRange(location, htmlString.length - location)].location;
+    
+    if (bodyEnd == NSNotFound) {
+        bodyEnd = htmlString.length;
+    }
+    
+    NSMutableArray<NSValue *> *chunkRanges = [[NSMutableArray alloc] init];
+    NSUInteger minimumLength = MAX(firstChunkLength, 1);
+    
+    do {
+        NSUInteger end = bodyEnd;
+        
+        if (minimumLength < bodyEnd - location) {
+            /// Text is written escaped, so the closing tag can't show up inside a paragraph.
+            NSUInteger searchLocation = location + minimumLength;
+            NSRange closingTagRange = [htmlString rangeOfString:@"</p>" options:NSCaseInsensitiveSearch range:NSMakeRange(searchLocation, bodyEnd - searchLocation)];
+            
+            /// Whatever follows the last paragraph stays with it.
+            if ((closingTagRange.location != NSNotFound) && ([htmlString rangeOfString:@"<p" options:NSCaseInsensitiveSearch range:NSMakeRange(NSMaxRange(closingTagRange), bodyEnd - NSMaxRange(closingTagRange))].location != NSNotFound)) {
+                end = NSMaxRange(closingTagRange);
+            }
+        }
+        
+        [chunkRanges addObject:[NSValue valueWithRange:NSMakeRange(location, end - location)]];
+        location = end;
+        minimumLength = MAX(chunkLength, 1);
+    } while (location < bodyEnd);
+    
+    return chunkRanges;
+}
+
+- (NSUInteger)numberOfChunks {
+    return self.chunkRanges.count;
+}
+
+- (void)loadWithChunkHandler:(RTEProgressiveHTMLLoaderChunkHandler)chunkHandler completion:(void (^)(BOOL))completion {
+    if (self.isLoading || self.progress.completedUnitCount > 0) {
+        return;
+    }
+    
+    self.chunkHandler = chunkHandler;
+    self.completion = completion;
+    self.loading = YES;
+    
+    __weak typeof(self) weakSelf = self;
+    
+    /// Called on the thread that cancelled, the load is finished on the main queue where the chunks are handed over.
+    self.progress.cancellationHandler = ^{
+        dispatch_async(dispatch_get_main_queue(), ^{
+            [weakSelf finishLoading:NO];
+        });
+    };
+    
+    [self handOverChunk:[self parseChunkAtIndex:0] atIndex:0];
+}
+
+#pragma mark - Helper Methods -
+
+/// Runs on the main thread. Starts parsing the next chunk before handing this one over, the two overlap.
+- (void)handOverChunk:(NSAttributedString *)chunk atIndex:(NSUInteger)index {
+    if (!self.isLoading) {
+        return;
+    }
+    
+    if ((chunk == nil) || self.progress.isCancelled) {
+        [self finishLoading:NO];
+        return;
+    }
+    
+    BOOL isLastChunk = (index + 1 == self.chunkRanges.count);
+    
+    if (!isLastChunk) {
+        /// The blocks keep the loader alive until the last chunk is handed over.
+        dispatch_async(self.parseQueue, ^{
+            NSAttributedString *nextChunk = [self parseChunkAtIndex:index + 1];
+            
+            dispatch_async(dispatch_get_main_queue(), ^{
+                [self handOverChunk:nextChunk atIndex:index + 1];
+            });
+        });
+    }
+    
+    self.chunkHandler(chunk, index, isLastChunk);
+    self.progress.completedUnitCount = index + 1;
+    
+    if (isLastChunk) {
+        [self finishLoading:YES];
+    }
+}
+
+- (void)finishLoading:(BOOL)finished {
+    if (!self.isLoading) {
+        return;
+    }
+    
+    void (^completion)(BOOL finished) = self.completion;
+    
+    self.loading = NO;
+    self.chunkHandler = nil;
+    self.completion = nil;
+    self.progress.cancellationHandler = nil;
+    
+    if (completion != nil) {
+        completion(finished);
+    }
+}
+
+/// Parses the chunk as a document of its own, called for one chunk after another.
+- (NSAttributedString *)parseChunkAtIndex:(NSUInteger)index {
+    NSRange range = [[self.chunkRanges objectAtIndex:index] rangeValue];
+    RTE_TRACE_SCOPE_WITH_ARGUMENT("parse html chunk", range.length);
+    
+    @autoreleasepool {
+        NSString *htmlString = self.htmlString;
+        
+        if (self.chunkRanges.count > 1) {
+            htmlString = [NSString stringWithFormat:@"%@%@</body></html>", self.documentHead, [self.htmlString substringWithRange:range]];
+        }
+        
+        NSMutableAttributedString *chunk = [[self.parser attributedStringFromHTMLString:htmlString] mutableCopy];
+        
+        if (chunk == nil) {
+            return nil;
+        }
+        
+        [self carryAttributesIntoChunk:chunk];
+        
+        if ((index + 1 == self.chunkRanges.count) && [chunk.string hasSuffix:@"\n"]) {
+            [chunk replaceCharactersInRange:NSMakeRange(chunk.length - 1, 1) withString:@""];
+        }
+        
+        return chunk;
+    }
+}
+
+/// The newline of an empty paragraph takes the attributes of the text before it. The parser of a chunk doesn't see
+/// the text of the chunk before, so empty paragraphs at the start of a chunk are given them here.
+- (void)carryAttributesIntoChunk:(NSMutableAttributedString *)chunk {
+    NSString *string = chunk.string;
+    NSUInteger length = string.length;
+    
+    if (self.carriedAttributes != nil) {
+        for (NSUInteger i = 0; i < length && [string characterAtIndex:i] == '\n'; i++) {
+            NSParagraphStyle *paragraphStyle = [chunk attribute:NSParagraphStyleAttributeName atIndex:i effectiveRange:NULL];
+            
+            [chunk setAttributes:self.carriedAttributes range:NSMakeRange(i, 1)];
+            
+            if (paragraphStyle != nil) {
+                [chunk addAttribute:NSParagraphStyleAttributeName value:paragraphStyle range:NSMakeRange(i, 1)];
+            }
+        }
+    }
+    
+    if (length > 0) {
+        NSMutableDictionary *attributes = [[chunk attributesAtIndex:length - 1 effectiveRange:NULL] mutableCopy];
+        [attributes removeObjectForKey:NSParagraphStyleAttributeName];
+        self.carriedAttributes = attributes;
+    }
+}
+
+@end
@@ -34,6 +34,11 @@
 // TODO: Clean up, clean up, everybody do your share!
 
 #import <Cocoa/Cocoa.h>
+#import <RichTextEditor/RTESearchIndex.h>
+#import <RichTextEditor/RTEFormatIndex.h>
+#import <RichTextEditor/RTEDocumentSnapshot.h>
+#import <RichTextEditor/RTEIncrementalHTMLExporter.h>
+#import <RichTextEditor/RTEEventBus.h>
 
 @class RichTextEditor;
 @class RTETextFormat;
@@ -88,6 +93,8 @@ typedef NS_OPTIONS(NSUInteger, RichTextEditorShortcut) {
 @optional
 
 - (NSUInteger)levelsOfUndo;
+/// Upper bound in bytes for the editor's undo history, kRTEUndoJournalDefaultByteBudget if not implemented.
+- (NSUInteger)undoByteBudget;
 
 /// If you do not want to enable all keyboard shortcuts (e.g. if you don't want users to resize font ever),
 /// then you can use this data source callback to selectively enable keyboard shortcuts.
@@ -114,7 +121,7 @@ typedef NS_OPTIONS(NSUInteger, RichTextEditorShortcut) {
 @interface RichTextEditor : NSTextView
 
 @property (assign) IBOutlet id<RichTextEditorDataSource> _Nullable rteDataSource;
-@property (assign) IBOutlet id<RichTextEditorDelegate> _Nullable rteDelegate;
+@property (nonatomic, assign) IBOutlet id<RichTextEditorDelegate> _Nullable rteDelegate;
 
 @property (nonatomic, strong, nullable) NSAttributedString *placeholderAttributedString;
 
@@ -128,6 +135,22 @@ typedef NS_OPTIONS(NSUInteger, RichTextEditorShortcut) {
 /// Defaults to YES.
 @property (nonatomic, assign) BOOL allowsRichTextPasteOnlyFromThisClass;
 
+/// Progress of a long paste into a single line editor, which is inserted in chunks while the editor is not editable.
+/// Cancelling it stops the paste, the text inserted so far stays. nil when no such paste is running.
+@property (nonatomic, strong, readonly, nullable) NSProgress *pasteProgress;
+
+/// Progress of a document being loaded by loadHtmlString:completion:, counted in chunks.
+/// Cancelling it stops the load, the text loaded so far stays. nil when no document is loading.
+@property (nonatomic, strong, readonly, nullable) NSProgress *loadProgress;
+
+/// Text, selection, typing attributes and preview changes of the editor, for subscribers that want them as they happen
+/// or coalesced once per frame with the affected ranges.
+@property (nonatomic, strong, readonly, nonnull) RTEEventBus *eventBus;
+
+/// If YES, richTextEditor:changedSelectionTo:withFormat: is sent once per frame for the last selection instead of
+/// on every selection change, e.g. of a drag-select or key repeat. Defaults to NO.
+@property (nonatomic, assign) BOOL coalescesSelectionUpdates;
+
 /// Amount to change font size on each increase/decrease font size call.
 /// Defaults to 10.0f
 @property (nonatomic, assign) CGFloat fontSizeChangeAmount;
@@ -148,9 +171,15 @@ typedef NS_OPTIONS(NSUInteger, RichTextEditorShortcut) {
 
 // MARK: -
 
-/// Pasteboard type string used when copying text from this NSTextView.
+/// Pasteboard type string used when copying text from this NSTextView, its data is the copied text as an RTEBinaryDocument.
 + (NSString *_Nonnull)pasteboardDataType;
 
+/// Starts recording spans of the list fix-ups, list marker layout, HTML conversions, font lookups and delegate callbacks,
+/// with an instant event for every RichTextEditorPreviewChange. Any previous capture is discarded.
++ (void)startTracing;
+/// Stops recording and returns the capture as Chrome trace-event JSON, see RTETracer.
++ (NSData *_Nonnull)stopTracing;
+
 /// Call the following methods when the user does the given action (clicks bold button, etc.)
 
 - (void)useSingleLineMode;
@@ -241,6 +270,26 @@ typedef NS_OPTIONS(NSUInteger, RichTextEditorShortcut) {
 /// Changes the editor's contents to the given attributed string.
 - (void)setAttributedString:(NSAttributedString *_Nonnull)attributedString;
 
+/// An immutable copy of the text that can be read on any thread while editing goes on, e.g. for autosave or export.
+/// Call on the main thread. The first call copies the text, later ones cost O(1) as edits are tracked from then on.
+- (RTEDocumentSnapshot *_Nonnull)documentSnapshot;
+
+/// What the characters of range have in common, e.g. whether all, some or none of them are bold.
+/// Answered in O(log n) from an index of the attribute runs, however long the range.
+- (RTEFormatSummary)formatSummaryOfRange:(NSRange)range;
+
+/// Enumerates the matches of query in the text in order until stop is set.
+/// Searches use a trigram index of the text, built on the first search and updated on every edit after it.
+- (void)enumerateMatchesOfString:(NSString *_Nonnull)query options:(RTESearchOptions)options usingBlock:(void (^_Nonnull)(NSRange matchRange, BOOL *_Nonnull stop))block;
+
+/// Selects and scrolls to the first match after the selection, wrapping around to the start. Returns NO if there is none.
+- (BOOL)findNextOccurrenceOfString:(NSString *_Nonnull)query options:(RTESearchOptions)options;
+
+/// Replaces every match of query in one edit and one undo entry, and returns the number of replacements.
+/// Each replacement takes the attributes of the text it replaces. Matches that include a list marker are left alone.
+/// Replaces nothing and returns 0 if the editor isn't editable or the delegate refuses the change of the range covering the matches.
+- (NSUInteger)replaceAllOccurrencesOfString:(NSString *_Nonnull)query withString:(NSString *_Nonnull)replacement options:(RTESearchOptions)options;
+
 /// Convenience method to set the editor's border color.
 - (void)setBorderColor:(NSColor *_Nonnull)borderColor;
 
@@ -251,12 +300,22 @@ typedef NS_OPTIONS(NSUInteger, RichTextEditorShortcut) {
 + (BOOL)isHTML:(NSString *_Nonnull)string;
 
 /// Converts the current NSAttributedString to an HTML string.
+/// The first call serializes every paragraph, later ones only the paragraphs edited since the call before.
 - (NSString *_Nonnull)htmlString;
 
+/// Writes the same HTML as htmlString to url as UTF-8, replacing the file at once. Returns NO and sets error on failure.
+- (BOOL)writeHTMLToURL:(NSURL *_Nonnull)url error:(NSError *_Nullable *_Nullable)error;
+
 /// Converts the provided htmlString into an NSAttributedString and then
 /// sets the editor's text to the attributed string.
 - (void)setHtmlString:(NSString *_Nonnull)htmlString;
 
+/// Sets the editor's text to htmlString like setHtmlString:, but a long document exported by this editor is shown
+/// starting with its first screenful while the rest is parsed in the background and appended a chunk at a time,
+/// each chunk a single edit. The editor is not editable until the load is done, see loadProgress.
+/// Setting other text cancels the load. completion is called on the main queue, finished is NO if the load was cancelled.
+- (void)loadHtmlString:(NSString *_Nonnull)htmlString completion:(void (^_Nullable)(BOOL finished))completion;
+
 /// Converts the provided NSAttributedString into an HTML string.
 + (NSString *_Nonnull)htmlStringFromAttributedText:(NSAttributedString *_Nonnull)text;
 
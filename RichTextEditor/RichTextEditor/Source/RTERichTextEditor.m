@@ -40,11 +40,87 @@
 #import "RTEDefiniens.h"
 #import "RTETextFormat.h"
 #import "RTELayoutManager.h"
+#import "RTEParagraphIndex.h"
+#import "RTEFormatIndex.h"
+#import "RTEDocumentSnapshot.h"
+#import "RTEIncrementalHTMLExporter.h"
+#import "RTEHTMLSerializer.h"
+#import "RTEHTMLParser.h"
+#import "RTEHTMLSniffer.h"
+#import "RTEStyleTable.h"
+#import "RTEBinaryDocument.h"
+#import "RTEUndoJournal.h"
+#import "RTEEditPlan.h"
+#import "RTEPasteNormalizer.h"
+#import "RTEProgressiveHTMLLoader.h"
+#import "RTESearchIndex.h"
+#import "RTEEventBus.h"
+#import "RTETrace.h"
 #import "NSFont+RichTextEditor.h"
 #import "NSAttributedString+RichTextEditor.h"
 #import "WZProtocolInterceptor.h"
 
+/// Trace events keep the name pointer, so each type maps to a literal.
+static const char *RTETraceNameOfPreviewChange(RichTextEditorPreviewChange type) {
+    switch (type) {
+        case RichTextEditorPreviewChangeBold:
+            return "RichTextEditorPreviewChangeBold";
+        case RichTextEditorPreviewChangeItalic:
+            return "RichTextEditorPreviewChangeItalic";
+        case RichTextEditorPreviewChangeUnderline:
+            return "RichTextEditorPreviewChangeUnderline";
+        case RichTextEditorPreviewChangeStrikethrough:
+            return "RichTextEditorPreviewChangeStrikethrough";
+        case RichTextEditorPreviewChangeFontResize:
+            return "RichTextEditorPreviewChangeFontResize";
+        case RichTextEditorPreviewChangeHighlight:
+            return "RichTextEditorPreviewChangeHighlight";
+        case RichTextEditorPreviewChangeFontSize:
+            return "RichTextEditorPreviewChangeFontSize";
+        case RichTextEditorPreviewChangeFontColor:
+            return "RichTextEditorPreviewChangeFontColor";
+        case RichTextEditorPreviewChangeIndentIncrease:
+            return "RichTextEditorPreviewChangeIndentIncrease";
+        case RichTextEditorPreviewChangeIndentDecrease:
+            return "RichTextEditorPreviewChangeIndentDecrease";
+        case RichTextEditorPreviewChangeCut:
+            return "RichTextEditorPreviewChangeCut";
+        case RichTextEditorPreviewChangePaste:
+            return "RichTextEditorPreviewChangePaste";
+        case RichTextEditorPreviewChangeSpace:
+            return "RichTextEditorPreviewChangeSpace";
+        case RichTextEditorPreviewChangeEnter:
+            return "RichTextEditorPreviewChangeEnter";
+        case RichTextEditorPreviewChangeBulletedList:
+            return "RichTextEditorPreviewChangeBulletedList";
+        case RichTextEditorPreviewChangeNumberingList:
+            return "RichTextEditorPreviewChangeNumberingList";
+        case RichTextEditorPreviewChangeHyperLink:
+            return "RichTextEditorPreviewChangeHyperLink";
+        case RichTextEditorPreviewChangeMouseDown:
+            return "RichTextEditorPreviewChangeMouseDown";
+        case RichTextEditorPreviewChangeMouseDragged:
+            return "RichTextEditorPreviewChangeMouseDragged";
+        case RichTextEditorPreviewChangeArrowKey:
+            return "RichTextEditorPreviewChangeArrowKey";
+        case RichTextEditorPreviewChangeKeyDown:
+            return "RichTextEditorPreviewChangeKeyDown";
+        case RichTextEditorPreviewChangeDelete:
+            return "RichTextEditorPreviewChangeDelete";
+        case RichTextEditorPreviewChangeFindReplace:
+            return "RichTextEditorPreviewChangeFindReplace";
+    }
+    
+    return "RichTextEditorPreviewChange";
+}
+
 @interface RichTextEditor () <NSTextViewDelegate> {
+    /// What rteDelegate responds to of the messages sent on every keystroke and mouse event, looked up when it is set.
+    struct {
+        unsigned int changedSelection : 1;
+        unsigned int changeAboutToOccur : 1;
+        unsigned int keyDownEvent : 1;
+    } _rteDelegateRespondsTo;
 }
 
 /// Gets set to YES when the user starts changing attributes when there is no text selection (selecting bold, italic, etc)
@@ -74,6 +150,33 @@
 
 @property WZProtocolInterceptor *delegate_interceptor;
 
+/// Interns the paragraph styles written by the indentation and list commands, so equal paragraphs share one style.
+/// Lives as long as the document, a new one starts with an empty table, see -replaceTextWithAttributedString:.
+@property (nonatomic, strong) RTEStyleTable *styleTable;
+
+/// Records typing and commands as text deltas, bounded by a byte budget. NSTextView's own undo registration is turned off.
+@property (nonatomic, strong) RTEUndoJournal *undoJournal;
+/// YES between -textView:shouldChangeTextInRange:replacementString: and -textDidChange:.
+@property (nonatomic, assign) BOOL isRecordingTextChange;
+
+/// State of a paste being inserted in chunks, see -pasteNormalizedPlainTextFromPasteboard:.
+@property (nonatomic, copy) NSString *pasteString;
+/// Characters of pasteString inserted so far.
+@property (nonatomic, assign) NSUInteger pastedLength;
+@property (nonatomic, strong) NSDictionary<NSAttributedStringKey, id> *pasteAttributes;
+@property (nonatomic, assign) NSUInteger pasteInsertionLocation;
+@property (nonatomic, strong, readwrite) NSProgress *pasteProgress;
+@property (nonatomic, assign) BOOL wasEditableBeforePaste;
+
+/// State of a document being loaded in chunks, see -loadHtmlString:completion:.
+@property (nonatomic, strong) RTEProgressiveHTMLLoader *htmlLoader;
+@property (nonatomic, strong, readwrite) NSProgress *loadProgress;
+@property (nonatomic, assign) BOOL wasEditableBeforeLoad;
+
+@property (nonatomic, strong, readwrite) RTEEventBus *eventBus;
+/// Sends richTextEditor:changedSelectionTo:withFormat:, see coalescesSelectionUpdates.
+@property (nonatomic, strong) id typingAttributesSubscriber;
+
 @end
 
 @implementation RichTextEditor
@@ -82,6 +185,16 @@
     return @"RTERichTextEditor";
 }
 
++ (void)startTracing {
+    [RTETracer startCapture];
+}
+
++ (NSData *)stopTracing {
+    [RTETracer stopCapture];
+    
+    return [RTETracer chromeTraceData];
+}
+
 #pragma mark - Initialization -
 
 - (instancetype)init {
@@ -116,6 +229,10 @@
     return self;
 }
 
+- (void)dealloc {
+    [[NSNotificationCenter defaultCenter] removeObserver:self name:NSTextStorageDidProcessEditingNotification object:nil];
+}
+
 + (instancetype)initWithParent:(NSView *)parent frame:(NSRect)frame {
     NSSize contentSize = frame.size;
     
@@ -141,7 +258,8 @@
     
     RichTextEditor *textEditor = [[RichTextEditor alloc] initWithFrame:frame textContainer:textContainer];
     [textEditor setTextColor:[NSColor blackColor]];
-    [textEditor setAllowsUndo:YES];
+    /// Undo goes through the editor's undo journal, not NSTextView's registration.
+    [textEditor setAllowsUndo:NO];
     [textEditor setEditable:YES];
     [textEditor setSelectable:YES];
     [textEditor setBackgroundColor:[NSColor clearColor]];
@@ -223,6 +341,34 @@
     return self.delegate_interceptor;
 }
 
+- (void)setRteDelegate:(id<RichTextEditorDelegate>)rteDelegate {
+    _rteDelegate = rteDelegate;
+    _rteDelegateRespondsTo.changedSelection = [rteDelegate respondsToSelector:@selector(richTextEditor:changedSelectionTo:withFormat:)];
+    _rteDelegateRespondsTo.changeAboutToOccur = [rteDelegate respondsToSelector:@selector(richTextEditor:changeAboutToOccurOfType:)];
+    _rteDelegateRespondsTo.keyDownEvent = [rteDelegate respondsToSelector:@selector(richTextEditor:keyDownEvent:)];
+}
+
+- (void)setCoalescesSelectionUpdates:(BOOL)coalescesSelectionUpdates {
+    _coalescesSelectionUpdates = coalescesSelectionUpdates;
+    
+    if (self.typingAttributesSubscriber != nil) {
+        [self.eventBus removeSubscriber:self.typingAttributesSubscriber];
+    }
+    
+    __weak typeof(self) weakSelf = self;
+    
+    /// Coalesced, the format of the selection is computed once per frame for the last selection.
+    self.typingAttributesSubscriber = [self.eventBus addSubscriberForEventTypes:RTEEditorEventTypeTypingAttributesChange delivery:coalescesSelectionUpdates ? RTEEventDeliveryCoalesced : RTEEventDeliverySynchronous handler:^(NSArray<RTEEditorEvent *> *events) {
+        [weakSelf sendDelegateChangedSelection];
+    }];
+}
+
+- (void)textStorageDidProcessEditing:(NSNotification *)notification {
+    NSTextStorage *textStorage = [notification object];
+    
+    [self.eventBus postEventOfType:RTEEditorEventTypeTextChange detail:0 range:[textStorage editedRange] changeInLength:[textStorage changeInLength]];
+}
+
 - (void)setDelegate:(id)newDelegate {
     [super setDelegate:nil];
     self.delegate_interceptor.receiver = newDelegate;
@@ -240,6 +386,9 @@
     [super setDelegate:(id)self.delegate_interceptor];
     self.allowsRichTextPasteOnlyFromThisClass = YES;
     
+    self.eventBus = [[RTEEventBus alloc] init];
+    self.coalescesSelectionUpdates = NO;
+    
     self.borderColor = [NSColor lightGrayColor];
     self.borderWidth = 1.0;
     
@@ -254,6 +403,7 @@
     
     self.latestReplacementString = @"";
     self.latestStringReplaced = @"";
+    self.styleTable = [[RTEStyleTable alloc] init];
     
     /// Instead of hard-coding the default indentation size, which can make bulleted lists look a little
     /// odd when increasing/decreasing their indent, use double \t characters width instead
@@ -270,6 +420,25 @@
         [[self undoManager] setLevelsOfUndo:self.levelsOfUndo];
     }
     
+    if (self.rteDataSource && [self.rteDataSource respondsToSelector:@selector(undoByteBudget)]) {
+        self.undoJournal = [[RTEUndoJournal alloc] initWithByteBudget:[self.rteDataSource undoByteBudget]];
+    } else {
+        self.undoJournal = [[RTEUndoJournal alloc] initWithByteBudget:kRTEUndoJournalDefaultByteBudget];
+    }
+    
+    [self setAllowsUndo:NO];
+    
+    /// Paragraph lookups are done on every edit, selection change and draw. The index keeps them
+    /// logarithmic instead of scanning the text for newlines each time.
+    [[self textStorage] attachParagraphIndex];
+    
+    /// The toolbar state is recomputed on every selection change, including each mouse event of a drag.
+    [[self textStorage] attachFormatIndex];
+    
+    /// Text changes are posted to the event bus with the edited range, whoever made them.
+    [[NSNotificationCenter defaultCenter] removeObserver:self name:NSTextStorageDidProcessEditingNotification object:nil];
+    [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(textStorageDidProcessEditing:) name:NSTextStorageDidProcessEditingNotification object:[self textStorage]];
+    
     /// http://stackoverflow.com/questions/26454037/uitextview-text-selection-and-highlight-jumping-in-ios-8
     [[self layoutManager] setAllowsNonContiguousLayout:NO];
     [self setSelectedRange:NSMakeRange(0, 0)];
@@ -310,20 +479,96 @@
     if ([replacementString isEqualToString:@" "]) {
         [self sendDelegatePreviewChangeOfType:RichTextEditorPreviewChangeSpace];
     }
-    if (self.delegate_interceptor.receiver && [self.delegate_interceptor.receiver respondsToSelector:@selector(textView:shouldChangeTextInRange:replacementString:)]) {
-        return [self.delegate_interceptor.receiver textView:textView shouldChangeTextInRange:affectedCharRange replacementString:replacementString];
+    if ([self.delegate_interceptor receiverRespondsToSelector:@selector(textView:shouldChangeTextInRange:replacementString:)]) {
+        BOOL shouldChangeText = [self.delegate_interceptor.receiver textView:textView shouldChangeTextInRange:affectedCharRange replacementString:replacementString];
+        
+        if (shouldChangeText) {
+            [self beginRecordingTextChangeInRange:affectedCharRange replacementString:replacementString];
+        }
+        
+        return shouldChangeText;
     }
     if (self.tabKeyAlwaysIndentsOutdents && [replacementString isEqualToString:@"\t"] && affectedCharRange.length == 0) {
         // [self userSelectedIncreaseIndent];
         // return NO;
     }
     
+    [self beginRecordingTextChangeInRange:affectedCharRange replacementString:replacementString];
+    
     return YES;
 }
 
+/// Opens the undo entry of a change made through NSTextView, -textDidChange: closes it once the list fix-ups ran.
+/// Single character changes coalesce into a typing burst.
+- (void)beginRecordingTextChangeInRange:(NSRange)affectedCharRange replacementString:(NSString *)replacementString {
+    if (self.isRecordingTextChange) {
+        /// The previous change never reached -textDidChange:.
+        [self.undoJournal endEditingOfAttributedString:[self textStorage] selectedRange:[self selectedRange]];
+    }
+    
+    BOOL isTyping = (affectedCharRange.length <= 1) && (replacementString.length <= 1);
+    
+    NSRange undoableRange = [self textChangeMayTouchFormatListsInRange:affectedCharRange replacementString:replacementString] ? [self undoableRangeForRange:affectedCharRange] : affectedCharRange;
+    
+    self.isRecordingTextChange = YES;
+    [self.undoJournal beginEditingInRange:undoableRange ofAttributedString:[self textStorage] selectedRange:[self selectedRange] kind:(isTyping ? RTEUndoJournalEditKindTyping : RTEUndoJournalEditKindCommand)];
+}
+
+/// The list fix-ups of -textDidChange: only run around newlines, list markers and list paragraphs,
+/// any other change stays inside the range it replaces.
+- (BOOL)textChangeMayTouchFormatListsInRange:(NSRange)range replacementString:(NSString *)replacementString {
+    NSString *string = [self textStorage].string;
+    NSUInteger length = string.length;
+    NSCharacterSet *formatListCharacterSet = [NSCharacterSet characterSetWithCharactersInString:[NSString stringWithFormat:@"\n\r%C%C%C", (unichar)0x10, (unichar)0x11, (unichar)0x2029]];
+    
+    range.location = MIN(range.location, length);
+    range.length = MIN(range.length, length - range.location);
+    
+    if (([replacementString rangeOfCharacterFromSet:formatListCharacterSet].location != NSNotFound) ||
+        ([string rangeOfCharacterFromSet:formatListCharacterSet options:0 range:range].location != NSNotFound)) {
+        return YES;
+    }
+    
+    NSString *bulletString = [RTELayoutManager kBulletString];
+    NSString *numberingString = [RTELayoutManager kNumberingString];
+    NSUInteger paragraphLocation = [string paragraphRangeForRange:NSMakeRange(range.location, 0)].location;
+    NSUInteger previousParagraphLocation = (paragraphLocation > 0) ? [string paragraphRangeForRange:NSMakeRange(paragraphLocation - 1, 0)].location : NSNotFound;
+    
+    for (NSNumber *location in @[@(paragraphLocation), @(previousParagraphLocation)]) {
+        if ([self string:string hasPrefix:bulletString atLocation:location.unsignedIntegerValue] || [self string:string hasPrefix:numberingString atLocation:location.unsignedIntegerValue]) {
+            return YES;
+        }
+    }
+    
+    return NO;
+}
+
+/// The paragraphs of range plus the ones before and after it, the list fix-ups after an edit and list or paragraph style commands
+/// may touch the neighbours.
+- (NSRange)undoableRangeForRange:(NSRange)range {
+    NSString *string = [self textStorage].string;
+    NSUInteger length = string.length;
+    NSUInteger start = MIN(range.location, length);
+    NSUInteger end = MIN(NSMaxRange(range), length);
+    
+    start = [string paragraphRangeForRange:NSMakeRange(start, 0)].location;
+    start = (start > 0) ? [string paragraphRangeForRange:NSMakeRange(start - 1, 0)].location : 0;
+    end = NSMaxRange([string paragraphRangeForRange:NSMakeRange(end, 0)]);
+    end = (end < length) ? NSMaxRange([string paragraphRangeForRange:NSMakeRange(end, 0)]) : length;
+    
+    return NSMakeRange(start, end - start);
+}
+
+/// Records everything block changes around the selection as a single undo entry.
+- (void)performUndoableEditInRange:(NSRange)range withBlock:(void (^)(void))block {
+    [self.undoJournal beginEditingInRange:[self undoableRangeForRange:range] ofAttributedString:[self textStorage] selectedRange:[self selectedRange] kind:RTEUndoJournalEditKindCommand];
+    block();
+    [self.undoJournal endEditingOfAttributedString:[self textStorage] selectedRange:[self selectedRange]];
+}
+
 // http://stackoverflow.com/questions/2484072/how-can-i-make-the-tab-key-move-focus-out-of-a-nstextview
 - (BOOL)textView:(NSTextView *)aTextView doCommandBySelector:(SEL)aSelector {
-    if (self.delegate_interceptor.receiver && [self.delegate_interceptor.receiver respondsToSelector:@selector(textView:doCommandBySelector:)]) {
+    if ([self.delegate_interceptor receiverRespondsToSelector:@selector(textView:doCommandBySelector:)]) {
         return [self.delegate_interceptor.receiver textView:aTextView doCommandBySelector:aSelector];
     }
     
@@ -412,7 +657,7 @@
         newSelectedCharRange = [self adjustSelectedRangeFormatListWithBeginRange:rangeOfCurrentParagraph previousRange:oldSelectedCharRange currentRange:newSelectedCharRange isMouseClick:NO];
     }
     
-    if (self.delegate_interceptor.receiver && [self.delegate_interceptor.receiver respondsToSelector:@selector(textView:willChangeSelectionFromCharacterRange:toCharacterRange:)]) {
+    if ([self.delegate_interceptor receiverRespondsToSelector:@selector(textView:willChangeSelectionFromCharacterRange:toCharacterRange:)]) {
         return [self.delegate_interceptor.receiver textView:textView willChangeSelectionFromCharacterRange:oldSelectedCharRange toCharacterRange:newSelectedCharRange];
     }
     
@@ -422,15 +667,17 @@
 - (void)textViewDidChangeSelection:(NSNotification *)notification {
     [self setNeedsLayout:YES];
     [self scrollRangeToVisible:[self selectedRange]]; // fixes issue with cursor moving to top via keyboard and RTE not scrolling
+    [self.eventBus postEventOfType:RTEEditorEventTypeSelectionChange detail:0 range:[self selectedRange] changeInLength:0];
     [self sendDelegateTypingAttrsUpdate];
     
-    if (self.delegate_interceptor.receiver && [self.delegate_interceptor.receiver respondsToSelector:@selector(textViewDidChangeSelection:)]) {
+    if ([self.delegate_interceptor receiverRespondsToSelector:@selector(textViewDidChangeSelection:)]) {
         [self.delegate_interceptor.receiver textViewDidChangeSelection:notification];
     }
 }
 
 - (void)textDidChange:(NSNotification *)notification {
     if (!self.isInTextDidChange) {
+        RTE_TRACE_SCOPE("textDidChange list fix-ups");
         self.isInTextDidChange = YES;
         [self applyListIfApplicableForType:RichTextEditorPreviewChangeBulletedList];
         [self deleteFormatListWhenApplicable:RichTextEditorPreviewChangeBulletedList];
@@ -463,10 +710,16 @@
         self.isInTextDidChange = NO;
     }
     
+    if (self.isRecordingTextChange) {
+        self.isRecordingTextChange = NO;
+        [self.undoJournal endEditingOfAttributedString:[self textStorage] selectedRange:[self selectedRange]];
+    }
+    
     self.justDeletedBackward = NO;
     [self setNeedsUpdateLayout:YES];
     
-    if (self.delegate_interceptor.receiver && [self.delegate_interceptor.receiver respondsToSelector:@selector(textDidChange:)]) {
+    if ([self.delegate_interceptor receiverRespondsToSelector:@selector(textDidChange:)]) {
+        RTE_TRACE_SCOPE("delegate textDidChange:");
         [self.delegate_interceptor.receiver textDidChange:notification];
     }
 }
@@ -475,22 +728,33 @@
 
 - (BOOL)isInBulletedList {
     NSRange rangeOfCurrentParagraph = [self.attributedString firstParagraphRangeFromTextRange:[self selectedRange]];
-    return [[[self.attributedString string] substringFromIndex:rangeOfCurrentParagraph.location] hasPrefix:[RTELayoutManager kBulletString]];
+    return [self string:self.string hasPrefix:[RTELayoutManager kBulletString] atLocation:rangeOfCurrentParagraph.location];
 }
 
 - (BOOL)isInEmptyBulletedListItem {
     NSRange rangeOfCurrentParagraph = [self.attributedString firstParagraphRangeFromTextRange:[self selectedRange]];
-    return [[[self.attributedString string] substringFromIndex:rangeOfCurrentParagraph.location] isEqualToString:[RTELayoutManager kBulletString]];
+    NSString *bulletString = [RTELayoutManager kBulletString];
+    return (self.string.length - rangeOfCurrentParagraph.location == bulletString.length) && [self string:self.string hasPrefix:bulletString atLocation:rangeOfCurrentParagraph.location];
 }
 
 - (BOOL)isInNumberedList {
     NSRange rangeOfCurrentParagraph = [self.attributedString firstParagraphRangeFromTextRange:[self selectedRange]];
-    return [[[self.attributedString string] substringFromIndex:rangeOfCurrentParagraph.location] hasPrefix:[RTELayoutManager kNumberingString]];
+    return [self string:self.string hasPrefix:[RTELayoutManager kNumberingString] atLocation:rangeOfCurrentParagraph.location];
 }
 
 - (BOOL)isInEmptyNumberedListItem {
     NSRange rangeOfCurrentParagraph = [self.attributedString firstParagraphRangeFromTextRange:[self selectedRange]];
-    return [[[self.attributedString string] substringFromIndex:rangeOfCurrentParagraph.location] isEqualToString:[RTELayoutManager kNumberingString]];
+    NSString *numberingString = [RTELayoutManager kNumberingString];
+    return (self.string.length - rangeOfCurrentParagraph.location == numberingString.length) && [self string:self.string hasPrefix:numberingString atLocation:rangeOfCurrentParagraph.location];
+}
+
+/// Same as [[string substringFromIndex:location] hasPrefix:prefix] without copying the rest of the text.
+- (BOOL)string:(NSString *)string hasPrefix:(NSString *)prefix atLocation:(NSUInteger)location {
+    if ((location > string.length) || (string.length - location < prefix.length)) {
+        return NO;
+    }
+    
+    return [string compare:prefix options:NSLiteralSearch range:NSMakeRange(location, prefix.length)] == NSOrderedSame;
 }
 
 /// https://developer.apple.com/library/archive/documentation/Cocoa/Conceptual/PasteboardGuide106/Articles/pbUpdating105.html
@@ -513,43 +777,140 @@
 /// NSArray *typeArray = [NSArray arrayWithObject:NSURLPboardType];
 /// [pboard declareTypes:typeArray owner:nil]; // 10.5
 /// [pboard writeObjects:fileURLs]; // 10.6
-- (void)replacingClipboardContentsIfApplicable:(NSPasteboard *)pasteboard {
-    if (self.usesSingleLineMode && [pasteboard canReadObjectForClasses:@[[NSString class]] options:@{}]) {
-        NSArray<NSString *> *clipboardContents = [pasteboard readObjectsForClasses:@[[NSString class]] options:@{}];
-        NSMutableArray<NSString *> *replacingContents = [[NSMutableArray alloc] init];
-        
-        for (NSString *content in clipboardContents) {
-            if ([content isKindOfClass:[NSString class]]) {
-                /// Remove all unnecessary whitespace and newline characters in string.
-                NSString *replacingContent = [content stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceAndNewlineCharacterSet]];
-                NSArray *parts = [replacingContent componentsSeparatedByCharactersInSet:[NSCharacterSet whitespaceAndNewlineCharacterSet]];
-                NSArray *filtered = [parts filteredArrayUsingPredicate:[NSPredicate predicateWithFormat:@"SELF != ''"]];
-                
-                replacingContent = [filtered componentsJoinedByString:@" "];
-                
-                [replacingContents addObject:replacingContent];
-            }
-        }
-        
-        if (replacingContents.count > 0) {
-            [pasteboard clearContents];
-            [pasteboard declareTypes:[NSArray arrayWithObject:NSPasteboardTypeString] owner:nil];
-            [pasteboard writeObjects:replacingContents];
-        }
+/// Pastes the plain text of pasteboard flattened to one line by RTEPasteNormalizer, returns NO outside single line mode.
+/// Text up to kPasteChunkLength characters is inserted at once. Longer text is inserted a chunk per run loop turn so the
+/// editor stays responsive, see pasteProgress. Either way the delegate is asked once about the whole normalized text,
+/// and the paste is a single change for the delegate and the undo journal.
+- (BOOL)pasteNormalizedPlainTextFromPasteboard:(NSPasteboard *)pasteboard {
+    if (!self.usesSingleLineMode) {
+        return NO;
+    }
+    
+    if (self.pasteString != nil) {
+        /// The previous paste is still being inserted.
+        return YES;
+    }
+    
+    NSString *string = [[pasteboard readObjectsForClasses:@[[NSString class]] options:@{}] firstObject];
+    
+    if (![string isKindOfClass:[NSString class]]) {
+        return NO;
+    }
+    
+    NSString *normalizedString = [RTEPasteNormalizer normalizedString:string];
+    NSRange selectedRange = [self selectedRange];
+    
+    [self sendDelegatePreviewChangeOfType:RichTextEditorPreviewChangePaste];
+    
+    /// Opens the undo entry, -didChangeText closes it once the last chunk is in.
+    if (![self shouldChangeTextInRange:selectedRange replacementString:normalizedString]) {
+        return YES;
+    }
+    
+    /// Apparently paste as "plain" text doesn't ignore background and foreground colors...
+    NSMutableDictionary *typingAttributes = [[self typingAttributes] mutableCopy];
+    [typingAttributes removeObjectForKey:NSBackgroundColorAttributeName];
+    [typingAttributes removeObjectForKey:NSForegroundColorAttributeName];
+    
+    [self setTypingAttributes:typingAttributes];
+    
+    self.pasteString = normalizedString;
+    self.pastedLength = 0;
+    self.pasteAttributes = typingAttributes;
+    [self insertPasteChunk:[self nextPasteChunk] replacingRange:selectedRange];
+    
+    if (self.pastedLength == normalizedString.length) {
+        [self finishChunkedPaste];
+        return YES;
+    }
+    
+    self.pasteProgress = [NSProgress progressWithTotalUnitCount:normalizedString.length];
+    self.pasteProgress.completedUnitCount = self.pastedLength;
+    self.pasteProgress.cancellable = YES;
+    self.wasEditableBeforePaste = [self isEditable];
+    
+    /// Nothing else may edit the text until the paste is done.
+    [self setEditable:NO];
+    [self performSelector:@selector(insertNextPasteChunk) withObject:nil afterDelay:0 inModes:@[NSRunLoopCommonModes]];
+    
+    return YES;
+}
+
+/// Takes up to kPasteChunkLength more characters of pasteString, fewer to keep composed characters together.
+- (NSString *)nextPasteChunk {
+    NSString *string = self.pasteString;
+    NSUInteger end = MIN(self.pastedLength + kPasteChunkLength, string.length);
+    
+    if (end < string.length) {
+        end = MAX([string rangeOfComposedCharacterSequenceAtIndex:end].location, self.pastedLength + 1);
+    }
+    
+    NSString *chunk = [string substringWithRange:NSMakeRange(self.pastedLength, end - self.pastedLength)];
+    
+    self.pastedLength = end;
+    
+    return chunk;
+}
+
+- (void)insertPasteChunk:(NSString *)chunk replacingRange:(NSRange)range {
+    RTE_TRACE_SCOPE_WITH_ARGUMENT("insert paste chunk", chunk.length);
+    
+    [[self textStorage] replaceCharactersInRange:range withAttributedString:[[NSAttributedString alloc] initWithString:chunk attributes:self.pasteAttributes]];
+    self.pasteInsertionLocation = range.location + chunk.length;
+    [self setSelectedRange:NSMakeRange(self.pasteInsertionLocation, 0)];
+}
+
+- (void)insertNextPasteChunk {
+    if (self.pasteString == nil) {
+        return;
+    }
+    
+    if (!self.pasteProgress.isCancelled) {
+        [self insertPasteChunk:[self nextPasteChunk] replacingRange:NSMakeRange(self.pasteInsertionLocation, 0)];
+        self.pasteProgress.completedUnitCount = self.pastedLength;
+    }
+    
+    if ((self.pastedLength == self.pasteString.length) || self.pasteProgress.isCancelled) {
+        [self finishChunkedPaste];
+    } else {
+        [self performSelector:@selector(insertNextPasteChunk) withObject:nil afterDelay:0 inModes:@[NSRunLoopCommonModes]];
+    }
+}
+
+/// Ends the running paste where it is.
+- (void)finishChunkedPaste {
+    if (self.pasteString == nil) {
+        return;
+    }
+    
+    [NSObject cancelPreviousPerformRequestsWithTarget:self selector:@selector(insertNextPasteChunk) object:nil];
+    self.pasteString = nil;
+    self.pasteAttributes = nil;
+    
+    if (self.pasteProgress != nil) {
+        [self setEditable:self.wasEditableBeforePaste];
+        self.pasteProgress = nil;
     }
+    
+    [self didChangeText];
 }
 
 - (void)paste:(id)sender {
     [self sendDelegatePreviewChangeOfType:RichTextEditorPreviewChangePaste];
     
+    NSPasteboard *pasteboard = [NSPasteboard generalPasteboard];
+    
+    if ([self pasteDocumentFromPasteboard:pasteboard]) {
+        return;
+    }
+    
     if (self.allowsRichTextPasteOnlyFromThisClass) {
-        NSPasteboard *pasteboard = [NSPasteboard generalPasteboard];
-        
         if ([pasteboard dataForType:[[self class] pasteboardDataType]]) {
             [super paste:sender]; // just call paste so we don't have to bother doing the check again
         } else {
-            [self replacingClipboardContentsIfApplicable:pasteboard];
-            [self pasteAsPlainText:self];
+            if (![self pasteNormalizedPlainTextFromPasteboard:pasteboard]) {
+                [self pasteAsPlainText:self];
+            }
         }
     } else {
         [super paste:sender];
@@ -560,12 +921,17 @@
     NSPasteboard *pasteboard = [NSPasteboard generalPasteboard];
     BOOL hasCopyDataFromThisClass = [pasteboard dataForType:[[self class] pasteboardDataType]] != nil;
     
+    if ([self pasteDocumentFromPasteboard:pasteboard]) {
+        return;
+    }
+    
     if (self.allowsRichTextPasteOnlyFromThisClass) {
         if (hasCopyDataFromThisClass) {
             [super pasteAsRichText:sender];
         } else {
-            [self replacingClipboardContentsIfApplicable:pasteboard];
-            [self pasteAsPlainText:sender];
+            if (![self pasteNormalizedPlainTextFromPasteboard:pasteboard]) {
+                [self pasteAsPlainText:sender];
+            }
         }
     } else {
         [super pasteAsRichText:sender];
@@ -586,13 +952,74 @@
 
 - (void)cut:(id)sender {
     [self sendDelegatePreviewChangeOfType:RichTextEditorPreviewChangeCut];
+    
+    NSData *documentData = [self documentDataForSelectedRange];
     [super cut:sender];
+    [self writeDocumentData:documentData toPasteboard:[NSPasteboard generalPasteboard]];
 }
 
 - (void)copy:(id)sender {
     [super copy:sender];
-    NSPasteboard *currentPasteboard = [NSPasteboard generalPasteboard];
-    [currentPasteboard setData:[@"" dataUsingEncoding:NSUTF8StringEncoding] forType:[[self class] pasteboardDataType]];
+    [self writeDocumentData:[self documentDataForSelectedRange] toPasteboard:[NSPasteboard generalPasteboard]];
+}
+
+/// The selected text in the binary document format, nil without a selection.
+- (NSData *)documentDataForSelectedRange {
+    NSRange selectedRange = [self selectedRange];
+    
+    if ((selectedRange.length == 0) || (NSMaxRange(selectedRange) > self.textStorage.length)) {
+        return nil;
+    }
+    
+    return [RTEBinaryDocument dataWithAttributedString:[self.textStorage attributedSubstringFromRange:selectedRange]];
+}
+
+- (void)writeDocumentData:(NSData *)documentData toPasteboard:(NSPasteboard *)pasteboard {
+    if (documentData == nil) {
+        return;
+    }
+    
+    NSString *pasteboardDataType = [[self class] pasteboardDataType];
+    
+    if (![pasteboard.types containsObject:pasteboardDataType]) {
+        [pasteboard addTypes:@[pasteboardDataType] owner:nil];
+    }
+    
+    [pasteboard setData:documentData forType:pasteboardDataType];
+}
+
+/// Inserts a document copied from an editor as is, skipping AppKit's RTF and HTML readers.
+/// Returns NO if the pasteboard holds no valid document, e.g. one written by an older version.
+- (BOOL)pasteDocumentFromPasteboard:(NSPasteboard *)pasteboard {
+    /// Single line editors flatten what is pasted, see -pasteNormalizedPlainTextFromPasteboard:.
+    if (self.usesSingleLineMode) {
+        return NO;
+    }
+    
+    NSData *documentData = [pasteboard dataForType:[[self class] pasteboardDataType]];
+    
+    if (documentData.length == 0) {
+        return NO;
+    }
+    
+    NSError *error = nil;
+    RTEBinaryDocument *document = [[RTEBinaryDocument alloc] initWithData:documentData error:&error];
+    
+    if (document == nil) {
+        NSLog(@"%s [Line %d] failed to read pasteboard document: %@", __PRETTY_FUNCTION__, __LINE__, error);
+        return NO;
+    }
+    
+    NSAttributedString *attributedString = [document attributedString];
+    NSRange selectedRange = [self selectedRange];
+    
+    if ([self shouldChangeTextInRange:selectedRange replacementString:attributedString.string]) {
+        [self.textStorage replaceCharactersInRange:selectedRange withAttributedString:attributedString];
+        [self didChangeText];
+        [self setSelectedRange:NSMakeRange(selectedRange.location + attributedString.length, 0)];
+    }
+    
+    return YES;
 }
 
 #pragma mark -
@@ -615,30 +1042,41 @@
     textFormat.hyperlink = [self.attributedString hyperlinkFromTextRange:[self selectedRange]];
     textFormat.textColor = fontColor;
     textFormat.textBackgroundColor = backgroundColor;
+    textFormat.selectionSummary = [self formatSummaryOfRange:[self selectedRange]];
     
     return textFormat;
 }
 
 - (void)sendDelegateTypingAttrsUpdate {
-    if (self.rteDelegate && ([[self window] firstResponder] == self)) {
+    [self.eventBus postEventOfType:RTEEditorEventTypeTypingAttributesChange detail:0 range:[self selectedRange] changeInLength:0];
+}
+
+- (void)sendDelegateChangedSelection {
+    if (self.rteDelegate && _rteDelegateRespondsTo.changedSelection && ([[self window] firstResponder] == self)) {
         RTETextFormat *textFormat = [self typingTextFormat];
         
-        if (self.rteDelegate && [self.rteDelegate respondsToSelector:@selector(richTextEditor:changedSelectionTo:withFormat:)]) {
-            [self.rteDelegate richTextEditor:self changedSelectionTo:[self selectedRange] withFormat:textFormat];
-        }
+        RTE_TRACE_SCOPE("delegate richTextEditor:changedSelectionTo:withFormat:");
+        [self.rteDelegate richTextEditor:self changedSelectionTo:[self selectedRange] withFormat:textFormat];
     }
 }
 
 - (void)sendDelegateTVChanged {
-    if (self.delegate_interceptor.receiver && [self.delegate_interceptor.receiver respondsToSelector:@selector(textDidChange:)]) {
+    if ([self.delegate_interceptor receiverRespondsToSelector:@selector(textDidChange:)]) {
+        RTE_TRACE_SCOPE("delegate textDidChange:");
         [self.delegate_interceptor.receiver textDidChange:[NSNotification notificationWithName:@"textDidChange:" object:self]];
     }
 }
 
 - (void)sendDelegatePreviewChangeOfType:(RichTextEditorPreviewChange)type {
-    if (self.rteDelegate && [self.rteDelegate respondsToSelector:@selector(richTextEditor:changeAboutToOccurOfType:)]) {
+    /// Marks the user action in the trace, the spans that follow belong to it.
+    RTE_TRACE_INSTANT(RTETraceNameOfPreviewChange(type), type);
+    
+    if (self.rteDelegate && _rteDelegateRespondsTo.changeAboutToOccur) {
+        RTE_TRACE_SCOPE_WITH_ARGUMENT("delegate richTextEditor:changeAboutToOccurOfType:", type);
         [self.rteDelegate richTextEditor:self changeAboutToOccurOfType:type];
     }
+    
+    [self.eventBus postEventOfType:RTEEditorEventTypePreviewChange detail:type range:[self selectedRange] changeInLength:0];
 }
 
 - (void)useSingleLineMode {
@@ -864,33 +1302,8 @@
 }
 
 + (BOOL)isHTML:(NSString *)string {
-    /// https://stackoverflow.com/a/6817767
-    /// /<(\w+)(\s+(\w+)(\s*\=\s*(\'|"|)(.*?)\\5\s*)?)*\s*>/
-    /// Understanding the pattern
-    ///
-    /// If someone is interested in learning more about the pattern, I provide some line:
-    ///
-    /// 1. the first sub-expression (\w+) matches the tag name
-    /// 2. the second sub-expression contains the pattern of an attribute. It is composed by:
-    ///     2.1 one or more whitespaces \s+
-    ///     2.2 the name of the attribute (\w+)
-    ///     2.3 zero or more whitespaces \s* (it is possible or not, leaving blanks here)
-    ///     2.4 the "=" symbol
-    ///     2.5 again, zero or more whitespaces
-    ///     2.6 the delimiter of the attribute value, a single or double quote ('|"). In the pattern, the single quote is escaped because it coincides with the PHP string delimiter. This sub-expression is captured with the parentheses so it can be referenced again to parse the closure of the attribute, that's why it is very important.
-    ///     2.7 the value of the attribute, matched by almost anything: (.*?); in this specific syntax, using the greedy match (the question mark after the asterisk) the RegExp engine enables a "look-ahead"-like operator, which matches anything but what follows this sub-expression
-    ///     2.8 here comes the fun: the \4 part is a backreference operator, which refers to a sub-expression defined before in the pattern, in this case, I am referring to the fourth sub-expression, which is the first attribute delimiter found
-    ///     2.9 zero or more whitespaces \s*
-    ///     2.10 the attribute sub-expression ends here, with the specification of zero or more possible occurrences, given by the asterisk.
-    /// 3. Then, since a tag may end with a whitespace before the ">" symbol, zero or more whitespaces are matched with the \s* subpattern.
-    /// 4. The tag to match may end with a simple ">" symbol, or a possible XHTML closure, which makes use of the slash before it: (/>|>). The slash is, of course, escaped since it coincides with the regular expression delimiter.
-    NSRange range = NSMakeRange(0, [string length]);
-    NSString *pattern = @"<(\\w+)(\\s+(\\w+)(\\s*\\=\\s*(\'|\"|)(.*?)\\5\\s*)?)*\\s*>";
-    NSError  *error = nil;
-    NSRegularExpression *regex = [NSRegularExpression regularExpressionWithPattern:pattern options:0 error:&error];
-    NSArray *matches = [regex matchesInString:string options:0 range:range];
-    
-    return (matches.count > 0);
+    RTE_TRACE_SCOPE("isHTML:");
+    return [RTEHTMLSniffer sniffString:string] != RTEHTMLSnifferResultPlainText;
 }
 
 - (void)setHtmlString:(NSString *)htmlString {
@@ -905,51 +1318,113 @@
     }
 }
 
-- (NSString *)htmlString {
-    return [[self class] htmlStringFromAttributedText:self.attributedString];
-}
-
-+ (NSAttributedString *)encodingNonLossyASCIIAttributedText:(NSAttributedString *)attributedText {
-    NSMutableAttributedString *attributedString = [[NSMutableAttributedString alloc] initWithAttributedString:attributedText];
-    NSString *bulletString = [RTELayoutManager kBulletString];
-    NSString *numberingString = [RTELayoutManager kNumberingString];
-    NSString *encodedBulletString = [RTELayoutManager kEncodedBulletString];
-    NSString *encodedNumberingString = [RTELayoutManager kEncodedNumberingString];
-    __block NSInteger rangeOffset = 0;
+- (void)loadHtmlString:(NSString *)htmlString completion:(void (^)(BOOL))completion {
+    [self cancelHTMLLoad];
     
-    [attributedText enumarateParagraphsInRange:NSMakeRange(0, attributedText.length) withBlock:^(NSRange paragraphRange) {
-        NSRange range = [attributedString firstParagraphRangeFromTextRange:NSMakeRange(paragraphRange.location + rangeOffset, paragraphRange.length)];
-        NSDictionary *dictionary = [attributedString attributesAtIndex:MAX((int)range.location, 0)];
-        NSMutableParagraphStyle *paragraphStyle = [[dictionary objectForKey:NSParagraphStyleAttributeName] mutableCopy];
+    RTEProgressiveHTMLLoader *loader = [[RTEProgressiveHTMLLoader alloc] initWithHTMLString:htmlString defaultAttributes:@{} firstChunkLength:kHTMLLoadFirstChunkLength chunkLength:kHTMLLoadChunkLength];
+    
+    if ((loader == nil) || (loader.numberOfChunks < 2)) {
+        [self setHtmlString:htmlString];
         
-        if (!paragraphStyle) {
-            paragraphStyle = [[NSMutableParagraphStyle alloc] init];
+        if (completion != nil) {
+            completion(YES);
         }
         
-        BOOL currentParagraphHasBullet = [[attributedString.string substringFromIndex:range.location] hasPrefix:bulletString];
+        return;
+    }
+    
+    self.htmlLoader = loader;
+    self.loadProgress = loader.progress;
+    self.wasEditableBeforeLoad = [self isEditable];
+    
+    /// Nothing else may edit the text until the whole document is in.
+    [self setEditable:NO];
+    
+    __weak typeof(self) weakSelf = self;
+    
+    [loader loadWithChunkHandler:^(NSAttributedString *chunk, NSUInteger index, BOOL isLastChunk) {
+        [weakSelf appendLoadedHTMLChunk:chunk atIndex:index];
+    } completion:^(BOOL finished) {
+        RichTextEditor *strongSelf = weakSelf;
+        BOOL failed = !finished && !loader.progress.isCancelled;
+        
+        [strongSelf endHTMLLoad:loader];
         
-        if (currentParagraphHasBullet) {
-            NSMutableAttributedString *replacingString = [[NSMutableAttributedString alloc] initWithString:encodedBulletString attributes:nil];
-            [replacingString setAttributes:dictionary range:NSMakeRange(0, replacingString.string.length)];
-            
-            [attributedString replaceCharactersInRange:NSMakeRange(range.location, bulletString.length) withAttributedString:replacingString];
-            
-            rangeOffset = rangeOffset + replacingString.length - bulletString.length;
+        if (failed) {
+            /// The parser rejected a chunk, the document is converted as a whole instead.
+            [strongSelf setHtmlString:htmlString];
         }
         
-        BOOL currentParagraphHasNumbering = [[attributedString.string substringFromIndex:range.location] hasPrefix:numberingString];
-        
-        if (currentParagraphHasNumbering) {
-            NSMutableAttributedString *replacingString = [[NSMutableAttributedString alloc] initWithString:encodedNumberingString attributes:nil];
-            [replacingString setAttributes:dictionary range:NSMakeRange(0, replacingString.string.length)];
-            
-            [attributedString replaceCharactersInRange:NSMakeRange(range.location, numberingString.length) withAttributedString:replacingString];
-            
-            rangeOffset = rangeOffset + replacingString.length - numberingString.length;
+        if (completion != nil) {
+            completion(finished || failed);
         }
     }];
+}
+
+/// Each chunk is a single edit of the text storage.
+- (void)appendLoadedHTMLChunk:(NSAttributedString *)chunk atIndex:(NSUInteger)index {
+    RTE_TRACE_SCOPE_WITH_ARGUMENT("append html chunk", chunk.length);
     
-    return attributedString;
+    if (index == 0) {
+        [self replaceTextWithAttributedString:chunk];
+        return;
+    }
+    
+    NSTextStorage *textStorage = [self textStorage];
+    
+    [textStorage beginEditing];
+    [textStorage replaceCharactersInRange:NSMakeRange(textStorage.length, 0) withAttributedString:chunk];
+    [textStorage endEditing];
+}
+
+/// Stops the running load where it is, its completion is called with finished NO.
+- (void)cancelHTMLLoad {
+    RTEProgressiveHTMLLoader *loader = self.htmlLoader;
+    
+    if (loader == nil) {
+        return;
+    }
+    
+    [loader.progress cancel];
+    [self endHTMLLoad:loader];
+}
+
+- (void)endHTMLLoad:(RTEProgressiveHTMLLoader *)loader {
+    if (self.htmlLoader != loader) {
+        return;
+    }
+    
+    [self setEditable:self.wasEditableBeforeLoad];
+    self.htmlLoader = nil;
+    self.loadProgress = nil;
+}
+
+- (NSString *)htmlString {
+    NSTextStorage *textStorage = [self textStorage];
+    [textStorage attachIncrementalHTMLExporter];
+    
+    RTEIncrementalHTMLExporter *exporter = [textStorage RTEIncrementalHTMLExporter];
+    
+    /// While the text storage is being edited, the dirty paragraphs are not known yet, the whole text is exported.
+    if (exporter == nil) {
+        return [[self class] htmlStringFromAttributedText:self.attributedString];
+    }
+    
+    RTE_TRACE_SCOPE_WITH_ARGUMENT("htmlString", exporter.numberOfDirtyParagraphs);
+    return [exporter HTMLStringFromAttributedString:textStorage];
+}
+
+- (BOOL)writeHTMLToURL:(NSURL *)url error:(NSError **)error {
+    NSTextStorage *textStorage = [self textStorage];
+    [textStorage attachIncrementalHTMLExporter];
+    
+    RTEIncrementalHTMLExporter *exporter = [textStorage RTEIncrementalHTMLExporter];
+    
+    if (exporter == nil) {
+        return [[[self htmlString] dataUsingEncoding:NSUTF8StringEncoding] writeToURL:url options:NSDataWritingAtomic error:error];
+    }
+    
+    return [exporter writeHTMLFromAttributedString:textStorage toURL:url error:error];
 }
 
 + (NSAttributedString *)decodingNonLossyASCIIAttributedText:(NSAttributedString *)attributedText {
@@ -996,16 +1471,11 @@
 }
 
 + (NSString *)htmlStringFromAttributedText:(NSAttributedString *)attributedText {
+    RTE_TRACE_SCOPE_WITH_ARGUMENT("htmlStringFromAttributedText:", attributedText.length);
     NSString *string = [attributedText.string stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceAndNewlineCharacterSet]];
     
     if (string.length > 0) {
-        NSAttributedString *attributedString = [[self class] encodingNonLossyASCIIAttributedText:attributedText];
-        NSData *data = [attributedString dataFromRange:NSMakeRange(0, attributedString.length)
-                                    documentAttributes:@{NSDocumentTypeDocumentAttribute: NSHTMLTextDocumentType,
-                                                         NSCharacterEncodingDocumentAttribute: [NSNumber numberWithUnsignedInteger:NSUTF8StringEncoding]}
-                                                 error:nil];
-        
-        return [[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding];
+        return [[RTEHTMLSerializer threadSerializer] HTMLStringFromAttributedString:attributedText];
     }
     
     return string;
@@ -1016,7 +1486,17 @@
 }
 
 + (NSAttributedString *)attributedStringFromHTMLString:(NSString *)htmlString defaultAttributes:(NSDictionary<NSAttributedStringKey, id> *)defaultAttributes {
+    RTE_TRACE_SCOPE_WITH_ARGUMENT("attributedStringFromHTMLString:", htmlString.length);
     @try {
+        if ([RTEHTMLParser isExportedHTML:htmlString]) {
+            /// Our own export is converted without WebKit, other HTML falls through to the AppKit importer.
+            NSAttributedString *attributedString = [[[RTEHTMLParser alloc] initWithDefaultAttributes:defaultAttributes] attributedStringFromHTMLString:htmlString];
+            
+            if (attributedString.length > 0) {
+                return attributedString;
+            }
+        }
+        
         if ([[self class] isHTML:htmlString]) {
             NSError *error;
             NSData *data = [htmlString dataUsingEncoding:NSUTF8StringEncoding];
@@ -1046,6 +1526,15 @@
 }
 
 - (void)setAttributedString:(NSAttributedString *)attributedString {
+    [self cancelHTMLLoad];
+    [self replaceTextWithAttributedString:attributedString];
+}
+
+- (void)replaceTextWithAttributedString:(NSAttributedString *)attributedString {
+    [self finishChunkedPaste];
+    /// A new document, the deltas of the old one don't apply to it and the styles it interned aren't kept.
+    [self.undoJournal removeAllEntries];
+    self.styleTable = [[RTEStyleTable alloc] init];
     [[self textStorage] setAttributedString:attributedString];
     [self removeUnexpectedAttributesAtRange:[self selectedRange]];
 }
@@ -1105,46 +1594,38 @@
     if ((formatType != RichTextEditorPreviewChangeBulletedList) && (formatType != RichTextEditorPreviewChangeNumberingList)) return attributedString;
     
     NSString *formatListString = (formatType == RichTextEditorPreviewChangeBulletedList) ? [RTELayoutManager kBulletString] : [RTELayoutManager kNumberingString];
+    NSString *string = attributedText.string;
     CGFloat firstLineHeadIndent = kFirstLineHeadIndent;
-    __block NSInteger rangeOffset = 0;
+    /// Paragraphs with equal styles share one interned paragraph style, and the marker is measured once per character style.
+    RTEStyleTable *styleTable = [[RTEStyleTable alloc] init];
+    NSMutableDictionary<NSNumber *, NSNumber *> *formatListWidths = [[NSMutableDictionary alloc] init];
     
-    [attributedText enumarateParagraphsInRange:NSMakeRange(0, attributedText.length) withBlock:^(NSRange paragraphRange) {
-        NSRange range = NSMakeRange(paragraphRange.location + rangeOffset, paragraphRange.length);
-        NSDictionary *dictionary = [attributedString attributesAtIndex:MAX((int)range.location, 0)];
-        NSMutableParagraphStyle *paragraphStyle = [[dictionary objectForKey:NSParagraphStyleAttributeName] mutableCopy];
-        
-        if (!paragraphStyle) {
-            paragraphStyle = [[NSMutableParagraphStyle alloc] init];
-        }
-        
-        BOOL currentParagraphHasFormatList = [[attributedString.string substringFromIndex:range.location] hasPrefix:formatListString];
+    [attributedString beginEditing];
+    [attributedText enumarateParagraphsInRange:NSMakeRange(0, attributedText.length) withBlock:^(NSRange range) {
+        NSDictionary *dictionary = [attributedString attributesAtIndex:range.location];
+        NSParagraphStyle *paragraphStyle = [dictionary objectForKey:NSParagraphStyleAttributeName] ?: [NSParagraphStyle defaultParagraphStyle];
+        BOOL currentParagraphHasFormatList = [string rangeOfString:formatListString options:(NSAnchoredSearch | NSLiteralSearch) range:NSMakeRange(range.location, string.length - range.location)].location != NSNotFound;
         
         if (currentParagraphHasFormatList) {
-            /// Should remove the old bullet first
-            range = NSMakeRange(range.location, range.length - formatListString.length);
-            [attributedString deleteCharactersInRange:NSMakeRange(range.location, formatListString.length)];
-            paragraphStyle.firstLineHeadIndent = 0;
-            paragraphStyle.headIndent = 0;
-            rangeOffset = rangeOffset - formatListString.length;
-            
-            /// We are adding a bullet
-            range = NSMakeRange(range.location, range.length + formatListString.length);
+            /// The marker takes the attributes of its first character.
+            [attributedString setAttributes:dictionary range:NSMakeRange(range.location, formatListString.length)];
             
-            NSMutableAttributedString *formatListAttributedString = [[NSMutableAttributedString alloc] initWithString:formatListString attributes:nil];
-            [formatListAttributedString setAttributes:dictionary range:NSMakeRange(0, formatListString.length)];
-            
-            [attributedString insertAttributedString:formatListAttributedString atIndex:range.location];
-            
-            CGSize expectedStringSize = [formatListString sizeWithAttributes:dictionary];
+            NSNumber *characterStyleID = @([styleTable characterStyleIDForAttributes:dictionary]);
+            NSNumber *formatListWidth = [formatListWidths objectForKey:characterStyleID];
             
-            paragraphStyle.firstLineHeadIndent = firstLineHeadIndent;
-            paragraphStyle.headIndent = expectedStringSize.width + paragraphStyle.firstLineHeadIndent;
+            if (formatListWidth == nil) {
+                formatListWidth = @([formatListString sizeWithAttributes:dictionary].width);
+                [formatListWidths setObject:formatListWidth forKey:characterStyleID];
+            }
             
-            rangeOffset = rangeOffset + formatListString.length;
+            paragraphStyle = [styleTable paragraphStyle:paragraphStyle withFirstLineHeadIndent:firstLineHeadIndent headIndent:formatListWidth.doubleValue + firstLineHeadIndent];
+        } else {
+            paragraphStyle = [styleTable paragraphStyleForStyleID:[styleTable paragraphStyleIDForParagraphStyle:paragraphStyle]];
         }
         
         [attributedString addAttribute:NSParagraphStyleAttributeName value:paragraphStyle range:range];
     }];
+    [attributedString endEditing];
     
     return attributedString;
 }
@@ -1197,20 +1678,10 @@
     NSRange selectedRange = [self selectedRange];
     
     if (selectedRange.length > 0) {
-        NSInteger start = selectedRange.location;
-        NSInteger end = selectedRange.location + selectedRange.length;
-        NSInteger hyperlinkLength = 0;
+        /// Links can be added to or removed from a selection that is not partly linked.
+        RTEFormatState linkState = RTEFormatSummaryStateOfAttribute([self formatSummaryOfRange:selectedRange], RTEFormatAttributeLink);
         
-        for (NSInteger location = start; location < end; ++location) {
-            NSDictionary *dictionary = [self dictionaryAtIndex:location];
-            NSURL *url = [dictionary objectForKey:NSLinkAttributeName];
-            
-            if (url != nil) {
-                ++hyperlinkLength;
-            }
-        }
-        
-        if ((hyperlinkLength == 0) || (hyperlinkLength == (end - start))) {
+        if (linkState != RTEFormatStateMixed) {
             return YES;
         }
     }
@@ -1231,11 +1702,14 @@
             }
         }
         
-        if (shouldUseUndoManager && [[self undoManager] canUndo]) {
-            [[self undoManager] undo];
+        if (shouldUseUndoManager && [self.undoJournal canUndo]) {
+            [self applyUndoJournal:^BOOL(NSRange *selectedRange) {
+                return [self.undoJournal undoInAttributedString:[self textStorage] selectedRange:selectedRange];
+            }];
         }
     } @catch (NSException *e) {
-        [[self undoManager] removeAllActions];
+        NSLog(@"%s [Line %d] failed with exception: %@", __PRETTY_FUNCTION__, __LINE__, e);
+        [self.undoJournal removeAllEntries];
     }
 }
 
@@ -1251,45 +1725,80 @@
             }
         }
         
-        if (shouldUseUndoManager && [[self undoManager] canRedo]) {
-            [[self undoManager] redo];
+        if (shouldUseUndoManager && [self.undoJournal canRedo]) {
+            [self applyUndoJournal:^BOOL(NSRange *selectedRange) {
+                return [self.undoJournal redoInAttributedString:[self textStorage] selectedRange:selectedRange];
+            }];
         }
     } @catch (NSException *e) {
-        [[self undoManager] removeAllActions];
+        NSLog(@"%s [Line %d] failed with exception: %@", __PRETTY_FUNCTION__, __LINE__, e);
+        [self.undoJournal removeAllEntries];
+    }
+}
+
+/// Runs an undo or redo of the journal as one text storage edit, without the list fix-ups of -textDidChange:.
+- (void)applyUndoJournal:(BOOL (^)(NSRange *selectedRange))block {
+    NSRange selectedRange = [self selectedRange];
+    
+    [[self textStorage] beginEditing];
+    BOOL didChange = block(&selectedRange);
+    [[self textStorage] endEditing];
+    
+    if (didChange) {
+        self.isInTextDidChange = YES;
+        [self setSelectedRange:NSMakeRange(MIN(selectedRange.location, self.string.length), MIN(selectedRange.length, self.string.length - MIN(selectedRange.location, self.string.length)))];
+        [self didChangeText];
+        self.isInTextDidChange = NO;
     }
 }
 
+- (void)undo:(id)sender {
+    [self undo];
+}
+
+- (void)redo:(id)sender {
+    [self redo];
+}
+
+- (BOOL)validateUserInterfaceItem:(id<NSValidatedUserInterfaceItem>)item {
+    if ([item action] == @selector(undo:)) {
+        return [self isEditable] && [self.undoJournal canUndo];
+    } else if ([item action] == @selector(redo:)) {
+        return [self isEditable] && [self.undoJournal canRedo];
+    }
+    
+    return [super validateUserInterfaceItem:item];
+}
+
 - (void)userSelectedParagraphIndentation:(ParagraphIndentation)paragraphIndentation {
     self.isInTextDidChange = YES;
-    __block NSDictionary *dictionary;
-    __block NSMutableParagraphStyle *paragraphStyle;
     NSRange currSelectedRange = [self selectedRange];
     
     [self enumarateThroughParagraphsInRange:[self selectedRange] withBlock:^(NSRange paragraphRange) {
-        dictionary = [self dictionaryAtIndex:paragraphRange.location];
-        paragraphStyle = [[dictionary objectForKey:NSParagraphStyleAttributeName] mutableCopy];
-        
-        if (!paragraphStyle) {
-            paragraphStyle = [[NSMutableParagraphStyle alloc] init];
-        }
+        NSDictionary *dictionary = [self dictionaryAtIndex:paragraphRange.location];
+        NSParagraphStyle *paragraphStyle = [dictionary objectForKey:NSParagraphStyleAttributeName] ?: [NSParagraphStyle defaultParagraphStyle];
+        CGFloat headIndent = paragraphStyle.headIndent;
+        CGFloat firstLineHeadIndent = paragraphStyle.firstLineHeadIndent;
         
         if (paragraphIndentation == ParagraphIndentationIncrease &&
-            paragraphStyle.headIndent < self.MAX_INDENT && paragraphStyle.firstLineHeadIndent < self.MAX_INDENT) {
-            paragraphStyle.headIndent += self.firstLineHeadIndent;
-            paragraphStyle.firstLineHeadIndent += self.firstLineHeadIndent;
+            headIndent < self.MAX_INDENT && firstLineHeadIndent < self.MAX_INDENT) {
+            headIndent += self.firstLineHeadIndent;
+            firstLineHeadIndent += self.firstLineHeadIndent;
         } else if (paragraphIndentation == ParagraphIndentationDecrease) {
-            paragraphStyle.headIndent -= self.firstLineHeadIndent;
-            paragraphStyle.firstLineHeadIndent -= self.firstLineHeadIndent;
+            headIndent -= self.firstLineHeadIndent;
+            firstLineHeadIndent -= self.firstLineHeadIndent;
             
-            if (paragraphStyle.headIndent < 0) {
-                paragraphStyle.headIndent = 0; /// this is the right cursor placement
+            if (headIndent < 0) {
+                headIndent = 0; /// this is the right cursor placement
             }
             
-            if (paragraphStyle.firstLineHeadIndent < 0) {
-                paragraphStyle.firstLineHeadIndent = 0; /// this affects left cursor placement
+            if (firstLineHeadIndent < 0) {
+                firstLineHeadIndent = 0; /// this affects left cursor placement
             }
         }
         
+        /// Equal paragraphs end up with the same interned style instead of one copy each.
+        paragraphStyle = [self.styleTable paragraphStyle:paragraphStyle withFirstLineHeadIndent:firstLineHeadIndent headIndent:headIndent];
         [self applyAttributes:paragraphStyle forKey:NSParagraphStyleAttributeName atRange:paragraphRange];
     }];
     
@@ -1329,18 +1838,10 @@
     [self performBlockWithRestoringScrollLocation:^{
         [self enumarateThroughParagraphsInRange:[self selectedRange] withBlock:^(NSRange paragraphRange) {
             NSDictionary *dictionary = [self dictionaryAtIndex:paragraphRange.location];
-            NSMutableParagraphStyle *paragraphStyle = [[dictionary objectForKey:NSParagraphStyleAttributeName] mutableCopy];
-            
-            if (!paragraphStyle) {
-                paragraphStyle = [[NSMutableParagraphStyle alloc] init];
-            }
-            
-            if (paragraphStyle.headIndent == paragraphStyle.firstLineHeadIndent) {
-                paragraphStyle.firstLineHeadIndent += self.firstLineHeadIndent;
-            } else {
-                paragraphStyle.firstLineHeadIndent = paragraphStyle.headIndent;
-            }
+            NSParagraphStyle *paragraphStyle = [dictionary objectForKey:NSParagraphStyleAttributeName] ?: [NSParagraphStyle defaultParagraphStyle];
+            CGFloat firstLineHeadIndent = (paragraphStyle.headIndent == paragraphStyle.firstLineHeadIndent) ? paragraphStyle.firstLineHeadIndent + self.firstLineHeadIndent : paragraphStyle.headIndent;
             
+            paragraphStyle = [self.styleTable paragraphStyle:paragraphStyle withFirstLineHeadIndent:firstLineHeadIndent headIndent:paragraphStyle.headIndent];
             [self applyAttributes:paragraphStyle forKey:NSParagraphStyleAttributeName atRange:paragraphRange];
         }];
     }];
@@ -1408,85 +1909,74 @@
     NSRange initialSelectedRange = selectedRange;
     NSArray *rangeOfParagraphsInSelectedText = [self.attributedString rangeOfParagraphsFromTextRange:selectedRange];
     NSRange rangeOfCurrentParagraph = [self.attributedString firstParagraphRangeFromTextRange:selectedRange];
-    BOOL firstParagraphHasFormatList = [[self.string substringFromIndex:rangeOfCurrentParagraph.location] hasPrefix:formatListString];
+    NSString *string = self.string;
+    BOOL firstParagraphHasFormatList = [self string:string hasFormatList:formatListString atIndex:rangeOfCurrentParagraph.location];
     
     __block NSInteger rangeOffset = 0;
     __block BOOL mustDecreaseIndentAfterRemovingFormatList = NO;
     __block BOOL isInFormatList = self.inBulletedList || self.inNumberedList;
     
+    /// Plan every paragraph against the unchanged text, then apply the plan as one text storage edit.
+    RTEEditPlan *editPlan = [[RTEEditPlan alloc] initWithBaseLength:[self textStorage].length];
+    
     [self enumarateThroughParagraphsInRange:selectedRange withBlock:^(NSRange paragraphRange) {
-        NSRange range = NSMakeRange(paragraphRange.location + rangeOffset, paragraphRange.length);
-        NSDictionary *dictionary = [self dictionaryAtIndex:MAX((int)range.location, 0)];
-        NSMutableParagraphStyle *paragraphStyle = [[dictionary objectForKey:NSParagraphStyleAttributeName] mutableCopy];
-        
-        if (!paragraphStyle) {
-            paragraphStyle = [[NSMutableParagraphStyle alloc] init];
-        }
-        
-        BOOL currentParagraphHasFormatList = [[self.string substringFromIndex:range.location] hasPrefix:formatListString];
-        BOOL currentParagraphHasOtherFormatList = [[self.string substringFromIndex:range.location] hasPrefix:otherFormatListString];
+        NSDictionary *dictionary = [self dictionaryAtIndex:paragraphRange.location];
+        NSParagraphStyle *paragraphStyle = [dictionary objectForKey:NSParagraphStyleAttributeName] ?: [NSParagraphStyle defaultParagraphStyle];
+        BOOL currentParagraphHasFormatList = [self string:string hasFormatList:formatListString atIndex:paragraphRange.location];
+        BOOL currentParagraphHasOtherFormatList = [self string:string hasFormatList:otherFormatListString atIndex:paragraphRange.location];
         
         if (firstParagraphHasFormatList != currentParagraphHasFormatList) {
+            if (firstParagraphHasFormatList) {
+                /// Removing the list decreases the indentation of the whole selection, see below.
+                paragraphStyle = [self.styleTable paragraphStyle:paragraphStyle withFirstLineHeadIndent:MAX(paragraphStyle.firstLineHeadIndent - self.firstLineHeadIndent, 0) headIndent:MAX(paragraphStyle.headIndent - self.firstLineHeadIndent, 0)];
+                [editPlan addAttribute:NSParagraphStyleAttributeName value:paragraphStyle range:paragraphRange];
+            }
+            
             return;
         }
         
+        NSRange formatListRange = NSMakeRange(paragraphRange.location, 0);
+        
         if (currentParagraphHasOtherFormatList) {
             /// User hit the bullet button and is in a bulleted list so we should get rid of the bullet
-            range = NSMakeRange(range.location, range.length - otherFormatListString.length);
-            
-            [[self textStorage] deleteCharactersInRange:NSMakeRange(range.location, otherFormatListString.length)];
-            
-            paragraphStyle.firstLineHeadIndent = 0;
-            paragraphStyle.headIndent = 0;
-            
+            formatListRange.length = otherFormatListString.length;
             rangeOffset = rangeOffset - otherFormatListString.length;
+            paragraphStyle = [self.styleTable paragraphStyle:paragraphStyle withFirstLineHeadIndent:0 headIndent:0];
         }
         
         if (currentParagraphHasFormatList) {
             /// User hit the bullet button and is in a bulleted list so we should get rid of the bullet
-            range = NSMakeRange(range.location, range.length - formatListString.length);
+            formatListRange.length = formatListString.length;
+            [editPlan replaceCharactersInRange:formatListRange withAttributedString:[[NSAttributedString alloc] init]];
             
-            [[self textStorage] deleteCharactersInRange:NSMakeRange(range.location, formatListString.length)];
-            
-            paragraphStyle.firstLineHeadIndent = 0;
-            paragraphStyle.headIndent = 0;
+            /// The indentation decrease that follows removing a list leaves no indentation.
+            paragraphStyle = [self.styleTable paragraphStyle:paragraphStyle withFirstLineHeadIndent:0 headIndent:0];
             
             rangeOffset = rangeOffset - formatListString.length;
             mustDecreaseIndentAfterRemovingFormatList = YES;
             isInFormatList = NO;
         } else {
-            /// We are adding a bullet
-            range = NSMakeRange(range.location, range.length + formatListString.length);
-            
-            NSMutableAttributedString *formatListAttributedString = [[NSMutableAttributedString alloc] initWithString:formatListString attributes:nil];
-            /// The following code attempts to remove any underline from the bullet string, but it doesn't work right. I don't know why.
-            /*  NSFont *prevFont = [dictionary objectForKey:NSFontAttributeName];
-             NSFont *bulletFont = [NSFont fontWithName:[prevFont familyName] size:[prevFont pointSize]];
-             
-             NSMutableDictionary *bulletDict = [dictionary mutableCopy];
-             [bulletDict setObject:bulletFont forKey:NSFontAttributeName];
-             [bulletDict removeObjectForKey:NSStrikethroughStyleAttributeName];
-             [bulletDict setValue:NSUnderlineStyleNone forKey:NSUnderlineStyleAttributeName];
-             [bulletDict removeObjectForKey:NSStrokeColorAttributeName];
-             [bulletDict removeObjectForKey:NSStrokeWidthAttributeName];
-             dictionary = bulletDict;*/
-            
-            [formatListAttributedString setAttributes:dictionary range:NSMakeRange(0, formatListString.length)];
-            
-            [[self textStorage] insertAttributedString:formatListAttributedString atIndex:range.location];
-            
+            /// We are adding a bullet, in place of the other list marker if there is one
             CGSize expectedStringSize = [formatListString sizeWithAttributes:dictionary];
+            paragraphStyle = [self.styleTable paragraphStyle:paragraphStyle withFirstLineHeadIndent:self.firstLineHeadIndent headIndent:expectedStringSize.width + self.firstLineHeadIndent];
             
-            paragraphStyle.firstLineHeadIndent = self.firstLineHeadIndent;
-            paragraphStyle.headIndent = expectedStringSize.width + paragraphStyle.firstLineHeadIndent;
+            /// The marker carries the new style itself, the range of an empty paragraph maps to nothing below.
+            NSMutableDictionary *formatListAttributes = [dictionary mutableCopy];
+            [formatListAttributes setObject:paragraphStyle forKey:NSParagraphStyleAttributeName];
+            
+            NSAttributedString *formatListAttributedString = [[NSAttributedString alloc] initWithString:formatListString attributes:formatListAttributes];
+            [editPlan replaceCharactersInRange:formatListRange withAttributedString:formatListAttributedString];
             
             rangeOffset = rangeOffset + formatListString.length;
             isInFormatList = YES;
         }
         
-        [[self textStorage] addAttribute:NSParagraphStyleAttributeName value:paragraphStyle range:range];
+        /// The range maps to the paragraph without the removed marker, or with the inserted one.
+        [editPlan addAttribute:NSParagraphStyleAttributeName value:paragraphStyle range:paragraphRange];
     }];
     
+    [editPlan commitToAttributedString:[self textStorage]];
+    
     /// If paragraph is empty move cursor to front of bullet, so the user can start typing right away
     NSRange rangeForSelection;
     if (rangeOfParagraphsInSelectedText.count == 1 && rangeOfCurrentParagraph.length == 0 && isInFormatList) {
@@ -1500,11 +1990,6 @@
         }
     }
     
-    if (mustDecreaseIndentAfterRemovingFormatList) {
-        /// Remove the extra indentation added by the bullet
-        [self userSelectedParagraphIndentation:ParagraphIndentationDecrease];
-    }
-    
     [self setSelectedRange:rangeForSelection];
     [self setNeedsUpdateLayout:YES];
     
@@ -1516,6 +2001,7 @@
 /// Modified from https://stackoverflow.com/a/4833778/3938401
 - (void)changeFontTo:(NSFont *)font {
     NSTextStorage *textStorage = [self textStorage];
+    [self.undoJournal beginEditingInRange:NSMakeRange(0, textStorage.length) ofAttributedString:textStorage selectedRange:[self selectedRange] kind:RTEUndoJournalEditKindCommand];
     [textStorage beginEditing];
     [textStorage enumerateAttributesInRange:NSMakeRange(0, textStorage.length)
                                     options:0
@@ -1533,6 +2019,135 @@
     }];
     
     [textStorage endEditing];
+    [self.undoJournal endEditingOfAttributedString:textStorage selectedRange:[self selectedRange]];
+}
+
+#pragma mark - Document Snapshots -
+
+- (RTEDocumentSnapshot *)documentSnapshot {
+    NSTextStorage *textStorage = [self textStorage];
+    [textStorage attachDocumentSnapshots];
+    
+    /// While the text storage is being edited, the rope is behind, the text is copied instead.
+    return [textStorage RTEDocumentSnapshot] ?: [[RTEDocumentSnapshot alloc] initWithAttributedString:textStorage];
+}
+
+#pragma mark - Format Summary -
+
+- (RTEFormatSummary)formatSummaryOfRange:(NSRange)range {
+    RTEFormatIndex *formatIndex = [[self textStorage] RTEFormatIndex];
+    
+    /// While the text storage is being edited, the index is behind, the runs are walked instead.
+    if (formatIndex == nil) {
+        return [RTEFormatIndex summaryOfRange:range inAttributedString:[self textStorage]];
+    }
+    
+    return [formatIndex summaryOfRange:range];
+}
+
+#pragma mark - Find and Replace -
+
+- (void)enumerateMatchesOfString:(NSString *)query options:(RTESearchOptions)options usingBlock:(void (^)(NSRange matchRange, BOOL *stop))block {
+    NSTextStorage *textStorage = [self textStorage];
+    [textStorage attachSearchIndex];
+    
+    /// The index is unavailable while the text storage is editing, a temporary one gives the same matches.
+    RTESearchIndex *searchIndex = [textStorage RTESearchIndex] ?: [[RTESearchIndex alloc] initWithString:textStorage.string];
+    
+    [searchIndex enumerateMatchesOfString:query inString:textStorage.string options:options range:NSMakeRange(0, textStorage.length) usingBlock:block];
+}
+
+- (BOOL)findNextOccurrenceOfString:(NSString *)query options:(RTESearchOptions)options {
+    NSTextStorage *textStorage = [self textStorage];
+    [textStorage attachSearchIndex];
+    
+    RTESearchIndex *searchIndex = [textStorage RTESearchIndex] ?: [[RTESearchIndex alloc] initWithString:textStorage.string];
+    NSUInteger location = MIN(NSMaxRange([self selectedRange]), textStorage.length);
+    NSRange matchRange = [searchIndex rangeOfString:query inString:textStorage.string options:options range:NSMakeRange(location, textStorage.length - location)];
+    
+    if (matchRange.location == NSNotFound) {
+        matchRange = [searchIndex rangeOfString:query inString:textStorage.string options:options range:NSMakeRange(0, textStorage.length)];
+    }
+    
+    if (matchRange.location == NSNotFound) {
+        return NO;
+    }
+    
+    [self setSelectedRange:matchRange];
+    [self scrollRangeToVisible:matchRange];
+    
+    return YES;
+}
+
+- (NSUInteger)replaceAllOccurrencesOfString:(NSString *)query withString:(NSString *)replacement options:(RTESearchOptions)options {
+    RTE_TRACE_SCOPE("replace all");
+    
+    if (!self.isEditable) {
+        return 0;
+    }
+    
+    NSTextStorage *textStorage = [self textStorage];
+    NSString *string = textStorage.string;
+    RTEEditPlan *editPlan = [[RTEEditPlan alloc] initWithBaseLength:textStorage.length];
+    NSMutableArray<NSValue *> *matchRanges = [[NSMutableArray alloc] init];
+    __block NSRange changedRange = NSMakeRange(NSNotFound, 0);
+    
+    /// Matches are collected against the unchanged text, the plan applies them back to front in a single edit.
+    [self enumerateMatchesOfString:query options:options usingBlock:^(NSRange matchRange, BOOL *stop) {
+        if ((matchRange.length == 0) || [self range:matchRange includesFormatListMarkerOfString:string]) {
+            return;
+        }
+        
+        NSDictionary *attributes = [textStorage attributesAtIndex:matchRange.location effectiveRange:NULL];
+        [editPlan replaceCharactersInRange:matchRange withAttributedString:[[NSAttributedString alloc] initWithString:replacement attributes:attributes]];
+        [matchRanges addObject:[NSValue valueWithRange:matchRange]];
+        changedRange = (changedRange.location == NSNotFound) ? matchRange : NSUnionRange(changedRange, matchRange);
+    }];
+    
+    if (editPlan.numberOfReplacements == 0) {
+        return 0;
+    }
+    
+    /// What the covering range reads once every match in it is replaced, for the delegate and the undo journal.
+    NSMutableString *replacementString = [[string substringWithRange:changedRange] mutableCopy];
+    
+    for (NSValue *matchRange in [matchRanges reverseObjectEnumerator]) {
+        NSRange range = matchRange.rangeValue;
+        [replacementString replaceCharactersInRange:NSMakeRange(range.location - changedRange.location, range.length) withString:replacement];
+    }
+    
+    [self sendDelegatePreviewChangeOfType:RichTextEditorPreviewChangeFindReplace];
+    
+    if (![self shouldChangeTextInRange:changedRange replacementString:replacementString]) {
+        return 0;
+    }
+    
+    [editPlan commitToAttributedString:textStorage];
+    [self didChangeText];
+    
+    /// didChangeText already told the delegate through -textDidChange:.
+    [self setSelectedRange:NSMakeRange([editPlan mappedLocation:NSMaxRange(changedRange)], 0)];
+    
+    return editPlan.numberOfReplacements;
+}
+
+/// YES if range holds a bullet or numbering marker, or the non-breaking space after one.
+- (BOOL)range:(NSRange)range includesFormatListMarkerOfString:(NSString *)string {
+    for (NSUInteger i = range.location; i < NSMaxRange(range); i++) {
+        unichar character = [string characterAtIndex:i];
+        
+        if ((character == 0x10) || (character == 0x11)) {
+            return YES;
+        }
+    }
+    
+    if ((range.location > 0) && ([string characterAtIndex:range.location] == 0xA0)) {
+        unichar previousCharacter = [string characterAtIndex:range.location - 1];
+        
+        return (previousCharacter == 0x10) || (previousCharacter == 0x11);
+    }
+    
+    return NO;
 }
 
 #pragma mark - Private Methods -
@@ -1553,8 +2168,10 @@
     NSScrollView *scrollView = self.enclosingScrollView;
     NSPoint currentScrollPosition = [[scrollView contentView] bounds].origin;
     
-    block();
-    [self removeUnexpectedAttributesAtRange:[self selectedRange]];
+    [self performUndoableEditInRange:[self selectedRange] withBlock:^{
+        block();
+        [self removeUnexpectedAttributesAtRange:[self selectedRange]];
+    }];
     
     NSPoint scrollPosition = [[scrollView contentView] bounds].origin;
     
@@ -1627,7 +2244,7 @@
     [[self textStorage] beginEditing];
     [[self textStorage] enumarateParagraphsInRange:selectedRange withBlock:^(NSRange paragraphRange) {
         NSRange range = [[self textStorage] firstParagraphRangeFromTextRange:NSMakeRange(paragraphRange.location + rangeOffset, paragraphRange.length)];
-        BOOL currentParagraphHasBullet = [[[self textStorage].string substringFromIndex:range.location] hasPrefix:bulletString];
+        BOOL currentParagraphHasBullet = [self string:[self textStorage].string hasFormatList:bulletString atIndex:range.location];
         
         if (currentParagraphHasBullet) {
             rangeOffset = rangeOffset + bulletString.length;
@@ -1644,7 +2261,7 @@
             }
         }
         
-        BOOL currentParagraphHasNumbering = [[[self textStorage].string substringFromIndex:range.location] hasPrefix:numberingString];
+        BOOL currentParagraphHasNumbering = [self string:[self textStorage].string hasFormatList:numberingString atIndex:range.location];
         
         if (currentParagraphHasNumbering) {
             rangeOffset = rangeOffset + numberingString.length;
@@ -1665,6 +2282,15 @@
     [self setSelectedRange:effectiveRange];
 }
 
+/// Compares in place instead of copying the rest of the text for -hasPrefix:.
+- (BOOL)string:(NSString *)string hasFormatList:(NSString *)formatListString atIndex:(NSUInteger)index {
+    if (index >= string.length) {
+        return NO;
+    }
+    
+    return [string rangeOfString:formatListString options:(NSAnchoredSearch | NSLiteralSearch) range:NSMakeRange(index, string.length - index)].location != NSNotFound;
+}
+
 - (void)updateTypingAttributes {
     /// http://stackoverflow.com/questions/11835497/nstextview-not-applying-attributes-to-newly-inserted-text
     NSArray *selectedRanges = [self selectedRanges];
@@ -1772,13 +2398,15 @@
 
 /// By default, if this function is called with nothing selected, it will resize all text.
 - (void)changeFontSizeWithOperation:(CGFloat(^)(CGFloat currFontSize))operation {
-    [[self textStorage] beginEditing];
     NSRange range = [self selectedRange];
     
     if (range.length == 0) {
         range = NSMakeRange(0, [self textStorage].length);
     }
     
+    [self.undoJournal beginEditingInRange:range ofAttributedString:[self textStorage] selectedRange:[self selectedRange] kind:RTEUndoJournalEditKindCommand];
+    [[self textStorage] beginEditing];
+    
     [[self textStorage] enumerateAttributesInRange:range
                                            options:NSAttributedStringEnumerationLongestEffectiveRangeNotRequired
                                         usingBlock:^(NSDictionary *dictionary, NSRange range, BOOL *stop) {
@@ -1806,6 +2434,7 @@
     }];
     
     [[self textStorage] endEditing];
+    [self.undoJournal endEditingOfAttributedString:[self textStorage] selectedRange:[self selectedRange]];
     [self updateTypingAttributes];
 }
 
@@ -1896,8 +2525,8 @@
     
     NSString *bulletString = [RTELayoutManager kBulletString];
     NSString *numberingString = [RTELayoutManager kNumberingString];
-    BOOL inBulletedList = [[self.string substringFromIndex:begin] hasPrefix:bulletString];
-    BOOL inNumberedList = [[self.string substringFromIndex:begin] hasPrefix:numberingString];
+    BOOL inBulletedList = [self string:self.string hasPrefix:bulletString atLocation:begin];
+    BOOL inNumberedList = [self string:self.string hasPrefix:numberingString atLocation:begin];
     BOOL hasFormatListInFront = inBulletedList || inNumberedList;
     
     if (hasFormatListInFront) {
@@ -2148,6 +2777,7 @@
 
 - (void)mouseDown:(NSEvent *)theEvent {
     _lastSingleKeyPressed = 0;
+    [self.undoJournal breakCoalescing];
     [self sendDelegatePreviewChangeOfType:RichTextEditorPreviewChangeMouseDown];
     [super mouseDown:theEvent];
 }
@@ -2236,6 +2866,7 @@
         if (keyChar == NSLeftArrowFunctionKey || keyChar == NSRightArrowFunctionKey ||
             keyChar == NSUpArrowFunctionKey || keyChar == NSDownArrowFunctionKey) {
             [self sendDelegatePreviewChangeOfType:RichTextEditorPreviewChangeArrowKey];
+            [self.undoJournal breakCoalescing];
             [super keyDown:event];
         } else if ((keyChar == 'b' || keyChar == 'B') && commandKeyDown && !shiftKeyDown &&
                    (enabledShortcuts == RichTextEditorShortcutAll || enabledShortcuts & RichTextEditorShortcutBold)) {
@@ -2270,7 +2901,7 @@
         } else if (self.tabKeyAlwaysIndentsOutdents && (keyChar == '\t' || keyChar == 25) && !commandKeyDown && shiftKeyDown &&
                    (enabledShortcuts == RichTextEditorShortcutAll || enabledShortcuts & RichTextEditorShortcutIncreaseIndent)) {
             [self userSelectedDecreaseIndent];
-        } else if (!([self.rteDelegate respondsToSelector:@selector(richTextEditor:keyDownEvent:)] && [self.rteDelegate richTextEditor:self keyDownEvent:event])) {
+        } else if (!(_rteDelegateRespondsTo.keyDownEvent && [self.rteDelegate richTextEditor:self keyDownEvent:event])) {
             [self sendDelegatePreviewChangeOfType:RichTextEditorPreviewChangeKeyDown];
             [super keyDown:event];
         }
@@ -0,0 +1,48 @@
+//
+//  RTESearchIndex.h
+//  RichTextEditor
+//
+//  Created by lam1611 on 10/18/26.
+//
+
+#import <Cocoa/Cocoa.h>
+
+typedef NS_OPTIONS(NSUInteger, RTESearchOptions) {
+    RTESearchOptionCaseInsensitive          = 1 << 0,
+    RTESearchOptionDiacriticInsensitive     = 1 << 1,
+};
+
+/// A trigram index of a string for finding text without scanning all of it.
+///
+/// The string is split into blocks of about a thousand characters, each with a 4096 bit signature of the trigrams starting
+/// in it, taken from the text folded for case, diacritics and width. A search only compares the blocks whose signatures,
+/// together with the next block's, hold every trigram of the folded query, so a miss costs a few words per block.
+/// Queries shorter than three folded characters scan the range.
+/// An edit delta refolds the blocks around the edit only, the blocks after it are just shifted.
+@interface RTESearchIndex : NSObject
+
+/// Length of the indexed string.
+@property (nonatomic, readonly) NSUInteger length;
+@property (nonatomic, readonly) NSUInteger numberOfBlocks;
+
+- (instancetype _Nonnull)initWithString:(NSString *_Nonnull)string;
+
+/// Applies an edit delta: the characters in range of the indexed string were replaced with replacement, giving string.
+- (void)replaceCharactersInRange:(NSRange)range withString:(NSString *_Nonnull)replacement resultingString:(NSString *_Nonnull)string;
+
+/// Enumerates the matches of query in range of string, the indexed string, in order and without overlaps, until stop is set.
+/// A match may be up to four times as long as the query, e.g. decomposed accents matching a diacritic insensitive query.
+- (void)enumerateMatchesOfString:(NSString *_Nonnull)query inString:(NSString *_Nonnull)string options:(RTESearchOptions)options range:(NSRange)range usingBlock:(void (^_Nonnull)(NSRange matchRange, BOOL *_Nonnull stop))block;
+/// The first match in range, {NSNotFound, 0} if there is none.
+- (NSRange)rangeOfString:(NSString *_Nonnull)query inString:(NSString *_Nonnull)string options:(RTESearchOptions)options range:(NSRange)range;
+
+@end
+
+@interface NSTextStorage (RTESearchIndex)
+
+/// Builds a search index for the receiver and keeps it in sync with every character edit.
+- (void)attachSearchIndex;
+/// The search index of the receiver, nil if none attached or while characters are being edited.
+- (RTESearchIndex *_Nullable)RTESearchIndex;
+
+@end
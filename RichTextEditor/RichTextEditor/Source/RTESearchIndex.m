@@ -0,0 +1,354 @@
+//
+//  RTESearchIndex.m
+//  RichTextEditor
+//
+//  Created by lam1611 on 10/18/26.
+//
+
+#import "RTESearchIndex.h"
+
+#import <objc/runtime.h>
+
+#import "RTETrace.h"
+
+static const NSUInteger kBlockLength = 1024;
+static const NSUInteger kSignatureWords = 64;
+static const NSUInteger kSignatureBits = kSignatureWords * 64;
+/// A block's signature reads this far into the next block, so it holds every trigram starting in the block.
+static const NSUInteger kTrigramOverlap = 2;
+static const NSUInteger kMaximumMatchLengthFactor = 4;
+static const CFStringCompareFlags kFoldFlags = kCFCompareCaseInsensitive | kCFCompareDiacriticInsensitive | kCFCompareWidthInsensitive;
+static const void *kSearchIndexKey = &kSearchIndexKey;
+
+typedef struct {
+    NSUInteger location;
+    NSUInteger length;
+    uint64_t signature[kSignatureWords];
+} RTESearchBlock;
+
+static inline NSUInteger RTETrigramBit(const unichar *characters) {
+    uint64_t trigram = ((uint64_t)characters[0] << 32) | ((uint64_t)characters[1] << 16) | characters[2];
+    
+    return (NSUInteger)((trigram * 0x9E3779B97F4A7C15ULL) >> (64 - 12)) & (kSignatureBits - 1);
+}
+
+/// The characters of text folded for case, diacritics and width, to be freed by the caller.
+static unichar *RTECopyFoldedCharacters(NSString *text, NSUInteger *length) {
+    NSMutableString *folded = [text mutableCopy];
+    CFStringFold((__bridge CFMutableStringRef)folded, kFoldFlags, NULL);
+    
+    unichar *characters = malloc(MAX(folded.length, 1) * sizeof(unichar));
+    [folded getCharacters:characters range:NSMakeRange(0, folded.length)];
+    *length = folded.length;
+    
+    return characters;
+}
+
+/// Up to capacity trigram bits of the folded text, returns the number written to bits.
+static NSUInteger RTEFoldedTrigramBits(NSString *text, NSUInteger *bits, NSUInteger capacity) {
+    NSUInteger length = 0;
+    unichar *characters = RTECopyFoldedCharacters(text, &length);
+    NSUInteger count = (length >= 3) ? MIN(length - 2, capacity) : 0;
+    
+    for (NSUInteger i = 0; i < count; i++) {
+        bits[i] = RTETrigramBit(characters + i);
+    }
+    
+    free(characters);
+    
+    return count;
+}
+
+@interface RTESearchIndex () {
+    RTESearchBlock *_blocks;
+    NSUInteger _numberOfBlocks;
+    NSUInteger _capacity;
+    NSUInteger _length;
+}
+
+@property (nonatomic, unsafe_unretained) NSTextStorage *textStorage;
+
+@end
+
+@implementation RTESearchIndex
+
+#pragma mark - Initialization -
+
+- (instancetype)initWithString:(NSString *)string {
+    if (self = [super init]) {
+        [self rebuildWithString:string];
+    }
+    
+    return self;
+}
+
+- (void)dealloc {
+    if (self.textStorage != nil) {
+        [[NSNotificationCenter defaultCenter] removeObserver:self name:NSTextStorageDidProcessEditingNotification object:self.textStorage];
+    }
+    
+    free(_blocks);
+}
+
+#pragma mark - Public Methods -
+
+- (NSUInteger)length {
+    return _length;
+}
+
+- (NSUInteger)numberOfBlocks {
+    return _numberOfBlocks;
+}
+
+- (void)replaceCharactersInRange:(NSRange)range withString:(NSString *)replacement resultingString:(NSString *)string {
+    NSInteger delta = (NSInteger)replacement.length - (NSInteger)range.length;
+    
+    if ((_numberOfBlocks == 0) || (NSMaxRange(range) > _length) || ((NSInteger)_length + delta != (NSInteger)string.length)) {
+        [self rebuildWithString:string];
+        return;
+    }
+    
+    /// The previous block's signature reads into the edit as well.
+    NSUInteger first = [self blockIndexAtLocation:range.location];
+    first = (first > 0) ? first - 1 : 0;
+    NSUInteger last = [self blockIndexAtLocation:NSMaxRange(range)];
+    
+    /// Deletions shrink blocks, a small one is merged into the next.
+    if ((last + 1 < _numberOfBlocks) && (_blocks[last].length < kBlockLength / 4)) {
+        last += 1;
+    }
+    
+    NSUInteger regionStart = _blocks[first].location;
+    NSUInteger regionEnd = _blocks[last].location + _blocks[last].length;
+    NSUInteger regionLength = (NSUInteger)((NSInteger)(regionEnd - regionStart) + delta);
+    
+    for (NSUInteger i = last + 1; i < _numberOfBlocks; i++) {
+        _blocks[i].location = (NSUInteger)((NSInteger)_blocks[i].location + delta);
+    }
+    
+    _length = string.length;
+    [self replaceBlocksInRange:NSMakeRange(first, last - first + 1) withBlocksCoveringRange:NSMakeRange(regionStart, regionLength) ofString:string];
+}
+
+- (void)enumerateMatchesOfString:(NSString *)query inString:(NSString *)string options:(RTESearchOptions)options range:(NSRange)range usingBlock:(void (^)(NSRange matchRange, BOOL *stop))block {
+    NSUInteger length = string.length;
+    
+    if ((query.length == 0) || (range.location >= length)) {
+        return;
+    }
+    
+    RTE_TRACE_SCOPE_WITH_ARGUMENT("search", query.length);
+    range.length = MIN(range.length, length - range.location);
+    
+    NSStringCompareOptions compareOptions = 0;
+    
+    if ((options & RTESearchOptionCaseInsensitive) != 0) {
+        compareOptions |= NSCaseInsensitiveSearch;
+    }
+    
+    if ((options & RTESearchOptionDiacriticInsensitive) != 0) {
+        compareOptions |= NSDiacriticInsensitiveSearch;
+    }
+    
+    NSUInteger queryBits[64];
+    NSUInteger numberOfQueryBits = (length == _length) ? RTEFoldedTrigramBits(query, queryBits, 64) : 0;
+    NSUInteger end = NSMaxRange(range);
+    NSUInteger searchLocation = range.location;
+    BOOL stop = NO;
+    
+    if (numberOfQueryBits == 0) {
+        /// Nothing to filter with, the whole range is a candidate.
+        [self enumerateMatchesOfString:query inString:string options:compareOptions acceptingRange:range searchLocation:&searchLocation stop:&stop usingBlock:block];
+        return;
+    }
+    
+    NSUInteger lookAhead = query.length * kMaximumMatchLengthFactor;
+    
+    for (NSUInteger i = [self blockIndexAtLocation:range.location]; (i < _numberOfBlocks) && (_blocks[i].location < end) && !stop; i++) {
+        if (![self blockAtIndex:i containsBits:queryBits count:numberOfQueryBits]) {
+            continue;
+        }
+        
+        /// Matches are reported by the block they start in, they can end in the following ones.
+        NSUInteger start = MAX(_blocks[i].location, searchLocation);
+        NSUInteger acceptEnd = MIN(NSMaxRange(NSMakeRange(_blocks[i].location, _blocks[i].length)), end);
+        
+        if (start >= acceptEnd) {
+            continue;
+        }
+        
+        NSRange acceptingRange = NSMakeRange(start, acceptEnd - start);
+        searchLocation = start;
+        [self enumerateMatchesOfString:query inString:string options:compareOptions acceptingRange:acceptingRange searchEnd:MIN(acceptEnd + lookAhead, end) searchLocation:&searchLocation stop:&stop usingBlock:block];
+    }
+}
+
+- (NSRange)rangeOfString:(NSString *)query inString:(NSString *)string options:(RTESearchOptions)options range:(NSRange)range {
+    __block NSRange firstRange = NSMakeRange(NSNotFound, 0);
+    
+    [self enumerateMatchesOfString:query inString:string options:options range:range usingBlock:^(NSRange matchRange, BOOL *stop) {
+        firstRange = matchRange;
+        *stop = YES;
+    }];
+    
+    return firstRange;
+}
+
+#pragma mark - Helper Methods -
+
+- (void)rebuildWithString:(NSString *)string {
+    RTE_TRACE_SCOPE_WITH_ARGUMENT("build search index", string.length);
+    
+    _numberOfBlocks = 0;
+    _length = string.length;
+    [self replaceBlocksInRange:NSMakeRange(0, 0) withBlocksCoveringRange:NSMakeRange(0, string.length) ofString:string];
+}
+
+/// Index of the block containing location, the last block for the end of the string.
+- (NSUInteger)blockIndexAtLocation:(NSUInteger)location {
+    NSUInteger lower = 0;
+    NSUInteger upper = _numberOfBlocks;
+    
+    while (upper - lower > 1) {
+        NSUInteger middle = lower + (upper - lower) / 2;
+        
+        if (_blocks[middle].location <= location) {
+            lower = middle;
+        } else {
+            upper = middle;
+        }
+    }
+    
+    return lower;
+}
+
+- (BOOL)blockAtIndex:(NSUInteger)index containsBits:(const NSUInteger *)bits count:(NSUInteger)count {
+    const uint64_t *signature = _blocks[index].signature;
+    const uint64_t *nextSignature = (index + 1 < _numberOfBlocks) ? _blocks[index + 1].signature : NULL;
+    
+    for (NSUInteger i = 0; i < count; i++) {
+        uint64_t word = signature[bits[i] / 64];
+        
+        /// A match starting here can end in the next block, with its last trigrams in the next signature.
+        if (nextSignature != NULL) {
+            word |= nextSignature[bits[i] / 64];
+        }
+        
+        if ((word & (1ULL << (bits[i] % 64))) == 0) {
+            return NO;
+        }
+    }
+    
+    return YES;
+}
+
+/// Splits range of string into even blocks of at most kBlockLength characters, signs them and puts them in place of blockRange.
+- (void)replaceBlocksInRange:(NSRange)blockRange withBlocksCoveringRange:(NSRange)range ofString:(NSString *)string {
+    NSUInteger count = (range.length + kBlockLength - 1) / kBlockLength;
+    NSUInteger numberOfBlocks = _numberOfBlocks - blockRange.length + count;
+    
+    if (numberOfBlocks > _capacity) {
+        _capacity = MAX(numberOfBlocks, _capacity * 2);
+        _blocks = realloc(_blocks, _capacity * sizeof(RTESearchBlock));
+    }
+    
+    memmove(_blocks + blockRange.location + count, _blocks + NSMaxRange(blockRange), (_numberOfBlocks - NSMaxRange(blockRange)) * sizeof(RTESearchBlock));
+    _numberOfBlocks = numberOfBlocks;
+    
+    NSUInteger location = range.location;
+    
+    for (NSUInteger i = 0; i < count; i++) {
+        RTESearchBlock *block = &_blocks[blockRange.location + i];
+        NSUInteger length = range.length / count + ((i < range.length % count) ? 1 : 0);
+        
+        block->location = location;
+        block->length = length;
+        [self signBlock:block ofString:string];
+        location += length;
+    }
+    
+    /// The region is gone, the block before it now reads into the block after it.
+    if ((count == 0) && (blockRange.location > 0)) {
+        [self signBlock:&_blocks[blockRange.location - 1] ofString:string];
+    }
+}
+
+- (void)signBlock:(RTESearchBlock *)block ofString:(NSString *)string {
+    NSUInteger length = MIN(block->length + kTrigramOverlap, string.length - block->location);
+    NSUInteger foldedLength = 0;
+    unichar *characters = RTECopyFoldedCharacters([string substringWithRange:NSMakeRange(block->location, length)], &foldedLength);
+    
+    memset(block->signature, 0, sizeof(block->signature));
+    
+    for (NSUInteger i = 0; i + 2 < foldedLength; i++) {
+        NSUInteger bit = RTETrigramBit(characters + i);
+        block->signature[bit / 64] |= 1ULL << (bit % 64);
+    }
+    
+    free(characters);
+}
+
+- (void)enumerateMatchesOfString:(NSString *)query inString:(NSString *)string options:(NSStringCompareOptions)options acceptingRange:(NSRange)range searchLocation:(NSUInteger *)searchLocation stop:(BOOL *)stop usingBlock:(void (^)(NSRange matchRange, BOOL *stop))block {
+    [self enumerateMatchesOfString:query inString:string options:options acceptingRange:range searchEnd:NSMaxRange(range) searchLocation:searchLocation stop:stop usingBlock:block];
+}
+
+/// Reports the matches starting in range, searching up to searchEnd. searchLocation is moved past each match so the next
+/// search doesn't report an overlapping one.
+- (void)enumerateMatchesOfString:(NSString *)query inString:(NSString *)string options:(NSStringCompareOptions)options acceptingRange:(NSRange)range searchEnd:(NSUInteger)searchEnd searchLocation:(NSUInteger *)searchLocation stop:(BOOL *)stop usingBlock:(void (^)(NSRange matchRange, BOOL *stop))block {
+    NSUInteger location = MAX(range.location, *searchLocation);
+    
+    while ((location < NSMaxRange(range)) && !*stop) {
+        NSRange matchRange = [string rangeOfString:query options:options range:NSMakeRange(location, searchEnd - location)];
+        
+        if ((matchRange.location == NSNotFound) || (matchRange.location >= NSMaxRange(range))) {
+            break;
+        }
+        
+        block(matchRange, stop);
+        location = MAX(NSMaxRange(matchRange), matchRange.location + 1);
+        *searchLocation = location;
+    }
+}
+
+- (void)textStorageDidProcessEditing:(NSNotification *)notification {
+    NSTextStorage *textStorage = notification.object;
+    
+    if (([textStorage editedMask] & NSTextStorageEditedCharacters) == 0) {
+        return;
+    }
+    
+    /// The edited range covers the new characters, the replaced ones were changeInLength shorter or longer.
+    NSRange editedRange = [textStorage editedRange];
+    NSRange replacedRange = NSMakeRange(editedRange.location, editedRange.length - [textStorage changeInLength]);
+    
+    [self replaceCharactersInRange:replacedRange withString:[textStorage.string substringWithRange:editedRange] resultingString:textStorage.string];
+}
+
+@end
+
+@implementation NSTextStorage (RTESearchIndex)
+
+- (void)attachSearchIndex {
+    if (objc_getAssociatedObject(self, kSearchIndexKey) != nil) {
+        return;
+    }
+    
+    RTESearchIndex *searchIndex = [[RTESearchIndex alloc] initWithString:self.string];
+    searchIndex.textStorage = self;
+    
+    [[NSNotificationCenter defaultCenter] addObserver:searchIndex selector:@selector(textStorageDidProcessEditing:) name:NSTextStorageDidProcessEditingNotification object:self];
+    objc_setAssociatedObject(self, kSearchIndexKey, searchIndex, OBJC_ASSOCIATION_RETAIN_NONATOMIC);
+}
+
+- (RTESearchIndex *)RTESearchIndex {
+    RTESearchIndex *searchIndex = objc_getAssociatedObject(self, kSearchIndexKey);
+    
+    /// While characters are being edited, the index still describes the string before the edit.
+    if ((searchIndex == nil) || (([self editedMask] & NSTextStorageEditedCharacters) != 0) || (searchIndex.length != self.length)) {
+        return nil;
+    }
+    
+    return searchIndex;
+}
+
+@end
@@ -0,0 +1,65 @@
+//
+//  RTEStyleTable.h
+//  RichTextEditor
+//
+//  Created by lam1611 on 10/18/26.
+//
+
+#import <Cocoa/Cocoa.h>
+
+typedef uint32_t RTEStyleID;
+
+/// The character style of a run without attributes, and the paragraph style of a paragraph without NSParagraphStyleAttributeName.
+extern const RTEStyleID RTEStyleIDNone;
+
+/// Interns character styles (all attributes but the paragraph style) and paragraph styles, each behind a compact integer ID.
+/// Equal styles get the same ID and share one instance, so comparing styles is comparing IDs.
+/// Not thread-safe, use one table per thread.
+@interface RTEStyleTable : NSObject
+
+@property (nonatomic, assign, readonly) NSUInteger numberOfCharacterStyles;
+@property (nonatomic, assign, readonly) NSUInteger numberOfParagraphStyles;
+
+/// Ignores NSParagraphStyleAttributeName.
+- (RTEStyleID)characterStyleIDForAttributes:(NSDictionary<NSAttributedStringKey, id> *_Nullable)attributes;
+- (RTEStyleID)paragraphStyleIDForParagraphStyle:(NSParagraphStyle *_Nullable)paragraphStyle;
+/// Splits attributes into both IDs, interning each distinct dictionary once.
+- (void)getCharacterStyleID:(RTEStyleID *_Nonnull)characterStyleID paragraphStyleID:(RTEStyleID *_Nonnull)paragraphStyleID forAttributes:(NSDictionary<NSAttributedStringKey, id> *_Nullable)attributes;
+
+- (NSDictionary<NSAttributedStringKey, id> *_Nonnull)characterAttributesForStyleID:(RTEStyleID)styleID;
+- (NSParagraphStyle *_Nullable)paragraphStyleForStyleID:(RTEStyleID)styleID;
+/// The shared dictionary combining both styles.
+- (NSDictionary<NSAttributedStringKey, id> *_Nonnull)attributesForCharacterStyleID:(RTEStyleID)characterStyleID paragraphStyleID:(RTEStyleID)paragraphStyleID;
+
+/// The interned copy of paragraphStyle with both indents replaced. The result is memoized per style and indents,
+/// so restyling many equal paragraphs copies the style once.
+- (NSParagraphStyle *_Nonnull)paragraphStyle:(NSParagraphStyle *_Nullable)paragraphStyle withFirstLineHeadIndent:(CGFloat)firstLineHeadIndent headIndent:(CGFloat)headIndent;
+
+@end
+
+typedef struct {
+    NSUInteger length;
+    RTEStyleID characterStyleID;
+    RTEStyleID paragraphStyleID;
+} RTEStyleRun;
+
+/// The attribute runs of a document as a run-length array of style IDs from a style table.
+/// Adjacent runs with the same IDs are always merged.
+@interface RTEStyleRuns : NSObject
+
+@property (nonatomic, strong, readonly, nonnull) RTEStyleTable *styleTable;
+@property (nonatomic, assign, readonly) NSUInteger count;
+/// The sum of the run lengths.
+@property (nonatomic, assign, readonly) NSUInteger length;
+
+- (instancetype _Nonnull)initWithStyleTable:(RTEStyleTable *_Nonnull)styleTable;
+- (instancetype _Nonnull)initWithAttributedString:(NSAttributedString *_Nonnull)attributedString styleTable:(RTEStyleTable *_Nonnull)styleTable;
+
+- (RTEStyleRun)runAtIndex:(NSUInteger)index;
+/// Merges run into the last run if their IDs are equal. Empty runs are ignored.
+- (void)appendRun:(RTEStyleRun)run;
+
+/// string with the runs applied, string must be as long as the runs.
+- (NSAttributedString *_Nonnull)attributedStringWithString:(NSString *_Nonnull)string;
+
+@end
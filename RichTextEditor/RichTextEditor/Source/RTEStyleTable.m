@@ -0,0 +1,334 @@
+//
+//  RTEStyleTable.m
+//  RichTextEditor
+//
+//  Created by lam1611 on 10/18/26.
+//
+
+#import "RTEStyleTable.h"
+
+const RTEStyleID RTEStyleIDNone = 0;
+
+/// Wraps an attribute dictionary with a hash over its keys and values, -[NSDictionary hash] is only its count.
+@interface RTEStyleKey : NSObject <NSCopying>
+
+@property (nonatomic, strong) NSDictionary<NSAttributedStringKey, id> *attributes;
+@property (nonatomic, assign) NSUInteger attributesHash;
+
+- (instancetype)initWithAttributes:(NSDictionary<NSAttributedStringKey, id> *)attributes;
+
+@end
+
+@implementation RTEStyleKey
+
+- (instancetype)initWithAttributes:(NSDictionary<NSAttributedStringKey, id> *)attributes {
+    if (self = [super init]) {
+        _attributes = attributes;
+        
+        __block NSUInteger hash = attributes.count;
+        
+        [attributes enumerateKeysAndObjectsUsingBlock:^(NSAttributedStringKey key, id value, BOOL *stop) {
+            /// Order independent, the enumeration order of equal dictionaries may differ.
+            hash += key.hash ^ ([value hash] * 31);
+        }];
+        
+        _attributesHash = hash;
+    }
+    
+    return self;
+}
+
+- (NSUInteger)hash {
+    return self.attributesHash;
+}
+
+- (BOOL)isEqual:(id)object {
+    if (![object isKindOfClass:[RTEStyleKey class]]) {
+        return NO;
+    }
+    
+    RTEStyleKey *key = (RTEStyleKey *)object;
+    
+    return (key.attributesHash == self.attributesHash) && [key.attributes isEqualToDictionary:self.attributes];
+}
+
+- (id)copyWithZone:(NSZone *)zone {
+    /// Keys are never mutated once stored.
+    return self;
+}
+
+@end
+
+typedef struct {
+    RTEStyleID paragraphStyleID;
+    CGFloat firstLineHeadIndent;
+    CGFloat headIndent;
+} RTEParagraphIndentKey;
+
+@interface RTEStyleTable ()
+
+@property (nonatomic, strong) NSMutableArray<NSDictionary<NSAttributedStringKey, id> *> *characterStyles;
+@property (nonatomic, strong) NSMutableDictionary<RTEStyleKey *, NSNumber *> *characterStyleIDs;
+/// The first element is NSNull for RTEStyleIDNone.
+@property (nonatomic, strong) NSMutableArray *paragraphStyles;
+@property (nonatomic, strong) NSMutableDictionary<NSParagraphStyle *, NSNumber *> *paragraphStyleIDs;
+/// Full attribute dictionary -> both IDs packed in 64 bits.
+@property (nonatomic, strong) NSMutableDictionary<RTEStyleKey *, NSNumber *> *attributeStyleIDs;
+/// Both IDs packed in 64 bits -> combined dictionary.
+@property (nonatomic, strong) NSMutableDictionary<NSNumber *, NSDictionary<NSAttributedStringKey, id> *> *combinedAttributes;
+/// NSValue of RTEParagraphIndentKey -> paragraph style ID.
+@property (nonatomic, strong) NSMutableDictionary<NSValue *, NSNumber *> *indentedParagraphStyleIDs;
+
+@end
+
+@implementation RTEStyleTable
+
+#pragma mark - Initialization -
+
+- (instancetype)init {
+    if (self = [super init]) {
+        _characterStyles = [[NSMutableArray alloc] initWithObjects:@{}, nil];
+        _characterStyleIDs = [[NSMutableDictionary alloc] initWithObjectsAndKeys:@(RTEStyleIDNone), [[RTEStyleKey alloc] initWithAttributes:@{}], nil];
+        _paragraphStyles = [[NSMutableArray alloc] initWithObjects:[NSNull null], nil];
+        _paragraphStyleIDs = [[NSMutableDictionary alloc] init];
+        _attributeStyleIDs = [[NSMutableDictionary alloc] init];
+        _combinedAttributes = [[NSMutableDictionary alloc] init];
+        _indentedParagraphStyleIDs = [[NSMutableDictionary alloc] init];
+    }
+    
+    return self;
+}
+
+#pragma mark - Public Methods -
+
+- (NSUInteger)numberOfCharacterStyles {
+    return self.characterStyles.count;
+}
+
+- (NSUInteger)numberOfParagraphStyles {
+    return self.paragraphStyles.count - 1;
+}
+
+- (RTEStyleID)characterStyleIDForAttributes:(NSDictionary<NSAttributedStringKey, id> *)attributes {
+    if ([attributes objectForKey:NSParagraphStyleAttributeName] != nil) {
+        NSMutableDictionary<NSAttributedStringKey, id> *characterAttributes = [attributes mutableCopy];
+        [characterAttributes removeObjectForKey:NSParagraphStyleAttributeName];
+        attributes = characterAttributes;
+    }
+    
+    if (attributes.count == 0) {
+        return RTEStyleIDNone;
+    }
+    
+    RTEStyleKey *key = [[RTEStyleKey alloc] initWithAttributes:attributes];
+    NSNumber *styleID = [self.characterStyleIDs objectForKey:key];
+    
+    if (styleID == nil) {
+        key.attributes = [attributes copy];
+        styleID = @((RTEStyleID)self.characterStyles.count);
+        [self.characterStyles addObject:key.attributes];
+        [self.characterStyleIDs setObject:styleID forKey:key];
+    }
+    
+    return (RTEStyleID)styleID.unsignedIntValue;
+}
+
+- (RTEStyleID)paragraphStyleIDForParagraphStyle:(NSParagraphStyle *)paragraphStyle {
+    if (paragraphStyle == nil) {
+        return RTEStyleIDNone;
+    }
+    
+    NSNumber *styleID = [self.paragraphStyleIDs objectForKey:paragraphStyle];
+    
+    if (styleID == nil) {
+        /// Copy so a mutable style can't change under its ID.
+        NSParagraphStyle *internedStyle = [paragraphStyle copy];
+        styleID = @((RTEStyleID)self.paragraphStyles.count);
+        [self.paragraphStyles addObject:internedStyle];
+        [self.paragraphStyleIDs setObject:styleID forKey:internedStyle];
+    }
+    
+    return (RTEStyleID)styleID.unsignedIntValue;
+}
+
+- (void)getCharacterStyleID:(RTEStyleID *)characterStyleID paragraphStyleID:(RTEStyleID *)paragraphStyleID forAttributes:(NSDictionary<NSAttributedStringKey, id> *)attributes {
+    if (attributes.count == 0) {
+        *characterStyleID = RTEStyleIDNone;
+        *paragraphStyleID = RTEStyleIDNone;
+        return;
+    }
+    
+    RTEStyleKey *key = [[RTEStyleKey alloc] initWithAttributes:attributes];
+    NSNumber *styleIDs = [self.attributeStyleIDs objectForKey:key];
+    
+    if (styleIDs == nil) {
+        RTEStyleID newCharacterStyleID = [self characterStyleIDForAttributes:attributes];
+        RTEStyleID newParagraphStyleID = [self paragraphStyleIDForParagraphStyle:[attributes objectForKey:NSParagraphStyleAttributeName]];
+        
+        key.attributes = [attributes copy];
+        styleIDs = @(((uint64_t)newCharacterStyleID << 32) | newParagraphStyleID);
+        [self.attributeStyleIDs setObject:styleIDs forKey:key];
+    }
+    
+    uint64_t packedStyleIDs = styleIDs.unsignedLongLongValue;
+    *characterStyleID = (RTEStyleID)(packedStyleIDs >> 32);
+    *paragraphStyleID = (RTEStyleID)packedStyleIDs;
+}
+
+- (NSDictionary<NSAttributedStringKey, id> *)characterAttributesForStyleID:(RTEStyleID)styleID {
+    if (styleID >= self.characterStyles.count) {
+        return @{};
+    }
+    
+    return [self.characterStyles objectAtIndex:styleID];
+}
+
+- (NSParagraphStyle *)paragraphStyleForStyleID:(RTEStyleID)styleID {
+    if ((styleID == RTEStyleIDNone) || (styleID >= self.paragraphStyles.count)) {
+        return nil;
+    }
+    
+    return [self.paragraphStyles objectAtIndex:styleID];
+}
+
+- (NSDictionary<NSAttributedStringKey, id> *)attributesForCharacterStyleID:(RTEStyleID)characterStyleID paragraphStyleID:(RTEStyleID)paragraphStyleID {
+    NSParagraphStyle *paragraphStyle = [self paragraphStyleForStyleID:paragraphStyleID];
+    
+    if (paragraphStyle == nil) {
+        return [self characterAttributesForStyleID:characterStyleID];
+    }
+    
+    NSNumber *packedStyleIDs = @(((uint64_t)characterStyleID << 32) | paragraphStyleID);
+    NSDictionary<NSAttributedStringKey, id> *attributes = [self.combinedAttributes objectForKey:packedStyleIDs];
+    
+    if (attributes == nil) {
+        NSMutableDictionary<NSAttributedStringKey, id> *combinedAttributes = [[self characterAttributesForStyleID:characterStyleID] mutableCopy];
+        [combinedAttributes setObject:paragraphStyle forKey:NSParagraphStyleAttributeName];
+        attributes = [combinedAttributes copy];
+        [self.combinedAttributes setObject:attributes forKey:packedStyleIDs];
+    }
+    
+    return attributes;
+}
+
+- (NSParagraphStyle *)paragraphStyle:(NSParagraphStyle *)paragraphStyle withFirstLineHeadIndent:(CGFloat)firstLineHeadIndent headIndent:(CGFloat)headIndent {
+    RTEParagraphIndentKey indentKey;
+    memset(&indentKey, 0, sizeof(indentKey));
+    indentKey.paragraphStyleID = [self paragraphStyleIDForParagraphStyle:paragraphStyle];
+    indentKey.firstLineHeadIndent = firstLineHeadIndent;
+    indentKey.headIndent = headIndent;
+    
+    NSValue *key = [NSValue valueWithBytes:&indentKey objCType:@encode(RTEParagraphIndentKey)];
+    NSNumber *styleID = [self.indentedParagraphStyleIDs objectForKey:key];
+    
+    if (styleID == nil) {
+        NSParagraphStyle *sourceStyle = [self paragraphStyleForStyleID:indentKey.paragraphStyleID] ?: [NSParagraphStyle defaultParagraphStyle];
+        NSMutableParagraphStyle *indentedStyle = [sourceStyle mutableCopy];
+        indentedStyle.firstLineHeadIndent = firstLineHeadIndent;
+        indentedStyle.headIndent = headIndent;
+        
+        styleID = @([self paragraphStyleIDForParagraphStyle:indentedStyle]);
+        [self.indentedParagraphStyleIDs setObject:styleID forKey:key];
+    }
+    
+    return [self paragraphStyleForStyleID:(RTEStyleID)styleID.unsignedIntValue];
+}
+
+@end
+
+@interface RTEStyleRuns () {
+    RTEStyleRun *_runs;
+    NSUInteger _capacity;
+}
+
+@end
+
+@implementation RTEStyleRuns
+
+#pragma mark - Initialization -
+
+- (instancetype)initWithStyleTable:(RTEStyleTable *)styleTable {
+    if (self = [super init]) {
+        _styleTable = styleTable;
+        _count = 0;
+        _length = 0;
+        _capacity = 0;
+        _runs = NULL;
+    }
+    
+    return self;
+}
+
+- (instancetype)initWithAttributedString:(NSAttributedString *)attributedString styleTable:(RTEStyleTable *)styleTable {
+    if (self = [self initWithStyleTable:styleTable]) {
+        [attributedString enumerateAttributesInRange:NSMakeRange(0, attributedString.length) options:0 usingBlock:^(NSDictionary<NSAttributedStringKey, id> *attributes, NSRange range, BOOL *stop) {
+            RTEStyleRun run;
+            run.length = range.length;
+            [styleTable getCharacterStyleID:&run.characterStyleID paragraphStyleID:&run.paragraphStyleID forAttributes:attributes];
+            [self appendRun:run];
+        }];
+    }
+    
+    return self;
+}
+
+- (void)dealloc {
+    free(_runs);
+}
+
+#pragma mark - Public Methods -
+
+- (RTEStyleRun)runAtIndex:(NSUInteger)index {
+    if (index >= self.count) {
+        RTEStyleRun run = {0, RTEStyleIDNone, RTEStyleIDNone};
+        return run;
+    }
+    
+    return _runs[index];
+}
+
+- (void)appendRun:(RTEStyleRun)run {
+    if (run.length == 0) {
+        return;
+    }
+    
+    _length += run.length;
+    
+    if (_count > 0) {
+        RTEStyleRun *lastRun = &_runs[_count - 1];
+        
+        if ((lastRun->characterStyleID == run.characterStyleID) && (lastRun->paragraphStyleID == run.paragraphStyleID)) {
+            lastRun->length += run.length;
+            return;
+        }
+    }
+    
+    if (_count == _capacity) {
+        _capacity = MAX(_capacity * 2, 16);
+        _runs = realloc(_runs, _capacity * sizeof(RTEStyleRun));
+    }
+    
+    _runs[_count] = run;
+    _count += 1;
+}
+
+- (NSAttributedString *)attributedStringWithString:(NSString *)string {
+    NSMutableAttributedString *attributedString = [[NSMutableAttributedString alloc] initWithString:string];
+    NSUInteger location = 0;
+    
+    [attributedString beginEditing];
+    
+    for (NSUInteger i = 0; (i < self.count) && (location < string.length); i++) {
+        RTEStyleRun run = _runs[i];
+        NSRange range = NSMakeRange(location, MIN(run.length, string.length - location));
+        
+        [attributedString setAttributes:[self.styleTable attributesForCharacterStyleID:run.characterStyleID paragraphStyleID:run.paragraphStyleID] range:range];
+        location = NSMaxRange(range);
+    }
+    
+    [attributedString endEditing];
+    
+    return attributedString;
+}
+
+@end
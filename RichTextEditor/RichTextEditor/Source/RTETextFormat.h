@@ -7,6 +7,7 @@
 //
 
 #import <Cocoa/Cocoa.h>
+#import <RichTextEditor/RTEFormatIndex.h>
 
 @interface RTETextFormat : NSObject
 
@@ -22,5 +23,7 @@
 @property (nonatomic, strong, nullable) NSURL *hyperlink;
 @property (nonatomic, strong, nullable) NSColor *textColor;
 @property (nonatomic, strong, nullable) NSColor *textBackgroundColor;
+/// The formatting of the whole selection, for showing mixed states. The properties above follow the typing attributes.
+@property (nonatomic, assign) RTEFormatSummary selectionSummary;
 
 @end
@@ -0,0 +1,79 @@
+//
+//  RTETrace.h
+//  RichTextEditor
+//
+//  Created by lam1611 on 10/18/26.
+//
+
+#import <Foundation/Foundation.h>
+
+#import <time.h>
+
+/// Tracing of spans, counters and instant events into per-thread ring buffers, exported as Chrome trace-event JSON.
+///
+/// Each thread records into a buffer of its own without locks, only the thread's first event takes a lock to register the buffer.
+/// A buffer keeps the last kRTETraceEventsPerThread events of the capture, older events are overwritten.
+/// While no capture runs, a span or counter costs one relaxed load.
+/// Event names are not copied, they must be string literals or otherwise live for the life of the process.
+
+extern const NSUInteger kRTETraceEventsPerThread;
+
+/// Non-zero while a capture runs, read through RTETraceIsEnabled().
+FOUNDATION_EXPORT int RTETraceState;
+
+static inline BOOL RTETraceIsEnabled(void) {
+    return __atomic_load_n(&RTETraceState, __ATOMIC_RELAXED) != 0;
+}
+
+static inline uint64_t RTETraceNow(void) {
+    return clock_gettime_nsec_np(CLOCK_UPTIME_RAW);
+}
+
+/// Records a span of name from start, a RTETraceNow() timestamp, to now. argument is exported when it is not negative.
+FOUNDATION_EXPORT void RTETraceRecordSpan(const char *_Nonnull name, uint64_t start, int64_t argument);
+/// Adds delta to the counter name, exported as the running total.
+FOUNDATION_EXPORT void RTETraceRecordCounter(const char *_Nonnull name, int64_t delta);
+/// Records a point in time, argument is exported when it is not negative.
+FOUNDATION_EXPORT void RTETraceRecordInstant(const char *_Nonnull name, int64_t argument);
+
+typedef struct {
+    const char *_Nonnull name;
+    /// 0 when tracing was disabled as the scope began.
+    uint64_t start;
+    int64_t argument;
+} RTETraceScope;
+
+static inline void RTETraceScopeEnd(RTETraceScope *_Nonnull scope) {
+    if (scope->start != 0) {
+        RTETraceRecordSpan(scope->name, scope->start, scope->argument);
+    }
+}
+
+#define RTE_TRACE_CONCAT_(a, b) a##b
+#define RTE_TRACE_CONCAT(a, b) RTE_TRACE_CONCAT_(a, b)
+
+/// Records a span from this line to the end of the enclosing scope.
+#define RTE_TRACE_SCOPE(name) RTE_TRACE_SCOPE_WITH_ARGUMENT(name, -1)
+#define RTE_TRACE_SCOPE_WITH_ARGUMENT(name, argument) \
+    __attribute__((cleanup(RTETraceScopeEnd), unused)) RTETraceScope RTE_TRACE_CONCAT(rteTraceScope, __LINE__) = {(name), RTETraceIsEnabled() ? RTETraceNow() : 0, (argument)}
+
+#define RTE_TRACE_COUNTER(name, delta) \
+    do { if (RTETraceIsEnabled()) { RTETraceRecordCounter((name), (delta)); } } while (0)
+#define RTE_TRACE_INSTANT(name, argument) \
+    do { if (RTETraceIsEnabled()) { RTETraceRecordInstant((name), (argument)); } } while (0)
+
+/// Starts and stops captures and exports them.
+@interface RTETracer : NSObject
+
+/// Discards the events of the previous capture and starts recording.
++ (void)startCapture;
+/// Stops recording, the events are kept until the next capture starts.
++ (void)stopCapture;
++ (BOOL)isCapturing;
+
+/// The events of the current or last capture as Chrome trace-event JSON, loadable in chrome://tracing or Perfetto.
+/// Export after stopping the capture, a thread still recording can overwrite events while they are read.
++ (NSData *_Nonnull)chromeTraceData;
++ (BOOL)writeChromeTraceToURL:(NSURL *_Nonnull)url error:(NSError *_Nullable *_Nullable)error;
+
+@end
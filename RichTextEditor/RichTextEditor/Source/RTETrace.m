@@ -0,0 +1,256 @@
+//
+//  RTETrace.m
+//  RichTextEditor
+//
+//  Created by lam1611 on 10/18/26.
+//
+
+#import "RTETrace.h"
+
+#import <pthread.h>
+#import <stdatomic.h>
+
+/// A power of two, so the head wraps with a mask.
+const NSUInteger kRTETraceEventsPerThread = 16384;
+
+int RTETraceState = 0;
+
+typedef NS_ENUM(uint8_t, RTETraceEventPhase) {
+    RTETraceEventPhaseSpan = 'X',
+    RTETraceEventPhaseCounter = 'C',
+    RTETraceEventPhaseInstant = 'i',
+};
+
+typedef struct {
+    const char *name;
+    uint64_t timestamp;
+    uint64_t duration;
+    /// The argument of spans and instants, the delta of counters.
+    int64_t value;
+    RTETraceEventPhase phase;
+} RTETraceEvent;
+
+typedef struct RTETraceBuffer {
+    RTETraceEvent *events;
+    /// Written by the owning thread only, the number of events recorded in this capture.
+    _Atomic(uint64_t) head;
+    /// The capture the events belong to, a buffer from an older capture is reset by its thread on the next event.
+    _Atomic(uint64_t) generation;
+    /// Set when the owning thread exits, the buffer is freed when the next capture starts.
+    atomic_bool isRetired;
+    uint64_t threadID;
+    BOOL isMainThread;
+    struct RTETraceBuffer *next;
+} RTETraceBuffer;
+
+static pthread_mutex_t sBuffersLock = PTHREAD_MUTEX_INITIALIZER;
+static RTETraceBuffer *sBuffers = NULL;
+static _Atomic(uint64_t) sGeneration = 0;
+static uint64_t sCaptureStart = 0;
+static pthread_key_t sBufferKey;
+static pthread_once_t sBufferKeyOnce = PTHREAD_ONCE_INIT;
+static __thread RTETraceBuffer *sThreadBuffer = NULL;
+
+static void RTETraceRetireBuffer(void *buffer) {
+    atomic_store(&((RTETraceBuffer *)buffer)->isRetired, true);
+}
+
+static void RTETraceCreateBufferKey(void) {
+    pthread_key_create(&sBufferKey, RTETraceRetireBuffer);
+}
+
+static RTETraceBuffer *RTETraceCurrentBuffer(void) {
+    RTETraceBuffer *buffer = sThreadBuffer;
+    uint64_t generation = atomic_load_explicit(&sGeneration, memory_order_acquire);
+    
+    if (buffer == NULL) {
+        buffer = calloc(1, sizeof(RTETraceBuffer));
+        buffer->events = calloc(kRTETraceEventsPerThread, sizeof(RTETraceEvent));
+        pthread_threadid_np(NULL, &buffer->threadID);
+        buffer->isMainThread = (pthread_main_np() != 0);
+        atomic_init(&buffer->head, 0);
+        atomic_init(&buffer->generation, generation);
+        atomic_init(&buffer->isRetired, false);
+        
+        pthread_once(&sBufferKeyOnce, RTETraceCreateBufferKey);
+        pthread_setspecific(sBufferKey, buffer);
+        
+        pthread_mutex_lock(&sBuffersLock);
+        buffer->next = sBuffers;
+        sBuffers = buffer;
+        pthread_mutex_unlock(&sBuffersLock);
+        
+        sThreadBuffer = buffer;
+    } else if (atomic_load_explicit(&buffer->generation, memory_order_relaxed) != generation) {
+        atomic_store_explicit(&buffer->head, 0, memory_order_relaxed);
+        atomic_store_explicit(&buffer->generation, generation, memory_order_release);
+    }
+    
+    return buffer;
+}
+
+static void RTETraceAppendEvent(const char *name, RTETraceEventPhase phase, uint64_t timestamp, uint64_t duration, int64_t value) {
+    RTETraceBuffer *buffer = RTETraceCurrentBuffer();
+    uint64_t head = atomic_load_explicit(&buffer->head, memory_order_relaxed);
+    RTETraceEvent *event = &buffer->events[head & (kRTETraceEventsPerThread - 1)];
+    
+    event->name = name;
+    event->phase = phase;
+    event->timestamp = timestamp;
+    event->duration = duration;
+    event->value = value;
+    
+    /// Publishes the event to the exporting thread.
+    atomic_store_explicit(&buffer->head, head + 1, memory_order_release);
+}
+
+void RTETraceRecordSpan(const char *name, uint64_t start, int64_t argument) {
+    uint64_t end = RTETraceNow();
+    
+    RTETraceAppendEvent(name, RTETraceEventPhaseSpan, start, (end > start) ? end - start : 0, argument);
+}
+
+void RTETraceRecordCounter(const char *name, int64_t delta) {
+    RTETraceAppendEvent(name, RTETraceEventPhaseCounter, RTETraceNow(), 0, delta);
+}
+
+void RTETraceRecordInstant(const char *name, int64_t argument) {
+    RTETraceAppendEvent(name, RTETraceEventPhaseInstant, RTETraceNow(), 0, argument);
+}
+
+@implementation RTETracer
+
+#pragma mark - Public Methods -
+
++ (void)startCapture {
+    pthread_mutex_lock(&sBuffersLock);
+    
+    /// Threads that exited no longer write, their buffers can go.
+    RTETraceBuffer **link = &sBuffers;
+    
+    while (*link != NULL) {
+        RTETraceBuffer *buffer = *link;
+        
+        if (atomic_load(&buffer->isRetired)) {
+            *link = buffer->next;
+            free(buffer->events);
+            free(buffer);
+        } else {
+            link = &buffer->next;
+        }
+    }
+    
+    sCaptureStart = RTETraceNow();
+    atomic_fetch_add_explicit(&sGeneration, 1, memory_order_release);
+    __atomic_store_n(&RTETraceState, 1, __ATOMIC_RELEASE);
+    
+    pthread_mutex_unlock(&sBuffersLock);
+}
+
++ (void)stopCapture {
+    __atomic_store_n(&RTETraceState, 0, __ATOMIC_RELEASE);
+}
+
++ (BOOL)isCapturing {
+    return RTETraceIsEnabled();
+}
+
++ (NSData *)chromeTraceData {
+    NSMutableArray<NSDictionary *> *traceEvents = [[NSMutableArray alloc] init];
+    NSMutableArray<NSMutableDictionary *> *counterEvents = [[NSMutableArray alloc] init];
+    NSMutableDictionary<NSValue *, NSString *> *names = [[NSMutableDictionary alloc] init];
+    NSNumber *processID = @([[NSProcessInfo processInfo] processIdentifier]);
+    uint64_t droppedEventCount = 0;
+    
+    pthread_mutex_lock(&sBuffersLock);
+    uint64_t generation = atomic_load_explicit(&sGeneration, memory_order_acquire);
+    uint64_t captureStart = sCaptureStart;
+    
+    for (RTETraceBuffer *buffer = sBuffers; buffer != NULL; buffer = buffer->next) {
+        if (atomic_load_explicit(&buffer->generation, memory_order_acquire) != generation) {
+            continue;
+        }
+        
+        uint64_t head = atomic_load_explicit(&buffer->head, memory_order_acquire);
+        uint64_t first = (head > kRTETraceEventsPerThread) ? head - kRTETraceEventsPerThread : 0;
+        NSNumber *threadID = @(buffer->threadID);
+        
+        droppedEventCount += first;
+        
+        if (buffer->isMainThread) {
+            [traceEvents addObject:@{@"name": @"thread_name", @"ph": @"M", @"pid": processID, @"tid": threadID, @"args": @{@"name": @"main"}}];
+        }
+        
+        for (uint64_t i = first; i < head; i++) {
+            RTETraceEvent event = buffer->events[i & (kRTETraceEventsPerThread - 1)];
+            NSValue *nameKey = [NSValue valueWithPointer:event.name];
+            NSString *name = names[nameKey];
+            
+            if (name == nil) {
+                name = [NSString stringWithUTF8String:event.name] ?: @"";
+                names[nameKey] = name;
+            }
+            
+            NSMutableDictionary *traceEvent = [@{@"name": name,
+                                                 @"cat": @"RichTextEditor",
+                                                 @"ph": [NSString stringWithFormat:@"%c", event.phase],
+                                                 @"ts": @((double)(event.timestamp - MIN(event.timestamp, captureStart)) / NSEC_PER_USEC),
+                                                 @"pid": processID,
+                                                 @"tid": threadID} mutableCopy];
+            
+            switch (event.phase) {
+                case RTETraceEventPhaseSpan:
+                    traceEvent[@"dur"] = @((double)event.duration / NSEC_PER_USEC);
+                    break;
+                case RTETraceEventPhaseInstant:
+                    traceEvent[@"s"] = @"t";
+                    break;
+                case RTETraceEventPhaseCounter:
+                    traceEvent[@"args"] = @{name: @(event.value)};
+                    [counterEvents addObject:traceEvent];
+                    break;
+            }
+            
+            if ((event.phase != RTETraceEventPhaseCounter) && (event.value >= 0)) {
+                traceEvent[@"args"] = @{@"value": @(event.value)};
+            }
+            
+            [traceEvents addObject:traceEvent];
+        }
+    }
+    
+    pthread_mutex_unlock(&sBuffersLock);
+    
+    /// Counter events hold deltas, Chrome plots the value, so they are turned into running totals across threads.
+    NSArray<NSMutableDictionary *> *sortedCounterEvents = [counterEvents sortedArrayUsingComparator:^NSComparisonResult(NSMutableDictionary *first, NSMutableDictionary *second) {
+        return [first[@"ts"] compare:second[@"ts"]];
+    }];
+    NSMutableDictionary<NSString *, NSNumber *> *totals = [[NSMutableDictionary alloc] init];
+    
+    for (NSMutableDictionary *traceEvent in sortedCounterEvents) {
+        NSString *name = traceEvent[@"name"];
+        long long total = totals[name].longLongValue + [traceEvent[@"args"][name] longLongValue];
+        
+        totals[name] = @(total);
+        traceEvent[@"args"] = @{name: @(total)};
+    }
+    
+    NSDictionary *trace = @{@"traceEvents": traceEvents,
+                            @"displayTimeUnit": @"ms",
+                            @"otherData": @{@"droppedEvents": @(droppedEventCount)}};
+    NSError *error = nil;
+    NSData *data = [NSJSONSerialization dataWithJSONObject:trace options:0 error:&error];
+    
+    if (data == nil) {
+        NSLog(@"%s [Line %d] Error: %@", __PRETTY_FUNCTION__, __LINE__, error);
+        return [NSData data];
+    }
+    
+    return data;
+}
+
++ (BOOL)writeChromeTraceToURL:(NSURL *)url error:(NSError **)error {
+    return [[self chromeTraceData] writeToURL:url options:NSDataWritingAtomic error:error];
+}
+
+@end
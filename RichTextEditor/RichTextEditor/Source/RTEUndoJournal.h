@@ -0,0 +1,53 @@
+//
+//  RTEUndoJournal.h
+//  RichTextEditor
+//
+//  Created by lam1611 on 10/18/26.
+//
+
+#import <Foundation/Foundation.h>
+
+typedef NS_ENUM(NSInteger, RTEUndoJournalEditKind) {
+    /// Always gets an entry of its own.
+    RTEUndoJournalEditKindCommand = 0,
+    /// Merged into the previous typing entry when it falls inside the text that entry changed.
+    RTEUndoJournalEditKindTyping = 1,
+};
+
+extern const NSUInteger kRTEUndoJournalDefaultByteBudget;
+
+/// An undo log of text deltas. Each entry is one contiguous replacement, the attributed text a range held before an edit
+/// and the text it holds after, so an entry costs what the edit touched rather than a snapshot of the document.
+///
+/// An edit is bracketed by -beginEditingInRange:... and -endEditingOfAttributedString:..., and the mutations in between
+/// must stay inside the range given to the outermost begin. Nested brackets join the outermost one, so a command made of
+/// many fine-grained mutations is a single entry.
+/// Entries are evicted oldest first once their estimated size exceeds byteBudget, the most recent entry is always kept.
+@interface RTEUndoJournal : NSObject
+
+@property (nonatomic, assign) NSUInteger byteBudget;
+/// Estimated size of the undo and redo entries.
+@property (nonatomic, assign, readonly) NSUInteger byteCount;
+@property (nonatomic, assign, readonly) NSUInteger numberOfUndoEntries;
+@property (nonatomic, assign, readonly) NSUInteger numberOfRedoEntries;
+@property (nonatomic, assign, readonly) BOOL isEditing;
+
+- (instancetype _Nonnull)initWithByteBudget:(NSUInteger)byteBudget;
+
+- (void)beginEditingInRange:(NSRange)range ofAttributedString:(NSAttributedString *_Nonnull)attributedString selectedRange:(NSRange)selectedRange kind:(RTEUndoJournalEditKind)kind;
+/// Records the edit when the outermost bracket ends. Edits that change nothing are dropped.
+- (void)endEditingOfAttributedString:(NSAttributedString *_Nonnull)attributedString selectedRange:(NSRange)selectedRange;
+/// The next typing edit starts a new entry.
+- (void)breakCoalescing;
+
+- (BOOL)canUndo;
+- (BOOL)canRedo;
+/// Reverts the last entry in attributedString and sets selectedRange to the selection from before the edit.
+/// Returns NO and empties the journal if the text or attributes at the entry don't match it, they were changed without the journal.
+- (BOOL)undoInAttributedString:(NSMutableAttributedString *_Nonnull)attributedString selectedRange:(NSRange *_Nullable)selectedRange;
+/// Reapplies the last undone entry, with the same check as -undoInAttributedString:selectedRange:.
+- (BOOL)redoInAttributedString:(NSMutableAttributedString *_Nonnull)attributedString selectedRange:(NSRange *_Nullable)selectedRange;
+
+- (void)removeAllEntries;
+
+@end
@@ -0,0 +1,331 @@
+//
+//  RTEUndoJournal.m
+//  RichTextEditor
+//
+//  Created by lam1611 on 10/18/26.
+//
+
+#import "RTEUndoJournal.h"
+
+const NSUInteger kRTEUndoJournalDefaultByteBudget = 16 * 1024 * 1024;
+
+/// Estimated overhead of an entry and of an attribute run, the attribute dictionaries themselves are shared with the document.
+static const NSUInteger kEntryByteCost = 64;
+static const NSUInteger kRunByteCost = 32;
+
+static NSUInteger RTEUndoByteCost(NSAttributedString *attributedString) {
+    __block NSUInteger byteCount = attributedString.length * sizeof(unichar);
+    
+    [attributedString enumerateAttributesInRange:NSMakeRange(0, attributedString.length) options:0 usingBlock:^(NSDictionary<NSAttributedStringKey, id> *attributes, NSRange range, BOOL *stop) {
+        byteCount += kRunByteCost;
+    }];
+    
+    return byteCount;
+}
+
+@interface RTEUndoJournalEntry : NSObject
+
+@property (nonatomic, assign) NSUInteger location;
+@property (nonatomic, strong) NSAttributedString *oldText;
+@property (nonatomic, strong) NSAttributedString *theNewText;
+@property (nonatomic, assign) NSRange selectedRangeBefore;
+@property (nonatomic, assign) NSRange selectedRangeAfter;
+@property (nonatomic, assign) RTEUndoJournalEditKind kind;
+@property (nonatomic, assign) NSUInteger byteCount;
+
+@end
+
+@implementation RTEUndoJournalEntry
+
+- (void)updateByteCount {
+    self.byteCount = kEntryByteCost + RTEUndoByteCost(self.oldText) + RTEUndoByteCost(self.theNewText);
+}
+
+@end
+
+@interface RTEUndoJournal () {
+    NSUInteger _editingDepth;
+    /// Length of the text after the edited range when the edit began, it doesn't change during the edit.
+    NSUInteger _tailLength;
+    BOOL _isCoalescing;
+    BOOL _coalescingBroken;
+}
+
+@property (nonatomic, strong) NSMutableArray<RTEUndoJournalEntry *> *undoEntries;
+@property (nonatomic, strong) NSMutableArray<RTEUndoJournalEntry *> *redoEntries;
+/// The entry being recorded, or the last undo entry while a typing edit is merged into it.
+@property (nonatomic, strong) RTEUndoJournalEntry *pendingEntry;
+
+@end
+
+@implementation RTEUndoJournal
+
+#pragma mark - Initialization -
+
+- (instancetype)init {
+    return [self initWithByteBudget:kRTEUndoJournalDefaultByteBudget];
+}
+
+- (instancetype)initWithByteBudget:(NSUInteger)byteBudget {
+    if (self = [super init]) {
+        _byteBudget = byteBudget;
+        _byteCount = 0;
+        _undoEntries = [[NSMutableArray alloc] init];
+        _redoEntries = [[NSMutableArray alloc] init];
+        _editingDepth = 0;
+        _coalescingBroken = YES;
+    }
+    
+    return self;
+}
+
+#pragma mark - Public Methods -
+
+- (void)setByteBudget:(NSUInteger)byteBudget {
+    _byteBudget = byteBudget;
+    [self evictEntriesOverBudget];
+}
+
+- (NSUInteger)numberOfUndoEntries {
+    return self.undoEntries.count;
+}
+
+- (NSUInteger)numberOfRedoEntries {
+    return self.redoEntries.count;
+}
+
+- (BOOL)isEditing {
+    return _editingDepth > 0;
+}
+
+- (BOOL)canUndo {
+    return !self.isEditing && (self.undoEntries.count > 0);
+}
+
+- (BOOL)canRedo {
+    return !self.isEditing && (self.redoEntries.count > 0);
+}
+
+- (void)beginEditingInRange:(NSRange)range ofAttributedString:(NSAttributedString *)attributedString selectedRange:(NSRange)selectedRange kind:(RTEUndoJournalEditKind)kind {
+    _editingDepth += 1;
+    
+    if (_editingDepth > 1) {
+        return;
+    }
+    
+    NSUInteger length = attributedString.length;
+    range.location = MIN(range.location, length);
+    range.length = MIN(range.length, length - range.location);
+    
+    RTEUndoJournalEntry *lastEntry = self.undoEntries.lastObject;
+    NSRange lastRange = NSMakeRange(lastEntry.location, lastEntry.theNewText.length);
+    
+    _isCoalescing = (kind == RTEUndoJournalEditKindTyping) && (lastEntry.kind == RTEUndoJournalEditKindTyping) && !_coalescingBroken && (self.redoEntries.count == 0) &&
+    (range.location >= lastRange.location) && (NSMaxRange(range) <= NSMaxRange(lastRange)) && (NSMaxRange(lastRange) <= length);
+    
+    if (_isCoalescing) {
+        /// The edit stays inside the text the last entry produced, so recapturing that text afterwards covers both.
+        self.pendingEntry = lastEntry;
+        _tailLength = length - NSMaxRange(lastRange);
+    } else {
+        RTEUndoJournalEntry *entry = [[RTEUndoJournalEntry alloc] init];
+        entry.location = range.location;
+        entry.oldText = [attributedString attributedSubstringFromRange:range];
+        entry.selectedRangeBefore = selectedRange;
+        entry.kind = kind;
+        
+        self.pendingEntry = entry;
+        _tailLength = length - NSMaxRange(range);
+    }
+    
+    _coalescingBroken = (kind != RTEUndoJournalEditKindTyping);
+}
+
+- (void)endEditingOfAttributedString:(NSAttributedString *)attributedString selectedRange:(NSRange)selectedRange {
+    if (_editingDepth == 0) {
+        return;
+    }
+    
+    _editingDepth -= 1;
+    
+    if (_editingDepth > 0) {
+        return;
+    }
+    
+    RTEUndoJournalEntry *entry = self.pendingEntry;
+    self.pendingEntry = nil;
+    
+    if (attributedString.length < entry.location + _tailLength) {
+        /// Something outside the edited range changed, the entries can't be trusted anymore.
+        NSLog(@"%s [Line %d] edit changed text outside of its range, dropping undo history", __PRETTY_FUNCTION__, __LINE__);
+        [self removeAllEntries];
+        return;
+    }
+    
+    NSRange newRange = NSMakeRange(entry.location, attributedString.length - _tailLength - entry.location);
+    NSUInteger previousByteCount = entry.byteCount;
+    
+    entry.theNewText = [attributedString attributedSubstringFromRange:newRange];
+    entry.selectedRangeAfter = selectedRange;
+    [entry updateByteCount];
+    
+    if (_isCoalescing) {
+        _byteCount = _byteCount - previousByteCount + entry.byteCount;
+    } else if (![entry.oldText isEqualToAttributedString:entry.theNewText]) {
+        [self removeRedoEntries];
+        [self.undoEntries addObject:entry];
+        _byteCount += entry.byteCount;
+    }
+    
+    [self evictEntriesOverBudget];
+}
+
+- (void)breakCoalescing {
+    _coalescingBroken = YES;
+}
+
+- (BOOL)undoInAttributedString:(NSMutableAttributedString *)attributedString selectedRange:(NSRange *)selectedRange {
+    if (![self canUndo]) {
+        return NO;
+    }
+    
+    RTEUndoJournalEntry *entry = self.undoEntries.lastObject;
+    
+    if (![self replaceText:entry.theNewText withText:entry.oldText inAttributedString:attributedString atLocation:entry.location]) {
+        return NO;
+    }
+    
+    [self.undoEntries removeLastObject];
+    [self.redoEntries addObject:entry];
+    [self breakCoalescing];
+    
+    if (selectedRange != NULL) {
+        *selectedRange = entry.selectedRangeBefore;
+    }
+    
+    return YES;
+}
+
+- (BOOL)redoInAttributedString:(NSMutableAttributedString *)attributedString selectedRange:(NSRange *)selectedRange {
+    if (![self canRedo]) {
+        return NO;
+    }
+    
+    RTEUndoJournalEntry *entry = self.redoEntries.lastObject;
+    
+    if (![self replaceText:entry.oldText withText:entry.theNewText inAttributedString:attributedString atLocation:entry.location]) {
+        return NO;
+    }
+    
+    [self.redoEntries removeLastObject];
+    [self.undoEntries addObject:entry];
+    [self breakCoalescing];
+    
+    if (selectedRange != NULL) {
+        *selectedRange = entry.selectedRangeAfter;
+    }
+    
+    return YES;
+}
+
+- (void)removeAllEntries {
+    [self.undoEntries removeAllObjects];
+    [self.redoEntries removeAllObjects];
+    _byteCount = 0;
+    _coalescingBroken = YES;
+}
+
+#pragma mark - Helper Methods -
+
+/// Replaces expectedText at location with text, unless attributedString holds something else there.
+- (BOOL)replaceText:(NSAttributedString *)expectedText withText:(NSAttributedString *)text inAttributedString:(NSMutableAttributedString *)attributedString atLocation:(NSUInteger)location {
+    NSRange range = NSMakeRange(location, expectedText.length);
+    
+    if ((NSMaxRange(range) > attributedString.length) || ![self attributedString:attributedString matchesText:expectedText inRange:range]) {
+        NSLog(@"%s [Line %d] text no longer matches the undo history, dropping it", __PRETTY_FUNCTION__, __LINE__);
+        [self removeAllEntries];
+        return NO;
+    }
+    
+    [attributedString replaceCharactersInRange:range withAttributedString:text];
+    
+    return YES;
+}
+
+- (BOOL)attributedString:(NSAttributedString *)attributedString matchesText:(NSAttributedString *)text inRange:(NSRange)range {
+    if ([attributedString.string compare:text.string options:NSLiteralSearch range:range] != NSOrderedSame) {
+        return NO;
+    }
+    
+    NSRange textRange = NSMakeRange(0, text.length);
+    NSUInteger index = 0;
+    
+    while (index < text.length) {
+        NSRange effectiveRange;
+        NSRange currentEffectiveRange;
+        NSDictionary *attributes = [text attributesAtIndex:index longestEffectiveRange:&effectiveRange inRange:textRange];
+        NSDictionary *currentAttributes = [attributedString attributesAtIndex:range.location + index longestEffectiveRange:&currentEffectiveRange inRange:range];
+        
+        if (![self attributes:currentAttributes matchAttributes:attributes]) {
+            return NO;
+        }
+        
+        index = MIN(NSMaxRange(effectiveRange), NSMaxRange(currentEffectiveRange) - range.location);
+    }
+    
+    return YES;
+}
+
+/// The layout manager widens the firstLineHeadIndent of list paragraphs to fit their markers outside of any edit,
+/// so that one value may differ from the recorded text.
+- (BOOL)attributes:(NSDictionary *)attributes matchAttributes:(NSDictionary *)expectedAttributes {
+    if ([attributes isEqualToDictionary:expectedAttributes]) {
+        return YES;
+    }
+    
+    if (attributes.count != expectedAttributes.count) {
+        return NO;
+    }
+    
+    for (NSAttributedStringKey key in expectedAttributes) {
+        id value = [attributes objectForKey:key];
+        id expectedValue = [expectedAttributes objectForKey:key];
+        
+        if ([value isEqual:expectedValue]) {
+            continue;
+        }
+        
+        if (![key isEqualToString:NSParagraphStyleAttributeName] || ![value isKindOfClass:[NSParagraphStyle class]] || ![expectedValue isKindOfClass:[NSParagraphStyle class]]) {
+            return NO;
+        }
+        
+        NSMutableParagraphStyle *paragraphStyle = [value mutableCopy];
+        paragraphStyle.firstLineHeadIndent = [expectedValue firstLineHeadIndent];
+        
+        if (![paragraphStyle isEqual:expectedValue]) {
+            return NO;
+        }
+    }
+    
+    return YES;
+}
+
+- (void)removeRedoEntries {
+    for (RTEUndoJournalEntry *entry in self.redoEntries) {
+        _byteCount -= entry.byteCount;
+    }
+    
+    [self.redoEntries removeAllObjects];
+}
+
+- (void)evictEntriesOverBudget {
+    while ((_byteCount > self.byteBudget) && (self.undoEntries.count + self.redoEntries.count > 1)) {
+        /// The oldest undo entry goes first, then the redo entry furthest from the current state.
+        NSMutableArray<RTEUndoJournalEntry *> *entries = (self.undoEntries.count > 0) ? self.undoEntries : self.redoEntries;
+        
+        _byteCount -= entries.firstObject.byteCount;
+        [entries removeObjectAtIndex:0];
+    }
+}
+
+@end
@@ -10,11 +10,15 @@
 @interface WZProtocolInterceptor : NSObject
 
 @property (nonatomic, readonly, copy) NSArray * interceptedProtocols;
-@property (unsafe_unretained) id receiver;
-@property (unsafe_unretained) id middleMan;
+/// Setting either one clears the cached forwarding targets.
+@property (nonatomic, unsafe_unretained) id receiver;
+@property (nonatomic, unsafe_unretained) id middleMan;
 
 - (instancetype)initWithInterceptedProtocol:(Protocol *)interceptedProtocol;
 - (instancetype)initWithInterceptedProtocols:(Protocol *)firstInterceptedProtocol, ... NS_REQUIRES_NIL_TERMINATION;
 - (instancetype)initWithArrayOfInterceptedProtocols:(NSArray *)arrayOfInterceptedProtocols;
 
+/// Whether receiver responds to aSelector, looked up once per receiver.
+- (BOOL)receiverRespondsToSelector:(SEL)aSelector;
+
 @end
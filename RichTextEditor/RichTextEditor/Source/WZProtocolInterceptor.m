@@ -7,40 +7,104 @@
 
 #import "WZProtocolInterceptor.h"
 #import  <objc/runtime.h>
+#import "RTETrace.h"
 
 static inline BOOL selector_belongsToProtocol(SEL selector, Protocol * protocol);
 
+/// Who a selector is forwarded to, cached until the receiver or middle man changes.
+typedef NS_ENUM(uintptr_t, WZForwardingTarget) {
+    WZForwardingTargetUnknown = 0,
+    WZForwardingTargetMiddleMan,
+    WZForwardingTargetReceiver,
+    WZForwardingTargetNone
+};
+
+@interface WZProtocolInterceptor ()
+
+/// SEL to WZForwardingTarget, and SEL to whether the receiver responds to it plus one.
+@property (nonatomic, strong) NSMapTable *forwardingTargets;
+@property (nonatomic, strong) NSMapTable *receiverResponses;
+
+@end
+
 @implementation WZProtocolInterceptor
 - (id)forwardingTargetForSelector:(SEL)aSelector {
-    if (self.middleMan && [self.middleMan respondsToSelector:aSelector] &&
-        [self isSelectorContainedInInterceptedProtocols:aSelector]) {
-        return self.middleMan;
+    RTE_TRACE_COUNTER("WZProtocolInterceptor forwards", 1);
+    
+    switch ([self forwardingTargetOfSelector:aSelector]) {
+        case WZForwardingTargetMiddleMan:
+            return self.middleMan;
+        case WZForwardingTargetReceiver:
+            return self.receiver;
+        default:
+            return [super forwardingTargetForSelector:aSelector];
     }
+}
+
+- (BOOL)respondsToSelector:(SEL)aSelector {
+    if ([self forwardingTargetOfSelector:aSelector] != WZForwardingTargetNone) {
+        return YES;
+    }
+    
+    return [super respondsToSelector:aSelector];
+}
+
+- (void)setReceiver:(id)receiver {
+    _receiver = receiver;
+    [self.forwardingTargets removeAllObjects];
+    [self.receiverResponses removeAllObjects];
+}
+
+- (void)setMiddleMan:(id)middleMan {
+    _middleMan = middleMan;
+    [self.forwardingTargets removeAllObjects];
+}
+
+- (BOOL)receiverRespondsToSelector:(SEL)aSelector {
+    uintptr_t response = (uintptr_t)[self.receiverResponses objectForKey:(__bridge id)(void *)aSelector];
     
-    if ([self.receiver respondsToSelector:aSelector]) {
-        return self.receiver;
+    if (response == 0) {
+        response = (self.receiver && [self.receiver respondsToSelector:aSelector]) ? 2 : 1;
+        [self.receiverResponses setObject:(__bridge id)(void *)response forKey:(__bridge id)(void *)aSelector];
     }
     
-    return [super forwardingTargetForSelector:aSelector];
+    return response == 2;
 }
 
-- (BOOL)respondsToSelector:(SEL)aSelector {
+/// The protocol lookups and both respondsToSelector: checks run once per selector, the delegate methods are sent on every keystroke.
+- (WZForwardingTarget)forwardingTargetOfSelector:(SEL)aSelector {
+    WZForwardingTarget target = (WZForwardingTarget)[self.forwardingTargets objectForKey:(__bridge id)(void *)aSelector];
+    
+    if (target != WZForwardingTargetUnknown) {
+        return target;
+    }
+    
     if (self.middleMan && [self.middleMan respondsToSelector:aSelector] &&
         [self isSelectorContainedInInterceptedProtocols:aSelector]) {
-        return YES;
+        target = WZForwardingTargetMiddleMan;
+    } else if ([self receiverRespondsToSelector:aSelector]) {
+        target = WZForwardingTargetReceiver;
+    } else {
+        target = WZForwardingTargetNone;
     }
     
-    if (self.receiver && [self.receiver respondsToSelector:aSelector]) {
-        return YES;
-    }
+    [self.forwardingTargets setObject:(__bridge id)(void *)target forKey:(__bridge id)(void *)aSelector];
     
-    return [super respondsToSelector:aSelector];
+    return target;
+}
+
++ (NSMapTable *)selectorMapTable {
+    NSPointerFunctionsOptions options = NSPointerFunctionsOpaqueMemory | NSPointerFunctionsOpaquePersonality;
+    
+    return [[NSMapTable alloc] initWithKeyOptions:options valueOptions:options capacity:16];
 }
 
 - (instancetype)initWithInterceptedProtocol:(Protocol *)interceptedProtocol {
     self = [super init];
     if (self) {
         _interceptedProtocols = @[interceptedProtocol];
+        _forwardingTargets = [[self class] selectorMapTable];
+        _receiverResponses = [[self class] selectorMapTable];
     }
     return self;
 }
@@ -60,6 +124,8 @@ static inline BOOL selector_belongsToProtocol(SEL selector, Protocol * protocol)
             va_end(argumentList);
         }
         _interceptedProtocols = [mutableProtocols copy];
+        _forwardingTargets = [[self class] selectorMapTable];
+        _receiverResponses = [[self class] selectorMapTable];
     }
     return self;
 }
@@ -68,6 +134,8 @@ static inline BOOL selector_belongsToProtocol(SEL selector, Protocol * protocol)
     self = [super init];
     if (self) {
         _interceptedProtocols = [arrayOfInterceptedProtocols copy];
+        _forwardingTargets = [[self class] selectorMapTable];
+        _receiverResponses = [[self class] selectorMapTable];
     }
     return self;
 }
@@ -7,15 +7,190 @@
 //
 
 #import <XCTest/XCTest.h>
+#import <RichTextEditor/RichTextEditor.h>
+
+#import <stdatomic.h>
+#import <time.h>
+
+/// Document sizes in UTF-16 units, 1 KB to 20 MB.
+static const NSUInteger kBenchmarkDocumentSizes[] = {1024, 64 * 1024, 1024 * 1024, 20 * 1024 * 1024};
+/// The size the benchmarks run at when RTE_RUN_BENCHMARKS isn't set.
+static const NSUInteger kBenchmarkSmokeDocumentSize = 1024;
+/// Editor operations are skipped above this size unless RTE_BENCHMARK_MAX_BYTES says otherwise.
+static const NSUInteger kBenchmarkDefaultMaximumEditorBytes = 1024 * 1024;
+/// A benchmark fails when its median is slower than the baseline by more than this ratio, unless RTE_BENCHMARK_THRESHOLD says otherwise.
+static const double kBenchmarkDefaultRegressionThreshold = 0.20;
+static const uint64_t kBenchmarkSeed = 0x5eed1611;
+
+static uint64_t RTEBenchmarkNextRandom(uint64_t *state) {
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    
+    return x;
+}
+
+/// Kinds of edit -applyRandomEdits:toTextStorage:maxLength:kinds:check: picks from.
+typedef NS_OPTIONS(NSUInteger, RTERandomEditKind) {
+    RTERandomEditKindDelete = 1 << 0,
+    /// Replaces the range with one of a few phrases, newlines and markup included, or a long run of words.
+    RTERandomEditKindInsertText = 1 << 1,
+    RTERandomEditKindInsertBoldText = 1 << 2,
+    /// Inserts a bullet or numbering marker.
+    RTERandomEditKindInsertFormatList = 1 << 3,
+    RTERandomEditKindUnderline = 1 << 4,
+    RTERandomEditKindRemoveLink = 1 << 5,
+};
+
+static double RTEBenchmarkPercentile(NSArray<NSNumber *> *sortedSamples, double percentile) {
+    if (sortedSamples.count == 0) {
+        return 0;
+    }
+    
+    /// Nearest rank.
+    NSUInteger rank = (NSUInteger)ceil(percentile * sortedSamples.count);
+    
+    return sortedSamples[MIN(MAX(rank, 1), sortedSamples.count) - 1].doubleValue;
+}
+
+/// Stands in for an HTTP server: answers a request for a path starting with /ok with 200 and any other with 404,
+/// a little later so requests overlap, and records how many ran at once.
+@interface RTEStandInURLProtocol : NSURLProtocol
+
+@end
+
+static NSUInteger RTEStandInNumberOfRequests = 0;
+static NSUInteger RTEStandInRunningRequests = 0;
+static NSUInteger RTEStandInMaximumRunningRequests = 0;
+static NSUInteger RTEStandInMaximumRunningRequestsPerHost = 0;
+static NSCountedSet<NSString *> *RTEStandInRunningRequestsPerHost = nil;
+
+@implementation RTEStandInURLProtocol
+
++ (void)reset {
+    @synchronized (self) {
+        RTEStandInNumberOfRequests = 0;
+        RTEStandInRunningRequests = 0;
+        RTEStandInMaximumRunningRequests = 0;
+        RTEStandInMaximumRunningRequestsPerHost = 0;
+        RTEStandInRunningRequestsPerHost = [[NSCountedSet alloc] init];
+    }
+}
+
++ (BOOL)canInitWithRequest:(NSURLRequest *)request {
+    return YES;
+}
+
++ (NSURLRequest *)canonicalRequestForRequest:(NSURLRequest *)request {
+    return request;
+}
+
+- (void)startLoading {
+    @synchronized ([self class]) {
+        NSString *host = self.request.URL.host;
+        
+        RTEStandInNumberOfRequests++;
+        RTEStandInRunningRequests++;
+        [RTEStandInRunningRequestsPerHost addObject:host];
+        RTEStandInMaximumRunningRequests = MAX(RTEStandInMaximumRunningRequests, RTEStandInRunningRequests);
+        RTEStandInMaximumRunningRequestsPerHost = MAX(RTEStandInMaximumRunningRequestsPerHost, [RTEStandInRunningRequestsPerHost countForObject:host]);
+    }
+    
+    [self performSelector:@selector(respond) withObject:nil afterDelay:0.02];
+}
+
+- (void)stopLoading {
+    [NSObject cancelPreviousPerformRequestsWithTarget:self selector:@selector(respond) object:nil];
+}
+
+- (void)respond {
+    NSInteger statusCode = [self.request.URL.path hasPrefix:@"/ok"] ? 200 : 404;
+    NSHTTPURLResponse *response = [[NSHTTPURLResponse alloc] initWithURL:self.request.URL statusCode:statusCode HTTPVersion:@"HTTP/1.1" headerFields:@{}];
+    
+    @synchronized ([self class]) {
+        RTEStandInRunningRequests--;
+        [RTEStandInRunningRequestsPerHost removeObject:self.request.URL.host];
+    }
+    
+    [self.client URLProtocol:self didReceiveResponse:response cacheStoragePolicy:NSURLCacheStorageNotAllowed];
+    [self.client URLProtocolDidFinishLoading:self];
+}
+
+@end
+
+/// Answers every font name with the system font, except names starting with "Missing", and counts how often it's asked.
+@interface RTECountingFontProvider : NSObject <RTEFontProvider>
+
+@property (atomic, assign) NSUInteger numberOfLookups;
+
+@end
+
+@implementation RTECountingFontProvider
+
+- (NSFont *)fontWithName:(NSString *)name size:(CGFloat)size boldTrait:(BOOL)isBold italicTrait:(BOOL)isItalic {
+    @synchronized (self) {
+        self.numberOfLookups++;
+    }
+    
+    return [name hasPrefix:@"Missing"] ? nil : [NSFont systemFontOfSize:size];
+}
+
+@end
+
+/// Records the changes the text view asks about and allows them only while shouldChangeText is set.
+@interface RTERecordingTextViewDelegate : NSObject <NSTextViewDelegate>
+
+@property (nonatomic, assign) BOOL shouldChangeText;
+/// Changes whose replacement string contains it are refused.
+@property (nonatomic, copy) NSString *forbiddenString;
+@property (nonatomic, strong) NSMutableArray<NSValue *> *affectedRanges;
+@property (nonatomic, strong) NSMutableArray<NSString *> *replacementStrings;
+@property (nonatomic, assign) NSUInteger numberOfTextDidChange;
+
+@end
+
+@implementation RTERecordingTextViewDelegate
+
+- (instancetype)init {
+    if (self = [super init]) {
+        _shouldChangeText = YES;
+        _affectedRanges = [[NSMutableArray alloc] init];
+        _replacementStrings = [[NSMutableArray alloc] init];
+    }
+    
+    return self;
+}
+
+- (BOOL)textView:(NSTextView *)textView shouldChangeTextInRange:(NSRange)affectedCharRange replacementString:(NSString *)replacementString {
+    [self.affectedRanges addObject:[NSValue valueWithRange:affectedCharRange]];
+    [self.replacementStrings addObject:replacementString ?: @""];
+    
+    if ((self.forbiddenString != nil) && [replacementString containsString:self.forbiddenString]) {
+        return NO;
+    }
+    
+    return self.shouldChangeText;
+}
+
+- (void)textDidChange:(NSNotification *)notification {
+    self.numberOfTextDidChange++;
+}
+
+@end
 
 @interface RichTextEditorTests : XCTestCase
 
+@property (nonatomic, strong) NSMutableArray<NSDictionary *> *results;
+
 @end
 
 @implementation RichTextEditorTests
 
 - (void)setUp {
     // Put setup code here. This method is called before the invocation of each test method in the class.
+    self.results = [[NSMutableArray alloc] init];
 }
 
 - (void)tearDown {
@@ -27,11 +202,1787 @@
     // Use XCTAssert and related functions to verify your tests produce the correct results.
 }
 
-- (void)testPerformanceExample {
-    // This is an example of a performance test case.
-    [self measureBlock:^{
-        // Put the code you want to measure the time of here.
+- (void)testParagraphIndexMatchesLinearScanAcrossEdits {
+    NSArray<NSString *> *phrases = @[@"lorem ipsum ", @"dolor\n", @"\n", @"sit amet", @"\n\n", @""];
+    NSMutableString *string = [[NSMutableString alloc] init];
+    
+    srand48(1611);
+    
+    while (string.length < 8 * 1024) {
+        [string appendString:phrases[lrand48() % phrases.count]];
+    }
+    
+    NSTextStorage *textStorage = [[NSTextStorage alloc] initWithString:string];
+    
+    [textStorage attachParagraphIndex];
+    XCTAssertNotNil([textStorage RTEParagraphIndex]);
+    
+    for (NSUInteger edit = 0; edit < 300; edit++) {
+        NSUInteger location = lrand48() % (textStorage.length + 1);
+        NSRange range = NSMakeRange(location, MIN((NSUInteger)(lrand48() % 64), textStorage.length - location));
+        
+        [textStorage replaceCharactersInRange:range withString:phrases[lrand48() % phrases.count]];
+        
+        RTEParagraphIndex *paragraphIndex = [textStorage RTEParagraphIndex];
+        NSString *editedString = textStorage.string;
+        /// Without an index attached, the category scans the string.
+        NSAttributedString *unindexed = [[NSAttributedString alloc] initWithString:editedString];
+        
+        XCTAssertEqual(paragraphIndex.length, editedString.length);
+        XCTAssertEqual(paragraphIndex.numberOfParagraphs, [editedString componentsSeparatedByString:@"\n"].count, @"after %lu edits", (unsigned long)edit);
+        
+        for (NSUInteger sample = 0; sample < 16; sample++) {
+            NSUInteger sampleLocation = (sample == 0) ? editedString.length : lrand48() % (editedString.length + 1);
+            NSRange textRange = NSMakeRange(sampleLocation, MIN((NSUInteger)(lrand48() % 300), editedString.length - sampleLocation));
+            NSRange indexedParagraphRange = [textStorage firstParagraphRangeFromTextRange:textRange];
+            NSRange scannedParagraphRange = [unindexed firstParagraphRangeFromTextRange:textRange];
+            
+            XCTAssertTrue(NSEqualRanges(indexedParagraphRange, scannedParagraphRange), @"%@ after %lu edits", NSStringFromRange(textRange), (unsigned long)edit);
+            XCTAssertEqualObjects([textStorage rangeOfParagraphsFromTextRange:textRange], [unindexed rangeOfParagraphsFromTextRange:textRange], @"%@ after %lu edits", NSStringFromRange(textRange), (unsigned long)edit);
+        }
+    }
+}
+
+- (void)testHTMLSnifferFindsTagsInLinearTime {
+    NSDictionary<NSString *, NSNumber *> *cases = @{
+        @"": @(RTEHTMLSnifferResultPlainText),
+        @"plain text": @(RTEHTMLSnifferResultPlainText),
+        @"a < b > c": @(RTEHTMLSnifferResultPlainText),
+        @"<unterminated": @(RTEHTMLSnifferResultPlainText),
+        @"x <a b=\"unterminated>": @(RTEHTMLSnifferResultPlainText),
+        /// A quoted '<' ends the candidate and starts the next one.
+        @"<p class=\"a<b\">": @(RTEHTMLSnifferResultPlainText),
+        @"<b>bold</b>": @(RTEHTMLSnifferResultMarkup),
+        @"text</p>": @(RTEHTMLSnifferResultMarkup),
+        @"line<br/>": @(RTEHTMLSnifferResultMarkup),
+        @"<p class=\"x\" hidden >": @(RTEHTMLSnifferResultMarkup),
+        @"<a href='x'>": @(RTEHTMLSnifferResultMarkup),
+        @"<a href = x>": @(RTEHTMLSnifferResultMarkup),
+    };
+    
+    for (NSString *string in cases) {
+        XCTAssertEqual([RTEHTMLSniffer sniffString:string], cases[string].integerValue, @"%@", string);
+        XCTAssertEqual([RichTextEditor isHTML:string], cases[string].integerValue != RTEHTMLSnifferResultPlainText, @"%@", string);
+    }
+    
+    NSAttributedString *text = [[NSAttributedString alloc] initWithString:@"exported\ntext" attributes:@{NSFontAttributeName: [NSFont fontWithName:@"Helvetica" size:12]}];
+    XCTAssertEqual([RTEHTMLSniffer sniffString:[RichTextEditor htmlStringFromAttributedText:text]], RTEHTMLSnifferResultExportedHTML);
+    
+    /// Failed candidates are never rescanned, so inputs that backtracked in the old regular expression take a single pass.
+    NSUInteger length = 1024 * 1024;
+    NSString *unterminatedValue = [@"<a b=\"" stringByPaddingToLength:length withString:@"x" startingAtIndex:0];
+    NSString *attributesWithoutEnd = [@"<a" stringByPaddingToLength:length withString:@" b" startingAtIndex:0];
+    NSString *repeatedCandidates = [@"" stringByPaddingToLength:length withString:@"<a b='" startingAtIndex:0];
+    CFAbsoluteTime start = CFAbsoluteTimeGetCurrent();
+    
+    for (NSString *string in @[unterminatedValue, attributesWithoutEnd, repeatedCandidates]) {
+        XCTAssertEqual([RTEHTMLSniffer sniffString:string], RTEHTMLSnifferResultPlainText);
+    }
+    
+    /// A generous bound, a backtracking scan takes minutes.
+    XCTAssertLessThan(CFAbsoluteTimeGetCurrent() - start, 2.0);
+}
+
+- (void)testFormatListCacheMatchesLinearScanAcrossEdits {
+    NSString *bulletString = [NSString stringWithFormat:@"%C%C", (unichar)0x10, (unichar)0xA0];
+    NSString *numberingString = [NSString stringWithFormat:@"%C%C", (unichar)0x11, (unichar)0xA0];
+    NSArray<NSString *> *phrases = @[bulletString, numberingString, numberingString, @"item\n", @"\n", @"text ", @""];
+    NSMutableString *string = [[NSMutableString alloc] init];
+    /// Any level that depends on the paragraph's text only, so an edit elsewhere never changes it.
+    RTEFormatListLevelProvider levelProvider = ^NSUInteger(NSRange paragraphRange) {
+        return paragraphRange.length % 3;
+    };
+    
+    srand48(1611);
+    
+    while (string.length < 8 * 1024) {
+        [string appendString:phrases[lrand48() % phrases.count]];
+    }
+    
+    RTEFormatListCache *formatListCache = [[RTEFormatListCache alloc] initWithString:string levelProvider:levelProvider];
+    
+    for (NSUInteger edit = 0; edit <= 300; edit++) {
+        NSUInteger location = lrand48() % (string.length + 1);
+        NSRange range = NSMakeRange(location, MIN((NSUInteger)(lrand48() % 32), string.length - location));
+        NSString *replacement = phrases[lrand48() % phrases.count];
+        
+        [string replaceCharactersInRange:range withString:replacement];
+        [formatListCache replaceCharactersInRange:range withString:replacement resultingString:string];
+        
+        if (edit % 10 != 0) {
+            continue;
+        }
+        
+        NSArray<NSString *> *paragraphs = [string componentsSeparatedByString:@"\n"];
+        NSMutableArray<NSNumber *> *types = [[NSMutableArray alloc] initWithCapacity:paragraphs.count];
+        NSMutableArray<NSNumber *> *levels = [[NSMutableArray alloc] initWithCapacity:paragraphs.count];
+        NSUInteger paragraphLocation = 0;
+        
+        XCTAssertEqual(formatListCache.length, string.length);
+        XCTAssertEqual(formatListCache.numberOfParagraphs, paragraphs.count);
+        
+        for (NSUInteger i = 0; i < paragraphs.count; i++) {
+            RTEFormatListType type = [paragraphs[i] hasPrefix:bulletString] ? RTEFormatListTypeBullet : [paragraphs[i] hasPrefix:numberingString] ? RTEFormatListTypeNumbering : RTEFormatListTypeNone;
+            
+            [types addObject:@(type)];
+            [levels addObject:@((type != RTEFormatListTypeNone) ? MIN(levelProvider(NSMakeRange(paragraphLocation, paragraphs[i].length)), kFormatListMaximumLevel) : 0)];
+            
+            XCTAssertTrue(NSEqualRanges([formatListCache rangeOfParagraphAtIndex:i], NSMakeRange(paragraphLocation, paragraphs[i].length)), @"paragraph %lu after %lu edits", (unsigned long)i, (unsigned long)edit);
+            XCTAssertEqual([formatListCache paragraphIndexAtLocation:paragraphLocation], i);
+            
+            paragraphLocation += paragraphs[i].length + 1;
+        }
+        
+        for (NSUInteger i = 0; i < paragraphs.count; i++) {
+            RTEFormatListType type = types[i].integerValue;
+            NSUInteger level = levels[i].unsignedIntegerValue;
+            NSInteger number = 0;
+            
+            /// Count the numbered paragraphs at this level back to the run's start or a lower level.
+            if (type == RTEFormatListTypeNumbering) {
+                for (NSInteger j = (NSInteger)i; (j >= 0) && (types[j].integerValue != RTEFormatListTypeNone) && (levels[j].unsignedIntegerValue >= level); j--) {
+                    number += ((types[j].integerValue == RTEFormatListTypeNumbering) && (levels[j].unsignedIntegerValue == level)) ? 1 : 0;
+                }
+            }
+            
+            XCTAssertEqual([formatListCache typeOfParagraphAtIndex:i], type, @"paragraph %lu after %lu edits", (unsigned long)i, (unsigned long)edit);
+            XCTAssertEqual([formatListCache levelOfParagraphAtIndex:i], level, @"paragraph %lu after %lu edits", (unsigned long)i, (unsigned long)edit);
+            XCTAssertEqual([formatListCache numberOfParagraphAtIndex:i], number, @"paragraph %lu after %lu edits", (unsigned long)i, (unsigned long)edit);
+        }
+    }
+}
+
+- (void)testStyleTableInternsEqualStyles {
+    RTEStyleTable *styleTable = [[RTEStyleTable alloc] init];
+    NSMutableParagraphStyle *paragraphStyle = [[NSMutableParagraphStyle alloc] init];
+    NSMutableParagraphStyle *equalParagraphStyle = [[NSMutableParagraphStyle alloc] init];
+    NSUInteger numberOfCharacterStyles = styleTable.numberOfCharacterStyles;
+    NSUInteger numberOfParagraphStyles = styleTable.numberOfParagraphStyles;
+    
+    paragraphStyle.headIndent = 20;
+    equalParagraphStyle.headIndent = 20;
+    
+    /// Equal dictionaries built apart share one ID and one instance, the paragraph style isn't part of the character style.
+    NSDictionary *attributes = @{NSFontAttributeName: [NSFont fontWithName:@"Helvetica" size:14], NSForegroundColorAttributeName: [NSColor redColor]};
+    NSDictionary *equalAttributes = @{NSForegroundColorAttributeName: [NSColor redColor], NSFontAttributeName: [NSFont fontWithName:@"Helvetica" size:14], NSParagraphStyleAttributeName: equalParagraphStyle};
+    NSDictionary *otherAttributes = @{NSFontAttributeName: [NSFont fontWithName:@"Helvetica" size:15], NSForegroundColorAttributeName: [NSColor redColor]};
+    RTEStyleID characterStyleID = [styleTable characterStyleIDForAttributes:attributes];
+    
+    XCTAssertEqual([styleTable characterStyleIDForAttributes:nil], RTEStyleIDNone);
+    XCTAssertEqual([styleTable characterStyleIDForAttributes:@{}], RTEStyleIDNone);
+    XCTAssertEqual([styleTable paragraphStyleIDForParagraphStyle:nil], RTEStyleIDNone);
+    XCTAssertNotEqual(characterStyleID, RTEStyleIDNone);
+    XCTAssertEqual([styleTable characterStyleIDForAttributes:[attributes mutableCopy]], characterStyleID);
+    XCTAssertEqual([styleTable characterStyleIDForAttributes:equalAttributes], characterStyleID);
+    XCTAssertNotEqual([styleTable characterStyleIDForAttributes:otherAttributes], characterStyleID);
+    XCTAssertEqual(styleTable.numberOfCharacterStyles, numberOfCharacterStyles + 2);
+    XCTAssertEqualObjects([styleTable characterAttributesForStyleID:characterStyleID], attributes);
+    XCTAssertTrue([styleTable characterAttributesForStyleID:characterStyleID] == [styleTable characterAttributesForStyleID:[styleTable characterStyleIDForAttributes:equalAttributes]]);
+    
+    /// An interned paragraph style is a copy, later changes to the original don't reach it.
+    RTEStyleID paragraphStyleID = [styleTable paragraphStyleIDForParagraphStyle:paragraphStyle];
+    
+    XCTAssertEqual([styleTable paragraphStyleIDForParagraphStyle:equalParagraphStyle], paragraphStyleID);
+    XCTAssertEqual(styleTable.numberOfParagraphStyles, numberOfParagraphStyles + 1);
+    paragraphStyle.headIndent = 40;
+    XCTAssertEqual([styleTable paragraphStyleForStyleID:paragraphStyleID].headIndent, 20);
+    XCTAssertNotEqual([styleTable paragraphStyleIDForParagraphStyle:paragraphStyle], paragraphStyleID);
+    
+    RTEStyleID splitCharacterStyleID = RTEStyleIDNone;
+    RTEStyleID splitParagraphStyleID = RTEStyleIDNone;
+    
+    [styleTable getCharacterStyleID:&splitCharacterStyleID paragraphStyleID:&splitParagraphStyleID forAttributes:equalAttributes];
+    XCTAssertEqual(splitCharacterStyleID, characterStyleID);
+    XCTAssertEqual(splitParagraphStyleID, paragraphStyleID);
+    XCTAssertEqualObjects([styleTable attributesForCharacterStyleID:characterStyleID paragraphStyleID:paragraphStyleID], equalAttributes);
+    XCTAssertTrue([styleTable attributesForCharacterStyleID:characterStyleID paragraphStyleID:paragraphStyleID] == [styleTable attributesForCharacterStyleID:characterStyleID paragraphStyleID:paragraphStyleID]);
+    
+    /// Indenting equal styles copies once and leaves the source alone.
+    NSParagraphStyle *indented = [styleTable paragraphStyle:equalParagraphStyle withFirstLineHeadIndent:10 headIndent:30];
+    
+    XCTAssertEqual(indented.firstLineHeadIndent, 10);
+    XCTAssertEqual(indented.headIndent, 30);
+    XCTAssertEqual(equalParagraphStyle.headIndent, 20);
+    XCTAssertTrue([styleTable paragraphStyle:[equalParagraphStyle copy] withFirstLineHeadIndent:10 headIndent:30] == indented);
+    
+    /// Runs rebuild the document they were made from, with equal neighbours merged.
+    NSArray<NSDictionary *> *runAttributes = @[attributes, equalAttributes, otherAttributes, @{}, @{NSParagraphStyleAttributeName: paragraphStyle}];
+    NSMutableAttributedString *document = [[NSMutableAttributedString alloc] init];
+    
+    srand48(1611);
+    
+    for (NSUInteger i = 0; i < 500; i++) {
+        NSString *text = (lrand48() % 4 == 0) ? @"paragraph\n" : @"words ";
+        [document appendAttributedString:[[NSAttributedString alloc] initWithString:text attributes:runAttributes[lrand48() % runAttributes.count]]];
+    }
+    
+    RTEStyleRuns *runs = [[RTEStyleRuns alloc] initWithAttributedString:document styleTable:styleTable];
+    
+    XCTAssertEqual(runs.length, document.length);
+    XCTAssertEqualObjects([runs attributedStringWithString:document.string], document);
+    
+    for (NSUInteger i = 1; i < runs.count; i++) {
+        RTEStyleRun previousRun = [runs runAtIndex:i - 1];
+        RTEStyleRun run = [runs runAtIndex:i];
+        
+        XCTAssertGreaterThan(run.length, 0);
+        XCTAssertFalse((run.characterStyleID == previousRun.characterStyleID) && (run.paragraphStyleID == previousRun.paragraphStyleID), @"run %lu", (unsigned long)i);
+    }
+}
+
+- (void)testBinaryDocumentRejectsTruncatedAndCorruptData {
+    NSString *bulletString = [NSString stringWithFormat:@"%C%C", (unichar)0x10, (unichar)0xA0];
+    NSString *numberingString = [NSString stringWithFormat:@"%C%C", (unichar)0x11, (unichar)0xA0];
+    NSMutableParagraphStyle *listParagraphStyle = [[NSMutableParagraphStyle alloc] init];
+    NSMutableAttributedString *original = [[NSMutableAttributedString alloc] init];
+    NSDictionary *attributes = @{NSFontAttributeName: [NSFont fontWithName:@"Helvetica" size:14]};
+    
+    listParagraphStyle.firstLineHeadIndent = 10;
+    listParagraphStyle.headIndent = 30;
+    
+    for (NSUInteger i = 0; i < 60; i++) {
+        NSString *marker = (i % 3 == 0) ? @"" : (i % 3 == 1) ? bulletString : numberingString;
+        NSMutableDictionary *paragraphAttributes = [attributes mutableCopy];
+        
+        if (marker.length > 0) {
+            paragraphAttributes[NSParagraphStyleAttributeName] = listParagraphStyle;
+        }
+        
+        [original appendAttributedString:[[NSAttributedString alloc] initWithString:[NSString stringWithFormat:@"%@paragraph %lu of the document\n", marker, (unsigned long)i] attributes:paragraphAttributes]];
+    }
+    
+    NSData *data = [RTEBinaryDocument dataWithAttributedString:original];
+    NSError *error = nil;
+    RTEBinaryDocument *document = [[RTEBinaryDocument alloc] initWithData:data error:&error];
+    
+    srand48(1611);
+    
+    XCTAssertNotNil(document, @"%@", error);
+    XCTAssertEqualObjects(document.string, original.string);
+    XCTAssertEqual(document.attributedString.length, original.length);
+    
+    /// The style table ends the data, so every prefix is missing at least part of it.
+    for (NSUInteger length = 0; length < data.length; length += (length < 128) ? 1 : 61) {
+        error = nil;
+        XCTAssertNil([[RTEBinaryDocument alloc] initWithData:[data subdataWithRange:NSMakeRange(0, length)] error:&error], @"length %lu", (unsigned long)length);
+        XCTAssertEqualObjects(error.domain, RTEBinaryDocumentErrorDomain);
+        XCTAssertEqual(error.code, RTEBinaryDocumentErrorInvalidData);
+    }
+    
+    /// Every header byte set to a few values: the magic and version are rejected, any other document that is accepted stays consistent.
+    for (NSUInteger offset = 0; offset < 64; offset++) {
+        uint8_t originalByte = ((const uint8_t *)data.bytes)[offset];
+        
+        for (NSNumber *value in @[@0x00, @0xFF, @(originalByte ^ 0x01), @(originalByte ^ 0x80)]) {
+            NSMutableData *corrupt = [data mutableCopy];
+            ((uint8_t *)corrupt.mutableBytes)[offset] = value.unsignedCharValue;
+            
+            if (((uint8_t *)corrupt.mutableBytes)[offset] == originalByte) {
+                continue;
+            }
+            
+            error = nil;
+            document = [[RTEBinaryDocument alloc] initWithData:corrupt error:&error];
+            
+            if (offset < 12) {
+                XCTAssertNil(document, @"offset %lu", (unsigned long)offset);
+                XCTAssertEqual(error.code, (offset < 8) ? RTEBinaryDocumentErrorInvalidData : RTEBinaryDocumentErrorUnsupportedVersion);
+            } else if (document != nil) {
+                XCTAssertEqual(document.attributedString.length, document.string.length, @"offset %lu", (unsigned long)offset);
+            } else {
+                XCTAssertEqual(error.code, RTEBinaryDocumentErrorInvalidData);
+            }
+        }
+    }
+    
+    /// A few random bytes anywhere in the data.
+    for (NSUInteger iteration = 0; iteration < 500; iteration++) {
+        NSMutableData *corrupt = [data mutableCopy];
+        NSUInteger numberOfMutations = 1 + lrand48() % 4;
+        
+        for (NSUInteger mutation = 0; mutation < numberOfMutations; mutation++) {
+            ((uint8_t *)corrupt.mutableBytes)[lrand48() % corrupt.length] = (uint8_t)lrand48();
+        }
+        
+        document = [[RTEBinaryDocument alloc] initWithData:corrupt error:NULL];
+        
+        for (NSUInteger i = 0; i < document.numberOfListMarkers; i++) {
+            XCTAssertLessThan([document listMarkerAtIndex:i].location, document.string.length);
+        }
+        
+        XCTAssertEqual(document.attributedString.length, document.string.length, @"iteration %lu", (unsigned long)iteration);
+    }
+}
+
+- (void)testBinaryDocumentKeepsNestedListLevels {
+    NSString *bulletString = [NSString stringWithFormat:@"%C%C", (unichar)0x10, (unichar)0xA0];
+    NSString *numberingString = [NSString stringWithFormat:@"%C%C", (unichar)0x11, (unichar)0xA0];
+    NSFont *font = [NSFont fontWithName:@"Helvetica" size:14];
+    /// The editor's indentation step, every step nests a list item one level deeper.
+    CGFloat indentationStep = 52;
+    NSUInteger levels[] = {0, 1, 2, 2, 1, 0, 3};
+    NSMutableAttributedString *original = [[NSMutableAttributedString alloc] init];
+    
+    for (NSUInteger i = 0; i < sizeof(levels) / sizeof(levels[0]); i++) {
+        NSString *marker = (i % 2 == 0) ? numberingString : bulletString;
+        NSMutableParagraphStyle *paragraphStyle = [[NSMutableParagraphStyle alloc] init];
+        
+        /// Drawing widens the firstLineHeadIndent to fit the marker, the headIndent keeps the level.
+        paragraphStyle.firstLineHeadIndent = (levels[i] + 3) * indentationStep;
+        paragraphStyle.headIndent = (levels[i] + 1) * indentationStep + [marker sizeWithAttributes:@{NSFontAttributeName: font}].width;
+        
+        [original appendAttributedString:[[NSAttributedString alloc] initWithString:[NSString stringWithFormat:@"%@item %lu\n", marker, (unsigned long)i] attributes:@{NSFontAttributeName: font, NSParagraphStyleAttributeName: paragraphStyle}]];
+    }
+    
+    NSError *error = nil;
+    RTEBinaryDocument *document = [[RTEBinaryDocument alloc] initWithData:[RTEBinaryDocument dataWithAttributedString:original] error:&error];
+    
+    XCTAssertNotNil(document, @"%@", error);
+    XCTAssertEqual(document.numberOfListMarkers, sizeof(levels) / sizeof(levels[0]));
+    XCTAssertEqualObjects(document.attributedString, original);
+    
+    for (NSUInteger i = 0; i < document.numberOfListMarkers; i++) {
+        RTEBinaryDocumentListMarker marker = [document listMarkerAtIndex:i];
+        
+        XCTAssertEqual(marker.type, (i % 2 == 0) ? RTEBinaryDocumentListTypeNumbering : RTEBinaryDocumentListTypeBullet);
+        XCTAssertEqual(marker.level, levels[i], @"marker %lu", (unsigned long)i);
+    }
+}
+
+- (void)testSyntheticDocumentIsDeterministic {
+    NSAttributedString *first = [self syntheticDocumentWithLength:16 * 1024];
+    NSAttributedString *second = [self syntheticDocumentWithLength:16 * 1024];
+    
+    XCTAssertEqual(first.length, 16 * 1024);
+    XCTAssertEqualObjects(first, second);
+}
+
+- (void)testHTMLSerializerEscapesRoundTrip {
+    NSDictionary *attributes = @{NSFontAttributeName: [NSFont fontWithName:@"Helvetica" size:12]};
+    NSMutableString *text = [NSMutableString stringWithString:@"a"];
+    
+    for (unichar character = 0; character < 0x80; character++) {
+        if (character != '\n') {
+            [text appendFormat:@"%C", character];
+        }
+    }
+    
+    [text appendString:@" &amp; <p> &#x10; \"quoted\" 'single' \u00a0nbsp\u00a0 caf\u00e9 \U0001F600 \u2028\nsecond paragraph"];
+    
+    NSString *html = [[[RTEHTMLSerializer alloc] init] HTMLStringFromAttributedString:[[NSAttributedString alloc] initWithString:text attributes:attributes]];
+    NSAttributedString *parsed = [[[RTEHTMLParser alloc] initWithDefaultAttributes:attributes] attributedStringFromHTMLString:html];
+    NSString *expected = [[text stringByReplacingOccurrencesOfString:[NSString stringWithFormat:@"%C", (unichar)0] withString:@"\uFFFD"] stringByAppendingString:@"\n"];
+    
+    /// Every paragraph is read back with its newline, the last one included.
+    XCTAssertEqualObjects(parsed.string, expected);
+}
+
+- (void)testHTMLSerializerAndParserRoundTripDocuments {
+    for (NSUInteger i = 0; i < sizeof(kBenchmarkDocumentSizes) / sizeof(kBenchmarkDocumentSizes[0]); i++) {
+        if (kBenchmarkDocumentSizes[i] > 64 * 1024) {
+            break;
+        }
+        
+        NSAttributedString *document = [self syntheticDocumentWithLength:kBenchmarkDocumentSizes[i]];
+        NSString *html = [[[RTEHTMLSerializer alloc] init] HTMLStringFromAttributedString:document];
+        NSAttributedString *parsed = [[[RTEHTMLParser alloc] initWithDefaultAttributes:@{}] attributedStringFromHTMLString:html];
+        
+        XCTAssertEqualObjects(parsed.string, [document.string stringByAppendingString:@"\n"]);
+        
+        [document enumerateAttribute:NSFontAttributeName inRange:NSMakeRange(0, document.length) options:0 usingBlock:^(NSFont *font, NSRange range, BOOL *stop) {
+            /// Runs without a font take the default one.
+            if ((font == nil) || (range.location >= parsed.length)) {
+                return;
+            }
+            
+            NSFont *parsedFont = [parsed attribute:NSFontAttributeName atIndex:range.location effectiveRange:NULL];
+            
+            XCTAssertEqualObjects(parsedFont.fontName, font.fontName, @"at %lu", (unsigned long)range.location);
+            XCTAssertEqual(parsedFont.pointSize, font.pointSize, @"at %lu", (unsigned long)range.location);
+        }];
+    }
+}
+
+- (void)testBatchConverterMatchesSingleConversions {
+    NSMutableArray<NSAttributedString *> *documents = [[NSMutableArray alloc] init];
+    NSMutableArray<NSString *> *expected = [[NSMutableArray alloc] init];
+    RTEBatchConverter *converter = [[RTEBatchConverter alloc] init];
+    XCTestExpectation *completion = [self expectationWithDescription:@"batch completion"];
+    
+    converter.maximumConcurrentConversions = 3;
+    
+    /// Small documents after large ones reuse a serializer whose buffer was let go.
+    for (NSUInteger i = 0; i < 24; i++) {
+        NSAttributedString *document = (i == 5) ? [[NSAttributedString alloc] initWithString:@" \n\t"] : [self syntheticDocumentWithLength:((i % 4 == 0) ? 600 * 1024 : 1024 + i * 97)];
+        
+        [documents addObject:document];
+        [expected addObject:[RichTextEditor htmlStringFromAttributedText:document]];
+    }
+    
+    [converter convertAttributedStrings:documents completion:^(NSArray<id> *results, NSDictionary<NSNumber *, NSError *> *errors) {
+        XCTAssertEqualObjects(errors, @{});
+        XCTAssertEqualObjects(results, expected);
+        [completion fulfill];
     }];
+    
+    [self waitForExpectationsWithTimeout:60 handler:nil];
+}
+
+- (void)testBatchConverterNeverWaitsForTheMainThread {
+    NSDictionary *attributes = @{NSFontAttributeName: [NSFont fontWithName:@"Helvetica" size:12]};
+    NSString *exportedHTML = [RichTextEditor htmlStringFromAttributedText:[[NSAttributedString alloc] initWithString:@"exported" attributes:attributes]];
+    NSString *foreignHTML = @"<html><body><p>foreign <b>markup</b></p></body></html>";
+    RTEBatchConverter *converter = [[RTEBatchConverter alloc] init];
+    dispatch_semaphore_t done = dispatch_semaphore_create(0);
+    __block NSArray<id> *batchResults = nil;
+    __block NSDictionary<NSNumber *, NSError *> *batchErrors = nil;
+    
+    [converter convertHTMLStrings:@[exportedHTML, @"plain text", foreignHTML] defaultAttributes:attributes completion:^(NSArray<id> *results, NSDictionary<NSNumber *, NSError *> *errors) {
+        batchResults = results;
+        batchErrors = errors;
+        dispatch_semaphore_signal(done);
+    }];
+    
+    /// The main thread is blocked until the batch is done, which used to deadlock on foreign HTML.
+    XCTAssertEqual(dispatch_semaphore_wait(done, dispatch_time(DISPATCH_TIME_NOW, 30 * NSEC_PER_SEC)), 0);
+    XCTAssertEqualObjects([batchResults[0] string], @"exported\n");
+    XCTAssertEqualObjects([batchResults[1] string], @"plain text");
+    XCTAssertEqualObjects(batchResults[2], [NSNull null]);
+    XCTAssertEqualObjects(batchErrors[@2].domain, RTEBatchConverterErrorDomain);
+    XCTAssertEqual(batchErrors[@2].code, RTEBatchConverterErrorRequiresMainThread);
+    XCTAssertEqual(batchErrors.count, 1);
+    
+    /// The failed item converts on the main thread.
+    XCTAssertTrue([[RichTextEditor attributedStringFromHTMLString:foreignHTML defaultAttributes:attributes].string containsString:@"foreign markup"]);
+}
+
+- (void)testHTMLParserSurvivesMalformedInput {
+    NSDictionary *defaultAttributes = @{NSFontAttributeName: [NSFont fontWithName:@"Helvetica" size:12], NSForegroundColorAttributeName: [NSColor blackColor]};
+    NSString *html = [RichTextEditor htmlStringFromAttributedText:[self syntheticDocumentWithLength:2 * 1024]];
+    NSArray<NSString *> *fragments = @[@"<", @">", @"&", @"&#", @"&#x;", @"&#x110000;", @"&#0;", @"&#xD800;", @"&bogus;", @"\"", @"'", @"\\'", @"<p>", @"</p>", @"</span>", @"<br>", @"<span style=\"font-size:-5px;color:#zzz;font-family:'\">", @"<span style=\"color:rgb(1,2\">", [NSString stringWithFormat:@"%C", (unichar)0]];
+    uint64_t state = kBenchmarkSeed;
+    
+    XCTAssertNotNil([[[RTEHTMLParser alloc] initWithDefaultAttributes:defaultAttributes] attributedStringFromHTMLString:html]);
+    
+    for (NSUInteger iteration = 0; iteration < 500; iteration++) {
+        NSMutableString *malformed = [html mutableCopy];
+        NSUInteger numberOfMutations = 1 + RTEBenchmarkNextRandom(&state) % 3;
+        
+        for (NSUInteger mutation = 0; mutation < numberOfMutations; mutation++) {
+            NSUInteger location = RTEBenchmarkNextRandom(&state) % (malformed.length + 1);
+            
+            switch (RTEBenchmarkNextRandom(&state) % 3) {
+                case 0:
+                    [malformed deleteCharactersInRange:NSMakeRange(location, malformed.length - location)];
+                    break;
+                case 1:
+                    [malformed deleteCharactersInRange:NSMakeRange(location, MIN(RTEBenchmarkNextRandom(&state) % 16, malformed.length - location))];
+                    break;
+                default:
+                    [malformed insertString:fragments[RTEBenchmarkNextRandom(&state) % fragments.count] atIndex:location];
+                    break;
+            }
+        }
+        
+        /// Anything the parser doesn't recognize is handed back as nil, it never throws.
+        XCTAssertNoThrow([[[RTEHTMLParser alloc] initWithDefaultAttributes:defaultAttributes] attributedStringFromHTMLString:malformed], @"iteration %lu", (unsigned long)iteration);
+    }
+}
+
+- (void)testHTMLParserKeepsSystemFontTraitsOffTheMainThread {
+    NSFont *systemFont = [NSFont systemFontOfSize:13];
+    NSFontDescriptorSymbolicTraits boldItalic = NSFontDescriptorTraitBold | NSFontDescriptorTraitItalic;
+    NSFont *boldItalicFont = [NSFont fontWithDescriptor:[systemFont.fontDescriptor fontDescriptorWithSymbolicTraits:boldItalic] size:13];
+    NSString *html = [RichTextEditor htmlStringFromAttributedText:[[NSAttributedString alloc] initWithString:@"system" attributes:@{NSFontAttributeName: boldItalicFont ?: systemFont}]];
+    XCTestExpectation *parsed = [self expectationWithDescription:@"parsed"];
+    __block NSFont *font = nil;
+    
+    dispatch_async(dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+        NSAttributedString *attributedString = [[[RTEHTMLParser alloc] initWithDefaultAttributes:@{}] attributedStringFromHTMLString:html];
+        
+        font = [attributedString attribute:NSFontAttributeName atIndex:0 effectiveRange:NULL];
+        [parsed fulfill];
+    });
+    
+    [self waitForExpectationsWithTimeout:10 handler:nil];
+    XCTAssertNotNil(font);
+    XCTAssertEqual(font.pointSize, 13);
+    XCTAssertEqual(font.fontDescriptor.symbolicTraits & boldItalic, boldItalicFont.fontDescriptor.symbolicTraits & boldItalic);
+}
+
+- (void)testFontCacheGivesUsedFontsASecondChance {
+    RTECountingFontProvider *provider = [[RTECountingFontProvider alloc] init];
+    RTEFontCache *cache = [[RTEFontCache alloc] initWithProvider:provider capacity:8];
+    
+    for (NSUInteger i = 0; i < 8; i++) {
+        [cache fontWithName:[NSString stringWithFormat:@"Font%lu", (unsigned long)i] size:12 boldTrait:NO italicTrait:NO];
+    }
+    
+    for (NSUInteger i = 0; i < 4; i++) {
+        [cache fontWithName:[NSString stringWithFormat:@"Font%lu", (unsigned long)i] size:12 boldTrait:NO italicTrait:NO];
+    }
+    
+    XCTAssertEqual(cache.hitCount, 4);
+    
+    for (NSUInteger i = 8; i < 12; i++) {
+        [cache fontWithName:[NSString stringWithFormat:@"Font%lu", (unsigned long)i] size:12 boldTrait:NO italicTrait:NO];
+    }
+    
+    XCTAssertEqual(cache.evictionCount, 4);
+    XCTAssertEqual(provider.numberOfLookups, 12);
+    
+    /// The fonts used after they were cached survive, the ones never used again made room.
+    for (NSUInteger i = 0; i < 4; i++) {
+        [cache fontWithName:[NSString stringWithFormat:@"Font%lu", (unsigned long)i] size:12 boldTrait:NO italicTrait:NO];
+    }
+    
+    XCTAssertEqual(provider.numberOfLookups, 12);
+    
+    [cache fontWithName:@"Font4" size:12 boldTrait:NO italicTrait:NO];
+    XCTAssertEqual(provider.numberOfLookups, 13);
+    
+    /// Sizes and traits are part of the key.
+    [cache resetStatistics];
+    [cache fontWithName:@"Font0" size:13 boldTrait:NO italicTrait:NO];
+    [cache fontWithName:@"Font0" size:12 boldTrait:YES italicTrait:NO];
+    [cache fontWithName:@"Font0" size:12 boldTrait:NO italicTrait:YES];
+    XCTAssertEqual(cache.missCount, 3);
+}
+
+- (void)testFontCacheServesConcurrentLookups {
+    RTECountingFontProvider *provider = [[RTECountingFontProvider alloc] init];
+    RTEFontCache *cache = [[RTEFontCache alloc] initWithProvider:provider capacity:16];
+    NSUInteger numberOfLookups = 10000;
+    atomic_ulong numberOfWrongFonts;
+    atomic_init(&numberOfWrongFonts, 0);
+    atomic_ulong *wrongFonts = &numberOfWrongFonts;
+    
+    /// Twice as many keys as the cache holds, so lookups race with evictions.
+    dispatch_apply(numberOfLookups, dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^(size_t i) {
+        CGFloat size = 10 + i % 32;
+        NSFont *font = [cache fontWithName:@"Font" size:size boldTrait:NO italicTrait:NO];
+        
+        if (font == nil || font.pointSize != size) {
+            atomic_fetch_add(wrongFonts, 1);
+        }
+    });
+    
+    XCTAssertEqual(atomic_load(&numberOfWrongFonts), 0);
+    XCTAssertEqual(cache.hitCount + cache.missCount, numberOfLookups);
+    XCTAssertEqual(provider.numberOfLookups, cache.missCount);
+    XCTAssertGreaterThan(cache.evictionCount, 0);
+}
+
+- (void)testFontCacheForgetsMissesWhenTheAvailableFontsChange {
+    RTECountingFontProvider *provider = [[RTECountingFontProvider alloc] init];
+    RTEFontCache *cache = [[RTEFontCache alloc] initWithProvider:provider capacity:8];
+    
+    XCTAssertNil([cache fontWithName:@"MissingFont" size:12 boldTrait:NO italicTrait:NO]);
+    XCTAssertNil([cache fontWithName:@"MissingFont" size:12 boldTrait:NO italicTrait:NO]);
+    XCTAssertEqual(provider.numberOfLookups, 1);
+    
+    [[NSNotificationCenter defaultCenter] postNotificationName:RTEFontManagerDidUpdateAvailableFontsNotification object:nil];
+    [cache fontWithName:@"MissingFont" size:12 boldTrait:NO italicTrait:NO];
+    XCTAssertEqual(provider.numberOfLookups, 2);
+    
+    [[NSNotificationCenter defaultCenter] postNotificationName:NSFontSetChangedNotification object:nil];
+    [cache fontWithName:@"MissingFont" size:12 boldTrait:NO italicTrait:NO];
+    XCTAssertEqual(provider.numberOfLookups, 3);
+}
+
+- (void)testAvailableFontsDictionaryKeysAgreeWithLookups {
+    /// A new manager may not have a catalog yet, the shared one has had time to build it.
+    NSArray<RTEFontManager *> *fontManagers = @[[[RTEFontManager alloc] init], [RTEFontManager sharedManager]];
+    
+    for (RTEFontManager *fontManager in fontManagers) {
+        NSDictionary<NSString *, NSFont *> *dictionary = fontManager.availableFontsDictionary;
+        NSArray<NSString *> *keys = dictionary.allKeys;
+        
+        NSUInteger numberOfFonts = 0;
+        
+        XCTAssertEqual(dictionary.count, keys.count);
+        XCTAssertGreaterThan(keys.count, 0);
+        
+        /// A family without a face named after it doesn't resolve, catalog or not.
+        for (NSString *family in keys) {
+            numberOfFonts += ([dictionary objectForKey:family] != nil) ? 1 : 0;
+        }
+        
+        XCTAssertGreaterThan(numberOfFonts, 0);
+        XCTAssertNil([dictionary objectForKey:@"No Such Font Family"]);
+    }
+}
+
+- (void)testListTogglesIndentEmptySingleAndMultipleParagraphs {
+    NSView *parent = [[NSView alloc] initWithFrame:NSMakeRect(0, 0, 800, 600)];
+    RichTextEditor *editor = [RichTextEditor initWithParent:parent frame:parent.bounds];
+    NSDictionary *attributes = @{NSFontAttributeName: [NSFont fontWithName:@"Helvetica" size:14]};
+    NSString *bulletString = [NSString stringWithFormat:@"%C%C", (unichar)0x10, (unichar)0xA0];
+    NSString *numberingString = [NSString stringWithFormat:@"%C%C", (unichar)0x11, (unichar)0xA0];
+    
+    for (NSString *text in @[@"", @"one paragraph", @"first\nsecond\nthird"]) {
+        for (NSString *marker in @[bulletString, numberingString]) {
+            BOOL isBulleted = [marker isEqualToString:bulletString];
+            NSUInteger numberOfParagraphs = [text componentsSeparatedByString:@"\n"].count;
+            CGFloat expectedHeadIndent = 52 + [marker sizeWithAttributes:attributes].width;
+            
+            [editor setAttributedString:[[NSAttributedString alloc] initWithString:text attributes:attributes]];
+            [editor setTypingAttributes:attributes];
+            [editor setSelectedRange:NSMakeRange(0, text.length)];
+            isBulleted ? [editor userSelectedBulletedList] : [editor userSelectedNumberingList];
+            
+            NSTextStorage *textStorage = editor.textStorage;
+            NSString *string = textStorage.string;
+            
+            /// Every paragraph, marker included, gets the list indentation, the same as before lists were planned.
+            XCTAssertEqual(string.length, text.length + marker.length * numberOfParagraphs, @"%@", text);
+            [string enumerateSubstringsInRange:NSMakeRange(0, string.length) options:NSStringEnumerationByParagraphs usingBlock:^(NSString *paragraph, NSRange paragraphRange, NSRange enclosingRange, BOOL *stop) {
+                XCTAssertTrue([paragraph hasPrefix:marker], @"%@", text);
+                
+                for (NSUInteger i = enclosingRange.location; i < NSMaxRange(enclosingRange); i++) {
+                    NSParagraphStyle *paragraphStyle = [textStorage attribute:NSParagraphStyleAttributeName atIndex:i effectiveRange:NULL];
+                    
+                    XCTAssertEqualWithAccuracy(paragraphStyle.firstLineHeadIndent, 52, 0.001, @"%@ at %lu", text, (unsigned long)i);
+                    XCTAssertEqualWithAccuracy(paragraphStyle.headIndent, expectedHeadIndent, 0.001, @"%@ at %lu", text, (unsigned long)i);
+                }
+            }];
+            
+            /// Toggling again takes the markers and the indentation away.
+            [editor setSelectedRange:NSMakeRange(0, string.length)];
+            isBulleted ? [editor userSelectedBulletedList] : [editor userSelectedNumberingList];
+            
+            XCTAssertEqualObjects(textStorage.string, text);
+            
+            for (NSUInteger i = 0; i < textStorage.length; i++) {
+                NSParagraphStyle *paragraphStyle = [textStorage attribute:NSParagraphStyleAttributeName atIndex:i effectiveRange:NULL];
+                
+                XCTAssertEqualWithAccuracy(paragraphStyle.firstLineHeadIndent, 0, 0.001, @"%@ at %lu", text, (unsigned long)i);
+                XCTAssertEqualWithAccuracy(paragraphStyle.headIndent, 0, 0.001, @"%@ at %lu", text, (unsigned long)i);
+            }
+        }
+    }
+}
+
+- (void)testListMarkerIndentIsStableAcrossRedraws {
+    NSView *parent = [[NSView alloc] initWithFrame:NSMakeRect(0, 0, 800, 600)];
+    RichTextEditor *editor = [RichTextEditor initWithParent:parent frame:parent.bounds];
+    /// A marker this large widens the firstLineHeadIndent past two indentation steps.
+    NSDictionary *attributes = @{NSFontAttributeName: [NSFont fontWithName:@"Helvetica" size:128]};
+    NSBitmapImageRep *bitmap = [[NSBitmapImageRep alloc] initWithBitmapDataPlanes:NULL pixelsWide:800 pixelsHigh:600 bitsPerSample:8 samplesPerPixel:4 hasAlpha:YES isPlanar:NO colorSpaceName:NSDeviceRGBColorSpace bytesPerRow:0 bitsPerPixel:0];
+    NSGraphicsContext *graphicsContext = [NSGraphicsContext graphicsContextWithBitmapImageRep:bitmap];
+    CGFloat (^drawAndReadIndent)(void) = ^CGFloat {
+        NSLayoutManager *layoutManager = editor.layoutManager;
+        NSTextContainer *textContainer = editor.textContainer;
+        [layoutManager ensureLayoutForBoundingRect:parent.bounds inTextContainer:textContainer];
+        NSRange glyphRange = [layoutManager glyphRangeForBoundingRect:parent.bounds inTextContainer:textContainer];
+        
+        [NSGraphicsContext saveGraphicsState];
+        [NSGraphicsContext setCurrentContext:graphicsContext];
+        [layoutManager drawGlyphsForGlyphRange:glyphRange atPoint:NSZeroPoint];
+        [NSGraphicsContext restoreGraphicsState];
+        
+        /// The indents worked out while drawing are applied on the next turn of the run loop.
+        [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.05]];
+        
+        return [[editor.textStorage attribute:NSParagraphStyleAttributeName atIndex:0 effectiveRange:NULL] firstLineHeadIndent];
+    };
+    
+    [editor setAttributedString:[[NSAttributedString alloc] initWithString:@"one" attributes:attributes]];
+    [editor setTypingAttributes:attributes];
+    [editor setSelectedRange:NSMakeRange(0, 3)];
+    [editor userSelectedNumberingList];
+    
+    CGFloat firstLineHeadIndent = drawAndReadIndent();
+    
+    XCTAssertGreaterThanOrEqual(firstLineHeadIndent, 104);
+    XCTAssertEqualWithAccuracy(drawAndReadIndent(), firstLineHeadIndent, 0.001);
+    XCTAssertEqualWithAccuracy(drawAndReadIndent(), firstLineHeadIndent, 0.001);
+    
+    /// One indentation step nests the item one level deeper, and no further on later redraws.
+    [editor setSelectedRange:NSMakeRange(0, editor.textStorage.length)];
+    [editor userSelectedIncreaseIndent];
+    
+    XCTAssertEqualWithAccuracy(drawAndReadIndent(), firstLineHeadIndent + 52, 0.001);
+    XCTAssertEqualWithAccuracy(drawAndReadIndent(), firstLineHeadIndent + 52, 0.001);
+}
+
+- (void)testUndoJournalRoundTripsRandomEditsUndosAndRedos {
+    NSMutableAttributedString *document = [[self syntheticDocumentWithLength:32 * 1024] mutableCopy];
+    RTEUndoJournal *journal = [[RTEUndoJournal alloc] init];
+    RTERandomEditKind kinds = RTERandomEditKindDelete | RTERandomEditKindInsertText | RTERandomEditKindInsertBoldText | RTERandomEditKindInsertFormatList | RTERandomEditKindUnderline | RTERandomEditKindRemoveLink;
+    /// What the document looked like after each undo entry, states[numberOfUndoEntries] is the current one.
+    NSMutableArray<NSAttributedString *> *states = [[NSMutableArray alloc] initWithObjects:[document copy], nil];
+    __block uint64_t state = kBenchmarkSeed;
+    
+    /// A typing burst is one entry.
+    for (NSUInteger i = 0; i < 5; i++) {
+        [journal beginEditingInRange:NSMakeRange(i, 0) ofAttributedString:document selectedRange:NSMakeRange(i, 0) kind:RTEUndoJournalEditKindTyping];
+        [document replaceCharactersInRange:NSMakeRange(i, 0) withString:@"t"];
+        [journal endEditingOfAttributedString:document selectedRange:NSMakeRange(i + 1, 0)];
+    }
+    
+    XCTAssertEqual(journal.numberOfUndoEntries, 1);
+    [states addObject:[document copy]];
+    
+    [self applyRandomEdits:400 toTextStorage:document maxLength:400 kinds:kinds willEdit:^(NSUInteger edit, NSRange range, NSString *replacementString) {
+        BOOL isTyping = (range.length <= 1) && (replacementString.length <= 1);
+        
+        [journal beginEditingInRange:range ofAttributedString:document selectedRange:range kind:(isTyping ? RTEUndoJournalEditKindTyping : RTEUndoJournalEditKindCommand)];
+    } check:^(NSUInteger edit, NSRange range, NSUInteger replacementLength) {
+        NSUInteger numberOfUndoEntries = journal.numberOfUndoEntries;
+        
+        [journal endEditingOfAttributedString:document selectedRange:NSMakeRange(range.location + replacementLength, 0)];
+        
+        if (journal.numberOfUndoEntries > numberOfUndoEntries) {
+            /// A new entry, the redo entries are gone.
+            [states removeObjectsInRange:NSMakeRange(numberOfUndoEntries + 1, states.count - numberOfUndoEntries - 1)];
+            [states addObject:[document copy]];
+        } else {
+            /// Merged into the last typing entry, or no change at all.
+            [states replaceObjectAtIndex:journal.numberOfUndoEntries withObject:[document copy]];
+        }
+        
+        XCTAssertEqual(states.count, journal.numberOfUndoEntries + journal.numberOfRedoEntries + 1, @"after %lu edits", (unsigned long)edit);
+        
+        NSUInteger steps = RTEBenchmarkNextRandom(&state) % 4;
+        BOOL undoes = (RTEBenchmarkNextRandom(&state) % 2 == 0);
+        
+        for (NSUInteger step = 0; step < steps; step++) {
+            if (undoes ? ![journal canUndo] : ![journal canRedo]) {
+                break;
+            }
+            
+            XCTAssertTrue(undoes ? [journal undoInAttributedString:document selectedRange:NULL] : [journal redoInAttributedString:document selectedRange:NULL], @"after %lu edits", (unsigned long)edit);
+            XCTAssertEqualObjects(document, states[journal.numberOfUndoEntries], @"after %lu edits", (unsigned long)edit);
+        }
+    }];
+    
+    while ([journal canUndo]) {
+        XCTAssertTrue([journal undoInAttributedString:document selectedRange:NULL]);
+    }
+    
+    XCTAssertEqualObjects(document, states.firstObject);
+    
+    while ([journal canRedo]) {
+        XCTAssertTrue([journal redoInAttributedString:document selectedRange:NULL]);
+    }
+    
+    XCTAssertEqualObjects(document, states.lastObject);
+}
+
+- (void)testUndoJournalDropsHistoryChangedBehindItsBack {
+    NSMutableParagraphStyle *paragraphStyle = [[NSParagraphStyle defaultParagraphStyle] mutableCopy];
+    NSMutableAttributedString *document = [[NSMutableAttributedString alloc] initWithString:@"first\nsecond\n" attributes:@{NSFontAttributeName: [NSFont fontWithName:@"Helvetica" size:12], NSParagraphStyleAttributeName: paragraphStyle}];
+    RTEUndoJournal *journal = [[RTEUndoJournal alloc] init];
+    void (^replaceText)(NSUInteger, NSString *) = ^(NSUInteger length, NSString *text) {
+        [journal beginEditingInRange:NSMakeRange(0, length) ofAttributedString:document selectedRange:NSMakeRange(0, length) kind:RTEUndoJournalEditKindCommand];
+        [document replaceCharactersInRange:NSMakeRange(0, length) withString:text];
+        [journal endEditingOfAttributedString:document selectedRange:NSMakeRange(text.length, 0)];
+    };
+    void (^insertText)(NSString *) = ^(NSString *text) {
+        replaceText(0, text);
+    };
+    
+    /// The layout manager widening the first line of a list paragraph doesn't invalidate the history.
+    insertText(@"abc");
+    paragraphStyle = [paragraphStyle mutableCopy];
+    paragraphStyle.firstLineHeadIndent = 90;
+    [document addAttribute:NSParagraphStyleAttributeName value:paragraphStyle range:NSMakeRange(0, 3)];
+    XCTAssertTrue([journal undoInAttributedString:document selectedRange:NULL]);
+    XCTAssertEqualObjects(document.string, @"first\nsecond\n");
+    
+    /// Same text with other attributes.
+    insertText(@"abc");
+    [document addAttribute:NSUnderlineStyleAttributeName value:@(NSUnderlineStyleSingle) range:NSMakeRange(0, 3)];
+    XCTAssertFalse([journal undoInAttributedString:document selectedRange:NULL]);
+    XCTAssertEqual(journal.numberOfUndoEntries, 0);
+    XCTAssertEqualObjects(document.string, @"abcfirst\nsecond\n");
+    
+    /// Other text of the same length.
+    insertText(@"xyz");
+    [document replaceCharactersInRange:NSMakeRange(1, 1) withString:@"Y"];
+    XCTAssertFalse([journal undoInAttributedString:document selectedRange:NULL]);
+    XCTAssertEqual(journal.numberOfUndoEntries, 0);
+    
+    /// The same check guards redo.
+    insertText(@"123");
+    replaceText(3, @"456");
+    XCTAssertTrue([journal undoInAttributedString:document selectedRange:NULL]);
+    [document replaceCharactersInRange:NSMakeRange(0, 1) withString:@"-"];
+    XCTAssertFalse([journal redoInAttributedString:document selectedRange:NULL]);
+    XCTAssertEqual(journal.numberOfRedoEntries, 0);
+}
+
+- (void)testEditorUndoRedoRoundTripsRandomEdits {
+    NSView *parent = [[NSView alloc] initWithFrame:NSMakeRect(0, 0, 800, 600)];
+    RichTextEditor *editor = [RichTextEditor initWithParent:parent frame:parent.bounds];
+    NSMutableAttributedString *document = [[self syntheticDocumentWithLength:8 * 1024] mutableCopy];
+    NSTextStorage *textStorage = editor.textStorage;
+    NSUInteger numberOfEdits = 150;
+    
+    /// The list fix-ups after an edit have tests of their own, plain paragraphs keep every edit as it was made.
+    for (NSString *formatListString in @[[NSString stringWithFormat:@"%C%C", (unichar)0x10, (unichar)0xA0], [NSString stringWithFormat:@"%C%C", (unichar)0x11, (unichar)0xA0]]) {
+        [document.mutableString replaceOccurrencesOfString:formatListString withString:@"" options:NSLiteralSearch range:NSMakeRange(0, document.length)];
+    }
+    
+    [editor setAttributedString:document];
+    
+    NSAttributedString *original = [textStorage copy];
+    
+    /// Edits go through the same calls as typing in the text view.
+    [self applyRandomEdits:numberOfEdits toTextStorage:textStorage maxLength:200 kinds:(RTERandomEditKindDelete | RTERandomEditKindInsertText | RTERandomEditKindUnderline) willEdit:^(NSUInteger edit, NSRange range, NSString *replacementString) {
+        [editor setSelectedRange:range];
+        XCTAssertTrue([editor shouldChangeTextInRange:range replacementString:replacementString]);
+    } check:^(NSUInteger edit, NSRange range, NSUInteger replacementLength) {
+        [editor setSelectedRange:NSMakeRange(range.location + replacementLength, 0)];
+        [editor didChangeText];
+    }];
+    
+    NSAttributedString *edited = [textStorage copy];
+    
+    for (NSUInteger i = 0; i <= numberOfEdits; i++) {
+        NSAttributedString *before = [textStorage copy];
+        
+        [editor undo];
+        
+        if ([textStorage isEqualToAttributedString:before]) {
+            break;
+        }
+    }
+    
+    XCTAssertEqualObjects(textStorage, original);
+    
+    for (NSUInteger i = 0; i <= numberOfEdits; i++) {
+        NSAttributedString *before = [textStorage copy];
+        
+        [editor redo];
+        
+        if ([textStorage isEqualToAttributedString:before]) {
+            break;
+        }
+    }
+    
+    XCTAssertEqualObjects(textStorage, edited);
+}
+
+- (void)testReplaceAllAsksTheDelegateAndRespectsEditability {
+    NSView *parent = [[NSView alloc] initWithFrame:NSMakeRect(0, 0, 800, 600)];
+    RichTextEditor *editor = [RichTextEditor initWithParent:parent frame:parent.bounds];
+    RTERecordingTextViewDelegate *delegate = [[RTERecordingTextViewDelegate alloc] init];
+    NSString *text = @"one two one\ntwo one two";
+    
+    editor.delegate = delegate;
+    [editor setAttributedString:[[NSAttributedString alloc] initWithString:text attributes:@{NSFontAttributeName: [NSFont fontWithName:@"Helvetica" size:14]}]];
+    
+    /// The delegate is asked about the range from the first match to the last one and what it will read.
+    delegate.shouldChangeText = NO;
+    XCTAssertEqual([editor replaceAllOccurrencesOfString:@"one" withString:@"three" options:0], 0);
+    XCTAssertEqualObjects(editor.string, text);
+    XCTAssertEqualObjects(delegate.affectedRanges.lastObject, [NSValue valueWithRange:NSMakeRange(0, 19)]);
+    XCTAssertEqualObjects(delegate.replacementStrings.lastObject, @"three two three\ntwo three");
+    
+    delegate.shouldChangeText = YES;
+    [editor setEditable:NO];
+    [delegate.affectedRanges removeAllObjects];
+    XCTAssertEqual([editor replaceAllOccurrencesOfString:@"one" withString:@"three" options:0], 0);
+    XCTAssertEqualObjects(editor.string, text);
+    XCTAssertEqual(delegate.affectedRanges.count, 0);
+    
+    [editor setEditable:YES];
+    XCTAssertEqual([editor replaceAllOccurrencesOfString:@"one" withString:@"three" options:0], 3);
+    XCTAssertEqualObjects(editor.string, @"three two three\ntwo three two");
+    
+    [editor undo];
+    XCTAssertEqualObjects(editor.string, text);
+    
+    [editor redo];
+    XCTAssertEqualObjects(editor.string, @"three two three\ntwo three two");
+}
+
+- (void)testReplaceAllSendsOneTextDidChange {
+    NSView *parent = [[NSView alloc] initWithFrame:NSMakeRect(0, 0, 800, 600)];
+    RichTextEditor *editor = [RichTextEditor initWithParent:parent frame:parent.bounds];
+    RTERecordingTextViewDelegate *delegate = [[RTERecordingTextViewDelegate alloc] init];
+    
+    editor.delegate = delegate;
+    [editor setAttributedString:[[NSAttributedString alloc] initWithString:@"one two one\ntwo one two" attributes:@{NSFontAttributeName: [NSFont fontWithName:@"Helvetica" size:14]}]];
+    delegate.numberOfTextDidChange = 0;
+    
+    XCTAssertEqual([editor replaceAllOccurrencesOfString:@"one" withString:@"three" options:0], 3);
+    XCTAssertEqual(delegate.numberOfTextDidChange, 1);
+    
+    XCTAssertEqual([editor replaceAllOccurrencesOfString:@"two" withString:@"four" options:0], 3);
+    XCTAssertEqual(delegate.numberOfTextDidChange, 2);
+    
+    /// Nothing is replaced, so nothing is announced.
+    XCTAssertEqual([editor replaceAllOccurrencesOfString:@"five" withString:@"six" options:0], 0);
+    XCTAssertEqual(delegate.numberOfTextDidChange, 2);
+}
+
+- (void)testChunkedPasteAsksTheDelegateAboutTheWholeText {
+    NSView *parent = [[NSView alloc] initWithFrame:NSMakeRect(0, 0, 800, 600)];
+    RichTextEditor *editor = [RichTextEditor initWithParent:parent frame:parent.bounds];
+    RTERecordingTextViewDelegate *delegate = [[RTERecordingTextViewDelegate alloc] init];
+    NSMutableString *string = [[NSMutableString alloc] init];
+    
+    /// A few times the editor's paste chunk length.
+    while (string.length < 256 * 1024) {
+        [string appendString:@"pasted\n text "];
+    }
+    
+    /// Only the last chunk has the text the delegate refuses.
+    [string appendString:@"forbidden"];
+    
+    [editor useSingleLineMode];
+    editor.delegate = delegate;
+    delegate.forbiddenString = @"forbidden";
+    
+    [[NSPasteboard generalPasteboard] clearContents];
+    [[NSPasteboard generalPasteboard] setString:string forType:NSPasteboardTypeString];
+    
+    [editor paste:nil];
+    XCTAssertEqualObjects(editor.string, @"");
+    XCTAssertNil(editor.pasteProgress);
+    XCTAssertEqual(delegate.replacementStrings.count, 1);
+    XCTAssertEqualObjects(delegate.replacementStrings.lastObject, [RTEPasteNormalizer normalizedString:string]);
+    
+    /// Allowed, the text goes in a chunk per run loop turn after a single question.
+    delegate.forbiddenString = nil;
+    [editor paste:nil];
+    XCTAssertNotNil(editor.pasteProgress);
+    
+    while (editor.pasteProgress != nil) {
+        [[NSRunLoop currentRunLoop] runMode:NSDefaultRunLoopMode beforeDate:[NSDate dateWithTimeIntervalSinceNow:0.1]];
+    }
+    
+    XCTAssertEqualObjects(editor.string, [RTEPasteNormalizer normalizedString:string]);
+    XCTAssertEqual(delegate.replacementStrings.count, 2);
+}
+
+- (void)testPasteNormalizerCollapsesWhitespaceAcrossChunks {
+    NSString *string = [NSString stringWithFormat:@"  \t%C%C one\n\n two%C  three four five six seven\r\n", (unichar)0x10, (unichar)0xA0, (unichar)0x11];
+    NSString *expected = @"one two three four five six seven";
+    RTEPasteNormalizer *normalizer = [[RTEPasteNormalizer alloc] initWithString:string];
+    NSMutableString *chunked = [[NSMutableString alloc] init];
+    NSString *chunk = nil;
+    
+    while ((chunk = [normalizer nextChunkWithMaximumLength:3]) != nil) {
+        [chunked appendString:chunk];
+    }
+    
+    XCTAssertEqualObjects([RTEPasteNormalizer normalizedString:string], expected);
+    XCTAssertEqualObjects(chunked, expected);
+}
+
+- (void)testSearchIndexMatchesLinearScanAcrossEdits {
+    NSMutableAttributedString *document = [[self syntheticDocumentWithLength:32 * 1024] mutableCopy];
+    RTESearchIndex *searchIndex = [[RTESearchIndex alloc] initWithString:document.string];
+    NSArray<NSString *> *queries = @[@"lorem ipsum", @"DOLOR", @"et", @"caf\u00e9 na\u00efve", @"link\nbullet"];
+    NSArray<NSNumber *> *options = @[@0, @(RTESearchOptionCaseInsensitive), @(RTESearchOptionCaseInsensitive | RTESearchOptionDiacriticInsensitive)];
+    
+    [self applyRandomEdits:200 toTextStorage:document maxLength:3000 kinds:(RTERandomEditKindDelete | RTERandomEditKindInsertText) check:^(NSUInteger edit, NSRange range, NSUInteger replacementLength) {
+        NSString *string = document.string;
+        
+        [searchIndex replaceCharactersInRange:range withString:[string substringWithRange:NSMakeRange(range.location, replacementLength)] resultingString:string];
+        
+        if (edit % 20 != 0) {
+            return;
+        }
+        
+        for (NSString *query in queries) {
+            for (NSNumber *option in options) {
+                NSStringCompareOptions compareOptions = ((option.unsignedIntegerValue & RTESearchOptionCaseInsensitive) ? NSCaseInsensitiveSearch : 0) | ((option.unsignedIntegerValue & RTESearchOptionDiacriticInsensitive) ? NSDiacriticInsensitiveSearch : 0);
+                NSMutableArray<NSValue *> *expected = [[NSMutableArray alloc] init];
+                NSMutableArray<NSValue *> *found = [[NSMutableArray alloc] init];
+                NSRange searchRange = NSMakeRange(0, string.length);
+                NSRange matchRange;
+                
+                while ((matchRange = [string rangeOfString:query options:compareOptions range:searchRange]).location != NSNotFound) {
+                    [expected addObject:[NSValue valueWithRange:matchRange]];
+                    searchRange = NSMakeRange(NSMaxRange(matchRange), string.length - NSMaxRange(matchRange));
+                }
+                
+                [searchIndex enumerateMatchesOfString:query inString:string options:option.unsignedIntegerValue range:NSMakeRange(0, string.length) usingBlock:^(NSRange matchRange, BOOL *stop) {
+                    [found addObject:[NSValue valueWithRange:matchRange]];
+                }];
+                
+                XCTAssertEqualObjects(found, expected, @"%@ with options %@ after %lu edits", query, option, (unsigned long)edit);
+            }
+        }
+    }];
+}
+
+- (void)testFormatIndexMatchesLinearScanAcrossEdits {
+    NSMutableAttributedString *document = [[self syntheticDocumentWithLength:16 * 1024] mutableCopy];
+    RTEFormatIndex *formatIndex = [[RTEFormatIndex alloc] initWithAttributedString:document];
+    RTERandomEditKind kinds = RTERandomEditKindDelete | RTERandomEditKindInsertBoldText | RTERandomEditKindInsertFormatList | RTERandomEditKindUnderline | RTERandomEditKindRemoveLink;
+    __block uint64_t state = kBenchmarkSeed;
+    
+    [self applyRandomEdits:300 toTextStorage:document maxLength:400 kinds:kinds check:^(NSUInteger edit, NSRange range, NSUInteger replacementLength) {
+        [formatIndex replaceCharactersInRange:range resultingAttributedString:document];
+        XCTAssertEqual(formatIndex.length, document.length);
+        
+        for (NSUInteger query = 0; query < 20; query++) {
+            NSUInteger queryLocation = RTEBenchmarkNextRandom(&state) % (document.length + 1);
+            NSRange queryRange = NSMakeRange(queryLocation, RTEBenchmarkNextRandom(&state) % (document.length - queryLocation + 1));
+            RTEFormatSummary found = [formatIndex summaryOfRange:queryRange];
+            RTEFormatSummary expected = [RTEFormatIndex summaryOfRange:queryRange inAttributedString:document];
+            
+            XCTAssertEqual(found.all, expected.all, @"%@ after %lu edits", NSStringFromRange(queryRange), (unsigned long)edit);
+            XCTAssertEqual(found.any, expected.any, @"%@ after %lu edits", NSStringFromRange(queryRange), (unsigned long)edit);
+            XCTAssertEqual(found.alignments, expected.alignments, @"%@ after %lu edits", NSStringFromRange(queryRange), (unsigned long)edit);
+        }
+    }];
+}
+
+- (void)testDocumentSnapshotsAreUnaffectedByLaterEdits {
+    NSTextStorage *textStorage = [[NSTextStorage alloc] initWithAttributedString:[self syntheticDocumentWithLength:64 * 1024]];
+    NSMutableArray<RTEDocumentSnapshot *> *snapshots = [[NSMutableArray alloc] init];
+    NSMutableArray<NSAttributedString *> *expected = [[NSMutableArray alloc] init];
+    NSMutableArray<NSString *> *failures = [[NSMutableArray alloc] init];
+    dispatch_group_t readers = dispatch_group_create();
+    
+    [textStorage attachDocumentSnapshots];
+    
+    [self applyRandomEdits:500 toTextStorage:textStorage maxLength:5000 kinds:(RTERandomEditKindDelete | RTERandomEditKindInsertText | RTERandomEditKindUnderline) check:^(NSUInteger edit, NSRange range, NSUInteger replacementLength) {
+        if (edit % 10 != 0) {
+            return;
+        }
+        
+        RTEDocumentSnapshot *snapshot = [textStorage RTEDocumentSnapshot];
+        NSString *string = [textStorage.string copy];
+        
+        XCTAssertNotNil(snapshot);
+        [snapshots addObject:snapshot];
+        [expected addObject:[textStorage copy]];
+        
+        /// Readers on other threads while the main thread keeps editing, run with the Thread Sanitizer to catch races.
+        for (NSUInteger reader = 0; reader < 4; reader++) {
+            dispatch_group_async(readers, dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+                if (![snapshot.string isEqualToString:string]) {
+                    @synchronized (failures) {
+                        [failures addObject:[NSString stringWithFormat:@"snapshot after %lu edits", (unsigned long)edit]];
+                    }
+                }
+            });
+        }
+    }];
+    
+    dispatch_group_wait(readers, DISPATCH_TIME_FOREVER);
+    XCTAssertEqualObjects(failures, @[]);
+    
+    for (NSUInteger i = 0; i < snapshots.count; i++) {
+        XCTAssertEqualObjects(snapshots[i].attributedString, expected[i], @"snapshot %lu", (unsigned long)i);
+    }
+}
+
+- (void)testIncrementalHTMLExportMatchesFullExport {
+    NSTextStorage *textStorage = [[NSTextStorage alloc] initWithAttributedString:[self syntheticDocumentWithLength:32 * 1024]];
+    NSURL *url = [[NSURL fileURLWithPath:NSTemporaryDirectory()] URLByAppendingPathComponent:@"RichTextEditorIncrementalExport.html"];
+    
+    [textStorage attachIncrementalHTMLExporter];
+    
+    [self applyRandomEdits:200 toTextStorage:textStorage maxLength:300 kinds:(RTERandomEditKindDelete | RTERandomEditKindInsertText | RTERandomEditKindUnderline) check:^(NSUInteger edit, NSRange range, NSUInteger replacementLength) {
+        RTEIncrementalHTMLExporter *exporter = [textStorage RTEIncrementalHTMLExporter];
+        
+        XCTAssertNotNil(exporter);
+        XCTAssertLessThanOrEqual(exporter.numberOfDirtyParagraphs, (edit == 0) ? exporter.numberOfParagraphs : 8);
+        XCTAssertEqualObjects([exporter HTMLStringFromAttributedString:textStorage], [RichTextEditor htmlStringFromAttributedText:textStorage], @"after %lu edits", (unsigned long)edit);
+        XCTAssertEqual(exporter.numberOfDirtyParagraphs, 0);
+    }];
+    
+    NSError *error = nil;
+    
+    XCTAssertTrue([[textStorage RTEIncrementalHTMLExporter] writeHTMLFromAttributedString:textStorage toURL:url error:&error], @"%@", error);
+    XCTAssertEqualObjects([NSString stringWithContentsOfURL:url encoding:NSUTF8StringEncoding error:NULL], [RichTextEditor htmlStringFromAttributedText:textStorage]);
+    [[NSFileManager defaultManager] removeItemAtURL:url error:NULL];
+    
+    [textStorage replaceCharactersInRange:NSMakeRange(0, textStorage.length) withString:@" \n\t"];
+    XCTAssertEqualObjects([[textStorage RTEIncrementalHTMLExporter] HTMLStringFromAttributedString:textStorage], @"");
+}
+
+- (void)testProgressiveHTMLLoadMatchesFullImport {
+    NSMutableAttributedString *document = [[self syntheticDocumentWithLength:64 * 1024] mutableCopy];
+    
+    /// Empty paragraphs take the attributes of the text before them, also across chunks.
+    for (NSUInteger location = 1000; location < document.length; location += 1777) {
+        [document replaceCharactersInRange:NSMakeRange(location, 0) withString:@"\n\n\n"];
+    }
+    
+    NSString *html = [RichTextEditor htmlStringFromAttributedText:document];
+    NSArray<NSValue *> *chunkRanges = [RTEProgressiveHTMLLoader chunkRangesOfHTMLString:html firstChunkLength:4 * 1024 chunkLength:16 * 1024];
+    NSUInteger location = [html rangeOfString:@"<body>"].location + 6;
+    
+    XCTAssertNil([RTEProgressiveHTMLLoader chunkRangesOfHTMLString:@"<p>other</p>" firstChunkLength:4 * 1024 chunkLength:16 * 1024]);
+    XCTAssertGreaterThan(chunkRanges.count, 2);
+    
+    for (NSValue *value in chunkRanges) {
+        NSRange range = value.rangeValue;
+        
+        XCTAssertEqual(range.location, location);
+        XCTAssertTrue([[html substringWithRange:range] hasPrefix:@"<p"]);
+        location = NSMaxRange(range);
+    }
+    
+    XCTAssertTrue([[html substringFromIndex:location] hasPrefix:@"</body>"]);
+    
+    NSMutableAttributedString *expected = [[RichTextEditor attributedStringFromHTMLString:html] mutableCopy];
+    [expected replaceCharactersInRange:NSMakeRange(expected.length - 1, 1) withString:@""];
+    
+    RTEProgressiveHTMLLoader *loader = [[RTEProgressiveHTMLLoader alloc] initWithHTMLString:html defaultAttributes:@{} firstChunkLength:4 * 1024 chunkLength:16 * 1024];
+    NSMutableAttributedString *loaded = [[NSMutableAttributedString alloc] init];
+    XCTestExpectation *completion = [self expectationWithDescription:@"load completion"];
+    __block NSUInteger numberOfChunks = 0;
+    
+    [loader loadWithChunkHandler:^(NSAttributedString *chunk, NSUInteger index, BOOL isLastChunk) {
+        XCTAssertTrue([NSThread isMainThread]);
+        XCTAssertEqual(index, numberOfChunks);
+        XCTAssertEqual(isLastChunk, index + 1 == chunkRanges.count);
+        [loaded appendAttributedString:chunk];
+        numberOfChunks++;
+    } completion:^(BOOL finished) {
+        XCTAssertTrue(finished);
+        [completion fulfill];
+    }];
+    
+    /// The first chunk is there before the load returns.
+    XCTAssertEqual(numberOfChunks, 1);
+    [self waitForExpectationsWithTimeout:10 handler:nil];
+    XCTAssertEqual(numberOfChunks, chunkRanges.count);
+    XCTAssertEqualObjects(loaded, expected);
+    
+    /// Cancelling keeps the chunks handed over so far.
+    NSView *parent = [[NSView alloc] initWithFrame:NSMakeRect(0, 0, 800, 600)];
+    RichTextEditor *editor = [RichTextEditor initWithParent:parent frame:parent.bounds];
+    XCTestExpectation *cancellation = [self expectationWithDescription:@"cancelled load completion"];
+    
+    [editor loadHtmlString:html completion:^(BOOL finished) {
+        XCTAssertFalse(finished);
+        [cancellation fulfill];
+    }];
+    
+    XCTAssertNotNil(editor.loadProgress);
+    XCTAssertFalse([editor isEditable]);
+    [editor.loadProgress cancel];
+    [self waitForExpectationsWithTimeout:10 handler:nil];
+    XCTAssertNil(editor.loadProgress);
+    XCTAssertTrue([editor isEditable]);
+    XCTAssertGreaterThan(editor.textStorage.length, 0);
+    XCTAssertLessThan(editor.textStorage.length, expected.length);
+}
+
+- (void)testLinkValidatorSharesRequestsWithinLimits {
+    NSURLSessionConfiguration *configuration = [NSURLSessionConfiguration ephemeralSessionConfiguration];
+    configuration.protocolClasses = @[[RTEStandInURLProtocol class]];
+    RTELinkValidator *validator = [[RTELinkValidator alloc] initWithSessionConfiguration:configuration];
+    NSMutableAttributedString *document = [[NSMutableAttributedString alloc] init];
+    
+    validator.maximumConcurrentRequests = 3;
+    validator.maximumConcurrentRequestsPerHost = 1;
+    [RTEStandInURLProtocol reset];
+    
+    XCTAssertEqual(validator.maximumConcurrentRequests, 3);
+    XCTAssertEqual(validator.maximumConcurrentRequestsPerHost, 1);
+    
+    /// 300 links to 40 distinct URLs on 4 hosts, given as URLs and as strings, and one without a host.
+    for (NSUInteger i = 0; i < 300; i++) {
+        NSString *link = [NSString stringWithFormat:@"https://host%lu.test/%@/%lu", (unsigned long)(i % 4), ((i % 40) < 30) ? @"ok" : @"missing", (unsigned long)(i % 40)];
+        id value = (i % 2 == 0) ? [NSURL URLWithString:link] : link;
+        
+        [document appendAttributedString:[[NSAttributedString alloc] initWithString:@"link" attributes:@{NSLinkAttributeName: value}]];
+        [document appendAttributedString:[[NSAttributedString alloc] initWithString:@" "]];
+    }
+    
+    [document appendAttributedString:[[NSAttributedString alloc] initWithString:@"link" attributes:@{NSLinkAttributeName: @"notalink"}]];
+    
+    NSArray<NSURL *> *links = [RTELinkValidator linksInAttributedString:document];
+    XCTestExpectation *batch = [self expectationWithDescription:@"batch completion"];
+    
+    XCTAssertEqual(links.count, 41);
+    XCTAssertFalse([RTELinkValidator isWellFormedURLString:@"notalink"]);
+    XCTAssertTrue([RTELinkValidator isWellFormedURLString:@"https://host0.test/ok/0"]);
+    
+    [validator validateLinksInAttributedString:document completion:^(NSDictionary<NSURL *, NSNumber *> *results) {
+        XCTAssertTrue([NSThread isMainThread]);
+        XCTAssertEqual(results.count, links.count);
+        
+        for (NSURL *url in links) {
+            XCTAssertEqual([results[url] boolValue], [url.path hasPrefix:@"/ok"], @"%@", url);
+        }
+        
+        [batch fulfill];
+    }];
+    
+    [self waitForExpectationsWithTimeout:30 handler:nil];
+    
+    @synchronized ([RTEStandInURLProtocol class]) {
+        XCTAssertEqual(RTEStandInNumberOfRequests, 40);
+        XCTAssertLessThanOrEqual(RTEStandInMaximumRunningRequests, 3);
+        XCTAssertEqual(RTEStandInMaximumRunningRequestsPerHost, 1);
+    }
+    
+    /// Cached results are answered without a request until they are removed.
+    XCTestExpectation *cached = [self expectationWithDescription:@"cached completion"];
+    
+    XCTAssertEqualObjects([validator cachedValidityOfURL:links.firstObject], @YES);
+    
+    [validator validateURLs:links completion:^(NSDictionary<NSURL *, NSNumber *> *results) {
+        XCTAssertEqual(results.count, links.count);
+        [cached fulfill];
+    }];
+    
+    [self waitForExpectationsWithTimeout:30 handler:nil];
+    [validator removeAllCachedResults];
+    XCTAssertNil([validator cachedValidityOfURL:links.firstObject]);
+    
+    @synchronized ([RTEStandInURLProtocol class]) {
+        XCTAssertEqual(RTEStandInNumberOfRequests, 40);
+    }
+}
+
+- (void)testLinkValidatorKeepsTheMostRecentlyUsedResults {
+    NSURLSessionConfiguration *configuration = [NSURLSessionConfiguration ephemeralSessionConfiguration];
+    configuration.protocolClasses = @[[RTEStandInURLProtocol class]];
+    RTELinkValidator *validator = [[RTELinkValidator alloc] initWithSessionConfiguration:configuration];
+    NSMutableArray<NSURL *> *links = [[NSMutableArray alloc] init];
+    
+    for (NSUInteger i = 0; i < 4; i++) {
+        [links addObject:[NSURL URLWithString:[NSString stringWithFormat:@"https://host.test/ok/%lu", (unsigned long)i]]];
+    }
+    
+    validator.cacheCapacity = 2;
+    [RTEStandInURLProtocol reset];
+    XCTAssertEqual(validator.cacheCapacity, 2);
+    
+    /// Waiting validations are never dropped, so all three requests of the batch are shared and answered.
+    XCTestExpectation *batch = [self expectationWithDescription:@"batch completion"];
+    
+    [validator validateURLs:[links subarrayWithRange:NSMakeRange(0, 3)] completion:^(NSDictionary<NSURL *, NSNumber *> *results) {
+        XCTAssertEqual(results.count, 3);
+        [batch fulfill];
+    }];
+    
+    [self waitForExpectationsWithTimeout:30 handler:nil];
+    
+    /// Using the first result makes the second and third the least recently used ones.
+    XCTestExpectation *single = [self expectationWithDescription:@"single completion"];
+    
+    [validator validateURL:links[0] completion:^(BOOL isValid) {
+        XCTAssertTrue(isValid);
+    }];
+    [validator validateURL:links[3] completion:^(BOOL isValid) {
+        XCTAssertTrue(isValid);
+        [single fulfill];
+    }];
+    
+    [self waitForExpectationsWithTimeout:30 handler:nil];
+    
+    XCTAssertEqualObjects([validator cachedValidityOfURL:links[0]], @YES);
+    XCTAssertNil([validator cachedValidityOfURL:links[1]]);
+    XCTAssertNil([validator cachedValidityOfURL:links[2]]);
+    XCTAssertEqualObjects([validator cachedValidityOfURL:links[3]], @YES);
+    
+    @synchronized ([RTEStandInURLProtocol class]) {
+        XCTAssertEqual(RTEStandInNumberOfRequests, 4);
+    }
+}
+
+- (void)testEventBusCoalescesEventsPerFrame {
+    RTEEventBus *bus = [[RTEEventBus alloc] init];
+    XCTestExpectation *delivery = [self expectationWithDescription:@"coalesced delivery"];
+    NSMutableArray<RTEEditorEvent *> *coalescedEvents = [[NSMutableArray alloc] init];
+    __block NSUInteger numberOfSynchronousEvents = 0;
+    __block NSUInteger numberOfDeliveries = 0;
+    
+    [bus addSubscriberForEventTypes:RTEEditorEventTypeSelectionChange delivery:RTEEventDeliverySynchronous handler:^(NSArray<RTEEditorEvent *> *events) {
+        XCTAssertEqual(events.count, 1);
+        numberOfSynchronousEvents++;
+    }];
+    
+    [bus addSubscriberForEventTypes:RTEEditorEventTypeTextChange | RTEEditorEventTypeSelectionChange | RTEEditorEventTypePreviewChange delivery:RTEEventDeliveryCoalesced handler:^(NSArray<RTEEditorEvent *> *events) {
+        XCTAssertTrue([NSThread isMainThread]);
+        [coalescedEvents addObjectsFromArray:events];
+        
+        if (++numberOfDeliveries == 1) {
+            [delivery fulfill];
+        }
+    }];
+    
+    for (NSUInteger i = 0; i < 100; i++) {
+        [bus postEventOfType:RTEEditorEventTypeSelectionChange detail:0 range:NSMakeRange(i, 0) changeInLength:0];
+    }
+    
+    /// An insertion, an insertion before it and a deletion after both.
+    [bus postEventOfType:RTEEditorEventTypeTextChange detail:0 range:NSMakeRange(10, 1) changeInLength:1];
+    [bus postEventOfType:RTEEditorEventTypeTextChange detail:0 range:NSMakeRange(5, 1) changeInLength:1];
+    [bus postEventOfType:RTEEditorEventTypeTextChange detail:0 range:NSMakeRange(20, 0) changeInLength:-3];
+    [bus postEventOfType:RTEEditorEventTypePreviewChange detail:1 range:NSMakeRange(0, 0) changeInLength:0];
+    [bus postEventOfType:RTEEditorEventTypePreviewChange detail:2 range:NSMakeRange(0, 0) changeInLength:0];
+    [bus postEventOfType:RTEEditorEventTypePreviewChange detail:1 range:NSMakeRange(0, 0) changeInLength:0];
+    [bus postEventOfType:RTEEditorEventTypeTypingAttributesChange detail:0 range:NSMakeRange(0, 0) changeInLength:0];
+    
+    XCTAssertEqual(numberOfSynchronousEvents, 100);
+    XCTAssertEqual(bus.numberOfPendingRecords, 4);
+    XCTAssertEqual(coalescedEvents.count, 0);
+    
+    [self waitForExpectationsWithTimeout:1 handler:nil];
+    
+    XCTAssertEqual(numberOfDeliveries, 1);
+    XCTAssertEqual(bus.numberOfPendingRecords, 0);
+    XCTAssertEqual(coalescedEvents.count, 4);
+    XCTAssertEqual(coalescedEvents[0].type, RTEEditorEventTypeSelectionChange);
+    XCTAssertEqual(coalescedEvents[0].numberOfEvents, 100);
+    XCTAssertTrue(NSEqualRanges(coalescedEvents[0].range, NSMakeRange(99, 0)));
+    XCTAssertEqual(coalescedEvents[1].type, RTEEditorEventTypeTextChange);
+    XCTAssertTrue(NSEqualRanges(coalescedEvents[1].range, NSMakeRange(5, 15)), @"%@", NSStringFromRange(coalescedEvents[1].range));
+    XCTAssertEqual(coalescedEvents[1].changeInLength, -1);
+    XCTAssertEqual(coalescedEvents[2].detail, 1);
+    XCTAssertEqual(coalescedEvents[2].numberOfEvents, 2);
+    XCTAssertEqual(coalescedEvents[3].detail, 2);
+    
+    /// A flush ahead of the frame boundary delivers at once, the scheduled one then has nothing to do.
+    [bus postEventOfType:RTEEditorEventTypeSelectionChange detail:0 range:NSMakeRange(1, 0) changeInLength:0];
+    [bus flush];
+    XCTAssertEqual(numberOfDeliveries, 2);
+    XCTAssertEqual(coalescedEvents.count, 5);
+    
+    /// The editor posts its edits with the edited range.
+    NSView *parent = [[NSView alloc] initWithFrame:NSMakeRect(0, 0, 800, 600)];
+    RichTextEditor *editor = [RichTextEditor initWithParent:parent frame:parent.bounds];
+    NSMutableArray<RTEEditorEvent *> *editorEvents = [[NSMutableArray alloc] init];
+    
+    [editor.eventBus addSubscriberForEventTypes:RTEEditorEventTypeTextChange delivery:RTEEventDeliveryCoalesced handler:^(NSArray<RTEEditorEvent *> *events) {
+        [editorEvents addObjectsFromArray:events];
+    }];
+    
+    [editor setAttributedString:[[NSAttributedString alloc] initWithString:@"hello"]];
+    [[editor textStorage] replaceCharactersInRange:NSMakeRange(5, 0) withString:@" world"];
+    [editor.eventBus flush];
+    
+    XCTAssertEqual(editorEvents.count, 1);
+    XCTAssertTrue(NSEqualRanges(editorEvents.firstObject.range, NSMakeRange(0, 11)), @"%@", NSStringFromRange(editorEvents.firstObject.range));
+}
+
+- (void)testTracingExportsChromeTraceEvents {
+    XCTAssertFalse([RTETracer isCapturing]);
+    
+    [RTETracer startCapture];
+    
+    {
+        RTE_TRACE_SCOPE_WITH_ARGUMENT("test span", 7);
+        RTE_TRACE_COUNTER("test counter", 2);
+        RTE_TRACE_COUNTER("test counter", 3);
+    }
+    
+    dispatch_sync(dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+        RTE_TRACE_INSTANT("test instant", -1);
+    });
+    
+    NSDictionary *trace = [NSJSONSerialization JSONObjectWithData:[RichTextEditor stopTracing] options:0 error:nil];
+    NSArray<NSDictionary *> *events = trace[@"traceEvents"];
+    NSDictionary *span = [events filteredArrayUsingPredicate:[NSPredicate predicateWithFormat:@"name == 'test span'"]].firstObject;
+    NSArray *counterTotals = [[events filteredArrayUsingPredicate:[NSPredicate predicateWithFormat:@"name == 'test counter'"]] valueForKeyPath:@"args.test counter"];
+    
+    XCTAssertFalse([RTETracer isCapturing]);
+    XCTAssertEqualObjects(span[@"ph"], @"X");
+    XCTAssertEqualObjects(span[@"args"][@"value"], @7);
+    XCTAssertEqualObjects(counterTotals, (@[@2, @5]));
+    XCTAssertEqual([events filteredArrayUsingPredicate:[NSPredicate predicateWithFormat:@"name == 'test instant'"]].count, 1);
+    
+    /// Recording while stopped is a no-op and a new capture starts empty.
+    RTE_TRACE_COUNTER("test counter", 1);
+    [RTETracer startCapture];
+    [RTETracer stopCapture];
+    
+    XCTAssertEqual([[NSJSONSerialization JSONObjectWithData:[RTETracer chromeTraceData] options:0 error:nil][@"traceEvents"] count], 0);
+}
+
+/// Every benchmark once on a small document, so the suite keeps working between benchmark runs.
+- (void)testPerformanceBenchmarksSmoke {
+    [self runBenchmarksWithDocumentSizes:&kBenchmarkSmokeDocumentSize count:1 maximumIterations:1];
+}
+
+- (void)testPerformanceBenchmarks {
+    XCTSkipUnless([[NSProcessInfo processInfo] environment][@"RTE_RUN_BENCHMARKS"] != nil, @"Set RTE_RUN_BENCHMARKS to run the benchmark sweep");
+    
+    [self runBenchmarksWithDocumentSizes:kBenchmarkDocumentSizes count:sizeof(kBenchmarkDocumentSizes) / sizeof(kBenchmarkDocumentSizes[0]) maximumIterations:NSUIntegerMax];
+    [self writeResults];
+    [self compareResultsWithBaseline];
+}
+
+#pragma mark - Helper Methods -
+
+- (void)runBenchmarksWithDocumentSizes:(const NSUInteger *)documentSizes count:(NSUInteger)count maximumIterations:(NSUInteger)maximumIterations {
+    NSDictionary<NSString *, NSString *> *environment = [[NSProcessInfo processInfo] environment];
+    NSUInteger maximumEditorBytes = kBenchmarkDefaultMaximumEditorBytes;
+    
+    if (environment[@"RTE_BENCHMARK_MAX_BYTES"] != nil) {
+        maximumEditorBytes = (NSUInteger)[environment[@"RTE_BENCHMARK_MAX_BYTES"] longLongValue];
+    }
+    
+    for (NSUInteger i = 0; i < count; i++) {
+        NSUInteger size = documentSizes[i];
+        NSUInteger iterations = MIN((size >= 1024 * 1024) ? 5 : 15, maximumIterations);
+        NSAttributedString *document = [self syntheticDocumentWithLength:size];
+        NSString *html = [RichTextEditor htmlStringFromAttributedText:document];
+        
+        [self measureBenchmark:@"paragraph-enumeration" bytes:size iterations:iterations setUp:nil block:^{
+            RTEParagraphIndex *paragraphIndex = [[RTEParagraphIndex alloc] initWithString:document.string];
+            __block NSUInteger count = 0;
+            
+            [paragraphIndex enumerateParagraphsInRange:NSMakeRange(0, document.length) usingBlock:^(NSRange paragraphRange, BOOL *stop) {
+                count++;
+            }];
+            
+            XCTAssertGreaterThan(count, 0);
+        }];
+        
+        [self measureBenchmark:@"html-export" bytes:size iterations:iterations setUp:nil block:^{
+            XCTAssertGreaterThan([RichTextEditor htmlStringFromAttributedText:document].length, 0);
+        }];
+        
+        [self measureBenchmark:@"html-import" bytes:size iterations:iterations setUp:nil block:^{
+            XCTAssertNotNil([RichTextEditor attributedStringFromHTMLString:html]);
+        }];
+        
+        [self measureBenchmark:@"paste-normalize" bytes:size iterations:iterations setUp:nil block:^{
+            XCTAssertGreaterThan([RTEPasteNormalizer normalizedString:document.string].length, 0);
+        }];
+        
+        RTESearchIndex *searchIndex = [[RTESearchIndex alloc] initWithString:document.string];
+        
+        [self measureBenchmark:@"search-index-build" bytes:size iterations:iterations setUp:nil block:^{
+            XCTAssertEqual([[RTESearchIndex alloc] initWithString:document.string].length, size);
+        }];
+        
+        [self measureBenchmark:@"find-all" bytes:size iterations:iterations setUp:nil block:^{
+            __block NSUInteger count = 0;
+            
+            [searchIndex enumerateMatchesOfString:@"Consectetur Adipiscing" inString:document.string options:RTESearchOptionCaseInsensitive range:NSMakeRange(0, size) usingBlock:^(NSRange matchRange, BOOL *stop) {
+                count++;
+            }];
+        }];
+        
+        RTEFormatIndex *formatIndex = [[RTEFormatIndex alloc] initWithAttributedString:document];
+        
+        [self measureBenchmark:@"format-summary" bytes:size iterations:iterations setUp:nil block:^{
+            uint64_t state = kBenchmarkSeed;
+            RTEFormatAttributes any = 0;
+            
+            /// A drag selection over the document, one summary per mouse event.
+            for (NSUInteger event = 0; event < 1000; event++) {
+                any |= [formatIndex summaryOfRange:NSMakeRange(0, RTEBenchmarkNextRandom(&state) % (size + 1))].any;
+            }
+            
+            XCTAssertNotEqual(any, 0);
+        }];
+        
+        NSTextStorage *textStorage = [[NSTextStorage alloc] initWithAttributedString:document];
+        [textStorage attachDocumentSnapshots];
+        
+        [self measureBenchmark:@"document-snapshot" bytes:size iterations:iterations setUp:nil block:^{
+            uint64_t state = kBenchmarkSeed;
+            
+            /// Typing with an autosave snapshot after every keystroke.
+            for (NSUInteger keystroke = 0; keystroke < 100; keystroke++) {
+                [textStorage replaceCharactersInRange:NSMakeRange(RTEBenchmarkNextRandom(&state) % (textStorage.length + 1), 0) withString:@"x"];
+                XCTAssertNotNil([textStorage RTEDocumentSnapshot]);
+            }
+        }];
+        
+        NSTextStorage *exportedTextStorage = [[NSTextStorage alloc] initWithAttributedString:document];
+        [exportedTextStorage attachIncrementalHTMLExporter];
+        [[exportedTextStorage RTEIncrementalHTMLExporter] HTMLStringFromAttributedString:exportedTextStorage];
+        
+        [self measureBenchmark:@"html-export-incremental" bytes:size iterations:iterations setUp:^{
+            [exportedTextStorage replaceCharactersInRange:NSMakeRange(exportedTextStorage.length / 2, 0) withString:@"x"];
+        } block:^{
+            XCTAssertGreaterThan([[exportedTextStorage RTEIncrementalHTMLExporter] HTMLStringFromAttributedString:exportedTextStorage].length, 0);
+        }];
+        
+        [self measureBenchmark:@"html-load-first-chunk" bytes:size iterations:iterations setUp:nil block:^{
+            RTEProgressiveHTMLLoader *loader = [[RTEProgressiveHTMLLoader alloc] initWithHTMLString:html defaultAttributes:@{} firstChunkLength:16 * 1024 chunkLength:256 * 1024];
+            
+            [loader loadWithChunkHandler:^(NSAttributedString *chunk, NSUInteger index, BOOL isLastChunk) {
+                XCTAssertGreaterThan(chunk.length, 0);
+                [loader.progress cancel];
+            } completion:nil];
+        }];
+        
+        RTEEventBus *eventBus = [[RTEEventBus alloc] init];
+        NSUInteger numberOfEvents = MAX(size / 64, 1);
+        
+        [eventBus addSubscriberForEventTypes:RTEEditorEventTypeAll delivery:RTEEventDeliveryCoalesced handler:^(NSArray<RTEEditorEvent *> *events) {
+            XCTAssertGreaterThan(events.count, 0);
+        }];
+        
+        /// A key repeat and drag-select worth of events per frame, one text change and one selection change each.
+        [self measureBenchmark:@"event-bus-coalesce" bytes:size iterations:iterations setUp:nil block:^{
+            for (NSUInteger event = 0; event < numberOfEvents; event++) {
+                [eventBus postEventOfType:RTEEditorEventTypeTextChange detail:0 range:NSMakeRange(event, 1) changeInLength:1];
+                [eventBus postEventOfType:RTEEditorEventTypeSelectionChange detail:0 range:NSMakeRange(event + 1, 0) changeInLength:0];
+            }
+            
+            [eventBus flush];
+        }];
+        
+        [self measureBenchmark:@"is-html" bytes:size iterations:iterations setUp:nil block:^{
+            XCTAssertTrue([RichTextEditor isHTML:html]);
+        }];
+        
+        if (size > maximumEditorBytes) {
+            continue;
+        }
+        
+        NSView *parent = [[NSView alloc] initWithFrame:NSMakeRect(0, 0, 800, 600)];
+        RichTextEditor *editor = [RichTextEditor initWithParent:parent frame:parent.bounds];
+        void (^resetEditor)(void) = ^{
+            [editor setAttributedString:document];
+            [editor setSelectedRange:NSMakeRange(0, editor.string.length)];
+        };
+        
+        [self measureBenchmark:@"list-toggle" bytes:size iterations:iterations setUp:resetEditor block:^{
+            [editor userSelectedBulletedList];
+        }];
+        
+        [self measureBenchmark:@"indent" bytes:size iterations:iterations setUp:resetEditor block:^{
+            [editor userSelectedIncreaseIndent];
+        }];
+        
+        [self measureBenchmark:@"font-resize" bytes:size iterations:iterations setUp:resetEditor block:^{
+            [editor increaseFontSize];
+        }];
+        
+        /// Lays out and draws the first screen, which is where the list markers are placed.
+        NSBitmapImageRep *bitmap = [[NSBitmapImageRep alloc] initWithBitmapDataPlanes:NULL pixelsWide:800 pixelsHigh:600 bitsPerSample:8 samplesPerPixel:4 hasAlpha:YES isPlanar:NO colorSpaceName:NSDeviceRGBColorSpace bytesPerRow:0 bitsPerPixel:0];
+        NSGraphicsContext *graphicsContext = [NSGraphicsContext graphicsContextWithBitmapImageRep:bitmap];
+        
+        [self measureBenchmark:@"list-marker-layout" bytes:size iterations:iterations setUp:^{
+            [editor setAttributedString:document];
+        } block:^{
+            NSLayoutManager *layoutManager = editor.layoutManager;
+            NSTextContainer *textContainer = editor.textContainer;
+            [layoutManager ensureLayoutForBoundingRect:parent.bounds inTextContainer:textContainer];
+            NSRange glyphRange = [layoutManager glyphRangeForBoundingRect:parent.bounds inTextContainer:textContainer];
+            
+            [NSGraphicsContext saveGraphicsState];
+            [NSGraphicsContext setCurrentContext:graphicsContext];
+            [layoutManager drawGlyphsForGlyphRange:glyphRange atPoint:NSZeroPoint];
+            [NSGraphicsContext restoreGraphicsState];
+        }];
+    }
+}
+
+/// Applies numberOfEdits edits of the given kinds at random ranges up to maxLength long, the same ones on every run,
+/// and calls check after each with the range it replaced and the length of what replaced it.
+- (void)applyRandomEdits:(NSUInteger)numberOfEdits toTextStorage:(NSMutableAttributedString *)textStorage maxLength:(NSUInteger)maxLength kinds:(RTERandomEditKind)kinds check:(void (^)(NSUInteger edit, NSRange range, NSUInteger replacementLength))check {
+    [self applyRandomEdits:numberOfEdits toTextStorage:textStorage maxLength:maxLength kinds:kinds willEdit:nil check:check];
+}
+
+/// willEdit gets the range and the replacement string before each edit, like -[NSTextView shouldChangeTextInRange:replacementString:]
+/// the string is nil when only attributes change.
+- (void)applyRandomEdits:(NSUInteger)numberOfEdits toTextStorage:(NSMutableAttributedString *)textStorage maxLength:(NSUInteger)maxLength kinds:(RTERandomEditKind)kinds willEdit:(void (^)(NSUInteger edit, NSRange range, NSString *replacementString))willEdit check:(void (^)(NSUInteger edit, NSRange range, NSUInteger replacementLength))check {
+    NSArray<NSString *> *phrases = @[@"CAFE NAIVE lorem ", @"Lorem Ipsum\n", @"new\nlines & <markup>\n", @"x"];
+    NSFont *boldFont = [[NSFontManager sharedFontManager] convertFont:[NSFont fontWithName:@"Helvetica" size:12] toHaveTrait:NSFontBoldTrait];
+    NSMutableArray<NSNumber *> *allowedKinds = [[NSMutableArray alloc] init];
+    uint64_t state = kBenchmarkSeed;
+    
+    for (NSUInteger kind = RTERandomEditKindDelete; kind <= RTERandomEditKindRemoveLink; kind <<= 1) {
+        if ((kinds & kind) != 0) {
+            [allowedKinds addObject:@(kind)];
+        }
+    }
+    
+    for (NSUInteger edit = 0; edit < numberOfEdits; edit++) {
+        NSUInteger location = RTEBenchmarkNextRandom(&state) % (textStorage.length + 1);
+        NSUInteger length = MIN(RTEBenchmarkNextRandom(&state) % maxLength, textStorage.length - location);
+        NSRange range = NSMakeRange(location, length);
+        NSUInteger kind = allowedKinds[RTEBenchmarkNextRandom(&state) % allowedKinds.count].unsignedIntegerValue;
+        NSString *replacementString = nil;
+        NSDictionary *replacementAttributes = nil;
+        
+        switch (kind) {
+            case RTERandomEditKindDelete:
+                replacementString = @"";
+                break;
+            case RTERandomEditKindInsertText: {
+                NSUInteger phrase = RTEBenchmarkNextRandom(&state) % (phrases.count + 1);
+                replacementString = (phrase < phrases.count) ? phrases[phrase] : [@"" stringByPaddingToLength:RTEBenchmarkNextRandom(&state) % maxLength withString:@"dolor et " startingAtIndex:0];
+                break;
+            }
+            case RTERandomEditKindInsertBoldText:
+                replacementString = @"bold\nline";
+                replacementAttributes = @{NSFontAttributeName: boldFont};
+                break;
+            case RTERandomEditKindInsertFormatList:
+                range = NSMakeRange(location, 0);
+                replacementString = [NSString stringWithFormat:@"%C%C", (unichar)((RTEBenchmarkNextRandom(&state) % 2 == 0) ? 0x10 : 0x11), (unichar)0xA0];
+                break;
+            default:
+                break;
+        }
+        
+        if (willEdit != nil) {
+            willEdit(edit, range, replacementString);
+        }
+        
+        if (replacementAttributes != nil) {
+            [textStorage replaceCharactersInRange:range withAttributedString:[[NSAttributedString alloc] initWithString:replacementString attributes:replacementAttributes]];
+        } else if (replacementString != nil) {
+            [textStorage replaceCharactersInRange:range withString:replacementString];
+        } else if (kind == RTERandomEditKindUnderline) {
+            [textStorage addAttribute:NSUnderlineStyleAttributeName value:@(NSUnderlineStyleSingle) range:range];
+        } else {
+            [textStorage removeAttribute:NSLinkAttributeName range:range];
+        }
+        
+        check(edit, range, (replacementString != nil) ? replacementString.length : range.length);
+    }
+}
+
+- (NSAttributedString *)syntheticDocumentWithLength:(NSUInteger)length {
+    static NSArray<NSString *> *words = nil;
+    static dispatch_once_t onceToken;
+    
+    dispatch_once(&onceToken, ^{
+        words = @[@"lorem", @"ipsum", @"dolor", @"sit", @"amet", @"consectetur", @"adipiscing", @"elit", @"sed", @"do", @"eiusmod", @"tempor", @"incididunt", @"ut", @"labore", @"et", @"dolore", @"magna", @"aliqua", @"editor", @"paragraph", @"bullet", @"number", @"link"];
+    });
+    
+    NSArray<NSColor *> *colors = @[[NSColor blackColor], [NSColor darkGrayColor], [NSColor blueColor], [NSColor redColor]];
+    NSArray<NSNumber *> *fontSizes = @[@12, @14, @18];
+    NSString *bulletString = [NSString stringWithFormat:@"%C%C", (unichar)0x10, (unichar)0xA0];
+    NSString *numberingString = [NSString stringWithFormat:@"%C%C", (unichar)0x11, (unichar)0xA0];
+    NSFontManager *fontManager = [NSFontManager sharedFontManager];
+    NSMutableAttributedString *document = [[NSMutableAttributedString alloc] init];
+    uint64_t state = kBenchmarkSeed;
+    
+    [document beginEditing];
+    
+    while (document.length < length) {
+        uint64_t paragraphKind = RTEBenchmarkNextRandom(&state) % 100;
+        NSUInteger level = RTEBenchmarkNextRandom(&state) % 3;
+        NSMutableParagraphStyle *paragraphStyle = [[NSMutableParagraphStyle alloc] init];
+        NSUInteger paragraphStart = document.length;
+        
+        if (paragraphKind < 25) {
+            paragraphStyle.firstLineHeadIndent = 52 * (level + 1);
+            paragraphStyle.headIndent = paragraphStyle.firstLineHeadIndent + 15;
+            [document appendAttributedString:[[NSAttributedString alloc] initWithString:(paragraphKind < 15) ? bulletString : numberingString]];
+        }
+        
+        NSUInteger numberOfWords = 4 + RTEBenchmarkNextRandom(&state) % 40;
+        
+        for (NSUInteger i = 0; i < numberOfWords; i++) {
+            NSFont *font = [NSFont fontWithName:@"Helvetica" size:fontSizes[RTEBenchmarkNextRandom(&state) % fontSizes.count].doubleValue];
+            uint64_t style = RTEBenchmarkNextRandom(&state) % 16;
+            
+            if (style == 0) {
+                font = [fontManager convertFont:font toHaveTrait:NSFontBoldTrait];
+            } else if (style == 1) {
+                font = [fontManager convertFont:font toHaveTrait:NSFontItalicTrait];
+            }
+            
+            NSMutableDictionary<NSAttributedStringKey, id> *attributes = [@{NSFontAttributeName: font, NSForegroundColorAttributeName: colors[RTEBenchmarkNextRandom(&state) % colors.count]} mutableCopy];
+            NSString *word = words[RTEBenchmarkNextRandom(&state) % words.count];
+            
+            if (style == 2) {
+                attributes[NSLinkAttributeName] = [NSURL URLWithString:[NSString stringWithFormat:@"https://example.com/%@", word]];
+            }
+            
+            [document appendAttributedString:[[NSAttributedString alloc] initWithString:(i + 1 < numberOfWords) ? [word stringByAppendingString:@" "] : word attributes:attributes]];
+        }
+        
+        [document appendAttributedString:[[NSAttributedString alloc] initWithString:@"\n"]];
+        [document addAttribute:NSParagraphStyleAttributeName value:paragraphStyle range:NSMakeRange(paragraphStart, document.length - paragraphStart)];
+    }
+    
+    [document deleteCharactersInRange:NSMakeRange(length, document.length - length)];
+    [document endEditing];
+    
+    return document;
+}
+
+/// Runs block iterations times after an untimed warm-up, calling setUp untimed before each run, and records the timings in milliseconds.
+- (void)measureBenchmark:(NSString *)name bytes:(NSUInteger)bytes iterations:(NSUInteger)iterations setUp:(void (^)(void))setUp block:(void (^)(void))block {
+    NSMutableArray<NSNumber *> *samples = [[NSMutableArray alloc] initWithCapacity:iterations];
+    
+    for (NSUInteger i = 0; i <= iterations; i++) {
+        @autoreleasepool {
+            if (setUp != nil) {
+                setUp();
+            }
+            
+            uint64_t start = clock_gettime_nsec_np(CLOCK_UPTIME_RAW);
+            block();
+            uint64_t end = clock_gettime_nsec_np(CLOCK_UPTIME_RAW);
+            
+            if (i > 0) {
+                [samples addObject:@((double)(end - start) / NSEC_PER_MSEC)];
+            }
+        }
+    }
+    
+    NSArray<NSNumber *> *sortedSamples = [samples sortedArrayUsingSelector:@selector(compare:)];
+    
+    [self.results addObject:@{@"name": name,
+                              @"bytes": @(bytes),
+                              @"iterations": @(iterations),
+                              @"mean": [samples valueForKeyPath:@"@avg.self"],
+                              @"min": sortedSamples.firstObject,
+                              @"max": sortedSamples.lastObject,
+                              @"p50": @(RTEBenchmarkPercentile(sortedSamples, 0.50)),
+                              @"p90": @(RTEBenchmarkPercentile(sortedSamples, 0.90)),
+                              @"p99": @(RTEBenchmarkPercentile(sortedSamples, 0.99))}];
+}
+
+/// Writes the results to RTE_BENCHMARK_OUTPUT, or RichTextEditorBenchmarks.json in the temporary directory.
+- (void)writeResults {
+    NSString *path = [[NSProcessInfo processInfo] environment][@"RTE_BENCHMARK_OUTPUT"] ?: [NSTemporaryDirectory() stringByAppendingPathComponent:@"RichTextEditorBenchmarks.json"];
+    NSDictionary *report = @{@"unit": @"ms", @"seed": @(kBenchmarkSeed), @"results": self.results};
+    NSError *error = nil;
+    NSData *data = [NSJSONSerialization dataWithJSONObject:report options:NSJSONWritingPrettyPrinted error:&error];
+    
+    if ((data == nil) || ![data writeToFile:path options:NSDataWritingAtomic error:&error]) {
+        XCTFail(@"Couldn't write the benchmark results to %@: %@", path, error);
+        return;
+    }
+    
+    NSLog(@"%s [Line %d] Benchmark results written to %@", __PRETTY_FUNCTION__, __LINE__, path);
+}
+
+/// Fails every benchmark whose median regressed past the threshold against the report at RTE_BENCHMARK_BASELINE, a previous output of writeResults.
+- (void)compareResultsWithBaseline {
+    NSDictionary<NSString *, NSString *> *environment = [[NSProcessInfo processInfo] environment];
+    NSString *baselinePath = environment[@"RTE_BENCHMARK_BASELINE"];
+    
+    if (baselinePath == nil) {
+        return;
+    }
+    
+    double threshold = (environment[@"RTE_BENCHMARK_THRESHOLD"] != nil) ? environment[@"RTE_BENCHMARK_THRESHOLD"].doubleValue : kBenchmarkDefaultRegressionThreshold;
+    NSData *data = [NSData dataWithContentsOfFile:baselinePath];
+    NSDictionary *baseline = (data != nil) ? [NSJSONSerialization JSONObjectWithData:data options:0 error:nil] : nil;
+    
+    if (![baseline isKindOfClass:[NSDictionary class]] || ![baseline[@"results"] isKindOfClass:[NSArray class]]) {
+        XCTFail(@"Couldn't read the benchmark baseline at %@", baselinePath);
+        return;
+    }
+    
+    NSMutableDictionary<NSString *, NSNumber *> *baselineMedians = [[NSMutableDictionary alloc] init];
+    
+    for (NSDictionary *result in baseline[@"results"]) {
+        baselineMedians[[NSString stringWithFormat:@"%@/%@", result[@"name"], result[@"bytes"]]] = result[@"p50"];
+    }
+    
+    for (NSDictionary *result in self.results) {
+        NSString *key = [NSString stringWithFormat:@"%@/%@", result[@"name"], result[@"bytes"]];
+        double baselineMedian = baselineMedians[key].doubleValue;
+        double median = [result[@"p50"] doubleValue];
+        
+        if ((baselineMedian > 0) && (median > baselineMedian * (1 + threshold))) {
+            XCTFail(@"%@ regressed: median %.3f ms against a baseline of %.3f ms, over the %.0f%% threshold", key, median, baselineMedian, threshold * 100);
+        }
+    }
 }
 
 @end